@@ -49,6 +49,47 @@ internal static class MilCoreApi
             [DllImport(DllImport.MilCore, EntryPoint = "MilCompositionEngine_ExitMediaSystemLock")]
             internal static extern void ExitMediaSystemLock();
 
+            // Layout of MilFrameTiming in wgx_render_types.h. Fields are only
+            // ever appended; set cbSize to sizeof(MilFrameTiming) before calling
+            // GetFrameTimings.
+            [StructLayout(LayoutKind.Sequential)]
+            internal struct MilFrameTiming
+            {
+                internal uint cbSize;
+                internal ulong frameNumber;
+                internal ulong qpcFrameStart;
+                internal uint usProcessBatches;
+                internal uint usCompose;
+                internal uint usPreCompute;
+                internal uint usRender;
+                internal uint usPresent;
+                internal uint cBatchesProcessed;
+                internal uint cCommandsProcessed;
+                internal uint cDirtyRects;
+                internal uint cDirtyPixels;
+                internal uint cVisualCacheUpdates;
+                internal uint cScrolledAreas;
+                internal uint cAcceleratedScrolls;
+                internal uint cFusedEffects;
+                internal uint cbEffectIntermediatesSaved;
+                internal uint cEffectResultsReused;
+                internal uint cbEffectResultCache;
+                internal uint cGlyphRealizationHits;
+                internal uint cGlyphRealizationMisses;
+                internal uint cGlyphRealizationsTrimmed;
+                internal uint cbGlyphRealizations;
+                internal uint cbGlyphSubpixelVariants;
+                internal uint cFontFaceCacheHits;
+                internal uint cFontFaceCacheMisses;
+            }
+
+            [DllImport(DllImport.MilCore, EntryPoint = "MilCompositionEngine_GetFrameTimings")]
+            internal unsafe static extern int /* HRESULT */ GetFrameTimings(
+                uint cFramesMax,
+                MilFrameTiming* rgFrames,
+                out uint pcFrames,
+                out uint pcFramesDropped);
+
             [DllImport(DllImport.MilCore)]
             internal static extern int MilVersionCheck(
                 uint uiCallerMilSdkVersion
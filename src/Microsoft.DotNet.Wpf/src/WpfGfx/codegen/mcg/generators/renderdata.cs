@@ -1520,6 +1520,7 @@ public void BaseValueDrawingContextWalk(DrawingContextWalker ctx)
                             PVOID pItemData;
                             UINT nItemDataSize;
                             int stackDepth;
+                            RenderDataHandleBatch handleBatch;
 
                             //
                             // Set up the command enumeration.
@@ -1582,6 +1583,12 @@ public void BaseValueDrawingContextWalk(DrawingContextWalker ctx)
                                 IFC(WGXERR_UCE_MALFORMEDPACKET);
                             }
 
+                            //
+                            // Resolve all the collected resource handles at once
+                            //
+
+                            IFC(ResolveHandleBatch(pHandleTable, &handleBatch));
+
                         Cleanup:
 
                             Assert(SUCCEEDED(hr));
@@ -1640,7 +1647,7 @@ private string WriteUnmanagedGetHandle(McgRenderDataInstruction renderdataInstru
 
                     haveResourceFields = true;
 
-                    csFields.WriteBlock("IFC(AddHandleToArrayAndReplace(&(pData->h" + field.PropertyName + "), " + resource.MilTypeEnum + ", &m_rgpResources, pHandleTable));");
+                    csFields.WriteBlock("IFC(handleBatch.Add(&(pData->h" + field.PropertyName + "), " + resource.MilTypeEnum + "));");
                 }
                 // Handle animations, if appropriate
                 else if (doAdvancedParameters && field.IsAnimated)
@@ -1651,7 +1658,7 @@ private string WriteUnmanagedGetHandle(McgRenderDataInstruction renderdataInstru
 
                     haveResourceFields = true;
 
-                    csFields.WriteBlock("IFC(AddHandleToArrayAndReplace(&(pData->h" + field.PropertyName + "Animations), " + resource.MilTypeEnum + ", &m_rgpResources, pHandleTable));");
+                    csFields.WriteBlock("IFC(handleBatch.Add(&(pData->h" + field.PropertyName + "Animations), " + resource.MilTypeEnum + "));");
                 }
             }
 
@@ -21,6 +21,8 @@ bool CCPUInfo::m_fHasSSE       = false;
 bool CCPUInfo::m_fHasSSE2      = false;
 bool CCPUInfo::m_fHasCMPXCHG8B = false;
 bool CCPUInfo::m_fHasSSE2ForEffects = false;
+bool CCPUInfo::m_fHasAVXForEffects = false;
+bool CCPUInfo::m_fHasAVX2ForEffects = false;
 
 #if DBG
 bool CCPUInfo::m_fDbgIsInitialized = false;
@@ -57,6 +59,20 @@ void CCPUInfo::Initialize()
     m_fHasSSE2ForEffects = true;
 #endif
 
+    //
+    // IsProcessorFeaturePresent reports AVX only when the OS also preserves
+    // the YMM state across context switches.
+    //
+#if defined(PF_AVX_INSTRUCTIONS_AVAILABLE)
+    m_fHasAVXForEffects = m_fHasSSE2ForEffects
+        && !!IsProcessorFeaturePresent(PF_AVX_INSTRUCTIONS_AVAILABLE);
+#endif
+
+#if defined(PF_AVX2_INSTRUCTIONS_AVAILABLE)
+    m_fHasAVX2ForEffects = m_fHasAVXForEffects
+        && !!IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE);
+#endif
+
 #if DBG
     m_fDbgIsInitialized = true;
 #endif
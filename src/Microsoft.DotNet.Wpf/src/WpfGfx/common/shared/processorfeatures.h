@@ -52,6 +52,21 @@ public:
         AssertIsInitialized();
         return m_fHasSSE2ForEffects;
     }
+
+    // Supports AVX, and the OS saves the extended register state. Valid for
+    // both 32- and 64-bit builds.
+    static bool HasAVXForEffects()
+    {
+        AssertIsInitialized();
+        return m_fHasAVXForEffects;
+    }
+
+    // Supports AVX2 on top of HasAVXForEffects.
+    static bool HasAVX2ForEffects()
+    {
+        AssertIsInitialized();
+        return m_fHasAVX2ForEffects;
+    }
     
     static void AssertIsInitialized()
     {
@@ -67,6 +82,8 @@ private:
     static bool m_fHasSSE2; // supports SSE2 instructions (Pentium 4+)
     static bool m_fHasCMPXCHG8B; // supports cmpxchg8b instruction
     static bool m_fHasSSE2ForEffects; // supports SSE2 (both X86 and AMD64)
+    static bool m_fHasAVXForEffects; // supports AVX (both X86 and AMD64)
+    static bool m_fHasAVX2ForEffects; // supports AVX2 (both X86 and AMD64)
 
 #if DBG
     static bool m_fDbgIsInitialized;
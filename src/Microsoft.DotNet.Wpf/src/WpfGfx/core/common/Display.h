@@ -308,7 +308,7 @@ public:
                           ) const;
     
     HRESULT GetEnhancedContrastTable(float k, 
-                                     __deref_out_ecount(1) EnhancedContrastTable **ppTable
+                                     __deref_out_ecount(1) EnhancedContrastTable const** ppTable
                                      ) const;
 
 public:
@@ -355,8 +355,8 @@ private:
 
     DisplaySettings m_defaultDisplaySettings;
 
-    mutable GammaTable* m_prgGammaTables[MAX_GAMMA_INDEX+1];
-
+    // Tables for contrast levels that did not fit in the process wide
+    // tables of EnhancedContrastTable::GetShared
     mutable DynArray<EnhancedContrastTable *> m_pEnhancedContrastTables;
 
     IDWriteFactory *m_pIDWriteFactory;
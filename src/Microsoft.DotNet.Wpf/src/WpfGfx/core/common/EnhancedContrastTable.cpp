@@ -10,9 +10,13 @@
 //-----------------------------------------------------------------------------
 
 #include "precomp.hpp"
+#include <immintrin.h>
 
 MtDefine(EnhancedContrastTable, MILRender, "EnhancedContrastTable");
 
+EnhancedContrastTable EnhancedContrastTable::s_rgSharedTables[EnhancedContrastTable::s_cSharedTables];
+volatile LONG EnhancedContrastTable::s_rgSharedTableStates[EnhancedContrastTable::s_cSharedTables];
+
 //
 // In the alpha blending variant to enhance contrast, proposed by John Platt, alpha is replaced by alpha', defined as follows:
 //
@@ -45,6 +49,66 @@ EnhancedContrastTable::EnhancedContrastTable()
     // Set this variable to a bogus value. This class must be initialized
     // before use.
     m_k = FLOAT_QNAN;
+    m_fIsIdentity = false;
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      EnhancedContrastTable::GetShared
+//
+//  Synopsis:
+//      Returns the process wide table for contrast level k, building it if
+//      this is the first request for k. Returns NULL if all shared tables
+//      are in use by other contrast levels.
+//
+//-----------------------------------------------------------------------------
+
+__out_opt const EnhancedContrastTable *
+EnhancedContrastTable::GetShared(
+    float k
+    )
+{
+    for (UINT i = 0; i < s_cSharedTables; i++)
+    {
+        LONG state = s_rgSharedTableStates[i];
+
+        if (state == SharedTableEmpty)
+        {
+            state = InterlockedCompareExchange(
+                &s_rgSharedTableStates[i],
+                SharedTableInitializing,
+                SharedTableEmpty
+                );
+
+            if (state == SharedTableEmpty)
+            {
+                s_rgSharedTables[i].ReInit(k);
+                InterlockedExchange(&s_rgSharedTableStates[i], SharedTableReady);
+
+                return &s_rgSharedTables[i];
+            }
+        }
+
+        //
+        // Another thread is building this table, which may be the one we are
+        // looking for. Tables take microseconds to build, so just wait.
+        //
+        while (state == SharedTableInitializing)
+        {
+            YieldProcessor();
+            state = s_rgSharedTableStates[i];
+        }
+
+        Assert(state == SharedTableReady);
+
+        if (s_rgSharedTables[i].GetContrastValue() == k)
+        {
+            return &s_rgSharedTables[i];
+        }
+    }
+
+    return NULL;
 }
 
 //+----------------------------------------------------------------------------
@@ -65,6 +129,7 @@ EnhancedContrastTable::ReInit(
     Assert(k >= 0.0f);
 
     m_k = k;
+    m_fIsIdentity = (k == 0.0f);
 
     // Since we cast to and index into the table using BYTEs, ensure our max alpha
     // is 255.
@@ -96,6 +161,15 @@ EnhancedContrastTable::ReInit(
     // MaxSubpixelWeight always maps to s_MaxAlpha.
     // 
     m_table[s_MaxAlpha] = s_MaxAlpha;
+
+#if DBG
+    // ApplyTableAVX2 relies on the table never decreasing, which holds
+    // for any k >= 0
+    for (UINT alpha = 1; alpha <= s_MaxAlpha; ++alpha)
+    {
+        Assert(m_table[alpha] >= m_table[alpha - 1]);
+    }
+#endif
 }
 
 
@@ -107,6 +181,11 @@ EnhancedContrastTable::ReInit(
 //  Synopsis:
 //      Applies contrast enhancement to a buffer of alpha values.
 //
+//      Glyph alpha maps are mostly fully covered or empty pixels, which the
+//      table leaves unchanged, so with SSE2 runs of 16 such pixels are
+//      skipped rather than looked up. With AVX2 the other values are looked
+//      up 32 at a time.
+//
 //-----------------------------------------------------------------------------
 
 void
@@ -120,6 +199,11 @@ EnhancedContrastTable::RenormalizeAndApplyContrast(
 {
     Assert(m_k >= 0.0f);
 
+    if (m_fIsIdentity)
+    {
+        return;
+    }
+
     BYTE *pRow = buffer;
 
     //
@@ -127,14 +211,190 @@ EnhancedContrastTable::RenormalizeAndApplyContrast(
     // 
     __analysis_assume(width <= stride);
 
+    bool const fUseAVX2 = CCPUInfo::HasAVX2ForEffects();
+    bool const fUseSSE2 = CCPUInfo::HasSSE2ForEffects();
+
     for (UINT row = 0; row < height; row++)
     {
-        for (UINT i = 0; i < width; i++)
+        if (fUseAVX2)
         {
-            pRow[i] = m_table[pRow[i]];
+            ApplyTableAVX2(pRow, width);
+        }
+        else if (fUseSSE2)
+        {
+            ApplyTableSSE2(pRow, width);
+        }
+        else
+        {
+            ApplyTable(pRow, width);
         }
 
         pRow += stride;
     }
 }
 
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      EnhancedContrastTable::ApplyTable
+//
+//  Synopsis:
+//      Replaces each of count alpha values with its table entry
+//
+//-----------------------------------------------------------------------------
+
+void
+EnhancedContrastTable::ApplyTable(
+    __inout_ecount(count) BYTE *pValues,
+    UINT count
+    ) const
+{
+    for (UINT i = 0; i < count; i++)
+    {
+        pValues[i] = m_table[pValues[i]];
+    }
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      EnhancedContrastTable::ApplyTableSSE2
+//
+//  Synopsis:
+//      Same as ApplyTable, but skips blocks of 16 alpha values that are all
+//      0 or s_MaxAlpha, since the table maps those to themselves.
+//
+//-----------------------------------------------------------------------------
+
+void
+EnhancedContrastTable::ApplyTableSSE2(
+    __inout_ecount(count) BYTE *pValues,
+    UINT count
+    ) const
+{
+    Assert(m_table[0] == 0);
+    Assert(m_table[s_MaxAlpha] == s_MaxAlpha);
+
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const maxAlpha = _mm_cmpeq_epi8(zero, zero);
+
+    UINT i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i const values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pValues + i));
+
+        __m128i const unchanged = _mm_or_si128(
+            _mm_cmpeq_epi8(values, zero),
+            _mm_cmpeq_epi8(values, maxAlpha)
+            );
+
+        if (_mm_movemask_epi8(unchanged) != 0xFFFF)
+        {
+            ApplyTable(pValues + i, 16);
+        }
+    }
+
+    ApplyTable(pValues + i, count - i);
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      EnhancedContrastTable::ApplyTableAVX2
+//
+//  Synopsis:
+//      Same as ApplyTableSSE2, but looks up 32 alpha values at once with
+//      vpshufb, which selects an entry of a 16 byte row of the table by the
+//      low nibble of each value.
+//
+//      Every value is looked up in all 16 rows: rows 0-7 with the value,
+//      and rows 8-15 with the value minus 128, less 16 per row with signed
+//      saturation. That index is negative in the rows above the value's own
+//      row and in the other half of the table, which vpshufb maps to 0, and
+//      positive in its own row and the rows below, which give the entry for
+//      the value's low nibble in that row. Since the table never decreases,
+//      the largest of those is the entry of the value itself.
+//
+//-----------------------------------------------------------------------------
+
+void
+EnhancedContrastTable::ApplyTableAVX2(
+    __inout_ecount(count) BYTE *pValues,
+    UINT count
+    ) const
+{
+    Assert(m_table[0] == 0);
+    Assert(m_table[s_MaxAlpha] == s_MaxAlpha);
+
+    __m256i rgRows[16];
+
+    for (UINT row = 0; row < 16; row++)
+    {
+        rgRows[row] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(m_table + 16 * row))
+            );
+    }
+
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const maxAlpha = _mm256_cmpeq_epi8(zero, zero);
+    __m256i const upperHalf = _mm256_set1_epi8(static_cast<char>(0x80));
+    __m256i const nextRow = _mm256_set1_epi8(0x10);
+    __m256i const nextRowPair = _mm256_set1_epi8(0x20);
+
+    UINT i = 0;
+
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i const values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pValues + i));
+
+        __m256i const unchanged = _mm256_or_si256(
+            _mm256_cmpeq_epi8(values, zero),
+            _mm256_cmpeq_epi8(values, maxAlpha)
+            );
+
+        if (_mm256_movemask_epi8(unchanged) == -1)
+        {
+            continue;
+        }
+
+        //
+        // Even and odd rows of each half are looked up in separate chains,
+        // so that the maxima don't wait on each other
+        //
+        __m256i indexLowerEven = values;
+        __m256i indexUpperEven = _mm256_xor_si256(values, upperHalf);
+        __m256i indexLowerOdd = _mm256_subs_epi8(indexLowerEven, nextRow);
+        __m256i indexUpperOdd = _mm256_subs_epi8(indexUpperEven, nextRow);
+
+        __m256i lowerEven = _mm256_shuffle_epi8(rgRows[0], indexLowerEven);
+        __m256i upperEven = _mm256_shuffle_epi8(rgRows[8], indexUpperEven);
+        __m256i lowerOdd = _mm256_shuffle_epi8(rgRows[1], indexLowerOdd);
+        __m256i upperOdd = _mm256_shuffle_epi8(rgRows[9], indexUpperOdd);
+
+        for (UINT row = 2; row < 8; row += 2)
+        {
+            indexLowerEven = _mm256_subs_epi8(indexLowerEven, nextRowPair);
+            indexUpperEven = _mm256_subs_epi8(indexUpperEven, nextRowPair);
+            indexLowerOdd = _mm256_subs_epi8(indexLowerOdd, nextRowPair);
+            indexUpperOdd = _mm256_subs_epi8(indexUpperOdd, nextRowPair);
+
+            lowerEven = _mm256_max_epu8(lowerEven, _mm256_shuffle_epi8(rgRows[row], indexLowerEven));
+            upperEven = _mm256_max_epu8(upperEven, _mm256_shuffle_epi8(rgRows[row + 8], indexUpperEven));
+            lowerOdd = _mm256_max_epu8(lowerOdd, _mm256_shuffle_epi8(rgRows[row + 1], indexLowerOdd));
+            upperOdd = _mm256_max_epu8(upperOdd, _mm256_shuffle_epi8(rgRows[row + 9], indexUpperOdd));
+        }
+
+        __m256i const result = _mm256_max_epu8(
+            _mm256_max_epu8(lowerEven, upperEven),
+            _mm256_max_epu8(lowerOdd, upperOdd)
+            );
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pValues + i), result);
+    }
+
+    // Avoid the penalty of SSE code running with dirty upper YMM halves
+    _mm256_zeroupper();
+
+    ApplyTable(pValues + i, count - i);
+}
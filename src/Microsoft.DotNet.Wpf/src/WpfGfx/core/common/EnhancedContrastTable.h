@@ -32,6 +32,12 @@ MtExtern(EnhancedContrastTable);
 //      Class which helps to renormalize and apply enhanced contrast to a
 //      buffer.
 //
+//      Tables only depend on their contrast value, so GetShared hands out
+//      tables that are built once and kept for the lifetime of the process.
+//      Gamma is applied afterwards when blending, from the per gamma index
+//      tables of g_GammaHandler, so keying these tables on gamma as well
+//      would only build identical copies.
+//
 //-----------------------------------------------------------------------------
 
 class EnhancedContrastTable
@@ -45,6 +51,10 @@ public:
         float k
         );
 
+    static __out_opt const EnhancedContrastTable *GetShared(
+        float k
+        );
+
     float GetContrastValue() const
     {
         return m_k;
@@ -59,10 +69,43 @@ public:
         ) const;
 
 private:
+    void ApplyTable(
+        __inout_ecount(count) BYTE *pValues,
+        UINT count
+        ) const;
+
+    void ApplyTableSSE2(
+        __inout_ecount(count) BYTE *pValues,
+        UINT count
+        ) const;
+
+    void ApplyTableAVX2(
+        __inout_ecount(count) BYTE *pValues,
+        UINT count
+        ) const;
+
     float m_k;
     BYTE m_table[256];
 
+    // True when k is 0 and the table maps every alpha to itself
+    bool m_fIsIdentity;
+
     static const UINT s_MaxAlpha = DWRITE_ALPHA_MAX;
+
+    // Process wide tables handed out by GetShared. A slot is claimed by
+    // moving its state from Empty to Initializing, and may be read by other
+    // threads once its state is Ready.
+    enum SharedTableState
+    {
+        SharedTableEmpty,
+        SharedTableInitializing,
+        SharedTableReady
+    };
+
+    static const UINT s_cSharedTables = 16;
+
+    static EnhancedContrastTable s_rgSharedTables[s_cSharedTables];
+    static volatile LONG s_rgSharedTableStates[s_cSharedTables];
 };
 
 
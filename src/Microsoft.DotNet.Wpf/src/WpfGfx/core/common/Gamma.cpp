@@ -39,6 +39,28 @@ CGammaHandler::sc_gammaRatios[MAX_GAMMA_INDEX+1] =
     { 0.2031f/4.f, -1.3864f/4.f,  1.9851f/4.f, -0.3501f/4.f,    -0.4452f,  0.3667f,  0.2751f,  0.2883f, -0.6812f,  0.5567f}, // gamma = 2.2
 };
 
+//+------------------------------------------------------------------------
+//
+//  Function:   SmallRoundSSE2
+//
+//  Synopsis:   CFloatFPU::SmallRound for four values. Values are widened
+//              to double for the addition like the scalar version does.
+//
+//-------------------------------------------------------------------------
+static MIL_FORCEINLINE __m128i
+SmallRoundSSE2(
+    __m128 x,
+    __m128d roundingBias
+    )
+{
+    __m128 const low = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(x), roundingBias));
+    __m128 const high = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), roundingBias));
+
+    __m128i const bits = _mm_castps_si128(_mm_movelh_ps(low, high));
+
+    return _mm_srai_epi32(_mm_slli_epi32(bits, 10), 11);
+}
+
 // unique static instance of CGammaHandler
 CGammaHandler g_GammaHandler;
 
@@ -46,12 +68,26 @@ CGammaHandler g_GammaHandler;
 //
 //  Function:  CGammaHandler::CGammaHandler
 //
-//  Synopsis:  Construct hard coded gamma table
+//  Synopsis:  Construct the gamma tables for every gamma index, so that
+//             display sets never have to calculate their own
 //
 //-------------------------------------------------------------------------
 CGammaHandler::CGammaHandler()
 {
-    CalculateGammaTable(&m_hardCodedGammaTable, HardCodedGammaIndex);
+    // CCPUInfo is not initialized yet when the global handler is constructed
+    bool const fUseSSE2 = !!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+    for (UINT i = 0; i <= MAX_GAMMA_INDEX; i++)
+    {
+        if (fUseSSE2)
+        {
+            CalculateGammaTableSSE2(&m_rgGammaTables[i], i);
+        }
+        else
+        {
+            CalculateGammaTable(&m_rgGammaTables[i], i);
+        }
+    }
 }
 
 
@@ -84,7 +120,7 @@ CGammaHandler::CGammaHandler()
 void
 CGammaHandler::CalculateGammaTable(
     __out_ecount(1) GammaTable * pTable,
-    __range(1, MAX_GAMMA_INDEX) UINT uiGammaIndex)
+    __range(0, MAX_GAMMA_INDEX) UINT uiGammaIndex)
 {
     // ensure right FPU rounding mode
     CFloatFPU oGuard;
@@ -122,4 +158,82 @@ CGammaHandler::CalculateGammaTable(
     }
 }
 
+//+------------------------------------------------------------------------
+//
+//  Function:   CGammaHandler::CalculateGammaTableSSE2
+//
+//  Synopsis:   Same as CalculateGammaTable, four alpha values at a time.
+//
+//              The polynomials are evaluated in the same order as the
+//              scalar code, and rounding repeats CFloatFPU::SmallRound,
+//              including its addition in double precision, so the tables
+//              are identical.
+//
+//-------------------------------------------------------------------------
+void
+CGammaHandler::CalculateGammaTableSSE2(
+    __out_ecount(1) GammaTable * pTable,
+    __range(0, MAX_GAMMA_INDEX) UINT uiGammaIndex)
+{
+    C_ASSERT(sizeof(GammaTable::Row) == sizeof(WORD));
+
+    const GammaRatios *pRatios = &sc_gammaRatios[uiGammaIndex];
+
+    static const float norm13 = (float)(double(0x10000)/(255*255)*4);
+    static const float norm24 = (float)(double(0x100  )/(255    )*4);
+    __m128 const g1 = _mm_set1_ps(norm13*pRatios->g1);
+    __m128 const g2 = _mm_set1_ps(norm24*pRatios->g2);
+    __m128 const g3 = _mm_set1_ps(norm13*pRatios->g3);
+    __m128 const g4 = _mm_set1_ps(norm24*pRatios->g4);
+
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const scale = _mm_set1_ps(float(1./255));
+    __m128 const maxValue = _mm_set1_ps(float(0xFF));
+    __m128d const roundingBias = _mm_set1_pd(0x00600000+.25);
+
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i const indexStep = _mm_set1_epi32(4);
+
+#if DBG
+    __m128i const outOfRange = _mm_set1_epi32(~0xFF);
+    static bool fAssertionReported = false;
+#endif //DBG
+
+    for (int i = 0; i < 256; i += 4)
+    {
+        __m128 const a = _mm_mul_ps(_mm_cvtepi32_ps(index), scale);
+        __m128 const a1a = _mm_mul_ps(a, _mm_sub_ps(one, a));
+
+        __m128 const f1 = _mm_add_ps(a, _mm_mul_ps(a1a, _mm_add_ps(_mm_mul_ps(g2, a), g4)));
+        __m128 const f2 = _mm_mul_ps(a1a, _mm_add_ps(_mm_mul_ps(g1, a), g3));
+
+        __m128i const if1 = SmallRoundSSE2(_mm_mul_ps(f1, maxValue), roundingBias);
+        __m128i const if2 = SmallRoundSSE2(_mm_mul_ps(f2, maxValue), roundingBias);
+
+        // Can't use Assert() because this code works at dll startup time
+#if DBG
+        __m128i const fInRange = _mm_cmpeq_epi32(
+            _mm_and_si128(_mm_or_si128(if1, if2), outOfRange),
+            _mm_setzero_si128()
+            );
+
+        if (!fAssertionReported && _mm_movemask_epi8(fInRange) != 0xFFFF)
+        {
+            MessageBox(NULL, _T("CGammaHandler::CalculateGammaTableSSE2()"), _T("Assertion"), MB_OK);
+            fAssertionReported = true;
+        }
+#endif //DBG
+
+        // Pack to f1 f1 f1 f1 f2 f2 f2 f2 and interleave into four rows
+        __m128i const values = _mm_packus_epi16(_mm_packs_epi32(if1, if2), _mm_setzero_si128());
+
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i *>(&pTable->Polynom[i]),
+            _mm_unpacklo_epi8(values, _mm_srli_si128(values, 4))
+            );
+
+        index = _mm_add_epi32(index, indexStep);
+    }
+}
+
 
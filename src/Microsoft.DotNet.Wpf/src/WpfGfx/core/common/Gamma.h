@@ -84,9 +84,22 @@ public:
     CGammaHandler::CGammaHandler();
     static void CalculateGammaTable(
         __out_ecount(1) GammaTable * pTable,
-        __range(1, MAX_GAMMA_INDEX) UINT uiGammaIndex);
+        __range(0, MAX_GAMMA_INDEX) UINT uiGammaIndex);
 
-    GammaTable m_hardCodedGammaTable;
+    static void CalculateGammaTableSSE2(
+        __out_ecount(1) GammaTable * pTable,
+        __range(0, MAX_GAMMA_INDEX) UINT uiGammaIndex);
+
+    const GammaTable *GetGammaTable(
+        __range(0, MAX_GAMMA_INDEX) UINT uiGammaIndex) const
+    {
+        Assert(uiGammaIndex <= MAX_GAMMA_INDEX);
+        return &m_rgGammaTables[uiGammaIndex];
+    }
+
+private:
+    // Tables for every gamma index, calculated once at dll startup
+    GammaTable m_rgGammaTables[MAX_GAMMA_INDEX+1];
 };
 
 // unique static instance of CGammaHandler
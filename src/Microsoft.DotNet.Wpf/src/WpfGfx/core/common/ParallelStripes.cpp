@@ -0,0 +1,171 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      Splits a range of independent items into stripes that are processed
+//      on the process thread pool.
+//
+//-----------------------------------------------------------------------------
+
+#include "precomp.hpp"
+
+UINT CParallelStripes::s_cProcessors = 0;
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      CParallelStripes::GetStripeCount
+//
+//  Synopsis:
+//      Returns the number of stripes to split cItems into: at most one per
+//      processor, each with at least cMinItemsPerStripe items. Returns 1 when
+//      the range is not worth splitting.
+//
+//-----------------------------------------------------------------------------
+
+UINT
+CParallelStripes::GetStripeCount(
+    UINT cItems,
+    UINT cMinItemsPerStripe
+    )
+{
+    UINT cStripes = cItems / max(cMinItemsPerStripe, 1u);
+
+    cStripes = min(cStripes, GetProcessorCount());
+
+    return max(cStripes, 1u);
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      CParallelStripes::Run
+//
+//  Synopsis:
+//      Calls pfnStripe once for each of cStripes contiguous stripes of
+//      [0, cItems). The calling thread processes stripes too, so a single
+//      stripe, or a failure to reach the thread pool, runs synchronously.
+//
+//-----------------------------------------------------------------------------
+
+void
+CParallelStripes::Run(
+    UINT cStripes,
+    UINT cItems,
+    __in PFNSTRIPECALLBACK pfnStripe,
+    __in void *pvContext
+    )
+{
+    Work work;
+    work.pfnStripe = pfnStripe;
+    work.pvContext = pvContext;
+    work.cItems = cItems;
+    work.cStripes = max(min(cStripes, cItems), 1u);
+    work.cStripesClaimed = 0;
+
+    PTP_WORK pThreadpoolWork = NULL;
+
+    if (work.cStripes > 1)
+    {
+        pThreadpoolWork = CreateThreadpoolWork(ThreadpoolWorkCallback, &work, NULL);
+    }
+
+    if (pThreadpoolWork != NULL)
+    {
+        // The calling thread takes one of the stripes itself
+        for (UINT i = 1; i < work.cStripes; i++)
+        {
+            SubmitThreadpoolWork(pThreadpoolWork);
+        }
+    }
+
+    ProcessStripes(&work);
+
+    if (pThreadpoolWork != NULL)
+    {
+        // Stripes are claimed dynamically, so callbacks that start late
+        // find nothing left to do and return immediately.
+        WaitForThreadpoolWorkCallbacks(pThreadpoolWork, FALSE);
+        CloseThreadpoolWork(pThreadpoolWork);
+    }
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      CParallelStripes::ProcessStripes
+//
+//  Synopsis:
+//      Processes stripes until none are left to claim.
+//
+//-----------------------------------------------------------------------------
+
+void
+CParallelStripes::ProcessStripes(
+    __inout_ecount(1) Work *pWork
+    )
+{
+    for (;;)
+    {
+        UINT iStripe = static_cast<UINT>(InterlockedIncrement(&pWork->cStripesClaimed) - 1);
+
+        if (iStripe >= pWork->cStripes)
+        {
+            break;
+        }
+
+        UINT iFirst = static_cast<UINT>(static_cast<UINT64>(pWork->cItems) * iStripe / pWork->cStripes);
+        UINT iEnd = static_cast<UINT>(static_cast<UINT64>(pWork->cItems) * (iStripe + 1) / pWork->cStripes);
+
+        pWork->pfnStripe(pWork->pvContext, iStripe, iFirst, iEnd);
+    }
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      CParallelStripes::ThreadpoolWorkCallback
+//
+//-----------------------------------------------------------------------------
+
+VOID CALLBACK
+CParallelStripes::ThreadpoolWorkCallback(
+    __inout PTP_CALLBACK_INSTANCE pInstance,
+    __inout_opt PVOID pvWork,
+    __inout PTP_WORK pThreadpoolWork
+    )
+{
+    UNREFERENCED_PARAMETER(pInstance);
+    UNREFERENCED_PARAMETER(pThreadpoolWork);
+
+    ProcessStripes(static_cast<Work *>(pvWork));
+}
+
+//+----------------------------------------------------------------------------
+//
+//  Member:
+//      CParallelStripes::GetProcessorCount
+//
+//-----------------------------------------------------------------------------
+
+UINT
+CParallelStripes::GetProcessorCount()
+{
+    if (s_cProcessors == 0)
+    {
+        // Racing initializations all store the same value
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+
+        s_cProcessors = max(static_cast<UINT>(sysInfo.dwNumberOfProcessors), 1u);
+    }
+
+    return s_cProcessors;
+}
+
@@ -0,0 +1,81 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      Splits a range of independent items, such as the lines of a software
+//      effect pass, into stripes that are processed on the process thread
+//      pool.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+//
+// Processes items [iFirst, iEnd) of the range. iStripe is in [0, cStripes)
+// and lets the callback pick per stripe scratch memory.
+//
+typedef void (*PFNSTRIPECALLBACK)(
+    __in void *pvContext,
+    UINT iStripe,
+    UINT iFirst,
+    UINT iEnd
+    );
+
+//+----------------------------------------------------------------------------
+//
+//  Class:
+//      CParallelStripes
+//
+//  Synopsis:
+//      Runs a callback over the stripes of a range, on the calling thread and
+//      on thread pool workers, and returns once every stripe has completed.
+//      Consecutive calls therefore act as a barrier between dependent passes.
+//
+//-----------------------------------------------------------------------------
+
+class CParallelStripes
+{
+public:
+    static UINT GetStripeCount(
+        UINT cItems,
+        UINT cMinItemsPerStripe
+        );
+
+    static void Run(
+        UINT cStripes,
+        UINT cItems,
+        __in PFNSTRIPECALLBACK pfnStripe,
+        __in void *pvContext
+        );
+
+private:
+    struct Work
+    {
+        PFNSTRIPECALLBACK pfnStripe;
+        void *pvContext;
+        UINT cItems;
+        UINT cStripes;
+        volatile LONG cStripesClaimed;
+    };
+
+    static void ProcessStripes(
+        __inout_ecount(1) Work *pWork
+        );
+
+    static VOID CALLBACK ThreadpoolWorkCallback(
+        __inout PTP_CALLBACK_INSTANCE pInstance,
+        __inout_opt PVOID pvWork,
+        __inout PTP_WORK pThreadpoolWork
+        );
+
+    static UINT GetProcessorCount();
+
+    static UINT s_cProcessors;
+};
+
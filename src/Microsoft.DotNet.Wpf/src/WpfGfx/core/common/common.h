@@ -74,6 +74,7 @@
 #include "memblockreader.h"
 
 #include "slistutil.h"
+#include "ParallelStripes.h"
 
 #include "typeconvert.inl"
 #include "dump.h"
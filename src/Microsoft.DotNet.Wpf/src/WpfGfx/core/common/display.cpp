@@ -890,7 +890,6 @@ CDisplaySet::CDisplaySet(
         m_rcDisplayBounds[dpiContextValue].SetEmpty();
     }
 
-    ZeroMemory(&m_prgGammaTables, sizeof(m_prgGammaTables));
     ZeroMemory(&m_commonMinCaps, sizeof(MilGraphicsAccelerationCaps));
     // m_defaultDisplaySettings remains uninitialized
 }
@@ -906,15 +905,6 @@ CDisplaySet::~CDisplaySet()
 {
     Assert(m_cRef == 0);
 
-    for (int i = 0; i <= MAX_GAMMA_INDEX; i++)
-    {
-        GammaTable* pTable = m_prgGammaTables[i];
-        if (pTable)
-        {
-            WPFFree(ProcessHeap, pTable);
-        }
-    }
-
     UINT count = m_pEnhancedContrastTables.GetCount();
     for (UINT k = 0; k < count; k++)
     {
@@ -1871,38 +1861,47 @@ Cleanup:
 //
 //-------------------------------------------------------------------------
 HRESULT
-CDisplaySet::GetEnhancedContrastTable(float k, __deref_out_ecount(1) EnhancedContrastTable **ppTable) const
+CDisplaySet::GetEnhancedContrastTable(float k, __deref_out_ecount(1) EnhancedContrastTable const** ppTable) const
 {
     HRESULT hr = S_OK;
 
     EnhancedContrastTable *pTable = NULL;
     *ppTable = NULL;
 
-    for (UINT i = 0; i < m_pEnhancedContrastTables.GetCount(); i++)
+    //
+    // Tables only depend on k, so they are shared by all display sets and
+    // built once per process. We expect that there should never be many ECTs
+    // during one process lifetime. There will be at most one for GDI
+    // compatible text with contrast boost (k value of 0.5), and two for each
+    // monitor for natural text (the contrast value for that monitor as
+    // specified by the registry, and a boosted contrast value for particular
+    // fonts for that monitor)
+    //
+    const EnhancedContrastTable *pSharedTable = EnhancedContrastTable::GetShared(k);
+    if (pSharedTable != NULL)
     {
-        if (m_pEnhancedContrastTables[i]->GetContrastValue() == k)
-        {
-            pTable = m_pEnhancedContrastTables[i];
-            break;
-        }
+        *ppTable = pSharedTable;
+        goto Cleanup;
     }
 
     //
-    // If we didn't find an entry, add one.
-    // This list grows linearly, and thus search will be O(n), however we expect
-    // that there should never be many ECTs during one process lifetime. There will be
-    // at most one for GDI compatible text with contrast boost (k value of
-    // 0.5), and two for each monitor for natural text (the contrast value for that monitor as specified
-    // by the registry, and a boosted contrast value for particular fonts for that monitor)
+    // All shared tables are in use, so fall back to a list owned by this
+    // display set. This list grows linearly, and thus search will be O(n).
     //
-    if (pTable == NULL)
+    for (UINT i = 0; i < m_pEnhancedContrastTables.GetCount(); i++)
     {
-        pTable = new EnhancedContrastTable();
-        IFCOOM(pTable);
-        pTable->ReInit(k);
-        IFC(m_pEnhancedContrastTables.Add(pTable));
+        if (m_pEnhancedContrastTables[i]->GetContrastValue() == k)
+        {
+            *ppTable = m_pEnhancedContrastTables[i];
+            goto Cleanup;
+        }
     }
 
+    pTable = new EnhancedContrastTable();
+    IFCOOM(pTable);
+    pTable->ReInit(k);
+    IFC(m_pEnhancedContrastTables.Add(pTable));
+
     *ppTable = pTable;
     pTable = NULL;
 
@@ -1925,21 +1924,13 @@ CDisplaySet::GetGammaTable(UINT gammaIndex, __deref_out_ecount(1) GammaTable con
 {
     HRESULT hr = S_OK;
 
-    // Check if we already have suitable gamma table.
-    GammaTable *& pTable = m_prgGammaTables[gammaIndex];
-    if (pTable == NULL)
+    if (gammaIndex > MAX_GAMMA_INDEX)
     {
-        // No luck. Need to allocate and fill with data.
-        pTable = WPFAllocType(GammaTable *,
-            ProcessHeap,
-            Mt(CDisplaySet),
-            sizeof(GammaTable)
-            );
-        IFCOOM(pTable);
-        CGammaHandler::CalculateGammaTable(pTable, gammaIndex);
+        IFC(E_INVALIDARG);
     }
 
-    *ppTable = pTable;
+    // Gamma tables are calculated for every index when the dll loads
+    *ppTable = g_GammaHandler.GetGammaTable(gammaIndex);
 
 Cleanup:
     RRETURN(hr);
@@ -98,6 +98,10 @@ CGlyphPainterMemory::CleanHuge()
     {
         m_alphaArray.Clean();
     }
+    if (m_runBitmap.GetSize() > tooMuch)
+    {
+        m_runBitmap.Clean();
+    }
 }
 
 
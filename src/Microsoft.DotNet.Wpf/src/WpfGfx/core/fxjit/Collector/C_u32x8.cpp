@@ -0,0 +1,302 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      SIMD operations on vectors of 8 32-bit values.
+//
+//-----------------------------------------------------------------------------
+
+#include "precomp.h"
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::C_u32x8
+//
+//  Synopsis:
+//      Constructor: just allocate variable ID of vtYmm type.
+//
+//------------------------------------------------------------------------------
+C_u32x8::C_u32x8()
+{
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    m_ID = pProgram->AllocVar(vtYmm);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::C_u32x8
+//
+//  Synopsis:
+//      Copy constructor.
+//      Serves statements like following:
+//          C_u32x8 x = <C_u32x8 expression>;
+//
+//------------------------------------------------------------------------------
+C_u32x8::C_u32x8(C_u32x8 const &src)
+{
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    m_ID = pProgram->AllocVar(vtYmm);
+    pProgram->AddOperator(otYmmAssign, m_ID, src.m_ID);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::operator=
+//
+//  Synopsis:
+//      Serves statements like following:
+//          x = y;
+//      where "x" and "y" are C_u32x8 variables declared before.
+//
+//------------------------------------------------------------------------------
+C_u32x8 const &
+C_u32x8::operator=(C_u32x8 const& src)
+{
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(otYmmAssign, m_ID, src.m_ID);
+    return *this;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::BinaryOperation
+//
+//  Synopsis:
+//      Serves binary operations like "+" etc.
+//
+//------------------------------------------------------------------------------
+C_u32x8
+C_u32x8::BinaryOperation(OpType ot, C_u32x8 const& other) const
+{
+    AssertAVX2();
+    C_u32x8 tmp;
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(ot, tmp.GetID(), GetID(), other.m_ID);
+    return tmp;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::BinaryAssignment
+//
+//  Synopsis:
+//      Serves binary operations like "+=" etc.
+//
+//------------------------------------------------------------------------------
+C_u32x8 &
+C_u32x8::BinaryAssignment(OpType ot, C_u32x8 const& other)
+{
+    AssertAVX2();
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(ot, m_ID, m_ID, other.m_ID);
+    return *this;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::operator>>
+//
+//  Synopsis:
+//      Performs per-component logical shift right.
+//
+//  Usage example:
+//      C_u32x8 a = ...;
+//      C_u32x8 b = a >> 8;
+//
+//  Assembler: vpsrld
+//  Intrinsic: _mm256_srli_epi32
+//
+//------------------------------------------------------------------------------
+C_u32x8
+C_u32x8::operator>>(int shift) const
+{
+    AssertAVX2();
+    C_u32x8 tmp;
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    SOperator *pOperator = pProgram->AddOperator(otYmmDWordsShiftRight, tmp.GetID(), m_ID);
+    pOperator->m_shift = shift;
+    return tmp;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::SetZero
+//
+//  Synopsis:
+//      Fill data with zeros.
+//
+//  Assembler: vpxor
+//  Intrinsic: _mm256_setzero_si256
+//
+//------------------------------------------------------------------------------
+C_u32x8 &
+C_u32x8::SetZero()
+{
+    AssertAVX2();
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(otYmmSetZero, m_ID);
+    return *this;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::LoadUnpackBytes
+//
+//  Synopsis:
+//      Load 8 bytes, two 32-bit values, from memory and zero extend each
+//      byte to 32 bits.
+//
+//  Usage example:
+//      P_u32 p = ...;   // points to 0xAARRGGBB, 0xaarrggbb
+//      C_u32x8 a;
+//      a.LoadUnpackBytes(p);
+//      Result: a = {0xaa, 0xrr, 0xgg, 0xbb, 0xAA, 0xRR, 0xGG, 0xBB}
+//
+//  Assembler: vpmovzxbd
+//  Intrinsic: _mm256_cvtepu8_epi32
+//
+//------------------------------------------------------------------------------
+C_u32x8 &
+C_u32x8::LoadUnpackBytes(P_u32 const& ptr)
+{
+    AssertAVX2();
+    C_pVoid::AddOperator(otYmmBytesUnpackToDWords, m_ID, ptr.GetID(), 0, 0, RefType_Base, 0);
+    return *this;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::Broadcast
+//
+//  Synopsis:
+//      Produces 256-bit value containing 8 copies of given 32-bit value
+//      in memory.
+//
+//  Usage example:
+//      P_u32 p = ...;
+//      C_u32 i = ...;
+//      C_u32x8 a = C_u32x8::Broadcast(p[i]);
+//
+//  Assembler: vpbroadcastd
+//  Intrinsic: _mm256_set1_epi32
+//
+//------------------------------------------------------------------------------
+C_u32x8
+C_u32x8::Broadcast(R_u32 const& ref)
+{
+    AssertAVX2();
+    C_u32x8 tmp;
+
+    if (ref.m_uIndexVarID == 0)
+    {
+        C_pVoid::AddOperator(otYmmDWordsBroadcast, tmp.GetID(), ref.m_uBaseVarID, 0, 0, RefType_Base, ref.m_uDisplacement);
+    }
+    else
+    {
+        C_pVoid::AddOperator(otYmmDWordsBroadcast, tmp.GetID(), ref.m_uBaseVarID, ref.m_uIndexVarID, 0, R_u32::IndexScale, ref.m_uDisplacement);
+    }
+
+    return tmp;
+}
+
+C_u32x8
+C_u32x8::Broadcast(UINT32 const& src)
+{
+    AssertAVX2();
+    C_u32x8 tmp;
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    SOperator *pOperator = pProgram->AddOperator(otYmmDWordsBroadcast, tmp.GetID());
+    pOperator->m_refType = RefType_Static;
+    pOperator->m_uDisplacement = pProgram->SnapData(src);
+    return tmp;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::GetLow
+//
+//  Synopsis:
+//      Fetch low 128 bits.
+//
+//  Assembler: vmovdqa, or nothing
+//  Intrinsic: _mm256_castsi256_si128
+//
+//------------------------------------------------------------------------------
+C_u32x4
+C_u32x8::GetLow() const
+{
+    C_u32x4 tmp;
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(otYmmGetLow, tmp.GetID(), m_ID);
+    return tmp;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::GetHigh
+//
+//  Synopsis:
+//      Fetch high 128 bits.
+//
+//  Assembler: vextracti128
+//  Intrinsic: _mm256_extracti128_si256
+//
+//------------------------------------------------------------------------------
+C_u32x4
+C_u32x8::GetHigh() const
+{
+    AssertAVX2();
+    C_u32x4 tmp;
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(otYmmGetHigh, tmp.GetID(), m_ID);
+    return tmp;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      C_u32x8::ZeroUpper
+//
+//  Synopsis:
+//      Zero the upper halves of all YMM registers, so that the legacy SSE
+//      code that follows runs at full speed. C_u32x4 values are not affected,
+//      but no C_u32x8 value may be used after this call before being set again.
+//
+//  Assembler: vzeroupper
+//  Intrinsic: _mm256_zeroupper
+//
+//------------------------------------------------------------------------------
+void
+C_u32x8::ZeroUpper()
+{
+    CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    pProgram->AddOperator(otYmmZeroUpper);
+}
+
+#if DBG
+void
+C_u32x8::AssertAVX2()
+{
+    const CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    WarpAssert(pProgram);
+    WarpAssert(pProgram->m_fUseAVX2);
+}
+#endif
+
@@ -136,6 +136,25 @@ CJitterAccess::GetCodeSize()
     return pProgram->GetCodeSize();
 }
 
+//+------------------------------------------------------------------------------
+//
+//  Member:
+//      CJitterAccess::GetBinarySize
+//
+//  Synopsis:
+//      Return the size of the whole memory block obtained by recent
+//      CJitterAccess::Compile() call, including static data that follow
+//      the code.
+//
+//-------------------------------------------------------------------------------
+UINT32
+CJitterAccess::GetBinarySize()
+{
+    const CProgram * pProgram = WarpPlatform::GetCurrentProgram();
+    WarpAssert(pProgram);
+    return pProgram->GetBinarySize();
+}
+
 //+------------------------------------------------------------------------------
 //
 //  Member:
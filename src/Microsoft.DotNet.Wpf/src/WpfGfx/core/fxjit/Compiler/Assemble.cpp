@@ -16,11 +16,12 @@
 
 static const UINT32 uPageSize = 4096;
 
-CAssembleContext::CAssembleContext(CMapper const & mapper, bool fUseNegativeStackOffsets)
+CAssembleContext::CAssembleContext(CMapper const & mapper, bool fUseNegativeStackOffsets, bool fUseVex)
 : m_mapper(mapper)
 {
     m_uOperatorFlags = 0;
     m_uEspOffset = fUseNegativeStackOffsets ? 128 : 0;
+    m_fUseVex = fUseVex;
 }
 
 #if WPFGFX_FXJIT_X86
@@ -209,12 +210,13 @@ CAssembleContext::GetOffset(UINT32 uVarID) const
 CAssemblePass2::CAssemblePass2(
         CMapper const & mapper,
         bool fUseNegativeStackOffsets,
+        bool fUseVex,
         UINT8 * pData,
         INT_PTR uStatic4Offset,
         INT_PTR uStatic8Offset,
         INT_PTR uStatic16Offset
         )
-        : CAssembleContext(mapper, fUseNegativeStackOffsets)
+        : CAssembleContext(mapper, fUseNegativeStackOffsets, fUseVex)
         , m_pData(pData)
         , m_uStatic4Offset(uStatic4Offset)
         , m_uStatic8Offset(uStatic8Offset)
@@ -42,7 +42,7 @@ class CMapper;
 class CAssembleContext : public CCoder86
 {
 public:
-    CAssembleContext(CMapper const & mapper, bool fUseNegativeStackOffsets);
+    CAssembleContext(CMapper const & mapper, bool fUseNegativeStackOffsets, bool fUseVex);
     void AssemblePrologue(
         __in UINT32 uFrameSize,
         __in UINT32 uFrameAlignment
@@ -70,6 +70,10 @@ public:
 
     UINT32 GetEspOffset() const { return m_uEspOffset; }
 
+    // Whether XMM operations may be encoded with VEX prefixes, which
+    // requires AVX. See COperator::CanUseVex().
+    bool UsesVex() const { return m_fUseVex; }
+
 public:
     // Offset from ebp to 1st argument, see AssemblePrologue().
 #if WPFGFX_FXJIT_X86
@@ -90,6 +94,7 @@ protected:
 private:
     COperator *m_pCurrentOperator;
     UINT32 m_uOperatorFlags;
+    bool m_fUseVex;
 };
 
 //+-----------------------------------------------------------------------------
@@ -106,7 +111,9 @@ private:
 class CAssemblePass1 : public CAssembleContext
 {
 public:
-    CAssemblePass1(CMapper const & mapper, bool fUseNegativeStackOffsets) : CAssembleContext(mapper, fUseNegativeStackOffsets) {}
+    CAssemblePass1(CMapper const & mapper, bool fUseNegativeStackOffsets, bool fUseVex)
+        : CAssembleContext(mapper, fUseNegativeStackOffsets, fUseVex)
+    {}
 
     void Emit(UINT32 /*data*/) {m_uCount++;}
     void Emit4(UINT32 /*data*/) {m_uCount += 4;}
@@ -143,6 +150,7 @@ public:
     CAssemblePass2(
         CMapper const & mapper,
         bool fUseNegativeStackOffsets,
+        bool fUseVex,
         UINT8 * pData,
         INT_PTR uStatic4Offset,
         INT_PTR uStatic8Offset,
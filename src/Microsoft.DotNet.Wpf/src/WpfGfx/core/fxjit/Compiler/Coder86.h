@@ -429,6 +429,9 @@ enum OpCode : UINT32
     movdqa_mr = OPCODE(Prefix_660F, 0x7F),
     movdqa_rr = movdqa_rm,
 
+    movdqu_rm = OPCODE(Prefix_F30F, 0x6F),
+    movdqu_mr = OPCODE(Prefix_F30F, 0x7F),
+
     andpd     = OPCODE(Prefix_660F, 0x54),
     andnpd    = OPCODE(Prefix_660F, 0x55),
 
@@ -463,6 +466,7 @@ enum OpCode : UINT32
     packuswb  = OPCODE(Prefix_660F, 0x67),
     pmaddwd   = OPCODE(Prefix_660F, 0xF5),
     pmullw    = OPCODE(Prefix_660F, 0xD5),
+    pmulhuw   = OPCODE(Prefix_660F, 0xE4),
 
     pminsw    = OPCODE(Prefix_660F, 0xEA),
     pmaxsw    = OPCODE(Prefix_660F, 0xEE),
@@ -491,6 +495,11 @@ enum OpCode : UINT32
 
     pextrd    = OPCODE(Prefix_660F, 0x3A16) | OpcReversed,
     pinsrd    = OPCODE(Prefix_660F, 0x3A22),
+
+    // AVX2, VEX encoded only
+    pmovzxbd     = OPCODE(Prefix_660F, 0x3831),
+    vpbroadcastd = OPCODE(Prefix_660F, 0x3858),
+    vextracti128 = OPCODE(Prefix_660F, 0x3A39) | OpcReversed,
 };
 
 //+-----------------------------------------------------------------------------
@@ -533,16 +542,95 @@ enum OpCode : UINT32
 class CCoder86
 {
 public:
-    CCoder86() : m_uCount(0) {};
+    CCoder86() : m_uCount(0), m_uVexOperand(sc_uNoVexOperand), m_uVexLength(0) {};
 
     virtual void Emit(UINT32 data) = 0;
     virtual void Emit4(UINT32 data) = 0;
     virtual void EmitOpcode(UINT32 opcode) = 0;
     virtual UINT_PTR GetBase() const = 0;
+
     UINT32 GetCount() const {return m_uCount;}
     void SetCount(UINT32 uCount) {m_uCount = uCount;}
 
 private:
+    //
+    // Emit the opcode, or the VEX prefix and opcode byte when the
+    // instruction is being assembled by vcmd().
+    //
+    void EmitOpcodeOrVex(UINT32 opcode)
+    {
+        if (m_uVexOperand == sc_uNoVexOperand)
+        {
+            EmitOpcode(opcode);
+        }
+        else
+        {
+            EmitVex(opcode, m_uVexOperand, m_uVexLength);
+        }
+    }
+
+    //
+    //      void EmitVex()
+    // Emit the VEX encoded form of an SSE instruction with a non destructive
+    // first source operand given by uVexOperand (VEX.vvvv), which is
+    // then followed by the same ModR/M, SIB, displacement and immediate
+    // bytes as the legacy form.
+    //
+    // The legacy prefix turns into VEX.pp and the escape bytes into
+    // VEX.mmmmm; REX bits, if any, are carried in inverted form.
+    // The two byte form (C5) is used when the instruction is in the 0F map
+    // and needs neither REX.X, REX.B nor REX.W. The 128-bit forms (VEX.L = 0)
+    // zero the upper halves of YMM registers, so mixing them with legacy SSE
+    // code has no transition cost; the 256-bit forms (VEX.L = 1) leave them
+    // dirty until vzeroupper, see otYmmZeroUpper.
+    //
+    void EmitVex(UINT32 opcode, UINT32 uVexOperand, UINT32 L)
+    {
+        C_ASSERT(Prefix_None == 0 && Prefix_F20F == 1 && Prefix_F30F == 2 && Prefix_660F == 3);
+        static const UINT32 pp[4] = { 0, 3, 2, 1 };
+
+        UINT32 prefix = (opcode & OpcPrefix) >> OpcShiftPrefix;
+        UINT32 byte1 = (opcode & OpcByte1) >> OpcShiftByte1;
+        UINT32 map = 1; // 0F
+
+        if (prefix == Prefix_None)
+        {
+            // Legacy opcodes without prefix carry the 0F escape in byte 1
+            WarpAssert((opcode & OpcIsLong) && byte1 == 0x0F);
+        }
+        else if (opcode & OpcIsLong)
+        {
+            // 0F 38 and 0F 3A maps (SSSE3 and SSE4.1)
+            WarpAssert(byte1 == 0x38 || byte1 == 0x3A);
+            map = (byte1 == 0x38) ? 2 : 3;
+        }
+
+        UINT32 R = 1, X = 1, B = 1, W = 0;
+#if WPFGFX_FXJIT_X86
+#else //_AMD64_
+        if (opcode & REX_R) R = 0;
+        if (opcode & REX_X) X = 0;
+        if (opcode & REX_B) B = 0;
+        if (opcode & REX_W) W = 1;
+#endif
+
+        UINT32 vvvv = (~uVexOperand) & 0xF;
+
+        if (map == 1 && X && B && !W)
+        {
+            Emit(0xC5);
+            Emit((R << 7) | (vvvv << 3) | (L << 2) | pp[prefix]);
+        }
+        else
+        {
+            Emit(0xC4);
+            Emit((R << 7) | (X << 6) | (B << 5) | map);
+            Emit((W << 7) | (vvvv << 3) | (L << 2) | pp[prefix]);
+        }
+
+        Emit((opcode & OpcByte2) >> OpcShiftByte2);
+    }
+
     //
     // Emit basic single register instruction.
     //
@@ -582,7 +670,7 @@ private:
         if (dstReg & 8) { opcode |= REX_R; dstReg &= 7; }
         if (srcReg & 8) { opcode |= REX_B; srcReg &= 7; }
 #endif
-        EmitOpcode(opcode);
+        EmitOpcodeOrVex(opcode);
 
         UINT8 mod = 3;
 
@@ -654,7 +742,7 @@ private:
         UINT8 mod = 0;
         UINT8 r_m = base;
 
-        EmitOpcode(opcode);
+        EmitOpcodeOrVex(opcode);
 
 
         if (index == gpr_none)
@@ -812,6 +900,84 @@ public:
         EmitCmdMemReg(opcode, dst, src, immSize, immData);
     }
 
+    //
+    // Three operand forms of SSE instructions: dst = src1 op src2.
+    // Require AVX; opcode is the legacy SSE opcode. With f256 the
+    // instruction operates on YMM registers, which requires AVX2 for
+    // integer data.
+    //
+
+    void vcmd(UINT32 opcode, CRegID dst, CRegID src1, CRegID src2, UINT32 immSize = 0, UINT32 immData = 0, bool f256 = false)
+    {
+        m_uVexOperand = src1.IndexInGroup();
+        m_uVexLength = f256 ? 1 : 0;
+        EmitCmdRegReg(opcode, dst.IndexInGroup(), src2.IndexInGroup(), immSize, immData);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
+    void vcmd(UINT32 opcode, CRegID dst, CRegID src1, memptr src2, UINT32 immSize = 0, UINT32 immData = 0, bool f256 = false)
+    {
+        m_uVexOperand = src1.IndexInGroup();
+        m_uVexLength = f256 ? 1 : 0;
+        EmitCmdRegMem(opcode, dst.IndexInGroup(), src2, immSize, immData);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
+    //
+    // Two operand 256-bit forms of AVX2 instructions, with VEX.vvvv unused
+    // (1111b) as moves, extensions and broadcasts require. YMM registers
+    // are given by the XMM register of the same index.
+    //
+
+    void vcmd256(UINT32 opcode, CRegID dst, CRegID src)
+    {
+        m_uVexOperand = 0;
+        m_uVexLength = 1;
+        EmitCmdRegReg(opcode, dst.IndexInGroup(), src.IndexInGroup(), 0, 0);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
+    void vcmd256(UINT32 opcode, CRegID dst, memptr src)
+    {
+        m_uVexOperand = 0;
+        m_uVexLength = 1;
+        EmitCmdRegMem(opcode, dst.IndexInGroup(), src, 0, 0);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
+    void vcmd256(UINT32 opcode, memptr dst, CRegID src)
+    {
+        m_uVexOperand = 0;
+        m_uVexLength = 1;
+        EmitCmdMemReg(opcode, dst, src.IndexInGroup(), 0, 0);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
+    // vpsrld ymm, ymm, imm8: the destination goes to VEX.vvvv
+    void vpsrld256(RegXMM dst, RegXMM src, int immed)
+    {
+        m_uVexOperand = dst;
+        m_uVexLength = 1;
+        EmitCmdRegReg(OPCODE(Prefix_660F, 0x72), 2, src, 1, immed);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
+    // vextracti128 xmm, ymm, 1
+    void vextracti128High(RegXMM dst, RegXMM src)
+    {
+        m_uVexOperand = 0;
+        m_uVexLength = 1;
+        EmitCmdRegReg(vextracti128, dst, src, 1, 1);
+        m_uVexOperand = sc_uNoVexOperand;
+        m_uVexLength = 0;
+    }
+
     void mov(RegGPR dst, RegGPR src)    { EmitCmdRegReg(OPCODE(Prefix_None, 0x8B), dst, src, 0, 0); }
     void mov(RegGPR dst, dword  src)    { EmitCmdRegMem(OPCODE(Prefix_None, 0x8B), dst, src, 0, 0); }
     void mov(dword  dst, RegGPR src)    { EmitCmdMemReg(OPCODE(Prefix_None, 0x89), dst, src, 0, 0); }
@@ -1093,6 +1259,12 @@ public:
         Emit(0x0F);
         Emit(0x77);
     }
+    void vzeroupper()
+    {
+        Emit(0xC5);
+        Emit(0xF8);
+        Emit(0x77);
+    }
     void mfence()
     {
         Emit(0x0F);
@@ -1107,6 +1279,12 @@ public:
 
 protected:
     UINT32 m_uCount;
+
+private:
+    // VEX.vvvv operand and VEX.L of the instruction being emitted by vcmd()
+    static const UINT32 sc_uNoVexOperand = 0xFFFFFFFF;
+    UINT32 m_uVexOperand;
+    UINT32 m_uVexLength;
 };
 
 
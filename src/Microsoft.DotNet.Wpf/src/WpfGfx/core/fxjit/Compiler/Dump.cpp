@@ -333,5 +333,24 @@ CProgram::DumpSpans()
     }
 }
 
+void
+CProgram::DumpStatistics()
+{
+    WarpPlatform::FilePrintf(m_hDumpFile,
+        "Operators: collected = %d; used = %d; reduced = %d; common subexpressions = %d; hoisted = %d\n",
+        m_statistics.cOperatorsCollected,
+        m_statistics.cOperatorsUsed,
+        m_statistics.cOperatorsReduced,
+        m_statistics.cCommonSubexpressions,
+        m_statistics.cHoistedOperators
+        );
+
+    WarpPlatform::FilePrintf(m_hDumpFile,
+        "Code size = %d; binary size = %d\n\n",
+        m_uCodeSize,
+        m_uBinarySize
+        );
+}
+
 #endif
 
@@ -815,11 +815,20 @@ void
 CMapper::AllocateStackFrame()
 {
     // Start allocating stack slots from biggest variables
-    // that require 16-byte aligning.
+    // that require 16-byte aligning. The stack frame is not aligned
+    // to 32 bytes, so YMM slots are accessed with vmovdqu.
     UINT32 uOffset = 0;
     for (UINT32 uVarID = 0; uVarID < m_uVarCount; uVarID++)
     {
         VariableType vt = m_pProgram->GetVarType(uVarID);
+        if (vt == vtYmm)
+        {
+            if (m_locator.WasInMemory(uVarID))
+            {
+                m_prgOffsets[uVarID] = uOffset;
+                uOffset += 32;
+            }
+        }
         // sometimes XmmF1 is casted to XmmF4 producing
         // AV of misaligned data. Allocate 16 bytes for now.
         if (vt == vtXmm || vt == vtXmmF4 || vt == vtXmmF1)
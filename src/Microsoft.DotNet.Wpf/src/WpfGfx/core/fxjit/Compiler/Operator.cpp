@@ -278,6 +278,15 @@ COperator::AssembleBinary(CAssembleContext & actx)
         }
     }
 
+    //
+    // With AVX, the result is not required to be the same register as the
+    // first operand, so that the move that would copy the first operand
+    // to the result can be avoided. 256-bit operators have VEX encoded
+    // forms only.
+    //
+    bool f256 = UsesYMM();
+    bool fUseVex = f256 || (actx.UsesVex() && HasVexForm() && m_rResult != m_rOperand1);
+
     switch (m_refType)
     {
     case RefType_Direct:
@@ -289,14 +298,18 @@ COperator::AssembleBinary(CAssembleContext & actx)
             if (m_rOperand2.IsDefined())
             {
                 CRegID src2 = m_rOperand2;
-                if (m_rResult == m_rOperand1)
+                if (m_rResult == m_rOperand1 && !f256)
                 {
                     actx.cmd(opCode, m_rResult, src2, immSize, immData);
                 }
-                else if (CanSwapOperands() && m_rResult == src2)
+                else if (CanSwapOperands() && m_rResult == src2 && !f256)
                 {
                     actx.cmd(opCode, m_rResult, m_rOperand1, immSize, immData);
                 }
+                else if (fUseVex)
+                {
+                    actx.vcmd(opCode, m_rResult, m_rOperand1, src2, immSize, immData, f256);
+                }
                 else
                 {
                     actx.cmd(movCode, m_rResult, m_rOperand1);
@@ -305,12 +318,19 @@ COperator::AssembleBinary(CAssembleContext & actx)
             }
             else
             {
+                UINT32 offset = actx.GetOffset(m_vOperand2);
+
+                if (fUseVex)
+                {
+                    actx.vcmd(opCode, m_rResult, m_rOperand1, actx.FramePtr(offset), immSize, immData, f256);
+                    break;
+                }
+
                 if (m_rResult != m_rOperand1)
                 {
                     actx.cmd(movCode, m_rResult, m_rOperand1);
                 }
 
-                UINT32 offset = actx.GetOffset(m_vOperand2);
                 actx.cmd(opCode, m_rResult, actx.FramePtr(offset), immSize, immData);
             }
         }
@@ -323,6 +343,12 @@ COperator::AssembleBinary(CAssembleContext & actx)
             //
             WarpAssert(m_vOperand2 == 0);
 
+            if (fUseVex)
+            {
+                actx.vcmd(opCode, m_rResult, m_rOperand1, memptr(actx.Place(m_pData, dataType)), immSize, immData, f256);
+                break;
+            }
+
             if (m_rResult != m_rOperand1)
             {
                 actx.cmd(movCode, m_rResult, m_rOperand1);
@@ -339,11 +365,18 @@ COperator::AssembleBinary(CAssembleContext & actx)
             //
             WarpAssert(m_vOperand2 != 0);
 
+            RegGPR pBase = RegGPROperand2();
+
+            if (fUseVex)
+            {
+                actx.vcmd(opCode, m_rResult, m_rOperand1, memptr(pBase, m_uDisplacement), immSize, immData, f256);
+                break;
+            }
+
             if (m_rResult != m_rOperand1)
             {
                 actx.cmd(movCode, m_rResult, m_rOperand1, 0 ,0);
             }
-            RegGPR pBase = RegGPROperand2();
             actx.cmd(opCode, m_rResult, memptr(pBase, m_uDisplacement), immSize, immData);
         }
         break;
@@ -354,7 +387,7 @@ COperator::AssembleBinary(CAssembleContext & actx)
             // data reside in memory pointed to by m_uDisplacement plus
             // index with given scale.
             //
-            if (m_rResult != m_rOperand1)
+            if (m_rResult != m_rOperand1 && !fUseVex)
             {
                 actx.cmd(movCode, m_rResult, m_rOperand1);
             }
@@ -363,13 +396,29 @@ COperator::AssembleBinary(CAssembleContext & actx)
             if (m_rOperand3 == 0)
             {
                 RegGPR index = RegGPROperand2();
-                actx.cmd(opCode, m_rResult, memptr(m_pData, index, (Scale32)m_refType), immSize, immData);
+                memptr src2(m_pData, index, (Scale32)m_refType);
+                if (fUseVex)
+                {
+                    actx.vcmd(opCode, m_rResult, m_rOperand1, src2, immSize, immData, f256);
+                }
+                else
+                {
+                    actx.cmd(opCode, m_rResult, src2, immSize, immData);
+                }
             }
             else
             {
                 RegGPR base = RegGPROperand2();
                 RegGPR index = RegGPROperand3();
-                actx.cmd(opCode, m_rResult, memptr(base, index, (Scale32)m_refType, m_uDisplacement), immSize, immData);
+                memptr src2(base, index, (Scale32)m_refType, m_uDisplacement);
+                if (fUseVex)
+                {
+                    actx.vcmd(opCode, m_rResult, m_rOperand1, src2, immSize, immData, f256);
+                }
+                else
+                {
+                    actx.cmd(opCode, m_rResult, src2, immSize, immData);
+                }
             }
         }
         break;
@@ -404,6 +453,10 @@ COperator::AssembleUnary(CAssembleContext & actx)
         }
     }
 
+    // 256-bit operators have VEX encoded forms only
+    bool f256 = UsesYMM();
+    WarpAssert(!f256 || immSize == 0);
+
     switch (m_refType)
     {
     case RefType_Direct:
@@ -414,12 +467,26 @@ COperator::AssembleUnary(CAssembleContext & actx)
             //
             if (m_rOperand1.IsDefined())
             {
-                actx.cmd(opcode, m_rResult, m_rOperand1, immSize, immData);
+                if (f256)
+                {
+                    actx.vcmd256(opcode, m_rResult, m_rOperand1);
+                }
+                else
+                {
+                    actx.cmd(opcode, m_rResult, m_rOperand1, immSize, immData);
+                }
             }
             else
             {
                 UINT32 offset = actx.GetOffset(m_vOperand1);
-                actx.cmd(opcode, m_rResult, actx.FramePtr(offset), immSize, immData);
+                if (f256)
+                {
+                    actx.vcmd256(opcode, m_rResult, actx.FramePtr(offset));
+                }
+                else
+                {
+                    actx.cmd(opcode, m_rResult, actx.FramePtr(offset), immSize, immData);
+                }
             }
         }
         break;
@@ -431,7 +498,14 @@ COperator::AssembleUnary(CAssembleContext & actx)
             //
             WarpAssert(m_vOperand1 == 0);
 
-            actx.cmd(opcode, m_rResult, memptr(actx.Place(m_pData, GetDataType())), immSize, immData);
+            if (f256)
+            {
+                actx.vcmd256(opcode, m_rResult, memptr(actx.Place(m_pData, GetDataType())));
+            }
+            else
+            {
+                actx.cmd(opcode, m_rResult, memptr(actx.Place(m_pData, GetDataType())), immSize, immData);
+            }
         }
         break;
     case RefType_Base:
@@ -444,7 +518,14 @@ COperator::AssembleUnary(CAssembleContext & actx)
             WarpAssert(m_vOperand1 != 0);
 
             RegGPR pBase = RegGPROperand1();
-            actx.cmd(opcode, m_rResult, memptr(pBase, m_uDisplacement), immSize, immData);
+            if (f256)
+            {
+                actx.vcmd256(opcode, m_rResult, memptr(pBase, m_uDisplacement));
+            }
+            else
+            {
+                actx.cmd(opcode, m_rResult, memptr(pBase, m_uDisplacement), immSize, immData);
+            }
         }
         break;
     default:
@@ -459,13 +540,27 @@ COperator::AssembleUnary(CAssembleContext & actx)
             if (m_vOperand2 == 0)
             {
                 RegGPR index = RegGPROperand1();
-                actx.cmd(opcode, m_rResult, memptr(m_pData, index, (Scale32)m_refType), immSize, immData);
+                if (f256)
+                {
+                    actx.vcmd256(opcode, m_rResult, memptr(m_pData, index, (Scale32)m_refType));
+                }
+                else
+                {
+                    actx.cmd(opcode, m_rResult, memptr(m_pData, index, (Scale32)m_refType), immSize, immData);
+                }
             }
             else
             {
                 RegGPR pBase = RegGPROperand1();
                 RegGPR index = RegGPROperand2();
-                actx.cmd(opcode, m_rResult, memptr(pBase, index, (Scale32)m_refType, m_uDisplacement), immSize, immData);
+                if (f256)
+                {
+                    actx.vcmd256(opcode, m_rResult, memptr(pBase, index, (Scale32)m_refType, m_uDisplacement));
+                }
+                else
+                {
+                    actx.cmd(opcode, m_rResult, memptr(pBase, index, (Scale32)m_refType, m_uDisplacement), immSize, immData);
+                }
             }
         }
         break;
@@ -531,6 +626,13 @@ case otReturn:
             actx.mfence();
         }
 
+        // Avoid the penalty of legacy SSE code that follows, including
+        // the restore of xmm6-xmm15 below, on dirty upper halves of YMM
+        if (actx.GetOperatorFlags() & ofUsesYMM)
+        {
+            actx.vzeroupper();
+        }
+
 #if WPFGFX_FXJIT_X86
         if (actx.GetOperatorFlags() & ofUsesMMX)
         {
@@ -1127,6 +1229,49 @@ case otXmmFloat4ExtractSignBits:
     }
     break;
 
+case otYmmAssign:
+    {
+        if (m_rResult != m_rOperand1)
+        {
+            actx.vcmd256(movdqa_rr, m_rResult, m_rOperand1);
+        }
+    }
+    break;
+
+case otYmmSetZero:
+    {
+        actx.vcmd(pxor, m_rResult, m_rResult, m_rResult, 0, 0, true);
+    }
+    break;
+
+case otYmmZeroUpper:
+    {
+        actx.vzeroupper();
+    }
+    break;
+
+case otYmmGetLow:
+    {
+        // The low half of YMM register is the XMM register of the same index
+        if (m_rResult != m_rOperand1)
+        {
+            actx.vcmd256(movdqa_rr, m_rResult, m_rOperand1);
+        }
+    }
+    break;
+
+case otYmmGetHigh:
+    {
+        actx.vextracti128High(RegXMMResult(), RegXMMOperand1());
+    }
+    break;
+
+case otYmmDWordsShiftRight:
+    {
+        actx.vpsrld256(RegXMMResult(), RegXMMOperand1(), m_shift);
+    }
+    break;
+
 #if WPFGFX_FXJIT_X86
 
 case otMmAssign:
@@ -1318,9 +1463,10 @@ COperator::sc_movCodesRM[] =
     movss_rm,       // ofDataF32
     movaps_rm,      // ofDataF128
 #if WPFGFX_FXJIT_X86
-    0               // ofDataR64 not supported
+    0,              // ofDataR64 not supported
 #else // _AMD64_
     mov_64_rm,      // ofDataR64
 #endif
+    movdqu_rm,      // ofDataI256, VEX encoded only
 };
 
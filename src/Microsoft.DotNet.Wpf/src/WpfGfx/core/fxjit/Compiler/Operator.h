@@ -31,6 +31,7 @@ enum VariableType : UINT8
     vtXmm       = 3,
     vtXmmF1     = 4,
     vtXmmF4     = 5,
+    vtYmm       = 6,
 };
 #else //_AMD64_
 enum VariableType : UINT8
@@ -41,6 +42,7 @@ enum VariableType : UINT8
     vtXmm       = 3,
     vtXmmF1     = 4,
     vtXmmF4     = 5,
+    vtYmm       = 6,
 };
 #endif
 
@@ -91,6 +93,7 @@ enum OpFlags
     ofDataF32           = 0x00000007,   // movss
     ofDataF128          = 0x00000008,   // movps
     ofDataR64           = 0x00000009,   // REX mov
+    ofDataI256          = 0x0000000A,   // vmovdqu
     ofDataMask          = 0x0000000F,
 
     ofChangesZF         = 0x00000010,   // this operator changes flag ZF maybe without purpose
@@ -118,6 +121,7 @@ enum OpFlags
     ofStandardMemDst    = 0x00200000,   // operator with memory destination operand that respects RefType notation
     ofNonTemporalStore  = 0x00400000,   // operator makes non-temporal store to memory
     ofHasOpcodeSuffix   = 0x00800000,   // instruction code is followed by immediate byte derived from opcode
+    ofUsesYMM           = 0x01000000,   // this operator involves 256-bit AVX2 instruction extension
 };
 
 //+-----------------------------------------------------------------------------
@@ -252,6 +256,11 @@ public:
         return (sc_opFlags[m_ot] & ofUsesMMX) != 0;
     }
 
+    bool UsesYMM() const
+    {
+        return (sc_opFlags[m_ot] & ofUsesYMM) != 0;
+    }
+
     bool HasImmediateByte() const
     {
         return (sc_opFlags[m_ot] & ofHasImmediateByte) != 0;
@@ -282,6 +291,16 @@ public:
         return (sc_opFlags[m_ot] & ofStandardMemDst) != 0;
     }
 
+    // True for SSE operators on full XMM registers, which have VEX encoded
+    // three operand forms. Scalar float operators are excluded, since their
+    // VEX forms take the upper elements from the first operand rather than
+    // leaving the destination's ones intact.
+    bool HasVexForm() const
+    {
+        UINT32 dataType = GetDataType();
+        return !UsesMMX() && (dataType == ofDataI128 || dataType == ofDataF128);
+    }
+
     // returns data type for operands, result might differ
     UINT32 GetDataType() const
     {
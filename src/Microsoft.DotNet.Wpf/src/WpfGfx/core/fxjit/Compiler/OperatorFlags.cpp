@@ -102,6 +102,7 @@
 #define FlagsXmmWordsSignedShiftRight   ofDataI128
 #define FlagsXmmWordsShiftLeft          ofDataI128
 #define FlagsXmmWordsMul                ofDataI128 | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
+#define FlagsXmmWordsMulHigh            ofDataI128 | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
 #define FlagsXmmWordsMulAdd             ofDataI128 | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
 #define FlagsXmmWordsSignedMin          ofDataI128 | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
 #define FlagsXmmWordsSignedMax          ofDataI128 | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
@@ -205,6 +206,17 @@
 #define FlagsXmmFloat4StoreNonTemporal  ofDataF128 | ofHasOutsideEffect | ofNonTemporalStore | ofStandardMemDst
 #define FlagsXmmFloat4ExtractSignBits   ofDataF128
 
+#define FlagsYmmAssign                  ofDataI256 | ofUsesYMM
+#define FlagsYmmSetZero                 ofDataI256 | ofUsesYMM
+#define FlagsYmmZeroUpper               ofDataNone | ofUsesYMM | ofHasOutsideEffect | ofNoBubble
+#define FlagsYmmGetLow                  ofDataNone | ofUsesYMM // I256->I128
+#define FlagsYmmGetHigh                 ofDataNone | ofUsesYMM // I256->I128
+#define FlagsYmmBytesUnpackToDWords     ofDataI256 | ofUsesYMM | ofCanTakeOperand1FromMemory                     | ofStandardUnary
+#define FlagsYmmWordsMulAdd             ofDataI256 | ofUsesYMM | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
+#define FlagsYmmDWordsAdd               ofDataI256 | ofUsesYMM | ofCanTakeOperand2FromMemory | ofCanSwapOperands | ofStandardBinary
+#define FlagsYmmDWordsShiftRight        ofDataI256 | ofUsesYMM
+#define FlagsYmmDWordsBroadcast         ofDataI32  | ofUsesYMM | ofCanTakeOperand1FromMemory                     | ofStandardUnary // I32->I256
+
 #if WPFGFX_FXJIT_X86
 #define FlagsMmAssign                   ofDataM64  | ofUsesMMX
 #define FlagsMmLoad                     ofDataM64  | ofUsesMMX | ofCanTakeOperand1FromMemory | ofStandardUnary
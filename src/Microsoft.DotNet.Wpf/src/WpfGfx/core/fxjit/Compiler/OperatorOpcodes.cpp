@@ -106,6 +106,7 @@
 #define OpcodeXmmWordsSignedShiftRight   0
 #define OpcodeXmmWordsShiftLeft          0
 #define OpcodeXmmWordsMul                pmullw
+#define OpcodeXmmWordsMulHigh            pmulhuw
 #define OpcodeXmmWordsShuffleLow         pshuflw
 #define OpcodeXmmWordsShuffleHigh        pshufhw
 #define OpcodeXmmWordsUnpackToDWords     pmovzxwd   // SSE4.1
@@ -207,6 +208,17 @@
 #define OpcodeXmmFloat4StoreNonTemporal  movntps
 #define OpcodeXmmFloat4ExtractSignBits   0
 
+#define OpcodeYmmAssign                  0
+#define OpcodeYmmSetZero                 0
+#define OpcodeYmmZeroUpper               0
+#define OpcodeYmmGetLow                  0
+#define OpcodeYmmGetHigh                 0
+#define OpcodeYmmBytesUnpackToDWords     pmovzxbd     // AVX2
+#define OpcodeYmmWordsMulAdd             pmaddwd      // AVX2
+#define OpcodeYmmDWordsAdd               paddd        // AVX2
+#define OpcodeYmmDWordsShiftRight        0
+#define OpcodeYmmDWordsBroadcast         vpbroadcastd // AVX2
+
 #if WPFGFX_FXJIT_X86
 #define OpcodeMmAssign                   0
 #define OpcodeMmLoad                     movq_mmx_rm
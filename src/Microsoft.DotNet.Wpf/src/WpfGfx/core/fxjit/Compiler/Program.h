@@ -21,6 +21,25 @@ class CBitArray;
 
 #define MAX_FLOWS 5
 
+//+------------------------------------------------------------------------------
+//
+//  Struct:
+//      ProgramStatistics
+//
+//  Synopsis:
+//      Operator counts after each stage of CProgram::Compile, used to
+//      evaluate the optimization passes.
+//
+//-------------------------------------------------------------------------------
+struct ProgramStatistics
+{
+    UINT32 cOperatorsCollected;     // added by the prototype program
+    UINT32 cOperatorsUsed;          // left after the first RemoveUnused
+    UINT32 cOperatorsReduced;       // left after Reduce and CSE
+    UINT32 cCommonSubexpressions;   // replaced by EliminateCommonSubexpressions
+    UINT32 cHoistedOperators;       // moved out of loops by HoistLoopInvariants
+};
+
 struct VarDesc
 {
     UINT8
@@ -237,6 +256,10 @@ public:
 
     UINT32 GetCodeSize() const { return m_uCodeSize; }
 
+    UINT32 GetBinarySize() const { return m_uBinarySize; }
+
+    ProgramStatistics const & GetStatistics() const { return m_statistics; }
+
     SOperator * GetOperator(__in UINT32 uIndex)
     {
         WarpAssert(uIndex < m_uOperatorsCount);
@@ -275,6 +298,7 @@ public:
             rtXMM,    //vtXmm
             rtXMM,    //vtXmmF1
             rtXMM,    //vtXmmF4
+            rtXMM,    //vtYmm
 #else //_AMD64_
             rtGPR,    //vtPointer
             rtGPR,    //vtUINT32
@@ -282,6 +306,7 @@ public:
             rtXMM,    //vtXmm
             rtXMM,    //vtXmmF1
             rtXMM,    //vtXmmF4
+            rtXMM,    //vtYmm
 #endif
         };
 
@@ -389,6 +414,7 @@ private:
 
     // optimization
     __checkReturn HRESULT Reduce();
+    __checkReturn HRESULT ProcessRethinkList();
     __checkReturn HRESULT Think(COperator * pOperator);
     __checkReturn HRESULT Rethink(COperator * pOperator);
     __checkReturn HRESULT RemoveAssignUp(COperator * pOperator);
@@ -400,6 +426,19 @@ private:
     __checkReturn HRESULT OptimizeIndicesUsage(COperator * pOperator);
     __checkReturn HRESULT OptimizePointersArithmetic(COperator * pOperator);
 
+    __checkReturn HRESULT HoistLoopInvariants();
+    bool IsHoistingCandidate(const COperator * pOperator) const;
+
+    __checkReturn HRESULT EliminateCommonSubexpressions();
+    OpType GetAssignOperator(UINT32 uVar) const;
+    bool IsCSECandidate(const COperator * pOperator) const;
+    bool IsSameComputation(const COperator * pProvider, const COperator * pRepeater);
+    static bool IsSameConstant(const COperator * pOperator1, const COperator * pOperator2);
+    __checkReturn HRESULT ReplaceWithAssign(COperator * pRepeater, COperator * pProvider);
+
+    // EliminateCommonSubexpressions search distance
+    static const UINT32 sc_uCSEWindow = 64;
+
     bool VarUnchangedInBetween(const COperator * pFrom, const COperator * pTo, UINT32 uVar);
     bool VarUnusedInBetween(const COperator * pFrom, const COperator * pTo, UINT32 uVar);
     Link* FindUniqueProvider(COperator * pOperator, UINT32 uOperand);
@@ -410,6 +449,7 @@ private:
     __checkReturn HRESULT Shuffle();
     __checkReturn HRESULT CheckImplicitDependencies(COperator *pOperator, UINT32 varID);
     __checkReturn HRESULT CheckFlagsDependencies(const COperator *pOperator);
+    __checkReturn HRESULT CheckZeroUpperDependencies(OpSpan * pSpan);
     __checkReturn HRESULT ShuffleSpan(OpSpan * pSpan);
     COperator* ChooseNextOperator(struct ShuffleCtx &ctx);
 
@@ -433,6 +473,7 @@ private:
     void Dump();
     void DumpConstants();
     void DumpSpans();
+    void DumpStatistics();
 public:
     void DbgDump();
 
@@ -462,6 +503,12 @@ private:
 
     UINT32 m_uCodeSize;
 
+    // Size of the whole block returned by Compile, i.e. the code followed
+    // by the static data
+    UINT32 m_uBinarySize;
+
+    ProgramStatistics m_statistics;
+
     // static variable control
     StaticStorage<uu32x1> m_storage4;
     StaticStorage<uu32x2> m_storage8;
@@ -498,10 +545,14 @@ private:
     bool m_fEnableShuffling;
     bool m_fEnableMemShuffling;
     bool m_fEnableTotalBubbling;
+    bool m_fEnableCSE;
+    bool m_fEnableHoisting;
     bool m_fUseNegativeStackOffsets;
 
 public:
     bool m_fUseSSE41;
+    bool m_fUseAVX;
+    bool m_fUseAVX2;
     bool m_fAvoidMOVDs;
     bool m_fReturnPresents;
 };
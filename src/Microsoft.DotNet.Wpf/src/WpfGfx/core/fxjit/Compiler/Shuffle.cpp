@@ -108,6 +108,7 @@ CProgram::Shuffle()
     for (UINT32 uSpan = 0; uSpan < m_uSpanCount; uSpan++)
     {
         OpSpan * pSpan = m_pSpanGraph + uSpan;
+        IFC(CheckZeroUpperDependencies(pSpan));
         IFC(ShuffleSpan(pSpan));
     }
 
@@ -185,6 +186,48 @@ Cleanup:
 }
 
 
+//------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::CheckZeroUpperDependencies
+//
+//  Synopsis:
+//      Keep every operator of the span on its side of otYmmZeroUpper.
+//      The operators before it may use YMM values it destroys, and the
+//      SSE operators after it would be slow if moved ahead of it.
+//------------------------------------------------------------------------
+__checkReturn HRESULT
+CProgram::CheckZeroUpperDependencies(OpSpan * pSpan)
+{
+    HRESULT hr = S_OK;
+
+    COperator *pLastZeroUpper = NULL;
+
+    for (UINT32 uOp = pSpan->m_uFirst; uOp < pSpan->m_uLast; uOp++)
+    {
+        COperator *pOperator = m_prgOperators[uOp];
+
+        if (pOperator->m_ot == otYmmZeroUpper)
+        {
+            UINT32 uFirst = pLastZeroUpper ? pLastZeroUpper->m_uOrder : pSpan->m_uFirst;
+
+            for (UINT32 uPrev = uFirst; uPrev < uOp; uPrev++)
+            {
+                IFC(AddHook(m_prgOperators[uPrev], pOperator));
+            }
+
+            pLastZeroUpper = pOperator;
+        }
+        else if (pLastZeroUpper)
+        {
+            IFC(AddHook(pLastZeroUpper, pOperator));
+        }
+    }
+
+Cleanup:
+    return hr;
+}
+
 class CHookList
 {
 public:
@@ -43,6 +43,7 @@ CShuffleRecord::Assemble(CAssembleContext & actx, CMapper const & mapper)
         case vtXmm:     actx.cmd(movdqa_rm  , m_regDst, actx.FramePtr(uOffset)); break;
         case vtXmmF1:   actx.cmd(movss_rm   , m_regDst, actx.FramePtr(uOffset)); break;
         case vtXmmF4:   actx.cmd(movaps_rm  , m_regDst, actx.FramePtr(uOffset)); break;
+        case vtYmm:     actx.vcmd256(movdqu_rm, m_regDst, actx.FramePtr(uOffset)); break;
         default: NO_DEFAULT;
         }
     }
@@ -64,6 +65,7 @@ CShuffleRecord::Assemble(CAssembleContext & actx, CMapper const & mapper)
         case vtXmm:     actx.cmd(movdqa_mr  , actx.FramePtr(uOffset), m_regSrc); break;
         case vtXmmF1:   actx.cmd(movss_mr   , actx.FramePtr(uOffset), m_regSrc); break;
         case vtXmmF4:   actx.cmd(movaps_mr  , actx.FramePtr(uOffset), m_regSrc); break;
+        case vtYmm:     actx.vcmd256(movdqu_mr, actx.FramePtr(uOffset), m_regSrc); break;
         default: NO_DEFAULT;
         }
     }
@@ -83,6 +85,7 @@ CShuffleRecord::Assemble(CAssembleContext & actx, CMapper const & mapper)
         case vtXmm:     actx.cmd(movdqa_rr  , m_regDst, m_regSrc); break;
         case vtXmmF1:   actx.cmd(movss_rr   , m_regDst, m_regSrc); break;
         case vtXmmF4:   actx.cmd(movaps_rr  , m_regDst, m_regSrc); break;
+        case vtYmm:     actx.vcmd256(movdqa_rr, m_regDst, m_regSrc); break;
         default: NO_DEFAULT;
         }
     }
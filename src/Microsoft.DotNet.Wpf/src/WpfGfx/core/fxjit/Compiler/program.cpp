@@ -112,6 +112,8 @@ CProgram::CProgram(
     m_fEnableShuffling = true;
     m_fEnableMemShuffling = true;
     m_fEnableTotalBubbling = true;
+    m_fEnableCSE = true;
+    m_fEnableHoisting = true;
 
     // Disable the use of negative stack offsets by default.  
     // This will likely increase generated code size, but is more compatible 
@@ -120,11 +122,20 @@ CProgram::CProgram(
     m_fUseNegativeStackOffsets = false;
 
     m_fUseSSE41 = false;
+    m_fUseAVX = false;
+    m_fUseAVX2 = false;
     m_fAvoidMOVDs = false;
 
     m_fReturnPresents = false;
 
     m_uCodeSize = 0;
+    m_uBinarySize = 0;
+
+    m_statistics.cOperatorsCollected = 0;
+    m_statistics.cOperatorsUsed = 0;
+    m_statistics.cOperatorsReduced = 0;
+    m_statistics.cCommonSubexpressions = 0;
+    m_statistics.cHoistedOperators = 0;
 }
 
 __checkReturn HRESULT
@@ -190,6 +201,22 @@ CProgram::SetMode(UINT32 uParameterIdx, INT32 nParameterValue)
         m_fUseSSE41 = nParameterValue != 0;
         break;
 
+    case CJitterAccess::sc_uidUseAVX:
+        m_fUseAVX = nParameterValue != 0;
+        break;
+
+    case CJitterAccess::sc_uidUseAVX2:
+        m_fUseAVX2 = nParameterValue != 0;
+        break;
+
+    case CJitterAccess::sc_uidEnableCSE:
+        m_fEnableCSE = nParameterValue != 0;
+        break;
+
+    case CJitterAccess::sc_uidEnableHoisting:
+        m_fEnableHoisting = nParameterValue != 0;
+        break;
+
     case CJitterAccess::sc_uidAvoidMOVDs:
         m_fAvoidMOVDs = nParameterValue != 0;
         break;
@@ -426,19 +453,35 @@ CProgram::Compile(
         IFC(E_OUTOFMEMORY);
     }
 
+    if (m_fEnableHoisting)
+    {
+        IFC(HoistLoopInvariants());
+    }
+
     IFC(BuildSpanGraph());
     IFC(BuildDependencyGraph());
 
+    m_statistics.cOperatorsCollected = m_uOperatorsCount;
+
     // It looks like for PixelJIT scenarios it's faster to apply RemoveUnused twice,
     // this reduce time losses on optimizations.
     RemoveUnused();
 
+    m_statistics.cOperatorsUsed = m_uOperatorsCount;
+
     IFC(ConvertToSSA());
 
     IFC(Reduce());
 
+    if (m_fEnableCSE)
+    {
+        IFC(EliminateCommonSubexpressions());
+    }
+
     RemoveUnused();
 
+    m_statistics.cOperatorsReduced = m_uOperatorsCount;
+
     IFC(BuildVarUsageTables());
 
     if (m_fEnableShuffling)
@@ -453,7 +496,11 @@ CProgram::Compile(
     IFC(Assemble(ppBinaryCode));
 
 #if DBG_DUMP
-    if (IsDumpEnabled()) DumpSpans();
+    if (IsDumpEnabled())
+    {
+        DumpSpans();
+        DumpStatistics();
+    }
 #endif
 
 Cleanup:
@@ -502,6 +549,25 @@ CProgram::Reduce()
         IFC(Think(pOperator));
     }
 
+    IFC(ProcessRethinkList());
+
+Cleanup:
+    return hr;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  CProgram::ProcessRethinkList
+//
+//  Think again about the operators placed into rethink list, until
+//  no more optimizations are found.
+//
+//-------------------------------------------------------------------
+__checkReturn HRESULT
+CProgram::ProcessRethinkList()
+{
+    HRESULT hr = S_OK;
+
     while(m_pRethinkList)
     {
         Hook * pHook = m_pRethinkList;
@@ -534,6 +600,7 @@ CProgram::Think(COperator * pOperator)
     case otXmmDWordsAssign:
     case otXmmFloat1Assign:
     case otXmmFloat4Assign:
+    case otYmmAssign:
         {
             IFC(RemoveAssignUp(pOperator));
             if (pOperator->m_ot != otNone)
@@ -1283,6 +1350,487 @@ Cleanup:
     return hr;
 }
 
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::HoistLoopInvariants
+//
+//  Synopsis:
+//      Move the operators that compute the same value on every iteration
+//      of a loop out of the loop, just before its start.
+//
+//      Given:
+//          LoopStart;
+//          A = foo(X, Y);      // X and Y are not changed in the loop
+//          B = bar(A, Z);
+//          ...
+//          RepeatIfNonZero;
+//
+//      Optimized:
+//          A = foo(X, Y);
+//          LoopStart;
+//          B = bar(A, Z);
+//          ...
+//          RepeatIfNonZero;
+//
+//      Loop bodies are executed at least once, so no guard is needed.
+//      Only operators that execute on every iteration, i.e. are not inside
+//      a branch or a nested loop, are considered, and only when nothing
+//      else in the loop assigns their result and nothing reads it before
+//      them. Inner loops are processed first, so a value can move out of
+//      several nested loops.
+//
+//      The pass runs before BuildSpanGraph, when moving an operator only
+//      requires renumbering the operator array.
+//
+//------------------------------------------------------------------------------
+__checkReturn HRESULT
+CProgram::HoistLoopInvariants()
+{
+    HRESULT hr = S_OK;
+
+    // Per variable: the number of operators in the loop that assign it,
+    // and the position of the first operator in the loop that reads it.
+    UINT32 *prgAssignCount = reinterpret_cast<UINT32*>(AllocMem(m_uVarsCount * sizeof(UINT32)));
+    IFCOOM(prgAssignCount);
+    UINT32 *prgFirstRead = reinterpret_cast<UINT32*>(AllocMem(m_uVarsCount * sizeof(UINT32)));
+    IFCOOM(prgFirstRead);
+
+    for (UINT32 uRepeat = 0; uRepeat < m_uOperatorsCount; uRepeat++)
+    {
+        const COperator *pRepeat = m_prgOperators[uRepeat];
+        if (!pRepeat->IsLoopRepeat())
+            continue;
+
+        UINT32 uStart = static_cast<const COperator*>(pRepeat->m_pLinkedOperator)->m_uOrder;
+        WarpAssert(uStart < uRepeat && m_prgOperators[uStart]->IsLoopStart());
+
+        bool fHasSubroutines = false;
+
+        for (UINT32 i = uStart + 1; i < uRepeat; i++)
+        {
+            const COperator *pOperator = m_prgOperators[i];
+
+            prgAssignCount[pOperator->m_vResult] = 0;
+            prgAssignCount[pOperator->m_vOperand1] = 0;
+            prgAssignCount[pOperator->m_vOperand2] = 0;
+            prgAssignCount[pOperator->m_vOperand3] = 0;
+
+            prgFirstRead[pOperator->m_vResult] = UINT_MAX;
+            prgFirstRead[pOperator->m_vOperand1] = UINT_MAX;
+            prgFirstRead[pOperator->m_vOperand2] = UINT_MAX;
+            prgFirstRead[pOperator->m_vOperand3] = UINT_MAX;
+
+            // Subroutines may change any variable
+            if (pOperator->m_ot == otSubroutineCall || pOperator->m_ot == otSubroutineStart)
+            {
+                fHasSubroutines = true;
+            }
+        }
+
+        if (fHasSubroutines)
+            continue;
+
+        for (UINT32 i = uStart + 1; i < uRepeat; i++)
+        {
+            const COperator *pOperator = m_prgOperators[i];
+
+            // Variable 0 stands for no operand and stays unassigned
+            if (pOperator->m_vResult != 0)
+            {
+                prgAssignCount[pOperator->m_vResult]++;
+            }
+
+            // Operators are visited in order, so the first read is kept
+            if (prgFirstRead[pOperator->m_vOperand1] == UINT_MAX)
+                prgFirstRead[pOperator->m_vOperand1] = i;
+            if (prgFirstRead[pOperator->m_vOperand2] == UINT_MAX)
+                prgFirstRead[pOperator->m_vOperand2] = i;
+            if (prgFirstRead[pOperator->m_vOperand3] == UINT_MAX)
+                prgFirstRead[pOperator->m_vOperand3] = i;
+        }
+
+        UINT32 uDepth = 0;
+
+        for (UINT32 i = uStart + 1; i < uRepeat; i++)
+        {
+            COperator *pOperator = m_prgOperators[i];
+
+            if (pOperator->IsLoopStart() || pOperator->IsBranchSplit())
+            {
+                uDepth++;
+                continue;
+            }
+
+            if (pOperator->IsLoopRepeat() || pOperator->IsBranchMerge())
+            {
+                WarpAssert(uDepth > 0);
+                uDepth--;
+                continue;
+            }
+
+            if (uDepth != 0 || !IsHoistingCandidate(pOperator))
+                continue;
+
+            UINT32 uResult = pOperator->m_vResult;
+
+            if (prgAssignCount[uResult] != 1 || prgFirstRead[uResult] < i)
+                continue;
+
+            if (prgAssignCount[pOperator->m_vOperand1] != 0
+                || prgAssignCount[pOperator->m_vOperand2] != 0
+                || prgAssignCount[pOperator->m_vOperand3] != 0)
+                continue;
+
+            // Shift the operators in between down and put this one in place
+            // of the loop start. Positions recorded in prgFirstRead become
+            // stale by one, which does not change their order relative
+            // to the operators that follow.
+            for (UINT32 j = i; j > uStart; j--)
+            {
+                m_prgOperators[j] = m_prgOperators[j - 1];
+                m_prgOperators[j]->m_uOrder = j;
+            }
+
+            m_prgOperators[uStart] = pOperator;
+            pOperator->m_uOrder = uStart;
+            uStart++;
+
+            // The result is now computed before the loop, so the operators
+            // that use it may follow.
+            prgAssignCount[uResult] = 0;
+
+            m_statistics.cHoistedOperators++;
+        }
+    }
+
+Cleanup:
+    return hr;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::IsHoistingCandidate
+//
+//  Synopsis:
+//      Detect whether given operator can be executed before the loop it
+//      belongs to, provided that its operands are not changed in the loop.
+//
+//------------------------------------------------------------------------------
+bool
+CProgram::IsHoistingCandidate(const COperator * pOperator) const
+{
+    UINT32 uResult = pOperator->m_vResult;
+
+    if (uResult == 0)
+        return false;
+
+    // 256-bit values do not survive ZeroUpper, which the loop may execute
+    if (pOperator->UsesYMM() || GetVarType(uResult) == vtYmm)
+        return false;
+
+    // Loading a constant in the loop is cheaper than keeping it in a
+    // register, and it can usually be folded into the consuming operator.
+    if (pOperator->m_vOperand1 == 0)
+        return false;
+
+    return IsCSECandidate(pOperator);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::EliminateCommonSubexpressions
+//
+//  Synopsis:
+//      Look for operators that repeat the computation of an earlier operator
+//      in the same span, and replace them with assignment of the earlier
+//      result. The assignments are then removed by the usual Reduce
+//      routines, RemoveAssignUp and RemoveAssignDown.
+//
+//      Given:
+//          provider: A = foo(X, Y);
+//          repeater: B = foo(X, Y);
+//          consumer: bar(B);
+//
+//      Optimized:
+//          provider: A = foo(X, Y);
+//          repeater: NOP;
+//          consumer: bar(A);
+//
+//      Constant operands are compared by value, so that constants that
+//      prototype programs snapped separately are recognized as equal.
+//
+//      Operators are only compared with the sc_uCSEWindow operators that
+//      precede them, to keep compile time linear on long spans.
+//
+//------------------------------------------------------------------------------
+__checkReturn HRESULT
+CProgram::EliminateCommonSubexpressions()
+{
+    HRESULT hr = S_OK;
+
+    for (UINT32 uSpan = 0; uSpan < m_uSpanCount; uSpan++)
+    {
+        const OpSpan *pSpan = m_pSpanGraph + uSpan;
+
+        for (UINT32 i = pSpan->m_uFirst + 1; i <= pSpan->m_uLast; i++)
+        {
+            COperator *pRepeater = m_prgOperators[i];
+            if (!IsCSECandidate(pRepeater))
+                continue;
+
+            UINT32 uStop = (i - pSpan->m_uFirst > sc_uCSEWindow) ? i - sc_uCSEWindow : pSpan->m_uFirst;
+
+            for (UINT32 j = i; j-- > uStop;)
+            {
+                COperator *pProvider = m_prgOperators[j];
+
+                if (pProvider->m_ot == pRepeater->m_ot
+                    && IsCSECandidate(pProvider)
+                    && IsSameComputation(pProvider, pRepeater))
+                {
+                    IFC(ReplaceWithAssign(pRepeater, pProvider));
+                    m_statistics.cCommonSubexpressions++;
+                    break;
+                }
+            }
+        }
+    }
+
+    IFC(ProcessRethinkList());
+
+Cleanup:
+    return hr;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::GetAssignOperator
+//
+//  Synopsis:
+//      The operator that copies a variable of given type,
+//      otNone if there is no such operator known to Think().
+//
+//------------------------------------------------------------------------------
+OpType
+CProgram::GetAssignOperator(UINT32 uVar) const
+{
+    switch (GetVarType(uVar))
+    {
+    case vtPointer: return otPtrAssign;
+    case vtUINT32:  return otUINT32Assign;
+#if WPFGFX_FXJIT_X86
+    case vtMm:      return otMmAssign;
+#endif
+    case vtXmm:     return otXmmAssign;
+    case vtXmmF1:   return otXmmFloat1Assign;
+    case vtXmmF4:   return otXmmFloat4Assign;
+    case vtYmm:     return otYmmAssign;
+    }
+
+    return otNone;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::IsCSECandidate
+//
+//  Synopsis:
+//      Detect whether the result of given operator depends only on its
+//      operands and immediate data, so that it can be computed once.
+//
+//------------------------------------------------------------------------------
+bool
+CProgram::IsCSECandidate(const COperator * pOperator) const
+{
+    UINT32 uResult = pOperator->m_vResult;
+
+    if (pOperator->m_ot == otNone || uResult == 0)
+        return false;
+
+    // Memory operands may be changed by stores in between
+    if (pOperator->m_refType != RefType_Direct && pOperator->m_refType != RefType_Static)
+        return false;
+
+    // Operators without variable operands are as cheap as an assignment
+    if (pOperator->m_vOperand1 == 0 && pOperator->m_refType != RefType_Static)
+        return false;
+
+    if (pOperator->HasOutsideEffect()
+        || pOperator->HasOutsideDependency()
+        || pOperator->IsControl()
+        || pOperator->ChangesZF()
+        || pOperator->IsIrregular())
+        return false;
+
+    OpType otAssign = GetAssignOperator(uResult);
+    if (otAssign == otNone || otAssign == pOperator->m_ot)
+        return false;
+
+    // Operators that accumulate into their result
+    if (uResult == pOperator->m_vOperand1
+        || uResult == pOperator->m_vOperand2
+        || uResult == pOperator->m_vOperand3)
+        return false;
+
+    // Pointer operands may be dereferenced even with direct addressing,
+    // as by otXmmFloat4LoadUnaligned
+    if ((pOperator->m_vOperand1 && GetVarType(pOperator->m_vOperand1) == vtPointer)
+        || (pOperator->m_vOperand2 && GetVarType(pOperator->m_vOperand2) == vtPointer)
+        || (pOperator->m_vOperand3 && GetVarType(pOperator->m_vOperand3) == vtPointer))
+        return false;
+
+    return uResult != m_uFramePointerID;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::IsSameComputation
+//
+//  Synopsis:
+//      Detect whether pRepeater, that follows pProvider in the same span,
+//      computes the same value as pProvider, and whether this value is
+//      still available in pProvider's result when pRepeater executes.
+//
+//------------------------------------------------------------------------------
+bool
+CProgram::IsSameComputation(const COperator * pProvider, const COperator * pRepeater)
+{
+    WarpAssert(pProvider->m_ot == pRepeater->m_ot);
+
+    if (pProvider->m_refType != pRepeater->m_refType
+        || pProvider->m_bImmediateByte != pRepeater->m_bImmediateByte
+        || pProvider->m_immediateData != pRepeater->m_immediateData
+        || pProvider->m_vResult == pRepeater->m_vResult
+        || GetVarType(pProvider->m_vResult) != GetVarType(pRepeater->m_vResult))
+        return false;
+
+    UINT32 uOperand1 = pRepeater->m_vOperand1;
+    UINT32 uOperand2 = pRepeater->m_vOperand2;
+
+    if (pProvider->m_vOperand1 != uOperand1 || pProvider->m_vOperand2 != uOperand2)
+    {
+        if (!pRepeater->CanSwapOperands()
+            || pProvider->m_vOperand1 != uOperand2
+            || pProvider->m_vOperand2 != uOperand1)
+            return false;
+    }
+
+    if (pProvider->m_vOperand3 != pRepeater->m_vOperand3)
+        return false;
+
+    if (pRepeater->m_refType == RefType_Static)
+    {
+        if (!IsSameConstant(pProvider, pRepeater))
+            return false;
+    }
+    else if (pProvider->m_uDisplacement != pRepeater->m_uDisplacement)
+    {
+        return false;
+    }
+
+    // Operands should keep their values, and provider's result should
+    // not be overwritten before the repeater
+    if (uOperand1 && !VarUnchangedInBetween(pProvider, pRepeater, uOperand1))
+        return false;
+    if (uOperand2 && !VarUnchangedInBetween(pProvider, pRepeater, uOperand2))
+        return false;
+    if (pRepeater->m_vOperand3 && !VarUnchangedInBetween(pProvider, pRepeater, pRepeater->m_vOperand3))
+        return false;
+
+    return VarUnchangedInBetween(pProvider, pRepeater, pProvider->m_vResult);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::IsSameConstant
+//
+//  Synopsis:
+//      Compare the data that static operands of given operators point to.
+//
+//------------------------------------------------------------------------------
+bool
+CProgram::IsSameConstant(const COperator * pOperator1, const COperator * pOperator2)
+{
+    UINT32 cDWords;
+
+    switch (pOperator1->GetDataType())
+    {
+    case ofDataR32:
+    case ofDataM32:
+    case ofDataI32:
+    case ofDataF32:
+        cDWords = 1;
+        break;
+
+    case ofDataM64:
+    case ofDataI64:
+        cDWords = 2;
+        break;
+
+    case ofDataI128:
+    case ofDataF128:
+        cDWords = 4;
+        break;
+
+    default:
+        return pOperator1->m_pData == pOperator2->m_pData;
+    }
+
+    const UINT32 *pData1 = reinterpret_cast<const UINT32 *>(pOperator1->m_pData);
+    const UINT32 *pData2 = reinterpret_cast<const UINT32 *>(pOperator2->m_pData);
+
+    for (UINT32 i = 0; i < cDWords; i++)
+    {
+        if (pData1[i] != pData2[i])
+            return false;
+    }
+
+    return true;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CProgram::ReplaceWithAssign
+//
+//  Synopsis:
+//      Convert pRepeater into assignment of pProvider's result,
+//      see EliminateCommonSubexpressions.
+//
+//------------------------------------------------------------------------------
+__checkReturn HRESULT
+CProgram::ReplaceWithAssign(COperator * pRepeater, COperator * pProvider)
+{
+    HRESULT hr = S_OK;
+
+    while (pRepeater->m_pProviders)
+    {
+        RemoveLink(pRepeater->m_pProviders);
+    }
+
+    pRepeater->m_ot = GetAssignOperator(pRepeater->m_vResult);
+    pRepeater->m_refType = RefType_Direct;
+    pRepeater->m_uDisplacement = 0;
+    pRepeater->m_bImmediateByte = 0;
+    pRepeater->m_immediateData = 0;
+    pRepeater->m_vOperand1 = pProvider->m_vResult;
+    pRepeater->m_vOperand2 = 0;
+    pRepeater->m_vOperand3 = 0;
+
+    IFC(AddLink(pRepeater, pProvider));
+    IFC(Rethink(pRepeater));
+
+Cleanup:
+    return hr;
+}
+
 //+-----------------------------------------------------------------------------
 //
 //  Member:
@@ -1448,7 +1996,7 @@ CProgram::Assemble(
     }
 
     {
-        CAssemblePass1 coder1(mapper, m_fUseNegativeStackOffsets);
+        CAssemblePass1 coder1(mapper, m_fUseNegativeStackOffsets, m_fUseAVX);
         coder1.AssemblePrologue(mapper.GetFrameSize(), mapper.GetFrameAlignment());
 
 #if DBG_DUMP
@@ -1474,6 +2022,8 @@ CProgram::Assemble(
 
     IFC(CJitterSupport::CodeAllocate(uSizeToAlloc, &pCode));
 
+    m_uBinarySize = uSizeToAlloc;
+
     m_storage4.CopyData(pCode);
     m_storage8.CopyData(pCode);
     m_storage16.CopyData(pCode);
@@ -1485,6 +2035,7 @@ CProgram::Assemble(
         CAssemblePass2 coder2(
             mapper,
             m_fUseNegativeStackOffsets,
+            m_fUseAVX,
             pCode,
             m_storage4.GetAddressDelta(),
             m_storage8.GetAddressDelta(),
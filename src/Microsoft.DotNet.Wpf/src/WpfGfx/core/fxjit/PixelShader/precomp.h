@@ -70,4 +70,5 @@
 #include "effectparams.h"
 #include "shaderreg.h"
 #include "pshader.h"
+#include "pscache.h"
 
@@ -0,0 +1,322 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+----------------------------------------------------------------------------
+//
+
+//
+//  Description:
+//      Process wide cache of compiled pixel shader code
+//
+//-----------------------------------------------------------------------------
+#include "precomp.h"
+
+// Serializes the cache with code generation, see CJitterAccess::Enter
+extern WarpPlatform::LockHandle g_LockJitterAccess;
+
+CPixelShaderCodeCache::Entry *CPixelShaderCodeCache::s_pFirst = NULL;
+CPixelShaderCodeCache::Entry *CPixelShaderCodeCache::s_pLast = NULL;
+UINT32 CPixelShaderCodeCache::s_cbIdle = 0;
+PixelShaderCodeCacheStatistics CPixelShaderCodeCache::s_statistics;
+
+//
+// 64-bit FNV-1a parameters
+//
+
+#define FNV64_OFFSET_BASIS  0xcbf29ce484222325ull
+#define FNV64_PRIME         0x00000100000001b3ull
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::ComputeKey
+//
+//  Synopsis:
+//     Compute a 64-bit FNV-1a hash of the target features and byte code
+//
+//-------------------------------------------------------------------------
+UINT64
+CPixelShaderCodeCache::ComputeKey(
+    __in_bcount(cbByteCode) const void *pByteCode,
+    UINT32 cbByteCode,
+    UINT32 uTargetFeatures
+    )
+{
+    UINT64 uKey = FNV64_OFFSET_BASIS;
+
+    for (UINT32 i = 0; i < sizeof(uTargetFeatures); i++)
+    {
+        uKey ^= static_cast<UINT8>(uTargetFeatures >> (8 * i));
+        uKey *= FNV64_PRIME;
+    }
+
+    const UINT8 *pb = static_cast<const UINT8 *>(pByteCode);
+
+    for (UINT32 i = 0; i < cbByteCode; i++)
+    {
+        uKey ^= pb[i];
+        uKey *= FNV64_PRIME;
+    }
+
+    return uKey;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::Link
+//
+//  Synopsis:
+//     Insert an entry at the front of the list
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCodeCache::Link(
+    __inout_ecount(1) Entry *pEntry
+    )
+{
+    pEntry->pPrev = NULL;
+    pEntry->pNext = s_pFirst;
+
+    if (s_pFirst)
+    {
+        s_pFirst->pPrev = pEntry;
+    }
+    else
+    {
+        s_pLast = pEntry;
+    }
+
+    s_pFirst = pEntry;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::Unlink
+//
+//  Synopsis:
+//     Remove an entry from the list
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCodeCache::Unlink(
+    __inout_ecount(1) Entry *pEntry
+    )
+{
+    if (pEntry->pPrev)
+    {
+        pEntry->pPrev->pNext = pEntry->pNext;
+    }
+    else
+    {
+        s_pFirst = pEntry->pNext;
+    }
+
+    if (pEntry->pNext)
+    {
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    }
+    else
+    {
+        s_pLast = pEntry->pPrev;
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::TrimIdleEntries
+//
+//  Synopsis:
+//     Free the least recently used entries no shader uses until those
+//     left fit in sc_cbIdleBudget
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCodeCache::TrimIdleEntries()
+{
+    Entry *pEntry = s_pLast;
+
+    while (s_cbIdle > sc_cbIdleBudget && pEntry)
+    {
+        Entry *pPrev = pEntry->pPrev;
+
+        if (pEntry->cRefs == 0)
+        {
+            WarpAssert(s_cbIdle >= pEntry->GetSize());
+            s_cbIdle -= pEntry->GetSize();
+
+            Unlink(pEntry);
+
+            CJitterSupport::CodeFree(pEntry->pBinaryCode);
+            CJitterSupport::MemoryFree(pEntry);
+
+            s_statistics.cEvictions++;
+        }
+
+        pEntry = pPrev;
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::Load
+//
+//  Synopsis:
+//     Look for code already compiled for the given shader. On success the
+//     caller shares the code and must give it back with Release. Returns
+//     false, and the shader has to be compiled, if there is none.
+//
+//-------------------------------------------------------------------------
+bool
+CPixelShaderCodeCache::Load(
+    __in_bcount(cbByteCode) const void *pByteCode,
+    UINT32 cbByteCode,
+    UINT32 uTargetFeatures,
+    __deref_out UINT8 **ppBinaryCode
+    )
+{
+    UINT64 uKey = ComputeKey(pByteCode, cbByteCode, uTargetFeatures);
+
+    *ppBinaryCode = NULL;
+
+    WarpPlatformAutoLock lock(g_LockJitterAccess);
+
+    for (Entry *pEntry = s_pFirst; pEntry; pEntry = pEntry->pNext)
+    {
+        // Compare the byte code itself, the key is only a hash of it
+        if (   pEntry->uKey == uKey
+            && pEntry->uTargetFeatures == uTargetFeatures
+            && pEntry->cbByteCode == cbByteCode
+            && memcmp(pEntry->GetByteCode(), pByteCode, cbByteCode) == 0
+            )
+        {
+            if (pEntry->cRefs++ == 0)
+            {
+                WarpAssert(s_cbIdle >= pEntry->GetSize());
+                s_cbIdle -= pEntry->GetSize();
+            }
+
+            // Move the entry to the front so that it is freed last
+            Unlink(pEntry);
+            Link(pEntry);
+
+            s_statistics.cHits++;
+
+            *ppBinaryCode = pEntry->pBinaryCode;
+            return true;
+        }
+    }
+
+    s_statistics.cMisses++;
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::Store
+//
+//  Synopsis:
+//     Add the code just compiled for the given shader to the cache, which
+//     takes over the block. The caller still uses the code and must give
+//     it back with Release. Failures are ignored: the block is then not
+//     shared, Release returns false and the caller frees it.
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCodeCache::Store(
+    __in_bcount(cbByteCode) const void *pByteCode,
+    UINT32 cbByteCode,
+    UINT32 uTargetFeatures,
+    __in UINT8 *pBinaryCode,
+    UINT32 cbBinary
+    )
+{
+    UINT32 cbActual = 0;
+    UINT64 uKey = ComputeKey(pByteCode, cbByteCode, uTargetFeatures);
+
+    if (cbByteCode > sc_cbIdleBudget)
+    {
+        return;
+    }
+
+    Entry *pEntry = reinterpret_cast<Entry *>(
+        CJitterSupport::MemoryAllocate(sizeof(Entry) + cbByteCode, cbActual)
+        );
+
+    if (pEntry == NULL)
+    {
+        return;
+    }
+
+    pEntry->uKey = uKey;
+    pEntry->uTargetFeatures = uTargetFeatures;
+    pEntry->cRefs = 1;
+    pEntry->pBinaryCode = pBinaryCode;
+    pEntry->cbBinary = cbBinary;
+    pEntry->cbByteCode = cbByteCode;
+
+    memcpy(pEntry + 1, pByteCode, cbByteCode);
+
+    WarpPlatformAutoLock lock(g_LockJitterAccess);
+
+    Link(pEntry);
+
+    s_statistics.cStores++;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::Release
+//
+//  Synopsis:
+//     Give back code obtained with Load or passed to Store. The code stays
+//     cached for other shaders while the idle budget allows. Returns false
+//     if the code is not in the cache, in which case the caller owns it.
+//
+//-------------------------------------------------------------------------
+bool
+CPixelShaderCodeCache::Release(
+    __in UINT8 *pBinaryCode
+    )
+{
+    WarpPlatformAutoLock lock(g_LockJitterAccess);
+
+    for (Entry *pEntry = s_pFirst; pEntry; pEntry = pEntry->pNext)
+    {
+        if (pEntry->pBinaryCode == pBinaryCode)
+        {
+            WarpAssert(pEntry->cRefs > 0);
+
+            if (--pEntry->cRefs == 0)
+            {
+                s_cbIdle += pEntry->GetSize();
+
+                TrimIdleEntries();
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCodeCache::GetStatistics
+//
+//  Synopsis:
+//     Return the counters accumulated since the process started
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCodeCache::GetStatistics(
+    __out PixelShaderCodeCacheStatistics *pStatistics
+    )
+{
+    WarpPlatformAutoLock lock(g_LockJitterAccess);
+
+    *pStatistics = s_statistics;
+}
+
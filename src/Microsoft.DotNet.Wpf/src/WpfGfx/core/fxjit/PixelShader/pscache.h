@@ -0,0 +1,112 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+----------------------------------------------------------------------------
+//
+
+//
+//  Description:
+//      Process wide cache of compiled pixel shader code
+//
+
+#pragma once
+
+//-------------------------------------------------------------------------
+//
+//  Class:   CPixelShaderCodeCache
+//
+//  Synopsis:
+//     Shares the code compiled for a pixel shader between all the shaders
+//     of the process with the same byte code, e.g. effects re-created with
+//     a new render target or device. Entries are found by a hash of the
+//     byte code and the target features, and the byte code is compared, so
+//     a hash collision results in a miss rather than in wrong code.
+//
+//     Each entry owns the block returned by CJitterAccess::Compile and
+//     counts the shaders using it. Unused entries are kept, least recently
+//     used freed first, while they take less than sc_cbIdleBudget bytes.
+//
+//     Nothing is kept beyond the process: the code is executed, and
+//     anything read back from storage another process can write could
+//     have been replaced.
+//
+//-------------------------------------------------------------------------
+class CPixelShaderCodeCache
+{
+public:
+    static bool Load(
+        __in_bcount(cbByteCode) const void *pByteCode,
+        UINT32 cbByteCode,
+        UINT32 uTargetFeatures,
+        __deref_out UINT8 **ppBinaryCode
+        );
+
+    static void Store(
+        __in_bcount(cbByteCode) const void *pByteCode,
+        UINT32 cbByteCode,
+        UINT32 uTargetFeatures,
+        __in UINT8 *pBinaryCode,
+        UINT32 cbBinary
+        );
+
+    static bool Release(
+        __in UINT8 *pBinaryCode
+        );
+
+    static void GetStatistics(
+        __out PixelShaderCodeCacheStatistics *pStatistics
+        );
+
+private:
+    struct Entry
+    {
+        Entry *pNext;
+        Entry *pPrev;
+
+        UINT64 uKey;
+        UINT32 uTargetFeatures;
+        UINT32 cRefs;
+
+        UINT8 *pBinaryCode;
+        UINT32 cbBinary;
+
+        // The byte code follows the entry
+        UINT32 cbByteCode;
+
+        const UINT8 *GetByteCode() const
+        {
+            return reinterpret_cast<const UINT8 *>(this + 1);
+        }
+
+        UINT32 GetSize() const
+        {
+            return sizeof(Entry) + cbByteCode + cbBinary;
+        }
+    };
+
+    static UINT64 ComputeKey(
+        __in_bcount(cbByteCode) const void *pByteCode,
+        UINT32 cbByteCode,
+        UINT32 uTargetFeatures
+        );
+
+    static void Link(__inout_ecount(1) Entry *pEntry);
+    static void Unlink(__inout_ecount(1) Entry *pEntry);
+
+    static void TrimIdleEntries();
+
+    // Generated shaders are a few KB, so this keeps a few hundred of them
+    static const UINT32 sc_cbIdleBudget = 1024 * 1024;
+
+    // Most recently used first
+    static Entry *s_pFirst;
+    static Entry *s_pLast;
+
+    // Bytes held by entries no shader uses
+    static UINT32 s_cbIdle;
+
+    static PixelShaderCodeCacheStatistics s_statistics;
+};
+
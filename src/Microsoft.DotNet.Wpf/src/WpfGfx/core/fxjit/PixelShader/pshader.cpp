@@ -53,8 +53,16 @@ struct CInstructionVariables
     C_f32x4               m_evalRight;
     C_f32x4               m_evalDown;
     C_f32x4               m_kill[4];
+
+    // Set for the outer program of a fused pair, see CreateFused. Samples
+    // of the input then return m_rgFusedInput, the inner program's output
+    // for the same pixel, and the texture coordinates are not evaluated.
+    bool                  m_fHasFusedInput;
+    C_f32x4               m_rgFusedInput[4];
 };
 
+unsigned CPixelShaderCompiler::s_uTargetFeatures = PIXELSHADER_TARGET_SSE2;
+
 //-------------------------------------------------------------------------
 //
 //  Function:   OutputBreakpointTrace
@@ -126,6 +134,65 @@ Cleanup:
     RRETURN(hr);
 }
 
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::CreateFused
+//
+//  Synopsis:
+//     Create a CPixelShaderCompiler whose function computes
+//     pOuter(pInner(input)) in one pass, without an intermediate texture.
+//     pOuter must be point-wise, see IsPointwise.
+//
+//     The inner program runs with the state passed to the function and the
+//     outer program with its m_pFusedShaderState, whose samplers are not
+//     used: the outer program's samples of its input return the inner
+//     program's output for the same pixel, quantized to 8 bits per channel
+//     as it would have been in the intermediate.
+//
+//-------------------------------------------------------------------------
+HRESULT 
+CPixelShaderCompiler::CreateFused(
+    __in CPixelShaderCompiler *pInner,
+    __in CPixelShaderCompiler *pOuter,
+    __out CPixelShaderCompiler **ppPixelShaderCompiler
+    )
+{
+    HRESULT hr = S_OK;
+    CPixelShaderCompiler *pPixelShaderCompiler = NULL;
+    UINT8 *pBinaryCode = NULL;
+
+    if (!pOuter->IsPointwise())
+    {
+        IFC(E_INVALIDARG);
+    }
+
+    pPixelShaderCompiler = new CPixelShaderCompiler();
+    IFCOOM(pPixelShaderCompiler);
+
+    pPixelShaderCompiler->m_pInner = pInner;
+    pInner->AddRef();
+
+    pPixelShaderCompiler->m_pOuter = pOuter;
+    pOuter->AddRef();
+
+    //
+    // Fused code is not cached: it has no byte code of its own to key the
+    // cache on, and is cheap to regenerate from the two programs.
+    //
+
+    IFC(pPixelShaderCompiler->GenerateCode(NULL, 0, &pBinaryCode));
+
+    pPixelShaderCompiler->m_pfn = (GenerateColorsEffect *)pBinaryCode;
+
+    *ppPixelShaderCompiler = pPixelShaderCompiler;
+    pPixelShaderCompiler = NULL;
+
+Cleanup:
+    delete pPixelShaderCompiler;
+
+    RRETURN(hr);
+}
+
 //-------------------------------------------------------------------------
 //
 //  Function:   CPixelShaderCompiler::CPixelShaderCompiler
@@ -139,6 +206,9 @@ CPixelShaderCompiler::CPixelShaderCompiler()
     m_pTranslated = NULL;
     m_pTextureVariables = NULL;
     m_pfn = NULL;
+    m_pInner = NULL;
+    m_pOuter = NULL;
+    m_fPointwise = false;
     m_cRefs = 1;
 }
 
@@ -155,10 +225,21 @@ CPixelShaderCompiler::~CPixelShaderCompiler()
     delete m_pTranslated;
     delete [] m_pTextureVariables;
 
-    if (m_pfn != NULL)
+    if (   m_pfn != NULL
+        && !CPixelShaderCodeCache::Release(reinterpret_cast<UINT8 *>(m_pfn)))
     {
         CJitterSupport::CodeFree(m_pfn);
     }
+
+    if (m_pInner != NULL)
+    {
+        m_pInner->Release();
+    }
+
+    if (m_pOuter != NULL)
+    {
+        m_pOuter->Release();
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -169,6 +250,9 @@ CPixelShaderCompiler::~CPixelShaderCompiler()
 //     Translate the shader to our risk instruction set for simpler compile
 //     and faster recompiler after a constant change;
 //
+//     The code is loaded from the code cache when this shader has already
+//     been compiled in this process.
+//
 //-------------------------------------------------------------------------
 HRESULT 
 CPixelShaderCompiler::Init(
@@ -177,18 +261,335 @@ CPixelShaderCompiler::Init(
     )
 {
     HRESULT hr = S_OK;
+    UINT8 *pBinaryCode = NULL;
 
     m_pTranslated = new RDPSTrans((DWORD *)pCode, uByteCodeSize, 0);
     IFCOOM(m_pTranslated);
 
     IFC(m_pTranslated->GetStatus());
 
-    IFC(Compile(&m_pfn));
+    m_fPointwise = ComputeIsPointwise();
+
+    if (CPixelShaderCodeCache::Load(pCode, uByteCodeSize, GetTargetFeatures(), &pBinaryCode))
+    {
+        m_pfn = (GenerateColorsEffect *)pBinaryCode;
+    }
+    else
+    {
+        IFC(Compile(pCode, uByteCodeSize, &m_pfn));
+    }
 
 Cleanup:
     RRETURN(hr);
 }
 
+//-------------------------------------------------------------------------
+//
+//  Function:   IsPositionDependentRegister
+//
+//  Synopsis:
+//     Does the register hold a value that depends on the pixel position,
+//     i.e. texture coordinates or other interpolated inputs, or is it
+//     relatively addressed so that we cannot tell?
+//
+//-------------------------------------------------------------------------
+static bool
+IsPositionDependentRegister(
+    __in const PSTRRegister &reg
+    )
+{
+    switch (reg.GetRegType())
+    {
+    case PSTRREG_INPUT:
+    case PSTRREG_TEXTURE:
+    case PSTRREG_POSITION:
+    case PSTRREG_FACE:
+        return true;
+    }
+
+    return reg.GetIsRelAddr() != FALSE;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::ComputeIsPointwise
+//
+//  Synopsis:
+//     Determines whether each output pixel of the shader depends only on
+//     the texel of its input at the same position: the shader samples a
+//     single 2D texture, always at the unmodified texture coordinates, and
+//     uses the coordinates and other position dependent values for
+//     nothing else. Such a shader can be the outer program of a fused
+//     pair, see CreateFused.
+//
+//     Instructions that are not known to be safe make the shader not
+//     point-wise.
+//
+//-------------------------------------------------------------------------
+bool
+CPixelShaderCompiler::ComputeIsPointwise() const
+{
+    UINT8 *pInstructions = m_pTranslated->GetOutputBuffer();
+    UINT32 cInstructions = m_pTranslated->GetPSTRInstCount();
+
+    if (m_pTranslated->GetActiveTextureStageCount() != 1
+        || m_pTranslated->GetSamplerRegDcl()[0] != D3DSTT_2D)
+    {
+        return false;
+    }
+
+    for (UINT32 uInstruction = 0; uInstruction < cInstructions; uInstruction++)
+    {
+        PSTRINST_BASE_PARAMS *pBaseInstr = (PSTRINST_BASE_PARAMS*)pInstructions;
+        const PSTRRegister *rgpRegisters[4] = { NULL, NULL, NULL, NULL };
+
+        switch (pBaseInstr->Inst)
+        {
+        case PSTRINST_TEXCOVERAGE:
+        case PSTRINST_QUADLOOPBEGIN:
+        case PSTRINST_QUADLOOPEND:
+        case PSTRINST_NEXTD3DPSINST:
+        case PSTRINST_END:
+            break;
+
+        case PSTRINST_EVAL:
+            {
+                const PSTRINST_EVAL_PARAMS *pEval = (PSTRINST_EVAL_PARAMS*)pBaseInstr;
+
+                if (pEval->DstReg.GetRegType() != PSTRREG_TEXTURE || pEval->DstReg.GetIsRelAddr())
+                {
+                    return false;
+                }
+            }
+            break;
+
+        case PSTRINST_SAMPLE:
+            {
+                const PSTRINST_SAMPLE_PARAMS *pSample = (PSTRINST_SAMPLE_PARAMS*)pBaseInstr;
+
+                if (pSample->uiStage != 0
+                    || pSample->CoordReg.GetRegType() != PSTRREG_TEXTURE
+                    || pSample->CoordReg.GetIsRelAddr())
+                {
+                    return false;
+                }
+
+                rgpRegisters[0] = &pSample->DstReg;
+            }
+            break;
+
+        //
+        // Gradients of the texture coordinates for sampling, which
+        // CompileInstruction ignores
+        //
+
+        case PSTRINST_DSX:
+            if (((PSTRINST_DSX_PARAMS*)pBaseInstr)->DstReg.GetRegType() != PSTRREG_XGRADIENT)
+            {
+                return false;
+            }
+            break;
+
+        case PSTRINST_DSY:
+            if (((PSTRINST_DSY_PARAMS*)pBaseInstr)->DstReg.GetRegType() != PSTRREG_YGRADIENT)
+            {
+                return false;
+            }
+            break;
+
+        case PSTRINST_KILL:
+            rgpRegisters[0] = &((PSTRINST_KILL_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_DSTMOD:
+            rgpRegisters[0] = &((PSTRINST_DSTMOD_PARAMS*)pBaseInstr)->DstReg;
+            break;
+
+        case PSTRINST_MOV:
+            rgpRegisters[0] = &((PSTRINST_MOV_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_MOV_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_FRC:
+            rgpRegisters[0] = &((PSTRINST_FRC_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_FRC_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_ABS:
+            rgpRegisters[0] = &((PSTRINST_ABS_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_ABS_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_SWIZZLE:
+            rgpRegisters[0] = &((PSTRINST_SWIZZLE_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_SWIZZLE_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_RCP:
+            rgpRegisters[0] = &((PSTRINST_RCP_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_RCP_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_RSQ:
+            rgpRegisters[0] = &((PSTRINST_RSQ_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_RSQ_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_SIN:
+            rgpRegisters[0] = &((PSTRINST_SIN_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_SIN_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_COS:
+            rgpRegisters[0] = &((PSTRINST_COS_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_COS_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_LOG:
+            rgpRegisters[0] = &((PSTRINST_LOG_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_LOG_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_EXP:
+            rgpRegisters[0] = &((PSTRINST_EXP_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_EXP_PARAMS*)pBaseInstr)->SrcReg0;
+            break;
+
+        case PSTRINST_ADD:
+            rgpRegisters[0] = &((PSTRINST_ADD_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_ADD_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_ADD_PARAMS*)pBaseInstr)->SrcReg1;
+            break;
+
+        case PSTRINST_MUL:
+            rgpRegisters[0] = &((PSTRINST_MUL_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_MUL_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_MUL_PARAMS*)pBaseInstr)->SrcReg1;
+            break;
+
+        case PSTRINST_MIN:
+            rgpRegisters[0] = &((PSTRINST_MIN_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_MIN_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_MIN_PARAMS*)pBaseInstr)->SrcReg1;
+            break;
+
+        case PSTRINST_MAX:
+            rgpRegisters[0] = &((PSTRINST_MAX_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_MAX_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_MAX_PARAMS*)pBaseInstr)->SrcReg1;
+            break;
+
+        case PSTRINST_DP3:
+            rgpRegisters[0] = &((PSTRINST_DP3_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_DP3_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_DP3_PARAMS*)pBaseInstr)->SrcReg1;
+            break;
+
+        case PSTRINST_DP4:
+            rgpRegisters[0] = &((PSTRINST_DP4_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_DP4_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_DP4_PARAMS*)pBaseInstr)->SrcReg1;
+            break;
+
+        case PSTRINST_MAD:
+            rgpRegisters[0] = &((PSTRINST_MAD_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_MAD_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_MAD_PARAMS*)pBaseInstr)->SrcReg1;
+            rgpRegisters[3] = &((PSTRINST_MAD_PARAMS*)pBaseInstr)->SrcReg2;
+            break;
+
+        case PSTRINST_LRP:
+            rgpRegisters[0] = &((PSTRINST_LRP_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_LRP_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_LRP_PARAMS*)pBaseInstr)->SrcReg1;
+            rgpRegisters[3] = &((PSTRINST_LRP_PARAMS*)pBaseInstr)->SrcReg2;
+            break;
+
+        case PSTRINST_CMP:
+            rgpRegisters[0] = &((PSTRINST_CMP_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_CMP_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_CMP_PARAMS*)pBaseInstr)->SrcReg1;
+            rgpRegisters[3] = &((PSTRINST_CMP_PARAMS*)pBaseInstr)->SrcReg2;
+            break;
+
+        case PSTRINST_CND:
+            rgpRegisters[0] = &((PSTRINST_CND_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_CND_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_CND_PARAMS*)pBaseInstr)->SrcReg1;
+            rgpRegisters[3] = &((PSTRINST_CND_PARAMS*)pBaseInstr)->SrcReg2;
+            break;
+
+        case PSTRINST_DP2ADD:
+            rgpRegisters[0] = &((PSTRINST_DP2ADD_PARAMS*)pBaseInstr)->DstReg;
+            rgpRegisters[1] = &((PSTRINST_DP2ADD_PARAMS*)pBaseInstr)->SrcReg0;
+            rgpRegisters[2] = &((PSTRINST_DP2ADD_PARAMS*)pBaseInstr)->SrcReg1;
+            rgpRegisters[3] = &((PSTRINST_DP2ADD_PARAMS*)pBaseInstr)->SrcReg2;
+            break;
+
+        default:
+            return false;
+        }
+
+        for (UINT32 i = 0; i < 4; i++)
+        {
+            if (rgpRegisters[i] != NULL && IsPositionDependentRegister(*rgpRegisters[i]))
+            {
+                return false;
+            }
+        }
+
+        pInstructions += pBaseInstr->InstSize;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::GetTargetFeatures
+//
+//  Synopsis:
+//     The instruction set extensions that Compile generates code for
+//
+//-------------------------------------------------------------------------
+unsigned
+CPixelShaderCompiler::GetTargetFeatures()
+{
+    return s_uTargetFeatures;
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::SetTargetFeatures
+//
+//  Synopsis:
+//     Selects the instruction set extensions that Compile may use. SSE2 is
+//     always required; the jitter is not asked to use SSE4.1, see
+//     CJitterAccess::SetMode.
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCompiler::SetTargetFeatures(unsigned uTargetFeatures)
+{
+    s_uTargetFeatures = PIXELSHADER_TARGET_SSE2 | (uTargetFeatures & PIXELSHADER_TARGET_AVX);
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::GetCodeCacheStatistics
+//
+//  Synopsis:
+//     Hit and miss counters of the code cache
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCompiler::GetCodeCacheStatistics(
+    __out PixelShaderCodeCacheStatistics *pStatistics
+    )
+{
+    CPixelShaderCodeCache::GetStatistics(pStatistics);
+}
+
 //-------------------------------------------------------------------------
 //
 //  Function:  CPixelShaderCompiler::Release
@@ -335,6 +736,68 @@ CPixelShaderCompiler::LoadShaderConstants(
     RRETURN(hr);
 }
 
+//-------------------------------------------------------------------------
+//
+//  Function:   GatherTexels
+//
+//  Synopsis:
+//     Read the texels of 4 pixels into one register. Lane j receives the
+//     texel at row offset rgvOffset[j] and column uU[j].
+//
+//-------------------------------------------------------------------------
+C_u32x4
+GatherTexels(
+    __in CTextureVariables *pTextureVars,         // Texture sampler info vars
+    __in_ecount(4) const C_u32 *rgvOffset,        // Byte offsets of the rows
+    __in const C_u32x4 &uU                        // Columns
+    )
+{
+    C_u32x4 rguTexels[4];
+
+    for (int j = 0; j < 4; j++)
+    {
+        // 0000 0000 0000 argb
+        rguTexels[j] = *((pTextureVars->m_pTextureSource.AsP_u8() + rgvOffset[j]).AsP_u32() + uU.GetElement(j));
+    }
+
+    // 0000 0000 argb1 argb0 and 0000 0000 argb3 argb2
+    C_u64x2 uTexels01 = rguTexels[0].InterleaveLow(rguTexels[1]);
+    C_u64x2 uTexels23 = rguTexels[2].InterleaveLow(rguTexels[3]);
+
+    // argb3 argb2 argb1 argb0
+    return uTexels01.InterleaveLow(uTexels23).AsC_u32x4();
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   ExtractTexelChannel
+//
+//  Synopsis:
+//     Convert the given byte of each texel to float: 0 for blue,
+//     1 for green, 2 for red and 3 for alpha.
+//
+//-------------------------------------------------------------------------
+C_f32x4
+ExtractTexelChannel(
+    __in const C_u32x4 &uTexels,
+    __in INT32 nChannel
+    )
+{
+    if (nChannel == 3)
+    {
+        return (uTexels >> 24).ToFloat4();
+    }
+
+    u32x4 uByteMask = {0xff, 0xff, 0xff, 0xff};
+
+    if (nChannel == 0)
+    {
+        return (uTexels & uByteMask).ToFloat4();
+    }
+
+    return ((uTexels >> (8*nChannel)) & uByteMask).ToFloat4();
+}
+
 //-------------------------------------------------------------------------
 //
 //  Function:   SampleTexture
@@ -449,131 +912,77 @@ SampleTexture(
             
         INT32 rgChannelOrder[4] = {2, 1, 0, 3};
 
-        // We are taking samples for each of 4 pixels.
-        for (int j = 0; j < 4; j++)
+        //
+        // Gather the texels of all 4 pixels into one register, lane j holding
+        // the texel of pixel j, and then extract the channels of all pixels at
+        // once. Output registers are transposed, so each holds 4 different
+        // pixels' values for the same color channel.
+        //
+
+        C_f32x4 rgSampleChannels[4];
+
+        if (useBilinear) // compile time switch
         {
-            C_u32 uCoordinate = uU.GetElement(3-j);
-            C_u32 vCoordinate = uV.GetElement(3-j);
-                                                                      
-            // Sample from memory - in argb format in a 32-bit integer
+            //
+            // Using bilinear, we generate a sample as the weighted sum of the four enclosing texels.
+
+            C_u32 uWidth = pTextureVars->m_uWidth*4;
 
-            // For nearest neighbor
-            C_u32 uSample;
-            // For bilinear
-            C_f32x4 rSample;
+            C_u32 rgvOffset[4];
+            C_u32 rgv1Offset[4];
 
-            if (useBilinear) // compile time switch
+            for (int j = 0; j < 4; j++)
             {
-                //
-                // Using bilinear, we generate a sample as the weighted sum of the four enclosing texels.
-                
-                C_u32 u1Coordinate = uU1.GetElement(3-j);
-                C_u32 v1Coordinate = uV1.GetElement(3-j);
-
-                C_u32 uWidth = pTextureVars->m_uWidth*4;
-                C_u32 vOffset = vCoordinate*uWidth;
-                C_u32 v1Offset = v1Coordinate*uWidth;
-
-                // Store the sample 32-bit uint as a 4x32 integer vector: 0000 0000 0000 argb
-                C_u32x4 uSampleUV = *((pTextureVars->m_pTextureSource.AsP_u8() + vOffset).AsP_u32() + uCoordinate);
-                C_u32x4 uSampleU1V = *((pTextureVars->m_pTextureSource.AsP_u8() + vOffset).AsP_u32() + u1Coordinate);
-                C_u32x4 uSampleUV1 = *((pTextureVars->m_pTextureSource.AsP_u8() + v1Offset).AsP_u32() + uCoordinate);
-                C_u32x4 uSampleU1V1 = *((pTextureVars->m_pTextureSource.AsP_u8() + v1Offset).AsP_u32() + u1Coordinate);
-
-                // Interleave to get 0000 0000 aarr ggbb
-                uSampleUV = uSampleUV.AsC_u8x16().InterleaveLow(uSampleUV.AsC_u8x16());
-                uSampleU1V = uSampleU1V.AsC_u8x16().InterleaveLow(uSampleU1V.AsC_u8x16());
-                uSampleUV1 = uSampleUV1.AsC_u8x16().InterleaveLow(uSampleUV1.AsC_u8x16());
-                uSampleU1V1 = uSampleU1V1.AsC_u8x16().InterleaveLow(uSampleU1V1.AsC_u8x16());
-
-                // Interleave to get aaaa rrrr gggg bbbb
-                uSampleUV = uSampleUV.AsC_u16x8().InterleaveLow(uSampleUV.AsC_u16x8());
-                uSampleU1V = uSampleU1V.AsC_u16x8().InterleaveLow(uSampleU1V.AsC_u16x8());
-                uSampleUV1 = uSampleUV1.AsC_u16x8().InterleaveLow(uSampleUV1.AsC_u16x8());
-                uSampleU1V1 = uSampleU1V1.AsC_u16x8().InterleaveLow(uSampleU1V1.AsC_u16x8());
-                
-                // Shift right to get 000a 000r 000g 000b
-                uSampleUV >>= 24;
-                uSampleU1V >>= 24;
-                uSampleUV1 >>= 24;
-                uSampleU1V1 >>= 24;
-
-                // Convert to 4x32 float vector.
-                C_f32x4 rSampleUV = uSampleUV.ToFloat4();
-                C_f32x4 rSampleU1V = uSampleU1V.ToFloat4();            
-                C_f32x4 rSampleUV1 = uSampleUV1.ToFloat4();
-                C_f32x4 rSampleU1V1 = uSampleU1V1.ToFloat4();
-                
-                // Get weights for this pixel.  We cast to int to select an element, but do not convert the floats.
-                C_u32 uURatio = rURatios.AsInt32x4().GetElement(3-j);
-                C_u32 uVRatio = rVRatios.AsInt32x4().GetElement(3-j);
-                C_u32 uUOpposite = rUOpposites.AsInt32x4().GetElement(3-j);
-                C_u32 uVOpposite = rVOpposites.AsInt32x4().GetElement(3-j);
-
-                // Replicate to 4x32 float vector.  Again, we do not convert the ints to floats, just cast back.
-                C_f32x4 rURatiox4 = uURatio.Replicate().As_f32x4();
-                C_f32x4 rVRatiox4 = uVRatio.Replicate().As_f32x4();
-                C_f32x4 rUOppositex4 = uUOpposite.Replicate().As_f32x4();
-                C_f32x4 rVOppositex4 = uVOpposite.Replicate().As_f32x4();
-
-                // Calculate the weighted color per channel as floats.
-                rSample = rVOppositex4 * (rUOppositex4 * rSampleUV   +  rURatiox4 * rSampleU1V) +
-                          rVRatiox4    * (rUOppositex4 * rSampleUV1  +  rURatiox4 * rSampleU1V1);
+                rgvOffset[j] = uV.GetElement(j)*uWidth;
+                rgv1Offset[j] = uV1.GetElement(j)*uWidth;
             }
-            else
+
+            C_u32x4 uSamplesUV = GatherTexels(pTextureVars, rgvOffset, uU);
+            C_u32x4 uSamplesU1V = GatherTexels(pTextureVars, rgvOffset, uU1);
+            C_u32x4 uSamplesUV1 = GatherTexels(pTextureVars, rgv1Offset, uU);
+            C_u32x4 uSamplesU1V1 = GatherTexels(pTextureVars, rgv1Offset, uU1);
+
+            for (i = 0; i < 4; i++)
             {
-                // Using nearest neighbor, we just sample at the tex coord we calculated earlier.
-                uSample = *((pTextureVars->m_pTextureSource.AsP_u8() + vCoordinate*pTextureVars->m_uWidth * 4).AsP_u32() + uCoordinate);
+                C_f32x4 rSampleUV = ExtractTexelChannel(uSamplesUV, i);
+                C_f32x4 rSampleU1V = ExtractTexelChannel(uSamplesU1V, i);
+                C_f32x4 rSampleUV1 = ExtractTexelChannel(uSamplesUV1, i);
+                C_f32x4 rSampleU1V1 = ExtractTexelChannel(uSamplesU1V1, i);
+
+                // The weights are per pixel, i.e. per lane, like the samples
+                rgSampleChannels[i] = rVOpposites * (rUOpposites * rSampleUV   +  rURatios * rSampleU1V) +
+                                      rVRatios    * (rUOpposites * rSampleUV1  +  rURatios * rSampleU1V1);
             }
-        
-            INT32 rgChannelOrder[4] = {2, 1, 0, 3};
+        }
+        else
+        {
+            // Using nearest neighbor, we just sample at the tex coord we calculated earlier.
 
-            // The inner loop samples each color channel for this pixel and packs it into the output register.
-            // Output registers are packed transposed, so each holds 4 different pixels' values for the same color channel.
-            for (i = 0; i < 4; i++)
+            C_u32 rgvOffset[4];
+
+            for (int j = 0; j < 4; j++)
             {
-                IFC(shaderRegisters[rgChannelOrder[i]].GetRegister(&pPixelShaderState, pRegOutput, &pRegDest));
+                rgvOffset[j] = uV.GetElement(j)*pTextureVars->m_uWidth * 4;
+            }
 
-                C_f32x4 rSampleChannel;
-                if (useBilinear)
-                {
-                    // For bilinear, we've already calculated all 4 channels in a 128-bit float.
-                    C_u32x4 uSampleChannel = rSample.AsInt32x4().GetElement(i);
-                    rSampleChannel = uSampleChannel.As_f32x4();
-                }
-                else
-                {
-                    // For nearest neighbor, we mask off one channel, replicate it to 128-bit and cast it to float.
-                    C_u32x4 uSampleChannel = (uSample & 0xff);
-                    rSampleChannel = uSampleChannel.ToFloat4();
-                }
+            C_u32x4 uSamples = GatherTexels(pTextureVars, rgvOffset, uU);
 
-                if (j == 0)
-                {
-                    (*pRegDest) = rSampleChannel;
-                }
-                else
-                {
-                    (*pRegDest) = (*pRegDest).Shuffle((*pRegDest), ((2 << 6) | (1 << 4) | (0 << 2) | 3));
-                    (*pRegDest) += rSampleChannel;
-                }
-        
-                if (i != 3)
-                {
-                    if (!useBilinear)
-                    {
-                        uSample = uSample >> 8;
-                    }
-                }
+            for (i = 0; i < 4; i++)
+            {
+                rgSampleChannels[i] = ExtractTexelChannel(uSamples, i);
             }
         }
-        
+
+        //
+        // The destination is only written once all the texels are read, since
+        // it may be the register that holds the texture coordinates.
+        //
         for (i = 0; i < 4; i++)
         {
             IFC(shaderRegisters[rgChannelOrder[i]].GetRegister(&pPixelShaderState, pRegOutput, &pRegDest));
 
-            *pRegDest = (*pRegDest)/r255;
-        }                
+            *pRegDest = rgSampleChannels[i]/r255;
+        }
     }
 
 Cleanup:
@@ -653,6 +1062,12 @@ CPixelShaderCompiler::CompileInstruction(
         {
             const PSTRINST_EVAL_PARAMS* pEval = (PSTRINST_EVAL_PARAMS*)pBaseInstr;
 
+            if (pInstructionVariables->m_fHasFusedInput)
+            {
+                // The coordinates are only used to sample the fused input
+                break;
+            }
+
             IFC(shaderRegisters[i].GetRegister(&pPixelShaderState, &pEval->DstReg, &pRegDest));
 
             // Texture coordinates evaluations output the computed u,v coordinates.  
@@ -1474,6 +1889,25 @@ CPixelShaderCompiler::CompileDependentInstruction(
             PSTRINST_SAMPLE_PARAMS* pSample = (PSTRINST_SAMPLE_PARAMS*)pBaseInstr;
             CTextureVariables *pVars;
 
+            if (pInstructionVariables->m_fHasFusedInput)
+            {
+                // Sampling the input at the pixel's own position yields the
+                // inner program's output. Like SampleTexture, all channels
+                // are written.
+
+                if (!IsPredicateFalse(pSample->Predication) && (pSample->WriteMask & PSTR_COMPONENTMASK_ALL) != 0)
+                {
+                    JIT_TRACE(L"PSTRINST_SAMPLE - fused input");
+
+                    for (i = 0; i < 4; i++)
+                    {
+                        IFC(shaderRegisters[i].GetRegister(&pPixelShaderState, &pSample->DstReg, &pRegDest));
+                        *pRegDest = pInstructionVariables->m_rgFusedInput[i];
+                    }
+                }
+                break;
+            }
+
             // Validate sampler register
 
             if (pSample->uiStage >= m_pTranslated->GetActiveTextureStageCount()
@@ -2163,24 +2597,243 @@ Cleanup:
 
 //-------------------------------------------------------------------------
 //
-//  Function:   CPixelShaderCompiler::CompilePixelShader
+//  Function:   CPixelShaderCompiler::InitInstructionVariables
+//
+//  Synopsis:
+//     Set up the registers, constants and common temporaries for compiling
+//     this program with the given state
+//
+//-------------------------------------------------------------------------
+HRESULT
+CPixelShaderCompiler::InitInstructionVariables(
+    __in const P_u8 &pPixelShaderState,
+    __out CInstructionVariables *pInstructionVars
+    )
+{
+    HRESULT hr = S_OK;
+
+    for (INT32 i = 0; i < 4; i++)
+    {
+        pInstructionVars->m_shaderRegisters[i].SetIndex(i);
+        IFC(LoadShaderConstants(i, &pInstructionVars->m_shaderRegisters[i]));
+    }
+
+    {
+        const f32x4 c_rZero = {0.0f, 0.0f, 0.0f, 0.0f};
+        const f32x4 c_rNegativeOne = {-1.0f, -1.0f, -1.0f, -1.0f};
+        const f32x4 c_r255 = {255.0f, 255.0f, 255.0f, 255.0f};
+
+        pInstructionVars->m_r255 = c_r255;
+        pInstructionVars->m_rZero = c_rZero;
+        pInstructionVars->m_rNegativeOne = c_rNegativeOne;
+    }
+
+    pInstructionVars->m_pPixelShaderState = pPixelShaderState;
+    pInstructionVars->m_fHasFusedInput = false;
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::PreloadConstants
+//
+//  Synopsis:
+//     Load the constants used by the program, outside the pixel loop
+//
+//-------------------------------------------------------------------------
+HRESULT
+CPixelShaderCompiler::PreloadConstants(
+    __inout CInstructionVariables *pInstructionVars
+    )
+{
+    HRESULT  hr            = S_OK;
+    UINT8   *pInstructions = m_pTranslated->GetOutputBuffer();
+    UINT32   cInstructions = m_pTranslated->GetPSTRInstCount();
+
+    for (UINT32 uInstruction = 0; uInstruction < cInstructions; uInstruction++)
+    {
+        PSTRINST_BASE_PARAMS *pBaseInstr = (PSTRINST_BASE_PARAMS*)pInstructions;
+
+        for (INT32 i = 0; i < 4; i++)
+        {
+            IFC(PreloadConstant(i, pBaseInstr, pInstructionVars));
+        }
+
+        pInstructions += pBaseInstr->InstSize;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::CompileInstructions
 //
 //  Synopsis:
-//     Compile a pixel shader
+//     Compile the program for one iteration of the pixel loop
+//
+//-------------------------------------------------------------------------
+HRESULT
+CPixelShaderCompiler::CompileInstructions(
+    __inout CInstructionVariables *pInstructionVars
+    )
+{
+    HRESULT  hr            = S_OK;
+    UINT8   *pInstructions = m_pTranslated->GetOutputBuffer();
+    UINT32   cInstructions = m_pTranslated->GetPSTRInstCount();
+
+    // Init kill if needed
+
+    if (m_pTranslated->HasTexKillInstructions())
+    {
+        JIT_TRACE(L"==> kill instructions present");
+        for (INT32 i = 0; i < 4; i++)
+        {
+            pInstructionVars->m_kill[i] = pInstructionVars->m_rZero;
+        }
+    }
+
+    for (UINT32 uInstruction = 0; uInstruction < cInstructions; uInstruction++)
+    {
+        PSTRINST_BASE_PARAMS *pBaseInstr = (PSTRINST_BASE_PARAMS*)pInstructions;
+        PSTR_INSTRUCTION_OPCODE_TYPE opcode = pBaseInstr->Inst;
+
+        switch (opcode)
+        {
+        case PSTRINST_SAMPLE:
+        case PSTRINST_SWIZZLE:
+        case PSTRINST_RCP:
+        case PSTRINST_DP2ADD:
+        case PSTRINST_DP3:
+        case PSTRINST_DP4:
+        case PSTRINST_SIN:
+        case PSTRINST_COS:
+        case PSTRINST_LOG:
+        case PSTRINST_EXP:
+        case PSTRINST_RSQ:
+            {
+                IFC(CompileDependentInstruction(pBaseInstr, pInstructionVars));
+            }
+            break;
+
+        default:
+            for (int i = 0; i < 4; i++)
+            {
+                IFC(CompileInstruction(
+                    i,
+                    pBaseInstr,
+                    pInstructionVars
+                    ));
+            }
+        }
+
+        pInstructions += pBaseInstr->InstSize;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::GetOutputColor
+//
+//  Synopsis:
+//     The output color of the compiled program, one register per channel
+//     in r, g, b, a order, clamped to [0, 255] and zero for killed pixels
+//
+//-------------------------------------------------------------------------
+void
+CPixelShaderCompiler::GetOutputColor(
+    __in CInstructionVariables *pInstructionVars,
+    __out_ecount(4) C_f32x4 *rgOutputColor
+    )
+{
+    const C_f32x4 &r255  = pInstructionVars->m_r255;
+    const C_f32x4 &rZero = pInstructionVars->m_rZero;
+
+    for (INT32 i = 0; i < 4; i++)
+    {
+        C_f32x4 rOutputColor = *pInstructionVars->m_shaderRegisters[i].GetColorOutput();
+
+        // Clamp
+
+        rOutputColor *= r255;
+        rOutputColor = rOutputColor.Min(r255);
+        rOutputColor = rOutputColor.Max(rZero);
+
+        // Check kill
+
+        if (m_pTranslated->HasTexKillInstructions())
+        {
+            rOutputColor = rOutputColor.Blend(rZero, pInstructionVars->m_kill[i]);
+        }
+
+        rgOutputColor[i] = rOutputColor;
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::Compile
+//
+//  Synopsis:
+//     Compile a pixel shader and store the code in the code cache
 //
 //-------------------------------------------------------------------------
 HRESULT
 CPixelShaderCompiler::Compile(
+    __in_bcount(uByteCodeSize) const void *pCode,
+    __in unsigned uByteCodeSize,
     __out GenerateColorsEffect **ppfn
     )
+{
+    HRESULT  hr          = S_OK;
+    UINT8   *pBinaryCode = NULL;
+
+    IFC(GenerateCode(pCode, uByteCodeSize, &pBinaryCode));
+
+    //
+    // Set the output program
+    //
+
+    *ppfn = (GenerateColorsEffect *)pBinaryCode;
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//-------------------------------------------------------------------------
+//
+//  Function:   CPixelShaderCompiler::GenerateCode
+//
+//  Synopsis:
+//     Generate the GenerateColorsEffect function: of this program, or of
+//     m_pOuter(m_pInner) for a fused compiler. The code is stored in the
+//     code cache under pCode when it is given.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CPixelShaderCompiler::GenerateCode(
+    __in_bcount_opt(uByteCodeSize) const void *pCode,
+    __in unsigned uByteCodeSize,
+    __deref_out UINT8 **ppBinaryCode
+    )
 {
     HRESULT  hr             = S_OK;
     BOOL     fEnteredJitter = FALSE;
-    UINT8   *pInstructions  = m_pTranslated->GetOutputBuffer();
-    UINT32   cInstructions  = m_pTranslated->GetPSTRInstCount();
     UINT8   *pBinaryCode    = NULL;
     UINT32   i;
 
+    // The program that reads the textures, and the one that outputs the color
+    CPixelShaderCompiler *pFirst = (m_pInner != NULL) ? m_pInner : this;
+    CPixelShaderCompiler *pLast = (m_pOuter != NULL) ? m_pOuter : this;
+
+    CInstructionVariables *pOuterInstructionVars = NULL;
+
     // Start the JIT'er
 
     IFC(CJitterAccess::Enter(sizeof(GenerateColorsEffectParams*)));
@@ -2190,50 +2843,46 @@ CPixelShaderCompiler::Compile(
     // size, but is more compatible with debugging and profiling.
     CJitterAccess::SetMode(CJitterAccess::sc_uidUseNegativeStackOffsets, 0);
 
+    CJitterAccess::SetMode(CJitterAccess::sc_uidUseAVX, (GetTargetFeatures() & PIXELSHADER_TARGET_AVX) != 0);
+
     {
         CInstructionVariables instructionVars;
-        CPixelShaderRegisters *shaderRegisters = instructionVars.m_shaderRegisters;
-
-        // Set the constants
-
-        for (i = 0; i < 4; i++)
-        {
-            shaderRegisters[i].SetIndex(i);
-            IFC(LoadShaderConstants(i, &shaderRegisters[i]));
-        }
-
-        // Constants loaded and common temporaries
-
-        const f32x4 c_rZero = {0.0f, 0.0f, 0.0f, 0.0f};
-        const f32x4 c_rNegativeOne = {-1.0f, -1.0f, -1.0f, -1.0f};
-        const f32x4 c_r255 = {255.0f, 255.0f, 255.0f, 255.0f};
-
-        instructionVars.m_r255 = c_r255;
-        instructionVars.m_rZero = c_rZero;
-        instructionVars.m_rNegativeOne = c_rNegativeOne;
-
-        const C_f32x4 &r255  = instructionVars.m_r255;
-        const C_f32x4 &rZero = instructionVars.m_rZero;
+        CInstructionVariables *pOutputVars = &instructionVars;
 
         // Get call parameters
     
         C_pVoid pArguments = C_pVoid::GetpVoidArgument(0); // Get GenerateColorsEffectParams structure argument.
         
-        instructionVars.m_pPixelShaderState = (pArguments.GetMemberPtr(OFFSET_OF(GenerateColorsEffectParams, pPixelShaderState))).AsP_u8();
-        P_u8 &pPixelShaderState = instructionVars.m_pPixelShaderState;
+        P_u8 pPixelShaderState = (pArguments.GetMemberPtr(OFFSET_OF(GenerateColorsEffectParams, pPixelShaderState))).AsP_u8();
 
         P_u32 pDst =  (pArguments.GetMemberPtr(OFFSET_OF(GenerateColorsEffectParams, pPargbBuffer))).AsP_u32();
         C_u32 uCount = (pArguments.GetMemberUINT32(OFFSET_OF(GenerateColorsEffectParams, nCount)));
         C_u32 uX = (pArguments.GetMemberUINT32(OFFSET_OF(GenerateColorsEffectParams, nX)));
         C_u32 uY = (pArguments.GetMemberUINT32(OFFSET_OF(GenerateColorsEffectParams, nY)));
 
+        // Set the constants and common temporaries
+
+        IFC(pFirst->InitInstructionVariables(pPixelShaderState, &instructionVars));
+
+        if (pLast != pFirst)
+        {
+            pOuterInstructionVars = new CInstructionVariables;
+            IFCOOM(pOuterInstructionVars);
+
+            P_u8 pOuterPixelShaderState = (pPixelShaderState.GetMemberPtr(OFFSET_OF(CPixelShaderState, m_pFusedShaderState))).AsP_u8();
+
+            IFC(pLast->InitInstructionVariables(pOuterPixelShaderState, pOuterInstructionVars));
+            pOuterInstructionVars->m_fHasFusedInput = true;
+
+            pOutputVars = pOuterInstructionVars;
+        }
 
         // Compute eval value, i.e., variables to do incremental tex coord evaluation
 
         C_f32x4 evalDeltaRight;
         C_f32x4 evalDeltaDown;
 
-        IFC(ComputeEval(
+        IFC(pFirst->ComputeEval(
             &pPixelShaderState, 
             &uX, 
             &uY, 
@@ -2245,100 +2894,54 @@ CPixelShaderCompiler::Compile(
 
         // Set up texture variables
 
-        IFC(LoadTextureVariables(&pPixelShaderState));
+        IFC(pFirst->LoadTextureVariables(&pPixelShaderState));
 
         // Preload constants outside the pixel loop
 
-        for (UINT32 uInstruction = 0; uInstruction < cInstructions; uInstruction++)
-        {
-            PSTRINST_BASE_PARAMS *pBaseInstr = (PSTRINST_BASE_PARAMS*)pInstructions;
+        IFC(pFirst->PreloadConstants(&instructionVars));
 
-            for (INT32 i = 0; i < 4; i++)
-            {
-                IFC(PreloadConstant(i, pBaseInstr, &instructionVars));
-            }
-
-            pInstructions += pBaseInstr->InstSize;
+        if (pOuterInstructionVars != NULL)
+        {
+            IFC(pLast->PreloadConstants(pOuterInstructionVars));
         }
-        pInstructions = m_pTranslated->GetOutputBuffer();
-
 
         // The main pixel loop
 
         C_Loop loop;    // do while (uCount != 0)
         {
-            // Init kill if needed
-
-            if (m_pTranslated->HasTexKillInstructions())
-            {
-                JIT_TRACE(L"==> kill instructions present");
-                for (i = 0; i < 4; i++)
-                {
-                    instructionVars.m_kill[i] = rZero;
-                }
-            }
+            C_f32x4 rgOutputColor[4];
 
-            // Compile instructions
+            IFC(pFirst->CompileInstructions(&instructionVars));
 
-            for (UINT32 uInstruction = 0; uInstruction < cInstructions; uInstruction++)
+            if (pOuterInstructionVars != NULL)
             {
-                PSTRINST_BASE_PARAMS *pBaseInstr = (PSTRINST_BASE_PARAMS*)pInstructions;
-                PSTR_INSTRUCTION_OPCODE_TYPE opcode = pBaseInstr->Inst;
+                //
+                // Pass the inner program's output to the outer program as it
+                // would have been read back from an intermediate texture:
+                // quantized to 8 bits and normalized, see SampleTexture.
+                //
 
-                switch (opcode)
-                {
-                case PSTRINST_SAMPLE:
-                case PSTRINST_SWIZZLE:
-                case PSTRINST_RCP:
-                case PSTRINST_DP2ADD:
-                case PSTRINST_DP3:
-                case PSTRINST_DP4:
-                case PSTRINST_SIN:
-                case PSTRINST_COS:
-                case PSTRINST_LOG:
-                case PSTRINST_EXP:
-                case PSTRINST_RSQ:
-                    {
-                        IFC(CompileDependentInstruction(pBaseInstr, &instructionVars));
-                    }
-                    break;
+                pFirst->GetOutputColor(&instructionVars, rgOutputColor);
 
-                default:
-                    for (int i = 0; i < 4; i++)
-                    {
-                        IFC(CompileInstruction(
-                            i,
-                            pBaseInstr,
-                            &instructionVars
-                            ));
-                    }
+                for (i = 0; i < 4; i++)
+                {
+                    pOuterInstructionVars->m_rgFusedInput[i] = rgOutputColor[i].ToInt32x4().ToFloat4() / instructionVars.m_r255;
                 }
 
-                pInstructions += pBaseInstr->InstSize;
+                IFC(pLast->CompileInstructions(pOuterInstructionVars));
             }
     
             // Output the color
 
+            pLast->GetOutputColor(pOutputVars, rgOutputColor);
+
             INT32 rgChannelOrder[4] = {3, 0, 1, 2};
 
             C_u32x4 colorOutput;
 
             for (i = 0; i < 4; i++)
             {
-                C_f32x4 rOutputColor = *shaderRegisters[rgChannelOrder[i]].GetColorOutput();
-
-                // Clamp
-
-                rOutputColor *= r255;
-                rOutputColor = rOutputColor.Min(r255);
-                rOutputColor = rOutputColor.Max(rZero);
-
-                // Check kill
-
-                if (m_pTranslated->HasTexKillInstructions())
-                {
-                    rOutputColor = rOutputColor.Blend(rZero, instructionVars.m_kill[i]);
-                }
+                C_f32x4 &rOutputColor = rgOutputColor[rgChannelOrder[i]];
 
                 // Add to output color
                 if (i == 0)
@@ -2391,6 +2994,17 @@ CPixelShaderCompiler::Compile(
 
     IFC(CJitterAccess::Compile(&pBinaryCode));
 
+    if (pCode != NULL)
+    {
+        CPixelShaderCodeCache::Store(
+            pCode,
+            uByteCodeSize,
+            GetTargetFeatures(),
+            pBinaryCode,
+            CJitterAccess::GetBinarySize()
+            );
+    }
+
 #if DBG
 
     //
@@ -2399,13 +3013,11 @@ CPixelShaderCompiler::Compile(
     OutputBreakpointTrace(pBinaryCode);
 #endif
 
-    //
-    // Set the output program
-    //
-
-    *ppfn = (GenerateColorsEffect *)pBinaryCode;
+    *ppBinaryCode = pBinaryCode;
 
 Cleanup:
+    delete pOuterInstructionVars;
+
     if (fEnteredJitter)
     {
         CJitterAccess::Leave();
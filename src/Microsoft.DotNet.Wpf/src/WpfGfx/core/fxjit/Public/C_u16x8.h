@@ -61,6 +61,9 @@ public:
     C_u16x8 AddSaturate(C_u16x8 const& other) const { return BinaryOperation(otXmmWordsAddSat, other); }
     C_u16x8 SubSaturate(C_u16x8 const& other) const { return BinaryOperation(otXmmWordsSubSat, other); }
 
+    // High 16 bits of the unsigned 32 bit products
+    C_u16x8 MulHigh(C_u16x8 const& other) const { return BinaryOperation(otXmmWordsMulHigh, other); }
+
     C_u32x4 MulAdd        (C_u16x8 const &other) const { return BinaryOperation(otXmmWordsMulAdd        , other); }
     C_u32x4 InterleaveLow (C_u16x8 const &other) const { return BinaryOperation(otXmmWordsInterleaveLow , other); }
     C_u32x4 InterleaveHigh(C_u16x8 const &other) const { return BinaryOperation(otXmmWordsInterleaveHigh, other); }
@@ -77,6 +80,8 @@ public:
     C_u16x8 AddSaturate(u16x8 const& src) const { return BinaryOperation(otXmmWordsAddSat, src); }
     C_u16x8 SubSaturate(u16x8 const& src) const { return BinaryOperation(otXmmWordsSubSat, src); }
 
+    C_u16x8 MulHigh(u16x8 const& src) const { return BinaryOperation(otXmmWordsMulHigh, src); }
+
     C_u32x4 MulAdd        (u16x8 const &src) const { return BinaryOperation(otXmmWordsMulAdd        , src); }
     C_u32x4 InterleaveLow (u16x8 const &src) const { return BinaryOperation(otXmmWordsInterleaveLow , src); }
     C_u32x4 InterleaveHigh(u16x8 const &src) const { return BinaryOperation(otXmmWordsInterleaveHigh, src); }
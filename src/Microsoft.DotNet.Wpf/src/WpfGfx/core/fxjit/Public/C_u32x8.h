@@ -0,0 +1,69 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      SIMD operations on vectors of 8 32-bit values.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      C_u32x8
+//
+//  Synopsis:
+//      Represents integer 256-bit variable in prototype program.
+//      Single 256-bit value is treated as an array of 8 32-bit words.
+//      Operators of this class correspond to AVX2 instructions and may
+//      only be used in programs compiled with CJitterAccess::sc_uidUseAVX2.
+//
+//      The instructions leave the upper halves of YMM registers dirty, which
+//      makes legacy SSE code that follows slow. Call ZeroUpper when done with
+//      256-bit values.
+//
+//------------------------------------------------------------------------------
+class C_u32x8 : public C_Variable
+{
+public:
+    C_u32x8();
+
+    C_u32x8(C_u32x8 const & origin);
+    C_u32x8 const& operator=(C_u32x8 const& origin);
+
+    C_u32x8 operator+(C_u32x8 const& other) const { return BinaryOperation(otYmmDWordsAdd, other); }
+    C_u32x8& operator+=(C_u32x8 const& other) { return BinaryAssignment(otYmmDWordsAdd, other); }
+
+    C_u32x8 operator>>(int shift) const;
+
+    C_u32x8 MulAddWords(C_u32x8 const& other) const { return BinaryOperation(otYmmWordsMulAdd, other); }
+
+    C_u32x8& SetZero();
+    C_u32x8& LoadUnpackBytes(P_u32 const& ptr);
+
+    static C_u32x8 Broadcast(R_u32 const& ref);
+    static C_u32x8 Broadcast(UINT32 const& src);
+
+    C_u32x4 GetLow() const;
+    C_u32x4 GetHigh() const;
+
+    static void ZeroUpper();
+
+private:
+    C_u32x8 BinaryOperation(OpType ot, C_u32x8 const& other) const;
+    C_u32x8& BinaryAssignment(OpType ot, C_u32x8 const& other);
+
+#if DBG
+    static void AssertAVX2();
+#else
+    static void AssertAVX2() {}
+#endif
+};
+
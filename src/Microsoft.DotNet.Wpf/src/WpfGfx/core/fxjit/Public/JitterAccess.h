@@ -32,6 +32,7 @@ public:
     static UINT8* AllocFlushMemory(UINT32 cbSize);
     static __checkReturn HRESULT Compile(__deref_out UINT8 **ppBinaryCode);
     static UINT32 GetCodeSize();
+    static UINT32 GetBinarySize();
     static void CodeFree(__in void *pBinaryCode);
 
     static void SplitFlow();
@@ -55,6 +56,10 @@ public:
     static const int sc_uidUseSSE41 = 4;
     static const int sc_uidAvoidMOVDs = 5;
     static const int sc_uidEnableMemShuffling = 6;
+    static const int sc_uidUseAVX = 7;
+    static const int sc_uidEnableCSE = 8;
+    static const int sc_uidUseAVX2 = 9;
+    static const int sc_uidEnableHoisting = 10;
 };
 
 
@@ -95,6 +95,7 @@
     m(XmmWordsPackUS             )\
     m(XmmWordsMulAdd             )\
     m(XmmWordsMul                )\
+    m(XmmWordsMulHigh            )\
     m(XmmWordsSignedShiftRight   )\
     m(XmmWordsShuffleLow         )\
     m(XmmWordsShuffleHigh        )\
@@ -188,6 +189,16 @@
     m(XmmFloat4StoreUnaligned    )\
     m(XmmFloat4StoreNonTemporal  )\
     m(XmmFloat4ExtractSignBits   )\
+    m(YmmAssign                  )\
+    m(YmmSetZero                 )\
+    m(YmmZeroUpper               )\
+    m(YmmGetLow                  )\
+    m(YmmGetHigh                 )\
+    m(YmmBytesUnpackToDWords     )\
+    m(YmmWordsMulAdd             )\
+    m(YmmDWordsAdd               )\
+    m(YmmDWordsShiftRight        )\
+    m(YmmDWordsBroadcast         )\
 
 #if WPFGFX_FXJIT_X86
 #define CPU_SPECIFIC_OPERATIONS(m)\
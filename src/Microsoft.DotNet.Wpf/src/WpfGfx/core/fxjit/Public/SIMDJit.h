@@ -39,6 +39,7 @@
 #include "C_f32x1.h"
 #include "C_f32x4.h"
 #include "C_s32x4.h"
+#include "C_u32x8.h"
 #include "C_LazyVar.h"
 #include "Branch.h"
 #include "PVoid.h"
@@ -94,6 +94,7 @@ class C_XmmValue;
 class C_u128x1;
 class C_u64x2;
 class C_u32x4;
+class C_u32x8;
 class C_u16x8;
 class C_u8x16;
 
@@ -90,6 +90,7 @@ struct CPixelShaderState
             m_rgShaderConstants[i][3] = 0.0f;
         }
 
+        m_pFusedShaderState = 0;
     }
 
     //
@@ -128,6 +129,13 @@ struct CPixelShaderState
 
     float m_rgShaderConstants[PIXELSHADER_CONSTANTS_MAX][4];
 
+    //
+    // State of the outer shader when running a fused shader pair, see
+    // CPixelShaderCompiler::CreateFused. Only its constants are used.
+    //
+
+    CPixelShaderState *m_pFusedShaderState;
+
 private:
     //
     // Private default texture
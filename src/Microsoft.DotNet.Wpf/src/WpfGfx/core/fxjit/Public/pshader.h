@@ -26,6 +26,32 @@ class P_u8;
 class C_u32;
 class C_f32x4;
 
+//
+// Instruction set extensions that generated code may use. They are part of
+// the code cache key, so that code is never loaded on a machine or with
+// settings it was not generated for.
+//
+
+#define PIXELSHADER_TARGET_SSE2     0x00000001
+#define PIXELSHADER_TARGET_SSE41    0x00000002
+#define PIXELSHADER_TARGET_AVX      0x00000004
+
+//-------------------------------------------------------------------------
+//
+//  Struct:  PixelShaderCodeCacheStatistics
+//
+//  Synopsis:
+//     Process wide counters of the pixel shader code cache
+//
+//-------------------------------------------------------------------------
+struct PixelShaderCodeCacheStatistics
+{
+    unsigned cHits;             // shaders that shared already compiled code
+    unsigned cMisses;           // shaders compiled because no entry was found
+    unsigned cStores;           // compiled code added to the cache
+    unsigned cEvictions;        // unused code freed to stay within budget
+};
+
 //-------------------------------------------------------------------------
 //
 //  Class:   CPixelShaderCompiler
@@ -43,6 +69,12 @@ public:
         __out CPixelShaderCompiler **ppPixelShaderCompiler
         );
 
+    static PS_HRESULT CreateFused(
+        __in CPixelShaderCompiler *pInner,
+        __in CPixelShaderCompiler *pOuter,
+        __out CPixelShaderCompiler **ppPixelShaderCompiler
+        );
+
     unsigned AddRef();
     unsigned Release();
 
@@ -51,6 +83,30 @@ public:
         return m_pfn;
     }
 
+    // True if each output pixel depends only on the input texel at the
+    // same position, so that the shader can be fused with the one that
+    // produces its input
+    bool IsPointwise() const
+    {
+        return m_fPointwise;
+    }
+
+    bool IsFusionOf(
+        __in const CPixelShaderCompiler *pInner,
+        __in const CPixelShaderCompiler *pOuter
+        ) const
+    {
+        return m_pInner == pInner && m_pOuter == pOuter;
+    }
+
+    static void GetCodeCacheStatistics(
+        __out PixelShaderCodeCacheStatistics *pStatistics
+        );
+
+    // Called once at startup with the PIXELSHADER_TARGET_* extensions
+    // that the processor supports and that are not disabled
+    static void SetTargetFeatures(unsigned uTargetFeatures);
+
 private:
     CPixelShaderCompiler();
     ~CPixelShaderCompiler();
@@ -61,9 +117,23 @@ private:
         );
 
     PS_HRESULT Compile(
+        __in_bcount(uByteCodeSize) const void *pCode,
+        __in unsigned uByteCodeSize,
         __out GenerateColorsEffect **ppfn
         );
 
+    PS_HRESULT GenerateCode(
+        __in_bcount_opt(uByteCodeSize) const void *pCode,
+        __in unsigned uByteCodeSize,
+        __deref_out UINT8 **ppBinaryCode
+        );
+
+    bool ComputeIsPointwise() const;
+
+    static unsigned GetTargetFeatures();
+
+    static unsigned s_uTargetFeatures;
+
     PS_HRESULT LoadTextureVariables(__in P_u8 *pPixelShaderState);
 
     PS_HRESULT LoadShaderConstants(__in int nChannel, __inout CPixelShaderRegisters *pShaderRegisters);
@@ -95,11 +165,34 @@ private:
         __inout CInstructionVariables *pInstructionVars     // variables used by instruction compiler
         );
 
+    PS_HRESULT InitInstructionVariables(
+        __in const P_u8 &pPixelShaderState,
+        __out CInstructionVariables *pInstructionVars
+        );
+
+    PS_HRESULT PreloadConstants(
+        __inout CInstructionVariables *pInstructionVars
+        );
+
+    PS_HRESULT CompileInstructions(
+        __inout CInstructionVariables *pInstructionVars
+        );
+
+    void GetOutputColor(
+        __in CInstructionVariables *pInstructionVars,
+        __out_ecount(4) C_f32x4 *rgOutputColor
+        );
+
 private:
     unsigned              m_cRefs;
     RDPSTrans            *m_pTranslated;
     CTextureVariables    *m_pTextureVariables;
     GenerateColorsEffect *m_pfn;
+    bool                  m_fPointwise;
+
+    // The programs of a compiler created by CreateFused, NULL otherwise
+    CPixelShaderCompiler *m_pInner;
+    CPixelShaderCompiler *m_pOuter;
 };
 
 
@@ -238,20 +238,43 @@ CBaseGlyphRunPainter::PrepareTransforms()
 //       - bounding rectangle
 //       - filtered alpha array
 //
+//      The alpha array of a realization composed from the glyph atlas is
+//      composed in the glyph painter memory, and is only valid for this
+//      painter.
+//
 //------------------------------------------------------------------------------
-void
+HRESULT
 CBaseGlyphRunPainter::MakeAlphaMap(
     __inout_ecount(1) CBaseGlyphRun *pRun
     )
 {
-    m_pRealization->GetAlphaMap(
-        &m_pAlphaArray, 
-        &m_alphaArraySize,
-        &(pRun->m_rcFiltered));
+    HRESULT hr = S_OK;
+
+    if (m_pRealization->IsComposedFromAtlas())
+    {
+        IFC(m_pGlyphRunResource->ComposeAlphaMap(
+            m_pRealization,
+            0,      // originPosition
+            m_pGlyphPainterMemory,
+            &m_pAlphaArray,
+            &m_alphaArraySize,
+            &(pRun->m_rcFiltered)
+            ));
+    }
+    else
+    {
+        m_pRealization->GetAlphaMap(
+            &m_pAlphaArray, 
+            &m_alphaArraySize,
+            &(pRun->m_rcFiltered));
+    }
 
     if (IsRectEmpty(&(pRun->m_rcFiltered)))
     {
         pRun->SetEmpty();
     }
+
+Cleanup:
+    RRETURN(hr);
 }
 
@@ -108,7 +108,7 @@ public:
         return (m_pAlphaArray != NULL);
     }
 
-    void MakeAlphaMap(__inout_ecount(1) CBaseGlyphRun *pRun);
+    HRESULT MakeAlphaMap(__inout_ecount(1) CBaseGlyphRun *pRun);
 
     __ecount(1) CContextState* GetContextState() const
     {
@@ -30,11 +30,14 @@ volatile LONG g_uiCMILGlyphRunCount = 0;
 CGlyphRunStorage::~CGlyphRunStorage()
 {
     ReleaseInterface(m_pIDWriteFont);
-    CGlyphRunResource::ResetFontFaceCache();
 
     WPFFree(ProcessHeap, m_pGlyphIndices);
     
-    InterlockedDecrement(&g_uiCMILGlyphRunCount);
+    // Let go of the cached font faces along with the last glyph run
+    if (InterlockedDecrement(&g_uiCMILGlyphRunCount) == 0)
+    {
+        CGlyphRunResource::ResetFontFaceCache();
+    }
 }
 
 //+-----------------------------------------------------------------------------
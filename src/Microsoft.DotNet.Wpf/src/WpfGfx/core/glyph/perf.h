@@ -59,6 +59,19 @@
 //      After application shut down the result is available in text file
 //      c:\perfDump.txt.
 //
+//      The stages of text rendering have accumulators named Text_*: glyph
+//      run realization through the atlas or DWrite, glyph tank uploads, and
+//      blending for each rendering mode of the software rasterizer. Their
+//      cache behavior is in the glyph counters of MilFrameTiming.
+//
+//      These measure whatever the running application draws, so results
+//      are only comparable between runs of the same scenario. For numbers
+//      that can be reproduced, debug builds record the glyph runs drawn in
+//      software with their alpha maps (tag "Record glyph runs with their
+//      alpha maps for replay"), and replay the recording into an offscreen
+//      CSwRenderTargetBitmap (tag "Replay recorded glyph runs on the first
+//      glyph run drawn"), see CSwRenderTargetBitmap::ReplayRecordedGlyphRuns.
+//
 //------------------------------------------------------------------------------
 
 class CPerfAcc
@@ -153,6 +166,7 @@ private:
         fprintf(pFile, "total time, 1000000 ticks: %10.6f\n", double(m_uTicksCount)*(1./1000000));
         fprintf(pFile, "time per call, 1000 ticks: %f\n", double(m_uTicksCount)*(1./1000)/double(m_uCallsCount));
         fprintf(pFile, "average time per item, ticks: %f\n", double(m_uTicksCount)/double(m_uItemsCount));
+        fprintf(pFile, "items per 1000000 ticks: %f\n", double(m_uItemsCount)*1000000./double(m_uTicksCount));
         fprintf(pFile, "Min time per call, ticks: %d\n", m_uMinTicks);
         fprintf(pFile, "Max time per call, ticks: %d\n", m_uMaxTicks);
         fprintf(pFile, "Min time per item, ticks: %d\n", m_uMinTicksPerItem);
@@ -29,8 +29,15 @@ MtDefine(CD3DGlyphBank, CD3DDeviceLevel1, "CD3DGlyphBank");
 MtDefine(D3DResource_GlyphTank, MILHwMetrics, "Approximate glyph tank size");
 MtDefine(D3DResource_GlyphBankTempSurface, MILHwMetrics, "Approximate glyph bank temporary surface size");
 
+DeclareTag(tagGlyphTankPackerReplay, "MIL-HW", "Replay a synthetic trace through the glyph tank packer");
+
 #define GLYPHRUNCOUNT_THRESHOLD 20
 
+// CompactTanks runs once per this many frames, evicting tanks whose live
+// load is under 1/COMPACTION_OCCUPANCY_DIVISOR of their size
+#define FRAMES_BETWEEN_COMPACTION 64
+#define COMPACTION_OCCUPANCY_DIVISOR 4
+
 //+-----------------------------------------------------------------------------
 //
 //  Member:
@@ -71,6 +78,13 @@ CD3DGlyphBank::Init(
 
     if (m_uMaxTankWidth < 256 || m_uMaxTankHeight < 64) {hr = E_FAIL; goto Cleanup;}
 
+#if DBG
+    if (IsTagEnabled(tagGlyphTankPackerReplay))
+    {
+        CGlyphTankPacker::ReplaySyntheticTrace(m_uMaxTankWidth, m_uMaxTankHeight);
+    }
+#endif
+
 Cleanup:
     RRETURN(hr);
 }
@@ -123,6 +137,16 @@ CD3DGlyphBank::~CD3DGlyphBank()
 //  Synopsis:
 //      Release the memory that we don't need much.
 //
+//      Every FRAMES_BETWEEN_COMPACTION frames this also compacts the tanks,
+//      by eviction rather than relocation: CompactTanks releases a tank
+//      with little live load, and its subglyphs upload their alpha maps
+//      again into the current tank the next time they are drawn. Nothing is
+//      copied between textures, since A8 surfaces can't be the target of
+//      StretchRect on every device, and tanks don't track the subglyphs
+//      that live in them. The cost is that re-upload, paid by the frames
+//      that draw those glyph runs again, in exchange for the texture memory
+//      and the texture switches the scattered entries cost every frame.
+//
 //------------------------------------------------------------------------------
 void
 CD3DGlyphBank::CollectGarbage()
@@ -130,8 +154,15 @@ CD3DGlyphBank::CollectGarbage()
     ReleaseStubs();
     ReleaseLazyTanks();
 
+    if (++m_cFramesSinceCompaction >= FRAMES_BETWEEN_COMPACTION)
+    {
+        CompactTanks();
+        m_cFramesSinceCompaction = 0;
+    }
+
     for (CD3DGlyphTank* pTank = m_pTanks; pTank; pTank = pTank->m_pNext)
     {
+        D3DLOG_ADD(tankOccupancy, pTank->GetOccupancy()*100/256)
         pTank->NewFrame();
     }
     D3DLOG_SET(tanksTotal, CountTanks())
@@ -219,11 +250,25 @@ retry:
         }
     }
 
+    ReleaseStubs();
+
+    // Before creating another tank, try the space freed in older ones
+    if (m_pTanks)
+    {
+        for (CD3DGlyphTank* pTank = m_pTanks->m_pNext; pTank; pTank = pTank->m_pNext)
+        {
+            if (SUCCEEDED(pTank->AllocRect(uWidth, uHeight, pptLocation)))
+            {
+                *ppTank = pTank;
+                hr = S_OK;
+                goto Cleanup;
+            }
+        }
+    }
+
     // need to create another tank.
     // We permitted to handle MAX_TANK_NUM tanks.
 
-    ReleaseStubs();
-
     CD3DGlyphTank* pTankReuse = NULL;
 
     if (CountTanks() == MAX_TANK_NUM)
@@ -587,22 +632,22 @@ CD3DGlyphBank::ReleaseStubs()
 //
 //  The heuristic implemented in this routine maybe not the best one, however it
 //  appeared to reduce working set size for text editing scenario. 
-// The overall approach assumes that tanks are never reused.
-//  The tank is filled sequentially, run by run and stripe by stripe, in the
-//  same sequence as rendering happens. This is made on purpose, in order to
-//  reduce amount of IDirect3DDevice9::SetTexture() calls that are costly
-//  (AshrafM's investigation says 100 switshing per frame are acceptable and
-//  1000 too much). Even if some glyphruns in the tank are released, there are
-//  no attempts to reuse freed space.
-//
-//  This routine fires at the moment of Present, i.e. at the end of each frame rendering.
-//  It inspects each tank and releases it if it became filled loosely. The criteria
-//  is when amount of released texels exceeds the half of amount of allocated texels.
-//  It is possible to change condition below to
-//        if (p->GetLostLoad()== p->GetPeakLoad())
-//  so the tank will be released only when all the glyphruns will gone away -
-//  but this appeared not to provide enough working set size reducing.
-//  (9/5/2002 mikhaill)
+//  Glyphruns are placed in the tank in the same sequence as rendering happens,
+//  run by run and stripe by stripe, in order to reduce amount of
+//  IDirect3DDevice9::SetTexture() calls that are costly (AshrafM's
+//  investigation says 100 switshing per frame are acceptable and 1000 too
+//  much).
+//
+//  Space freed by released glyphruns goes back to the tank's packer and is
+//  taken off the peak load, so the peak load is the live load plus the lost
+//  load: the freed texels the packer's free list could not hold. Free texels
+//  are reused; lost ones are wasted until the tank is released.
+//
+//  This routine fires at the moment of Present, i.e. at the end of each frame
+//  rendering. It releases each tank but the current one where at least as
+//  many texels are lost as live, which includes the tanks whose glyphruns
+//  have all gone away. Tanks with many free texels but few live ones are left
+//  to CompactTanks.
 //
 //------------------------------------------------------------------------------
 void
@@ -629,6 +674,859 @@ CD3DGlyphBank::ReleaseLazyTanks()
     }
 }
 
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CD3DGlyphBank::CompactTanks
+//
+//  Synopsis:
+//      Evict the least occupied persistent tank when its live glyphs fit in
+//      the free space of the current tank.
+//
+//  Freed space is reused, but the glyphruns that keep a tank alive can be
+//  scattered over it, each of them costing a texture switch. Texels can't be
+//  copied between A8 textures on every device, so live entries are relocated
+//  the way evicted ones always are: the subglyphs of the stubified tank see
+//  that they were evicted and are uploaded again into the current tank the
+//  next time they are drawn.
+//
+//------------------------------------------------------------------------------
+void
+CD3DGlyphBank::CompactTanks()
+{
+    if (!m_pTanks) return;
+
+    CD3DGlyphTank** ppVictimTank = NULL;
+    UINT uMinOccupancy = UINT_MAX;
+
+    // the current tank is never evicted
+    for (CD3DGlyphTank** pp = &m_pTanks->m_pNext; *pp; pp = &(*pp)->m_pNext)
+    {
+        UINT uOccupancy = (*pp)->GetOccupancy();
+        if (uOccupancy < uMinOccupancy)
+        {
+            uMinOccupancy = uOccupancy;
+            ppVictimTank = pp;
+        }
+    }
+
+    if (ppVictimTank == NULL || uMinOccupancy * COMPACTION_OCCUPANCY_DIVISOR >= 256)
+    {
+        return;
+    }
+
+    CD3DGlyphTank* pVictimTank = *ppVictimTank;
+
+    // Leave slack for the packer's imperfect fit
+    if (pVictimTank->GetLoad() * 2 > m_pTanks->GetFreeArea())
+    {
+        return;
+    }
+
+    *ppVictimTank = pVictimTank->m_pNext;
+    pVictimTank->DestroyAndRelease();
+    D3DLOG_INC(tanksCompacted)
+}
+
+//-------------------------------------------------------- CGlyphTankPacker
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::Init
+//
+//  Synopsis:
+//      Set the size of the area to pack. The skyline is created by the first
+//      AllocRect, so that this can not fail.
+//
+//------------------------------------------------------------------------------
+void
+CGlyphTankPacker::Init(
+    UINT uWidth,
+    UINT uHeight
+    )
+{
+    m_uWidth = uWidth;
+    m_uHeight = uHeight;
+    m_uLiveArea = 0;
+
+#if DBG
+    m_uLostArea = 0;
+#endif
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::AllocRect
+//
+//  Synopsis:
+//      Allocate rectangular space: on the skyline if it has room, otherwise
+//      in freed space. Fails with E_FAIL if neither can fit the rectangle.
+//
+//------------------------------------------------------------------------------
+HRESULT
+CGlyphTankPacker::AllocRect(
+    UINT uWidth,
+    UINT uHeight,
+    __out_ecount(1) POINT* pptLocation
+    )
+{
+    HRESULT hr = S_OK;
+    UINT iSegment;
+
+    if (uWidth > m_uWidth || uHeight > m_uHeight)
+        return E_FAIL;
+
+    if (m_rgSkyline.GetCount() == 0)
+    {
+        SkylineSegment segment = {0, 0, m_uWidth};
+        IFC(m_rgSkyline.Add(segment));
+    }
+
+    if (FindSkylinePosition(uWidth, uHeight, &iSegment, pptLocation))
+    {
+        IFC(RaiseSkyline(iSegment, uWidth, pptLocation->y, uHeight));
+    }
+    else if (!AllocFromFreeRects(uWidth, uHeight, pptLocation))
+    {
+        // not enough space in tank; the caller takes another one
+        return E_FAIL;
+    }
+
+    m_uLiveArea += uWidth*uHeight;
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::FreeRect
+//
+//  Synopsis:
+//      Return rectangular space obtained by AllocRect. A rectangle right under
+//      the skyline lowers it; other ones go to the free list. Freeing the last
+//      rectangle empties the packer.
+//
+//  Returns:
+//      false if the space can not be reused because the free list is full
+//
+//------------------------------------------------------------------------------
+bool
+CGlyphTankPacker::FreeRect(
+    UINT uWidth,
+    UINT uHeight,
+    POINT ptLocation
+    )
+{
+    Assert(m_uLiveArea >= uWidth*uHeight);
+    m_uLiveArea -= uWidth*uHeight;
+
+    if (m_uLiveArea == 0)
+    {
+        // Start over, forgetting the fragments
+        m_rgSkyline.Reset(FALSE);
+        m_rgFreeRects.Reset(FALSE);
+
+#if DBG
+        m_uLostArea = 0;
+#endif
+
+        return true;
+    }
+
+    if (LowerSkyline(uWidth, uHeight, ptLocation))
+    {
+        // Freed rectangles that now lie under the skyline lower it further
+        for (UINT i = 0; i < m_rgFreeRects.GetCount(); )
+        {
+            const RECT &rc = m_rgFreeRects[i];
+            POINT pt = {rc.left, rc.top};
+
+            if (LowerSkyline(rc.right - rc.left, rc.bottom - rc.top, pt))
+            {
+                IGNORE_HR(m_rgFreeRects.RemoveAtOrderNotPreserved(i));
+                i = 0;
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        return true;
+    }
+
+    if (m_rgFreeRects.GetCount() < sc_cMaxFreeRects)
+    {
+        RECT rc;
+        SetRect(&rc, ptLocation.x, ptLocation.y, ptLocation.x + uWidth, ptLocation.y + uHeight);
+
+        if (SUCCEEDED(m_rgFreeRects.Add(rc)))
+        {
+            return true;
+        }
+    }
+
+#if DBG
+    m_uLostArea += uWidth*uHeight;
+#endif
+
+    return false;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::GetFreeArea
+//
+//  Synopsis:
+//      Texels above the skyline and in the free list.
+//
+//------------------------------------------------------------------------------
+UINT
+CGlyphTankPacker::GetFreeArea() const
+{
+    UINT uArea = 0;
+
+    if (m_rgSkyline.GetCount() == 0)
+    {
+        uArea = m_uWidth * m_uHeight;
+    }
+
+    for (UINT i = 0; i < m_rgSkyline.GetCount(); i++)
+    {
+        uArea += m_rgSkyline[i].uWidth * (m_uHeight - m_rgSkyline[i].y);
+    }
+
+    for (UINT i = 0; i < m_rgFreeRects.GetCount(); i++)
+    {
+        const RECT &rc = m_rgFreeRects[i];
+        uArea += (rc.right - rc.left) * (rc.bottom - rc.top);
+    }
+
+    return uArea;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::FindSkylinePosition
+//
+//  Synopsis:
+//      Find the position on the skyline where the bottom of the rectangle
+//      would be lowest, leftmost among equals. *piSegment receives the
+//      segment the rectangle would start on.
+//
+//------------------------------------------------------------------------------
+bool
+CGlyphTankPacker::FindSkylinePosition(
+    UINT uWidth,
+    UINT uHeight,
+    __out_ecount(1) UINT* piSegment,
+    __out_ecount(1) POINT* pptLocation
+    ) const
+{
+    UINT uBestBottom = UINT_MAX;
+
+    for (UINT i = 0; i < m_rgSkyline.GetCount(); i++)
+    {
+        UINT x = m_rgSkyline[i].x;
+
+        if (x + uWidth > m_uWidth)
+        {
+            break;
+        }
+
+        // The rectangle rests on the highest segment under it
+        UINT y = 0;
+        UINT uWidthLeft = uWidth;
+
+        for (UINT j = i; uWidthLeft > 0; j++)
+        {
+            Assert(j < m_rgSkyline.GetCount());
+
+            y = max(y, m_rgSkyline[j].y);
+
+            if (m_rgSkyline[j].uWidth >= uWidthLeft)
+            {
+                break;
+            }
+
+            uWidthLeft -= m_rgSkyline[j].uWidth;
+        }
+
+        if (y + uHeight <= m_uHeight && y + uHeight < uBestBottom)
+        {
+            uBestBottom = y + uHeight;
+            *piSegment = i;
+            pptLocation->x = x;
+            pptLocation->y = y;
+        }
+    }
+
+    return uBestBottom != UINT_MAX;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::RaiseSkyline
+//
+//  Synopsis:
+//      Raise the skyline to the bottom of a rectangle placed at height y over
+//      uWidth texels from the start of segment iSegment. The gaps left under
+//      the rectangle, where it rests on a higher neighbour, go to the free
+//      list.
+//
+//------------------------------------------------------------------------------
+HRESULT
+CGlyphTankPacker::RaiseSkyline(
+    UINT iSegment,
+    UINT uWidth,
+    UINT y,
+    UINT uHeight
+    )
+{
+    HRESULT hr = S_OK;
+
+    SkylineSegment segment;
+    segment.x = m_rgSkyline[iSegment].x;
+    segment.y = y + uHeight;
+    segment.uWidth = uWidth;
+
+    IFC(m_rgSkyline.InsertAt(segment, iSegment));
+
+    {
+        // Cut the segments the new one now covers
+        UINT xEnd = segment.x + uWidth;
+
+        while (iSegment + 1 < m_rgSkyline.GetCount())
+        {
+            SkylineSegment &next = m_rgSkyline[iSegment + 1];
+
+            if (next.x >= xEnd)
+            {
+                break;
+            }
+
+            UINT uCovered = min(next.x + next.uWidth, xEnd) - next.x;
+
+            if (next.y < y)
+            {
+                AddFreeRect(next.x, next.y, uCovered, y - next.y);
+            }
+
+            if (uCovered == next.uWidth)
+            {
+                IGNORE_HR(m_rgSkyline.RemoveAt(iSegment + 1));
+            }
+            else
+            {
+                next.uWidth -= uCovered;
+                next.x = xEnd;
+                break;
+            }
+        }
+    }
+
+    MergeSegments();
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::LowerSkyline
+//
+//  Synopsis:
+//      If the given rectangle lies right under the skyline over its whole
+//      width, lower the skyline to its top and return true.
+//
+//------------------------------------------------------------------------------
+bool
+CGlyphTankPacker::LowerSkyline(
+    UINT uWidth,
+    UINT uHeight,
+    POINT ptLocation
+    )
+{
+    UINT x = static_cast<UINT>(ptLocation.x);
+    UINT y = static_cast<UINT>(ptLocation.y);
+    UINT xEnd = x + uWidth;
+
+    UINT iFirst = UINT_MAX;
+    UINT iLast = UINT_MAX;
+
+    for (UINT i = 0; i < m_rgSkyline.GetCount(); i++)
+    {
+        const SkylineSegment &segment = m_rgSkyline[i];
+
+        if (segment.x + segment.uWidth <= x)
+        {
+            continue;
+        }
+
+        if (segment.x >= xEnd)
+        {
+            break;
+        }
+
+        if (segment.y != y + uHeight)
+        {
+            return false;
+        }
+
+        if (iFirst == UINT_MAX)
+        {
+            iFirst = i;
+        }
+        iLast = i;
+    }
+
+    // Splitting the end segments inserts up to two segments
+    if (iFirst == UINT_MAX || FAILED(m_rgSkyline.ReserveSpace(2)))
+    {
+        return false;
+    }
+
+    SkylineSegment first = m_rgSkyline[iFirst];
+    SkylineSegment last = m_rgSkyline[iLast];
+
+    for (UINT i = iLast + 1; i > iFirst; i--)
+    {
+        IGNORE_HR(m_rgSkyline.RemoveAt(i - 1));
+    }
+
+    UINT iInsert = iFirst;
+
+    if (first.x < x)
+    {
+        first.uWidth = x - first.x;
+        IGNORE_HR(m_rgSkyline.InsertAt(first, iInsert++));
+    }
+
+    SkylineSegment lowered = {x, y, uWidth};
+    IGNORE_HR(m_rgSkyline.InsertAt(lowered, iInsert++));
+
+    if (last.x + last.uWidth > xEnd)
+    {
+        last.uWidth = last.x + last.uWidth - xEnd;
+        last.x = xEnd;
+        IGNORE_HR(m_rgSkyline.InsertAt(last, iInsert));
+    }
+
+    MergeSegments();
+
+    return true;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::AllocFromFreeRects
+//
+//  Synopsis:
+//      Place the rectangle in the smallest freed rectangle that fits it. The
+//      rest is split along the shorter leftover side and returned to the list.
+//
+//------------------------------------------------------------------------------
+bool
+CGlyphTankPacker::AllocFromFreeRects(
+    UINT uWidth,
+    UINT uHeight,
+    __out_ecount(1) POINT* pptLocation
+    )
+{
+    UINT iBest = UINT_MAX;
+    UINT uBestArea = UINT_MAX;
+
+    for (UINT i = 0; i < m_rgFreeRects.GetCount(); i++)
+    {
+        const RECT &rc = m_rgFreeRects[i];
+        UINT uFreeWidth = rc.right - rc.left;
+        UINT uFreeHeight = rc.bottom - rc.top;
+
+        if (uFreeWidth >= uWidth && uFreeHeight >= uHeight && uFreeWidth * uFreeHeight < uBestArea)
+        {
+            iBest = i;
+            uBestArea = uFreeWidth * uFreeHeight;
+        }
+    }
+
+    if (iBest == UINT_MAX)
+    {
+        return false;
+    }
+
+    RECT rc = m_rgFreeRects[iBest];
+    IGNORE_HR(m_rgFreeRects.RemoveAtOrderNotPreserved(iBest));
+
+    pptLocation->x = rc.left;
+    pptLocation->y = rc.top;
+
+    UINT uLeftoverWidth = (rc.right - rc.left) - uWidth;
+    UINT uLeftoverHeight = (rc.bottom - rc.top) - uHeight;
+
+    if (uLeftoverWidth < uLeftoverHeight)
+    {
+        // right piece as tall as the rectangle, bottom piece full width
+        AddFreeRect(rc.left + uWidth, rc.top, uLeftoverWidth, uHeight);
+        AddFreeRect(rc.left, rc.top + uHeight, rc.right - rc.left, uLeftoverHeight);
+    }
+    else
+    {
+        // right piece full height, bottom piece as wide as the rectangle
+        AddFreeRect(rc.left + uWidth, rc.top, uLeftoverWidth, rc.bottom - rc.top);
+        AddFreeRect(rc.left, rc.top + uHeight, uWidth, uLeftoverHeight);
+    }
+
+    return true;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::AddFreeRect
+//
+//  Synopsis:
+//      Keep a leftover piece for reuse. Pieces that do not fit in the list are
+//      dropped; the tank gets them back when it is repopulated.
+//
+//------------------------------------------------------------------------------
+void
+CGlyphTankPacker::AddFreeRect(
+    UINT x,
+    UINT y,
+    UINT uWidth,
+    UINT uHeight
+    )
+{
+    if (uWidth == 0 || uHeight == 0)
+    {
+        return;
+    }
+
+    if (m_rgFreeRects.GetCount() < sc_cMaxFreeRects)
+    {
+        RECT rc;
+        SetRect(&rc, x, y, x + uWidth, y + uHeight);
+
+        if (SUCCEEDED(m_rgFreeRects.Add(rc)))
+        {
+            return;
+        }
+    }
+
+#if DBG
+    m_uLostArea += uWidth*uHeight;
+#endif
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::MergeSegments
+//
+//  Synopsis:
+//      Join neighbouring skyline segments of the same height.
+//
+//------------------------------------------------------------------------------
+void
+CGlyphTankPacker::MergeSegments()
+{
+    UINT i = 0;
+
+    while (i + 1 < m_rgSkyline.GetCount())
+    {
+        if (m_rgSkyline[i].y == m_rgSkyline[i + 1].y)
+        {
+            m_rgSkyline[i].uWidth += m_rgSkyline[i + 1].uWidth;
+            IGNORE_HR(m_rgSkyline.RemoveAt(i + 1));
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+#if DBG
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::AssertValid
+//
+//  Synopsis:
+//      Check that the skyline spans the width, that freed rectangles lie under
+//      it without overlapping each other, and that every texel is either
+//      free, live or lost.
+//
+//------------------------------------------------------------------------------
+void
+CGlyphTankPacker::AssertValid() const
+{
+    if (m_rgSkyline.GetCount() == 0)
+    {
+        Assert(m_rgFreeRects.GetCount() == 0);
+        Assert(m_uLiveArea == 0);
+        Assert(m_uLostArea == 0);
+        return;
+    }
+
+    UINT x = 0;
+
+    for (UINT i = 0; i < m_rgSkyline.GetCount(); i++)
+    {
+        const SkylineSegment &segment = m_rgSkyline[i];
+
+        Assert(segment.x == x);
+        Assert(segment.uWidth > 0);
+        Assert(segment.y <= m_uHeight);
+        Assert(i == 0 || segment.y != m_rgSkyline[i - 1].y);
+
+        x += segment.uWidth;
+    }
+
+    Assert(x == m_uWidth);
+
+    for (UINT i = 0; i < m_rgFreeRects.GetCount(); i++)
+    {
+        const RECT &rc = m_rgFreeRects[i];
+
+        Assert(rc.left >= 0 && rc.left < rc.right && static_cast<UINT>(rc.right) <= m_uWidth);
+        Assert(rc.top >= 0 && rc.top < rc.bottom);
+
+        for (UINT j = 0; j < m_rgSkyline.GetCount(); j++)
+        {
+            const SkylineSegment &segment = m_rgSkyline[j];
+
+            if (   segment.x < static_cast<UINT>(rc.right)
+                && segment.x + segment.uWidth > static_cast<UINT>(rc.left))
+            {
+                Assert(static_cast<UINT>(rc.bottom) <= segment.y);
+            }
+        }
+
+        for (UINT j = i + 1; j < m_rgFreeRects.GetCount(); j++)
+        {
+            RECT rcOverlap;
+            Assert(!IntersectRect(&rcOverlap, &rc, &m_rgFreeRects[j]));
+        }
+    }
+
+    Assert(GetFreeArea() + m_uLiveArea + m_uLostArea == m_uWidth * m_uHeight);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::ReplayTrace
+//
+//  Synopsis:
+//      Replay an allocation trace against a packer of the given size, with no
+//      D3D work. Freeing a rectangle that could not be allocated is skipped,
+//      as a tank would have taken it.
+//
+//      The trace is replayed twice. The first run is timed; the second one
+//      asserts that placed rectangles are in bounds and overlap no live one,
+//      validates the packer after every step and records the peak lost area.
+//
+//------------------------------------------------------------------------------
+HRESULT
+CGlyphTankPacker::ReplayTrace(
+    UINT uWidth,
+    UINT uHeight,
+    __in_ecount(cSteps) const TraceStep *rgSteps,
+    UINT cSteps,
+    __out_ecount(1) ReplayResult *pResult
+    )
+{
+    HRESULT hr = S_OK;
+
+    // Placed rectangles by step; empty for failed or freed ones
+    DynArray<RECT> rgPlaced;
+    RECT rcEmpty = {0, 0, 0, 0};
+    LARGE_INTEGER liStart, liEnd;
+
+    ZeroMemory(pResult, sizeof(*pResult));
+
+    for (UINT i = 0; i < cSteps; i++)
+    {
+        if (rgSteps[i].fFree && (rgSteps[i].iAlloc >= i || rgSteps[rgSteps[i].iAlloc].fFree))
+        {
+            IFC(E_INVALIDARG);
+        }
+    }
+
+    IFC(rgPlaced.AddAndSet(cSteps, rcEmpty));
+
+    {
+        CGlyphTankPacker packer;
+        packer.Init(uWidth, uHeight);
+
+        IFCW32(QueryPerformanceCounter(&liStart));
+
+        for (UINT i = 0; i < cSteps; i++)
+        {
+            const TraceStep &step = rgSteps[i];
+
+            if (!step.fFree)
+            {
+                POINT pt;
+
+                if (SUCCEEDED(packer.AllocRect(step.uWidth, step.uHeight, &pt)))
+                {
+                    SetRect(&rgPlaced[i], pt.x, pt.y, pt.x + step.uWidth, pt.y + step.uHeight);
+                }
+            }
+            else if (!IsRectEmpty(&rgPlaced[step.iAlloc]))
+            {
+                const RECT &rc = rgPlaced[step.iAlloc];
+                POINT pt = {rc.left, rc.top};
+
+                packer.FreeRect(rc.right - rc.left, rc.bottom - rc.top, pt);
+                rgPlaced[step.iAlloc] = rcEmpty;
+            }
+        }
+
+        IFCW32(QueryPerformanceCounter(&liEnd));
+
+        pResult->llReplayTicks = liEnd.QuadPart - liStart.QuadPart;
+    }
+
+    for (UINT i = 0; i < cSteps; i++)
+    {
+        rgPlaced[i] = rcEmpty;
+    }
+
+    {
+        CGlyphTankPacker packer;
+        packer.Init(uWidth, uHeight);
+
+        for (UINT i = 0; i < cSteps; i++)
+        {
+            const TraceStep &step = rgSteps[i];
+
+            if (!step.fFree)
+            {
+                POINT pt;
+
+                if (FAILED(packer.AllocRect(step.uWidth, step.uHeight, &pt)))
+                {
+                    pResult->cFailedAllocs++;
+                    continue;
+                }
+
+                RECT &rcPlaced = rgPlaced[i];
+                SetRect(&rcPlaced, pt.x, pt.y, pt.x + step.uWidth, pt.y + step.uHeight);
+
+                Assert(rcPlaced.left >= 0 && static_cast<UINT>(rcPlaced.right) <= uWidth);
+                Assert(rcPlaced.top >= 0 && static_cast<UINT>(rcPlaced.bottom) <= uHeight);
+
+                for (UINT j = 0; j < i; j++)
+                {
+                    RECT rcOverlap;
+                    Assert(!IntersectRect(&rcOverlap, &rcPlaced, &rgPlaced[j]));
+                }
+            }
+            else if (!IsRectEmpty(&rgPlaced[step.iAlloc]))
+            {
+                const RECT &rc = rgPlaced[step.iAlloc];
+                POINT pt = {rc.left, rc.top};
+
+                packer.FreeRect(rc.right - rc.left, rc.bottom - rc.top, pt);
+                rgPlaced[step.iAlloc] = rcEmpty;
+            }
+
+            packer.AssertValid();
+            pResult->uMaxLostArea = max(pResult->uMaxLostArea, packer.m_uLostArea);
+        }
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphTankPacker::ReplaySyntheticTrace
+//
+//  Synopsis:
+//      Replay a reproducible trace shaped like text editing, glyph runs of a
+//      word to a line being created and released in random order, and trace
+//      the results. Small tanks overflow, which exercises failed allocations.
+//
+//------------------------------------------------------------------------------
+void
+CGlyphTankPacker::ReplaySyntheticTrace(
+    UINT uWidth,
+    UINT uHeight
+    )
+{
+    HRESULT hr = S_OK;
+
+    static const UINT sc_cSteps = 4096;
+
+    // About half of a full size tank
+    static const UINT sc_cMaxLiveSteps = 96;
+
+    DynArray<TraceStep> rgSteps;
+    DynArray<UINT> rgLiveSteps;
+    UINT uSeed = 1;
+    ReplayResult result;
+    LARGE_INTEGER liFrequency;
+
+    for (UINT i = 0; i < sc_cSteps; i++)
+    {
+        uSeed = uSeed * 1103515245 + 12345;
+        UINT uRandom = uSeed >> 8;
+
+        TraceStep step = {false, 0, 0, 0};
+
+        if (   rgLiveSteps.GetCount() >= sc_cMaxLiveSteps
+            || (rgLiveSteps.GetCount() > 0 && uRandom % 8 < 3))
+        {
+            UINT iLive = (uRandom >> 3) % rgLiveSteps.GetCount();
+
+            step.fFree = true;
+            step.iAlloc = rgLiveSteps[iLive];
+            IGNORE_HR(rgLiveSteps.RemoveAtOrderNotPreserved(iLive));
+        }
+        else
+        {
+            step.uWidth = 8 + (uRandom >> 3) % 400;
+            step.uHeight = 8 + (uRandom >> 12) % 24;
+            IFC(rgLiveSteps.Add(i));
+        }
+
+        IFC(rgSteps.Add(step));
+    }
+
+    IFC(ReplayTrace(uWidth, uHeight, rgSteps.GetDataBuffer(), rgSteps.GetCount(), &result));
+    IFCW32(QueryPerformanceFrequency(&liFrequency));
+
+    TraceTag((tagGlyphTankPackerReplay,
+              "Glyph tank packer replay: %u steps, %u failed allocations, %u texels lost at most, %I64d us",
+              sc_cSteps,
+              result.cFailedAllocs,
+              result.uMaxLostArea,
+              result.llReplayTicks * 1000000 / liFrequency.QuadPart
+              ));
+
+Cleanup:
+    if (FAILED(hr))
+    {
+        TraceTag((tagGlyphTankPackerReplay, "Glyph tank packer replay failed: 0x%08x", hr));
+    }
+}
+#endif
+
 //-------------------------------------------------------- CD3DGlyphTank
 
 //+-----------------------------------------------------------------------------
@@ -660,10 +1558,9 @@ CD3DGlyphTank::CD3DGlyphTank(
     m_rWidthReciprocal = 1.f/float(widTank);
     m_rHeightReciprocal = 1.f/float(heiTank);
     
+    m_packer.Init(widTank, heiTank);
+
     //DECLARE_METERHEAP_CLEAR assumed
-    //m_uX = 0;
-    //m_uY = 0;
-    //m_uBandHeight = 0;
     //m_nPeakLoad = 0;
     //m_nLostLoad = 0;
     //m_nThisFrameLoad = 0;
@@ -715,54 +1612,14 @@ CD3DGlyphTank::AllocRect(
     UINT uHeight,
     __out_ecount(1) POINT* pptLocation)
 {
-    if (uWidth > m_uWidth || uHeight > m_uHeight)
-        return E_FAIL;
-
-    if (m_uBandHeight)
-    {   // 1. Try use current band
-        if (m_uWidth - m_uX >= uWidth)
-        {
-            if (m_uBandHeight < uHeight && m_uHeight - m_uY >= uHeight)
-            {   // band height is too small;
-                // detect whether it would be reasonable to enlarge it
-                if ((m_uWidth - m_uX)*m_uBandHeight > m_uX*(uHeight - m_uBandHeight))
-                {   // enlarge
-                    m_uBandHeight = uHeight;
-                }
-            }
-            
-            if (m_uBandHeight >= uHeight)
-            {   // place in current band
-                pptLocation->x = m_uX;
-                pptLocation->y = m_uY;
-                m_uX += uWidth;
-                AddLoad(uWidth*uHeight);
-                return S_OK;
-            }
-        }
+    HRESULT hr = m_packer.AllocRect(uWidth, uHeight, pptLocation);
 
-        // close this band
-        m_uY += m_uBandHeight;
-        m_uBandHeight = 0;
-        m_uX = 0;
-    }
-
-    {   // 2. Try to alloc another band
-        if (m_uHeight - m_uY < uHeight)
-        {   // fatal failure - not enough space in tank
-            return E_FAIL;
-        }
-
-        m_uBandHeight = uHeight;
-    }
-
-    {   // 3. Use new band
-        pptLocation->x = m_uX;
-        pptLocation->y = m_uY;
-        m_uX += uWidth;
+    if (SUCCEEDED(hr))
+    {
         AddLoad(uWidth*uHeight);
-        return S_OK;
     }
+
+    return hr;
 }
 
 //+-----------------------------------------------------------------------------
@@ -773,14 +1630,10 @@ CD3DGlyphTank::AllocRect(
 //  Synopsis:
 //      Free rectangular space obtained by AllocRect.
 //
-//  Basically, we don't care about reusing freed surface area, supposing that
-//  detecting loosely populated tanks and re-populating them from scratch serves
-//  better. However there is special case: temporary tank. It never contains
-//  more than one allocated rectangle, and we need it to get really empty after
-//  FreeRect(). To provide it, we are comparing the rectangle requested to free
-//  with current allocation position defined by m_uX, m_uY and m_uBandHeight. If
-//  the rectangle turns to be the only allocated one, all these variables become
-//  zeros as if the tank was just created.
+//  The packer takes the space back for later allocations, so the tank only
+//  loses it when the packer's free list is full. The temporary tank never
+//  contains more than one allocated rectangle; freeing it lowers the skyline
+//  to the bottom, leaving the tank as empty as if it was just created.
 //
 //------------------------------------------------------------------------------
 void
@@ -790,35 +1643,12 @@ CD3DGlyphTank::FreeRect(
     __out_ecount(1) POINT ptLocation
     )
 {
-    //
-    // Check whether given rectangle is the last allocated one.
-    // Last allocated should be most right in the current band.
-    // See following codes in AllocRect:
-    //    pptLocation->x = m_uX;
-    //    pptLocation->y = m_uY;
-    //    m_uX += uWidth;
-    //
-    if (static_cast<UINT>(ptLocation.x) + uWidth == m_uX &&
-        static_cast<UINT>(ptLocation.y) == m_uY)
+    if (m_packer.FreeRect(uWidth, uHeight, ptLocation))
     {
-        //
-        // Given rectangle is the last allocated one,
-        // so we can gracefully reclaim used memory.
-        //
-        m_uX -= uWidth;
-        if (m_uX == 0)
-        {
-            // Current band became empty, so we can close it:
-            m_uBandHeight = 0;
-        }
-
         ReclaimLoad(uWidth*uHeight);
     }
     else
     {
-        //
-        // Given rectangle appeared to be somewhere inside tank surface;
-        // don't care about reusing this space, just count lost area.
         SubLoad(uWidth*uHeight);
     }
 }
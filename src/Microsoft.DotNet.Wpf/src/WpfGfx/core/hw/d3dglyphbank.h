@@ -75,6 +75,140 @@ private:
     UINT const m_uHeight;
 };
 
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CGlyphTankPacker
+//
+//  Synopsis:
+//      Packs rectangles into an area of fixed size. New rectangles are placed
+//      on the skyline, the upper edge of the free area, at the lowest position
+//      where they fit. Rectangles freed below the skyline go to a free list
+//      and are reused, split guillotine style, once the skyline is full.
+//
+//      The packer does no D3D work, so allocation traces can be replayed
+//      against it alone.
+//
+//------------------------------------------------------------------------------
+class CGlyphTankPacker
+{
+public:
+    // no ctor - owner's DECLARE_METERHEAP_CLEAR assumed
+    void Init(
+        UINT uWidth,
+        UINT uHeight
+        );
+
+    HRESULT AllocRect(
+        UINT uWidth,
+        UINT uHeight,
+        __out_ecount(1) POINT* pptLocation
+        );
+
+    bool FreeRect(
+        UINT uWidth,
+        UINT uHeight,
+        POINT ptLocation
+        );
+
+    UINT GetFreeArea() const;
+
+#if DBG
+    // One step of an allocation trace: allocating a rectangle, or freeing
+    // the one allocated by step iAlloc
+    struct TraceStep
+    {
+        bool fFree;
+        UINT uWidth;
+        UINT uHeight;
+        UINT iAlloc;
+    };
+
+    struct ReplayResult
+    {
+        UINT cFailedAllocs;
+        UINT uMaxLostArea;      // texels freed but not kept for reuse
+        LONGLONG llReplayTicks; // QueryPerformanceCounter ticks
+    };
+
+    static HRESULT ReplayTrace(
+        UINT uWidth,
+        UINT uHeight,
+        __in_ecount(cSteps) const TraceStep *rgSteps,
+        UINT cSteps,
+        __out_ecount(1) ReplayResult *pResult
+        );
+
+    static void ReplaySyntheticTrace(
+        UINT uWidth,
+        UINT uHeight
+        );
+
+    void AssertValid() const;
+#endif
+
+private:
+    struct SkylineSegment
+    {
+        UINT x;
+        UINT y;         // first free row
+        UINT uWidth;
+    };
+
+    bool FindSkylinePosition(
+        UINT uWidth,
+        UINT uHeight,
+        __out_ecount(1) UINT* piSegment,
+        __out_ecount(1) POINT* pptLocation
+        ) const;
+
+    HRESULT RaiseSkyline(
+        UINT iSegment,
+        UINT uWidth,
+        UINT y,
+        UINT uHeight
+        );
+
+    bool LowerSkyline(
+        UINT uWidth,
+        UINT uHeight,
+        POINT ptLocation
+        );
+
+    bool AllocFromFreeRects(
+        UINT uWidth,
+        UINT uHeight,
+        __out_ecount(1) POINT* pptLocation
+        );
+
+    void AddFreeRect(
+        UINT x,
+        UINT y,
+        UINT uWidth,
+        UINT uHeight
+        );
+
+    void MergeSegments();
+
+    // Freed rectangles beyond this many are not reused
+    static const UINT sc_cMaxFreeRects = 128;
+
+    UINT m_uWidth, m_uHeight;
+
+    // Segments are sorted by x and cover the whole width
+    DynArray<SkylineSegment> m_rgSkyline;
+
+    DynArray<RECT> m_rgFreeRects;
+
+    // Texels of the rectangles allocated and not freed
+    UINT m_uLiveArea;
+
+#if DBG
+    // Texels dropped rather than kept in the free list
+    UINT m_uLostArea;
+#endif
+};
+
 //+-----------------------------------------------------------------------------
 //
 //  Class:
@@ -117,6 +251,14 @@ public:
         __out_ecount(1) POINT ptLocation
         );
 
+    // Texels used by live rectangles, per 256 texels of the tank
+    UINT GetOccupancy() const
+    {
+        return static_cast<UINT>((static_cast<UINT64>(GetLoad()) * 256) / (m_uWidth * m_uHeight));
+    }
+
+    UINT GetFreeArea() const {return m_packer.GetFreeArea();}
+
     //
     // accessors
     //
@@ -155,7 +297,6 @@ private:
 
 public:
     MIL_FORCEINLINE UINT GetHeight() const {return m_uHeight;}
-    MIL_FORCEINLINE UINT GetFilledHeight() const {return m_uY+m_uBandHeight;}
 
     // tank list
     CD3DGlyphTank* m_pNext;
@@ -171,17 +312,15 @@ private:
     UINT m_uWidth, m_uHeight;
     float m_rWidthReciprocal, m_rHeightReciprocal;
 
-    // allocation variables
-    UINT m_uX, m_uY, m_uBandHeight;
+    CGlyphTankPacker m_packer;
 
     // load count: shows how many pixels occupied by consumers
     // who called AllocRect. When the consumer detaches from
-    // the tank, it should call CD3DGlyphTank::SubLoad(), then
-    // CD3DGlyphTank::Release(). In particular, this can happen
-    // when the consumer is being deleted, maybe on another
-    // thread (managed garbage collector's one). Therefore it is
-    // extremely important to make any changes of m_nLoad
-    // only by interlocked AddLoad(n) and SubLoad() routines.
+    // the tank by FreeRect, the space the packer takes back
+    // is reclaimed from m_nPeakLoad, and the space it cannot
+    // reuse is counted in m_nLostLoad. Consumers detach on
+    // the render thread, like they allocate, since FreeRect
+    // updates the packer.
 
     volatile LONG m_nPeakLoad;
     volatile LONG m_nLostLoad;
@@ -281,6 +420,7 @@ private:
 
     void ReleaseStubs();
     void ReleaseLazyTanks();
+    void CompactTanks();
     HRESULT CreateTank(UINT minHei, BOOL fPersistent);
     UINT CountTanks()
     {
@@ -292,6 +432,9 @@ private:
     CGlyphPainterMemory m_glyphPainterMemory;
 
     CD3DGlyphBankTemporarySurface *m_pTempSurface;
+
+    // CollectGarbage calls since the last CompactTanks
+    UINT m_cFramesSinceCompaction;
 };
 
 
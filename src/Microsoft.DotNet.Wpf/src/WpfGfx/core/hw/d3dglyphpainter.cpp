@@ -21,6 +21,9 @@
 
 #include "precomp.hpp"
 
+// Glyph runs drawn with D3D, see perf.h
+DeclarePerfAcc(Text_D3D_Paint);
+
 CD3DGlyphRunPainter::CD3DGlyphRunPainter()
 {
     m_data.m_pHwColorSource = NULL;
@@ -48,6 +51,8 @@ CD3DGlyphRunPainter::Paint(
     MilPixelFormat::Enum fmtTargetSurface
     )
 {
+    MeasurePerf(Text_D3D_Paint, 1);
+
     HRESULT hr = S_OK;
         
     m_pDevice = pDevice;
@@ -395,15 +400,18 @@ Cleanup:
 HRESULT
 CD3DGlyphRunPainter::EnsureAlphaMap()
 {  
+    HRESULT hr = S_OK;
+
     if (!HasAlphaArray()) 
     {
         // If we don't have an alpha map array, create one from the realization.
         Assert(m_pGlyphRun);
 
-        MakeAlphaMap(m_pGlyphRun);
+        IFC(MakeAlphaMap(m_pGlyphRun));
     }
 
-     RRETURN(S_OK);
+Cleanup:
+    RRETURN(hr);
 }
 
 
@@ -25,6 +25,9 @@
 // Meters ----------------------------------------------------------------------
 MtDefine(CD3DGlyphRun, CD3DDeviceLevel1, "CD3DGlyphRun");
 
+// Alpha map pixels copied into glyph tanks, see perf.h
+DeclarePerfAcc(Text_D3D_TankUpload);
+
 
 //==================================== CD3DSubGlyph ============================
 
@@ -85,6 +88,8 @@ CD3DSubGlyph::ValidateAlphaMap(CD3DGlyphRunPainter* pPainter)
     m_offset.cy = tankLocation.y - m_rcFiltered.top;
 
     {
+        MeasurePerf(Text_D3D_TankUpload, wid*hei);
+
         BYTE* pAlphaArray = NULL;
         UINT32 alphaArraySize = 0;
         pPainter->GetAlphaArray(&pAlphaArray, &alphaArraySize);
@@ -46,6 +46,8 @@ ExternTag(tagD3DLog);
     m(smallPersTanksDestroyed      , "Small Pers Tanks Destroyed"       )\
     m(smallReuseTanksDestroyed     , "Small Reuse Tanks Destroyed"      )\
     m(tanksTotal                   , "Tanks Total"                      )\
+    m(tanksCompacted               , "Tanks Compacted"                  )\
+    m(tankOccupancy                , "Tank Occupancy (sum of %)"        )\
     m(subglyphsRegenerated         , "Subglyphs Regenerated"            )\
     m(persSubglyphsRegenerated     , "Persistent Subglyphs Regenerated" )\
     m(subglyphsEvicted             , "Subglyphs Reanimated"             )\
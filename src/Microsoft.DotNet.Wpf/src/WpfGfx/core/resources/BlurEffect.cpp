@@ -18,11 +18,18 @@
 MtDefine(BlurEffectResource, MILRender, "BlurEffect Resource");
 MtDefine(CMilBlurEffectDuce, BlurEffectResource, "CMilBlurEffectDuce");
 MtDefine(BoxBlurLineBuffer, BlurEffectResource, "BoxBlurLineBuffer");
+MtDefine(BoxApproximationBuffer, BlurEffectResource, "BoxApproximationBuffer");
+MtDefine(BlurPyramidBuffer, BlurEffectResource, "BlurPyramidBuffer");
 
 CMilPixelShaderDuce* CMilBlurEffectDuce::s_pBlurPixelShaders[4] = { 0 };
 
+UINT CMilBlurEffectDuce::s_uPyramidMaxError = CMilBlurEffectDuce::PYRAMID_DEFAULT_MAX_ERROR;
+bool CMilBlurEffectDuce::s_fPyramidMaxErrorRead = false;
+
 GenerateColorsBlur CMilBlurEffectDuce::s_pfnBlurFunctionBox = NULL;
 GenerateColorsBlur CMilBlurEffectDuce::s_pfnBlurFunctionGaussian = NULL;
+GenerateColorsBlur CMilBlurEffectDuce::s_pfnBlurFunctionBoxFixedPoint = NULL;
+GenerateColorsBlur CMilBlurEffectDuce::s_pfnBlurFunctionGaussianFixedPoint = NULL;
 
 const f32x4 c_rZero = {0.0f, 0.0f, 0.0f, 0.0f};
 const u32x4 c_uZero = {0, 0, 0, 0};
@@ -393,6 +400,147 @@ CMilBlurEffectDuce::CalculateSamplingWeights(
 
 }
 
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::CalculateFixedPointGaussianWeights
+//
+// Synopsis: 
+//      Quantizes the 2 * radius + 1 weights of a full Gaussian kernel to
+//      units of 2^-GAUSSIAN_FIXED_POINT_SHIFT for the fixed point program.
+//      The center weight absorbs the rounding so that the weights sum to
+//      exactly one, which keeps areas of flat color unchanged.
+//
+//      Returns false if the fixed point program could differ from the
+//      floating point one by more than 1/255, i.e. if the weights change by
+//      more than 0.5/255 in total, or if a weight does not fit in 15 bits.
+//
+//-----------------------------------------------------------------------------
+bool
+CMilBlurEffectDuce::CalculateFixedPointGaussianWeights(
+    UINT radius,
+    __in_ecount(2*radius+1) const float *pWeights,
+    __out_ecount(2*radius+1) UINT *pFixedWeights
+    )
+{
+    const UINT one = 1 << GAUSSIAN_FIXED_POINT_SHIFT;
+
+    UINT sum = 0;
+
+    for (UINT i = 0; i < 2 * radius + 1; i++)
+    {
+        if (pWeights[i] < 0.0f || pWeights[i] >= 1.0f)
+        {
+            return false;
+        }
+
+        pFixedWeights[i] = static_cast<UINT>(pWeights[i] * one + 0.5f);
+
+        if (i != radius)
+        {
+            sum += pFixedWeights[i];
+        }
+    }
+
+    if (sum >= one)
+    {
+        return false;
+    }
+
+    pFixedWeights[radius] = one - sum;
+
+    if (pFixedWeights[radius] >= one)
+    {
+        return false;
+    }
+
+    double error = 0.0;
+
+    for (UINT i = 0; i < 2 * radius + 1; i++)
+    {
+        error += fabs(static_cast<double>(pWeights[i]) * one - pFixedWeights[i]);
+    }
+
+    return error * 255.0 <= 0.5 * one;
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::CalculateFixedPointBoxDivisor
+//
+// Synopsis: 
+//      Chooses the reciprocal and rounding term with which the fixed point
+//      box program divides a sum of sampleLength^2 pixels:
+//
+//          result = ((sum + rounding) * reciprocal) >> 16
+//
+//      This is computed with 16 bit multiplies, so it is only available
+//      when every sum fits in 16 bits. The result is exact when sum is a
+//      multiple of the divisor, so flat colors are unchanged, and otherwise
+//      within 1/255 of the rounded quotient. Being monotonic, it preserves
+//      color <= alpha.
+//
+//-----------------------------------------------------------------------------
+bool
+CMilBlurEffectDuce::CalculateFixedPointBoxDivisor(
+    UINT sampleLength,
+    __out UINT *pReciprocal,
+    __out UINT *pRounding
+    )
+{
+    UINT divisor = sampleLength * sampleLength;
+
+    *pReciprocal = 0;
+    *pRounding = 0;
+
+    if (divisor < 2 || 255 * divisor > 0xFFFF)
+    {
+        return false;
+    }
+
+    //
+    // Try the reciprocals nearest to 2^16 / divisor first. For each, the
+    // rounding terms that divide every multiple of the divisor exactly form
+    // the range [roundingMin, roundingMax].
+    //
+
+    UINT nearest = (0x10000 + divisor / 2) / divisor;
+
+    for (UINT i = 0; i < 5; i++)
+    {
+        UINT reciprocal = (i & 1) ? nearest + (i + 1) / 2 : nearest - i / 2;
+
+        if (reciprocal == 0 || reciprocal > 0xFFFF)
+        {
+            continue;
+        }
+
+        int roundingMin = 0;
+        int roundingMax = 0xFFFF - 255 * divisor;
+
+        for (UINT v = 0; v <= 255; v++)
+        {
+            int lowest = static_cast<int>((v * 0x10000 + reciprocal - 1) / reciprocal) - static_cast<int>(v * divisor);
+            int highest = static_cast<int>(((v + 1) * 0x10000 + reciprocal - 1) / reciprocal) - 1 - static_cast<int>(v * divisor);
+
+            roundingMin = max(roundingMin, lowest);
+            roundingMax = min(roundingMax, highest);
+        }
+
+        if (roundingMin <= roundingMax)
+        {
+            // Halfway between two multiples should round up, as closely as possible
+            int rounding = static_cast<int>((divisor + 1) / 2);
+
+            *pReciprocal = reciprocal;
+            *pRounding = static_cast<UINT>(min(max(rounding, roundingMin), roundingMax));
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
 //-----------------------------------------------------------------------------
 //
 // CMilBlurEffectDuce::ClearMarginPixels
@@ -524,6 +672,9 @@ CMilBlurEffectDuce::ApplyEffectSw(
     bool fPushedInterpolationMode = false;
     MilBitmapInterpolationMode::Enum interpolationModeBackup = MilBitmapInterpolationMode::NearestNeighbor;
 
+    // Whether the blurred result is back in the implicit input
+    bool fResultInInput = false;
+
     CMILBrushBitmap *pBrushBitmap = NULL;
 
     CSystemMemoryBitmap *pIntermediateBitmap = NULL;
@@ -603,34 +754,52 @@ CMilBlurEffectDuce::ApplyEffectSw(
             UINT intermediateBufferSize = 0;
             IFC(pIntermediateBitmapLock->GetDataPointer(&intermediateBufferSize, &pIntermediateBuffer));
 
-            switch (m_data.m_KernelType)
+            UINT reducedRadius = 0;
+            UINT cPyramidLevels = GetPyramidLevelCount(radius, GetPyramidMaxError(), &reducedRadius);
+
+            if (m_data.m_RenderingBias == MilEffectRenderingBias::Performance && cPyramidLevels > 0)
             {
-                case MilKernelType::Box:
-                {
-                    IFC(ApplyBoxBlurSw(pInputBuffer,
-                                       pIntermediateBuffer,
+                // The output of a large blur is low frequency, blur at a reduced resolution
+                IFC(ApplyPyramidBlurSw(pInputBuffer,
                                        uIntermediateWidth,
                                        uIntermediateHeight,
-                                       radius
+                                       cPyramidLevels,
+                                       reducedRadius
                                        ));
-                }
-                break;
-
-                case MilKernelType::Gaussian:
+                fResultInInput = true;
+            }
+            else
+            {
+                switch (m_data.m_KernelType)
                 {
-                    IFC(ApplyGaussianBlurSw(pInputBuffer,
-                                            pIntermediateBuffer,
-                                            uIntermediateWidth,
-                                            uIntermediateHeight,
-                                            radius
-                                            ));
+                    case MilKernelType::Box:
+                    {
+                        IFC(ApplyBoxBlurSw(pInputBuffer,
+                                           pIntermediateBuffer,
+                                           uIntermediateWidth,
+                                           uIntermediateHeight,
+                                           radius
+                                           ));
+                    }
+                    break;
+
+                    case MilKernelType::Gaussian:
+                    {
+                        IFC(ApplyGaussianBlurSw(pInputBuffer,
+                                                pIntermediateBuffer,
+                                                uIntermediateWidth,
+                                                uIntermediateHeight,
+                                                radius
+                                                ));
+                        fResultInInput = true;
+                    }
+                    break;
+
+                    default:
+                        AssertMsg(false, "CMILBlurEffectDuce: Unrecognized kernel type");
+                        IFC(E_INVALIDARG);
+                        break;                                            
                 }
-                break;
-
-                default:
-                    AssertMsg(false, "CMILBlurEffectDuce: Unrecognized kernel type");
-                    IFC(E_INVALIDARG);
-                    break;                                            
             }
 
             ReleaseInterface(pIntermediateBitmapLock);               
@@ -639,6 +808,7 @@ CMilBlurEffectDuce::ApplyEffectSw(
             //
             // For box, output is in pIntermediateBitmap
             // For gaussian, it's 2 pass so it's back in the source, pImplicitInput
+            // For the pyramid, it's scaled back up into the source as well
             //
 
             //
@@ -653,7 +823,7 @@ CMilBlurEffectDuce::ApplyEffectSw(
             }                    
             
             IFC(pDestRT->DrawBitmap(pContextState, 
-                                    (m_data.m_KernelType == MilKernelType::Box) ? pIntermediateBitmap : pImplicitInput, 
+                                    fResultInInput ? pImplicitInput : pIntermediateBitmap, 
                                     NULL
                                     ));                       
 
@@ -681,7 +851,8 @@ Cleanup:
 // Synopsis: 
 //          Applies a 2 pass Gaussian blur and places the result in 
 //          pInputOutputBuffer. pIntermediateBuffer is used for intermediate
-//          staging.
+//          staging. Radii of BOX_APPROXIMATION_MIN_RADIUS and above are
+//          handed to ApplyBoxApproximatedGaussianBlurSw.
 //          Assumes that sourceWidth > 2 * radius + 1 and 
 //          sourceHeight > 2 * radius + 1
 //-----------------------------------------------------------------------------
@@ -694,18 +865,47 @@ CMilBlurEffectDuce::ApplyGaussianBlurSw(__in_ecount(sourceWidth * sourceHeight *
                                         )
 {
     HRESULT hr = S_OK;
-    
-    if (s_pfnBlurFunctionGaussian == NULL)
+
+    float *pGaussianWeights = NULL;
+    UINT *pGaussianWeightsFixed = NULL;
+    GenerateColorsBlur pfnBlur = NULL;
+
+    if (radius >= BOX_APPROXIMATION_MIN_RADIUS)
     {
-        IFC(InitializeBlurFunction(true, false, &s_pfnBlurFunctionGaussian));
-        Assert(s_pfnBlurFunctionGaussian);
+        // The full kernel costs O(radius) per pixel, approximate it instead.
+        RRETURN(ApplyBoxApproximatedGaussianBlurSw(pInputOutputBuffer, pIntermediateBuffer, sourceWidth, sourceHeight, radius));
     }
 
-    float *pGaussianWeights = reinterpret_cast<float*>WPFAlloc(ProcessHeap, Mt(CMilBlurEffectDuce), (sizeof(float) * (2*radius + 1)));
+    pGaussianWeights = reinterpret_cast<float*>WPFAlloc(ProcessHeap, Mt(CMilBlurEffectDuce), (sizeof(float) * (2*radius + 1)));
     IFCOOM(pGaussianWeights);
 
     CalculateGaussianSamplingWeightsFullKernel(radius, &pGaussianWeights);
 
+    pGaussianWeightsFixed = reinterpret_cast<UINT*>WPFAlloc(ProcessHeap, Mt(CMilBlurEffectDuce), (sizeof(UINT) * (2*radius + 1)));
+    IFCOOM(pGaussianWeightsFixed);
+
+    // Use the integer program when the quantized weights are close enough
+    if (CalculateFixedPointGaussianWeights(radius, pGaussianWeights, pGaussianWeightsFixed))
+    {
+        if (s_pfnBlurFunctionGaussianFixedPoint == NULL)
+        {
+            IFC(InitializeBlurFunction(true, false, true, &s_pfnBlurFunctionGaussianFixedPoint));
+            Assert(s_pfnBlurFunctionGaussianFixedPoint);
+        }
+
+        pfnBlur = s_pfnBlurFunctionGaussianFixedPoint;
+    }
+    else
+    {
+        if (s_pfnBlurFunctionGaussian == NULL)
+        {
+            IFC(InitializeBlurFunction(true, false, false, &s_pfnBlurFunctionGaussian));
+            Assert(s_pfnBlurFunctionGaussian);
+        }
+
+        pfnBlur = s_pfnBlurFunctionGaussian;
+    }
+
     // Do vertical pass from source into intermediate
     BYTE *pPassInputBuffer = pInputOutputBuffer;
     BYTE *pPassOutputBuffer = pIntermediateBuffer;
@@ -730,8 +930,13 @@ CMilBlurEffectDuce::ApplyGaussianBlurSw(__in_ecount(sourceWidth * sourceHeight *
     arguments.boxBlurLineBufferLength = 0;
     arguments.pGaussianWeights = pGaussianWeights;
     arguments.vertical = 1;
+    arguments.pGaussianWeightsFixed = pGaussianWeightsFixed;
+    arguments.boxDivisorReciprocal = 0;
+    arguments.boxDivisorRounding = 0;
 
-    (*s_pfnBlurFunctionGaussian)(&arguments);
+    // Returns once the vertical pass has completed on every stripe, so the
+    // horizontal pass can read any line of the intermediate
+    ExecuteBlurFunction(pfnBlur, &arguments, GetStripeCount(arguments.nOutputLines, sourceWidth), 0);
 
     // Do horizontal pass from intermediate back into source
     pPassInputBuffer = pIntermediateBuffer;
@@ -753,12 +958,21 @@ CMilBlurEffectDuce::ApplyGaussianBlurSw(__in_ecount(sourceWidth * sourceHeight *
     arguments.boxBlurLineBufferLength = 0;
     arguments.pGaussianWeights = pGaussianWeights;
     arguments.vertical = 0;
+    arguments.pGaussianWeightsFixed = pGaussianWeightsFixed;
+    arguments.boxDivisorReciprocal = 0;
+    arguments.boxDivisorRounding = 0;
 
-    (*s_pfnBlurFunctionGaussian)(&arguments);
-    
-    WPFFree(ProcessHeap, pGaussianWeights);
+    ExecuteBlurFunction(pfnBlur, &arguments, GetStripeCount(arguments.nOutputLines, sourceWidth), 0);
     
 Cleanup:
+    if (pGaussianWeights)
+    {
+        WPFFree(ProcessHeap, pGaussianWeights);
+    }
+    if (pGaussianWeightsFixed)
+    {
+        WPFFree(ProcessHeap, pGaussianWeightsFixed);
+    }
     RRETURN(hr);
 }
 
@@ -780,61 +994,940 @@ CMilBlurEffectDuce::ApplyBoxBlurSw(__in_ecount(sourceWidth * sourceHeight * 4) B
                                    UINT radius)
 {
     HRESULT hr = S_OK;
-    
-    if (s_pfnBlurFunctionBox == NULL)
+    GenerateColorsBlur pfnBlur = NULL;
+    UINT divisorReciprocal = 0;
+    UINT divisorRounding = 0;
+
+    // Use the integer program when the sums fit in 16 bits
+    if (CalculateFixedPointBoxDivisor(2 * radius + 1, &divisorReciprocal, &divisorRounding))
+    {
+        if (s_pfnBlurFunctionBoxFixedPoint == NULL)
+        {
+            IFC(InitializeBlurFunction(false, false, true, &s_pfnBlurFunctionBoxFixedPoint));
+            Assert(s_pfnBlurFunctionBoxFixedPoint);
+        }
+
+        pfnBlur = s_pfnBlurFunctionBoxFixedPoint;
+    }
+    else
+    {
+        if (s_pfnBlurFunctionBox == NULL)
+        {
+            IFC(InitializeBlurFunction(false, false, false, &s_pfnBlurFunctionBox));
+            Assert(s_pfnBlurFunctionBox);
+        }
+
+        pfnBlur = s_pfnBlurFunctionBox;
+    }
+
+    UINT cStripes = GetStripeCount(sourceHeight - 2 * radius, sourceWidth);
+
+    //
+    // Need a buffer aligned to 16 byte boundary for SSE2 load/save operations,
+    // so make sure there's space in allocation to align the pointer. Each stripe
+    // keeps its column sums in its own line buffer.
+    //
+    UINT alignedAllocationSize = (cStripes * sourceWidth + 1) * sizeof(u32x4);
+
+    if (!m_pBoxBlurLineBuffer || (m_boxBlurLineBufferSize < alignedAllocationSize))
+    {
+        if (m_pBoxBlurLineBuffer)
+        {
+            WPFFree(ProcessHeap, m_pBoxBlurLineBuffer);
+        }
+
+        m_pBoxBlurLineBuffer = (BYTE *)WPFAlloc(ProcessHeap,
+                                               Mt(BoxBlurLineBuffer),
+                                               alignedAllocationSize);
+
+        IFCOOM(m_pBoxBlurLineBuffer);
+
+        m_boxBlurLineBufferSize = alignedAllocationSize;
+    }
+
+    // Clear the output pixels that the blur won't produce.
+    IFC(ClearMarginPixels(reinterpret_cast<UINT*>(pOutputBuffer), sourceWidth, sourceHeight, radius, radius, radius, radius));
+        
+    void *pBoxBlurLineBufferAligned = reinterpret_cast<void *>(IncrAlignTo(reinterpret_cast<uintptr_t>(m_pBoxBlurLineBuffer), SSE2_ALIGNMENT_BOUNDARY));
+
+    //
+    // Adjust output buffer to location of first output pixel. This is at position (radius, radius),
+    // since we know the input has been inflated by the radius beyond the output size.
+    //
+    pOutputBuffer += (sourceWidth * radius * 4) + (radius * 4);
+
+    GenerateColorsBlurParams arguments;
+    arguments.pargbSource = reinterpret_cast<unsigned *>(pInputBuffer);
+    arguments.pargbDestination = reinterpret_cast<unsigned *>(pOutputBuffer);
+    arguments.sourceWidth = sourceWidth;
+    arguments.radius = radius;  
+    arguments.nOutputPixelsPerLine = sourceWidth - radius * 2;
+    arguments.nOutputLines = sourceHeight - 2 * radius;
+    arguments.pBoxBlurLineBuffer = pBoxBlurLineBufferAligned;
+    arguments.boxBlurLineBufferLength = sourceWidth;
+    arguments.pGaussianWeights = NULL;
+    arguments.vertical = 1;
+    arguments.pGaussianWeightsFixed = NULL;
+    arguments.boxDivisorReciprocal = divisorReciprocal;
+    arguments.boxDivisorRounding = divisorRounding;
+
+    ExecuteBlurFunction(pfnBlur, &arguments, cStripes, sourceWidth * sizeof(u32x4));
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::GetStripeCount
+//
+// Synopsis: 
+//      Returns the number of stripes to split a software pass producing
+//      cLines lines of cPixelsPerLine pixels into. Small passes aren't worth
+//      the cost of waking thread pool workers and run as one stripe.
+//
+//-----------------------------------------------------------------------------
+UINT
+CMilBlurEffectDuce::GetStripeCount(
+    UINT cLines,
+    UINT cPixelsPerLine
+    )
+{
+    UINT cMinLinesPerStripe = MIN_PIXELS_PER_STRIPE / max(cPixelsPerLine, 1u);
+
+    return CParallelStripes::GetStripeCount(cLines, max(cMinLinesPerStripe, 1u));
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::ExecuteBlurFunction
+//
+// Synopsis: 
+//      Runs a generated blur function over the output lines described by
+//      pArguments, split into cStripes stripes of lines that are processed
+//      in parallel. Returns once all lines have been produced.
+//
+//      The generated functions only read and write through the pointers in
+//      their arguments, so each stripe gets its own copy with the pointers
+//      moved to its first line. Box blurs also need a line buffer per stripe,
+//      boxBlurLineBufferStride bytes apart.
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::ExecuteBlurFunction(
+    __in GenerateColorsBlur pfnBlur,
+    __in const GenerateColorsBlurParams *pArguments,
+    UINT cStripes,
+    UINT boxBlurLineBufferStride
+    )
+{
+    BlurFunctionStripeContext context;
+    context.pfnBlur = pfnBlur;
+    context.pArguments = pArguments;
+    context.boxBlurLineBufferStride = boxBlurLineBufferStride;
+
+    CParallelStripes::Run(cStripes, pArguments->nOutputLines, BlurFunctionStripe, &context);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::BlurFunctionStripe
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::BlurFunctionStripe(
+    __in void *pvContext,
+    UINT iStripe,
+    UINT iFirstLine,
+    UINT iEndLine
+    )
+{
+    const BlurFunctionStripeContext *pContext = static_cast<const BlurFunctionStripeContext *>(pvContext);
+
+    GenerateColorsBlurParams arguments = *pContext->pArguments;
+
+    // Source and destination advance by a whole line per output line in both directions
+    arguments.pargbSource += iFirstLine * arguments.sourceWidth;
+    arguments.pargbDestination += iFirstLine * arguments.sourceWidth;
+    arguments.nOutputLines = iEndLine - iFirstLine;
+
+    if (arguments.pBoxBlurLineBuffer != NULL)
+    {
+        arguments.pBoxBlurLineBuffer = static_cast<BYTE *>(arguments.pBoxBlurLineBuffer) + iStripe * pContext->boxBlurLineBufferStride;
+    }
+
+    (*pContext->pfnBlur)(&arguments);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Helpers for the box approximated Gaussian blur. Rows of pixels are
+// unpacked into one UINT per channel so that the box sums can be carried
+// through all passes without intermediate rounding.
+//
+//-----------------------------------------------------------------------------
+
+inline void
+UnpackPixelRow(
+    __in_ecount(width) const UINT *pPixels,
+    UINT width,
+    __out_ecount(4 * width) UINT *pChannels
+    )
+{
+    for (UINT x = 0; x < width; x++)
+    {
+        UINT pixel = pPixels[x];
+
+        pChannels[0] = pixel & 0xFF;
+        pChannels[1] = (pixel >> 8) & 0xFF;
+        pChannels[2] = (pixel >> 16) & 0xFF;
+        pChannels[3] = pixel >> 24;
+        pChannels += 4;
+    }
+}
+
+inline void
+PackPixelRow(
+    __in_ecount(4 * width) const UINT *pChannels,
+    UINT width,
+    UINT divisor,
+    __out_ecount(width) UINT *pPixels
+    )
+{
+    UINT rounding = divisor / 2;
+
+    for (UINT x = 0; x < width; x++)
+    {
+        pPixels[x] = ((pChannels[0] + rounding) / divisor)
+                   | (((pChannels[1] + rounding) / divisor) << 8)
+                   | (((pChannels[2] + rounding) / divisor) << 16)
+                   | (((pChannels[3] + rounding) / divisor) << 24);
+        pChannels += 4;
+    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::CalculateBoxApproximationRadii
+//
+// Synopsis: 
+//      Chooses the radii of the BOX_APPROXIMATION_PASSES box filters whose
+//      convolution has the same variance as the Gaussian produced by
+//      CalculateSamplingWeights (standard deviation radius / 3). The sum of
+//      the box radii never exceeds radius, so the approximation reads no
+//      pixels that the full kernel would not.
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::CalculateBoxApproximationRadii(
+    UINT radius,
+    __out_ecount(BOX_APPROXIMATION_PASSES) UINT *rgBoxRadii
+    )
+{
+    const double cPasses = BOX_APPROXIMATION_PASSES;
+
+    double variance = (radius / 3.0) * (radius / 3.0);
+
+    //
+    // A box of odd width w has variance (w*w - 1) / 12. Start from the widest
+    // odd width not above the ideal equal width and widen as many boxes by 2
+    // as needed to get closest to the Gaussian's variance.
+    //
+    UINT lowerWidth = static_cast<UINT>(sqrt(12.0 * variance / cPasses + 1.0));
+    if ((lowerWidth % 2) == 0)
+    {
+        lowerWidth--;
+    }
+
+    double lw = static_cast<double>(lowerWidth);
+    double cLowerPasses = (12.0 * variance - cPasses * lw * lw - 4.0 * cPasses * lw - 3.0 * cPasses) / (-4.0 * lw - 4.0);
+    cLowerPasses = max(0.0, min(cPasses, floor(cLowerPasses + 0.5)));
+
+    UINT totalRadius = 0;
+
+    for (UINT i = 0; i < BOX_APPROXIMATION_PASSES; i++)
+    {
+        UINT width = (i < static_cast<UINT>(cLowerPasses)) ? lowerWidth : lowerWidth + 2;
+
+        rgBoxRadii[i] = width / 2;
+        totalRadius += rgBoxRadii[i];
+    }
+
+    // Rounding can overshoot the kernel's support slightly, trim the widest boxes.
+    for (UINT i = BOX_APPROXIMATION_PASSES; totalRadius > radius; )
+    {
+        i = ((i == 0) ? BOX_APPROXIMATION_PASSES : i) - 1;
+
+        if (rgBoxRadii[i] > 0)
+        {
+            rgBoxRadii[i]--;
+            totalRadius--;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::BoxSumColumnsSw
+//
+// Synopsis: 
+//      Vertical half of ApplyBoxApproximatedGaussianBlurSw. Streams the rows
+//      of pSource through the cascade of box filters, keeping a running sum
+//      per column and channel for each box and a ring of the last
+//      2 * boxRadius + 1 rows that entered it, so each pixel costs a constant
+//      number of additions whatever the radius. Writes rows
+//      [radius, height - radius) of pDestination; the caller clears the rest.
+//
+//      Columns are independent, so width may be a stripe of columns of
+//      buffers whose lines are stride pixels apart.
+//
+//      pScratch must hold (sum of box widths + BOX_APPROXIMATION_PASSES)
+//      rows of 4 * width UINTs.
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::BoxSumColumnsSw(
+    __in_ecount(stride * height) const UINT *pSource,
+    __out_ecount(stride * height) UINT *pDestination,
+    UINT width,
+    UINT stride,
+    UINT height,
+    UINT radius,
+    __in_ecount(BOX_APPROXIMATION_PASSES) const UINT *rgBoxRadii,
+    __out UINT *pScratch
+    )
+{
+    UINT cRowValues = 4 * width;
+    UINT divisor = 1;
+    UINT totalBoxRadius = 0;
+
+    UINT *rgpSums[BOX_APPROXIMATION_PASSES];
+    UINT *rgpRings[BOX_APPROXIMATION_PASSES];
+
+    for (UINT k = 0; k < BOX_APPROXIMATION_PASSES; k++)
+    {
+        UINT boxWidth = 2 * rgBoxRadii[k] + 1;
+
+        rgpSums[k] = pScratch;
+        pScratch += cRowValues;
+        rgpRings[k] = pScratch;
+        pScratch += cRowValues * boxWidth;
+
+        divisor *= boxWidth;
+        totalBoxRadius += rgBoxRadii[k];
+
+        ZeroMemory(rgpSums[k], cRowValues * sizeof(UINT));
+    }
+
+    //
+    // Row t of the source enters the first box. Each box emits the row its
+    // window has just become centered on into the ring of the next box.
+    // Rows outside [0, height) are transparent and are never added to or
+    // removed from a sum.
+    //
+    for (UINT t = 0; t < height + totalBoxRadius; t++)
+    {
+        UINT row = t;
+
+        if (row < height)
+        {
+            UnpackPixelRow(pSource + row * stride, width, rgpRings[0] + (row % (2 * rgBoxRadii[0] + 1)) * cRowValues);
+        }
+
+        for (UINT k = 0; k < BOX_APPROXIMATION_PASSES; k++)
+        {
+            UINT boxRadius = rgBoxRadii[k];
+            UINT boxWidth = 2 * boxRadius + 1;
+            UINT *pSums = rgpSums[k];
+
+            if (row < height)
+            {
+                const UINT *pEntering = rgpRings[k] + (row % boxWidth) * cRowValues;
+
+                for (UINT i = 0; i < cRowValues; i++)
+                {
+                    pSums[i] += pEntering[i];
+                }
+            }
+
+            if (row < boxRadius)
+            {
+                // Not centered on a row yet, so nothing reaches the later boxes
+                break;
+            }
+
+            UINT center = row - boxRadius;
+
+            if (center < height)
+            {
+                if (k + 1 < BOX_APPROXIMATION_PASSES)
+                {
+                    UINT nextBoxWidth = 2 * rgBoxRadii[k + 1] + 1;
+
+                    RtlCopyMemory(rgpRings[k + 1] + (center % nextBoxWidth) * cRowValues, pSums, cRowValues * sizeof(UINT));
+                }
+                else if (center >= radius && center < height - radius)
+                {
+                    PackPixelRow(pSums, width, divisor, pDestination + center * stride);
+                }
+            }
+
+            if (center >= boxRadius && center - boxRadius < height)
+            {
+                const UINT *pLeaving = rgpRings[k] + ((center - boxRadius) % boxWidth) * cRowValues;
+
+                for (UINT i = 0; i < cRowValues; i++)
+                {
+                    pSums[i] -= pLeaving[i];
+                }
+            }
+
+            row = center;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::BoxSumRowsSw
+//
+// Synopsis: 
+//      Horizontal half of ApplyBoxApproximatedGaussianBlurSw. Runs the cascade
+//      of sliding window sums along each row and writes columns
+//      [radius, width - radius) of every row of pDestination.
+//
+//      pScratch must hold 2 rows of 4 * width UINTs.
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::BoxSumRowsSw(
+    __in_ecount(width * height) const UINT *pSource,
+    __inout_ecount(width * height) UINT *pDestination,
+    UINT width,
+    UINT height,
+    UINT radius,
+    __in_ecount(BOX_APPROXIMATION_PASSES) const UINT *rgBoxRadii,
+    __out_ecount(8 * width) UINT *pScratch
+    )
+{
+    UINT divisor = 1;
+
+    for (UINT k = 0; k < BOX_APPROXIMATION_PASSES; k++)
+    {
+        divisor *= 2 * rgBoxRadii[k] + 1;
+    }
+
+    for (UINT y = 0; y < height; y++)
+    {
+        UINT *pLine = pScratch;
+        UINT *pSums = pScratch + 4 * width;
+
+        UnpackPixelRow(pSource + y * width, width, pLine);
+
+        for (UINT k = 0; k < BOX_APPROXIMATION_PASSES; k++)
+        {
+            UINT boxRadius = rgBoxRadii[k];
+            UINT rgSum[4] = { 0, 0, 0, 0 };
+
+            // Pixels outside the row are transparent
+            for (UINT x = 0; x < boxRadius && x < width; x++)
+            {
+                for (UINT c = 0; c < 4; c++)
+                {
+                    rgSum[c] += pLine[4 * x + c];
+                }
+            }
+
+            for (UINT x = 0; x < width; x++)
+            {
+                if (x + boxRadius < width)
+                {
+                    for (UINT c = 0; c < 4; c++)
+                    {
+                        rgSum[c] += pLine[4 * (x + boxRadius) + c];
+                    }
+                }
+
+                for (UINT c = 0; c < 4; c++)
+                {
+                    pSums[4 * x + c] = rgSum[c];
+                }
+
+                if (x >= boxRadius)
+                {
+                    for (UINT c = 0; c < 4; c++)
+                    {
+                        rgSum[c] -= pLine[4 * (x - boxRadius) + c];
+                    }
+                }
+            }
+
+            // The sums of this box are the input of the next one
+            UINT *pTemp = pLine;
+            pLine = pSums;
+            pSums = pTemp;
+        }
+
+        PackPixelRow(pLine + 4 * radius, width - 2 * radius, divisor, pDestination + y * width + radius);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::BoxSumColumnsStripe
+//
+// Synopsis: 
+//      Runs BoxSumColumnsSw on columns [iFirstColumn, iEndColumn).
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::BoxSumColumnsStripe(
+    __in void *pvContext,
+    UINT iStripe,
+    UINT iFirstColumn,
+    UINT iEndColumn
+    )
+{
+    UNREFERENCED_PARAMETER(iStripe);
+
+    const BoxApproximationStripeContext *pContext = static_cast<const BoxApproximationStripeContext *>(pvContext);
+
+    BoxSumColumnsSw(pContext->pSource + iFirstColumn,
+                    pContext->pDestination + iFirstColumn,
+                    iEndColumn - iFirstColumn,
+                    pContext->width,
+                    pContext->height,
+                    pContext->radius,
+                    pContext->rgBoxRadii,
+                    pContext->pScratch + 4 * pContext->cScratchRows * iFirstColumn
+                    );
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::BoxSumRowsStripe
+//
+// Synopsis: 
+//      Runs BoxSumRowsSw on rows [iFirstRow, iEndRow).
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::BoxSumRowsStripe(
+    __in void *pvContext,
+    UINT iStripe,
+    UINT iFirstRow,
+    UINT iEndRow
+    )
+{
+    const BoxApproximationStripeContext *pContext = static_cast<const BoxApproximationStripeContext *>(pvContext);
+
+    BoxSumRowsSw(pContext->pSource + iFirstRow * pContext->width,
+                 pContext->pDestination + iFirstRow * pContext->width,
+                 pContext->width,
+                 iEndRow - iFirstRow,
+                 pContext->radius,
+                 pContext->rgBoxRadii,
+                 pContext->pScratch + 8 * pContext->width * iStripe
+                 );
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::ApplyBoxApproximatedGaussianBlurSw
+//
+// Synopsis: 
+//      Large radius replacement for ApplyGaussianBlurSw with the same buffer
+//      contract: the result is placed in pInputOutputBuffer, with the top and
+//      bottom radius rows cleared and the left and right radius columns left
+//      untouched, and pIntermediateBuffer is used for staging.
+//
+//      The Gaussian is approximated by BOX_APPROXIMATION_PASSES successive
+//      box filters in each direction (see CalculateBoxApproximationRadii),
+//      computed with sliding window sums, so the cost per pixel does not
+//      depend on the radius. Sums are kept exact between the boxes of a
+//      direction and rounded once per direction. Both directions are split
+//      into stripes processed in parallel.
+//
+//      Error bound: for radii of BOX_APPROXIMATION_MIN_RADIUS up to
+//      MAX_RADIUS, the response to a hard edge differs from the full
+//      kernel's by at most 3.5/255, and the output for any content by at
+//      most 11.5/255 (half the L1 distance between the two 2D kernels), in
+//      addition to at most 1/255 of rounding.
+//
+//-----------------------------------------------------------------------------
+HRESULT
+CMilBlurEffectDuce::ApplyBoxApproximatedGaussianBlurSw(
+    __inout_ecount(sourceWidth * sourceHeight * 4) BYTE *pInputOutputBuffer,
+    __inout_ecount(sourceWidth * sourceHeight * 4) BYTE *pIntermediateBuffer,
+    UINT sourceWidth,
+    UINT sourceHeight,
+    UINT radius
+    )
+{
+    HRESULT hr = S_OK;
+
+    UINT *pScratch = NULL;
+    UINT rgBoxRadii[BOX_APPROXIMATION_PASSES];
+    UINT cScratchRows = 2 * BOX_APPROXIMATION_PASSES;
+    UINT cScratchValues = 0;
+    UINT scratchSize = 0;
+
+    Assert(sourceWidth >= 2 * radius + 1);
+    Assert(sourceHeight >= 2 * radius + 1);
+
+    CalculateBoxApproximationRadii(radius, rgBoxRadii);
+
+    for (UINT k = 0; k < BOX_APPROXIMATION_PASSES; k++)
+    {
+        cScratchRows += 2 * rgBoxRadii[k];
+    }
+
+    //
+    // The vertical pass is split into stripes of columns and the horizontal
+    // pass into stripes of rows. The column stripes share the scratch rows
+    // between them, each row stripe needs two lines of its own.
+    //
+    UINT cColumnStripes = CParallelStripes::GetStripeCount(sourceWidth, max(MIN_PIXELS_PER_STRIPE / sourceHeight, 1u));
+    UINT cRowStripes = GetStripeCount(sourceHeight, sourceWidth);
+
+    IFC(UIntMult(4 * max(cScratchRows, 2 * cRowStripes), sourceWidth, &cScratchValues));
+    IFC(UIntMult(sizeof(UINT), cScratchValues, &scratchSize));
+
+    pScratch = static_cast<UINT*>WPFAlloc(ProcessHeap, Mt(BoxApproximationBuffer), scratchSize);
+    IFCOOM(pScratch);
+
+    // Clear top and bottom rows since the vertical pass won't fill them.
+    IFC(ClearMarginPixels(reinterpret_cast<UINT*>(pIntermediateBuffer), sourceWidth, sourceHeight, 0, radius, 0, radius));
+
+    {
+        BoxApproximationStripeContext context;
+        context.pSource = reinterpret_cast<UINT*>(pInputOutputBuffer);
+        context.pDestination = reinterpret_cast<UINT*>(pIntermediateBuffer);
+        context.width = sourceWidth;
+        context.height = sourceHeight;
+        context.radius = radius;
+        context.rgBoxRadii = rgBoxRadii;
+        context.pScratch = pScratch;
+        context.cScratchRows = cScratchRows;
+
+        CParallelStripes::Run(cColumnStripes, sourceWidth, BoxSumColumnsStripe, &context);
+
+        // The horizontal pass only starts once all columns are done
+        context.pSource = reinterpret_cast<UINT*>(pIntermediateBuffer);
+        context.pDestination = reinterpret_cast<UINT*>(pInputOutputBuffer);
+
+        CParallelStripes::Run(cRowStripes, sourceHeight, BoxSumRowsStripe, &context);
+    }
+
+Cleanup:
+    if (pScratch)
+    {
+        WPFFree(ProcessHeap, pScratch);
+    }
+    RRETURN(hr);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::GetPyramidMaxError
+//
+// Synopsis: 
+//      Returns the largest error, in 1/255 units, Performance blurs may
+//      trade for speed (see GetPyramidLevelCount). Defaults to
+//      PYRAMID_DEFAULT_MAX_ERROR and can be overridden with
+//      HKLM\Software\Microsoft\Avalon.Graphics\BlurPyramidMaxError;
+//      0 turns the pyramid off. The value is read once per process.
+//
+//-----------------------------------------------------------------------------
+UINT
+CMilBlurEffectDuce::GetPyramidMaxError()
+{
+    if (!s_fPyramidMaxErrorRead)
+    {
+        CDisplayRegKey keyGraphics(HKEY_LOCAL_MACHINE, _T(""));
+        DWORD dwMaxError;
+
+        if (keyGraphics.ReadDWORD(_T("BlurPyramidMaxError"), &dwMaxError))
+        {
+            s_uPyramidMaxError = dwMaxError;
+        }
+
+        s_fPyramidMaxErrorRead = true;
+    }
+
+    return s_uPyramidMaxError;
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::GetPyramidLevelCount
+//
+// Synopsis: 
+//      Returns how many times a blur of the given radius can be downsampled
+//      by 2 before blurring while keeping the difference from the full
+//      resolution Gaussian within maxError/255, and the reduced radius to
+//      blur with. Returns 0 if no level is accurate enough. Blurs with a
+//      Quality rendering bias never use the pyramid.
+//
+//      Averaging blocks of scale x scale pixels and scaling back up
+//      bilinearly adds about scale^2 / 4 to the variance of the blur, so
+//      the reduced radius is chosen for the remaining variance. The error
+//      is then estimated from what is left:
+//
+//        - the standard deviation missed by rounding the reduced radius,
+//          which moves a hard edge by up to 0.6 * 255 times its relative
+//          size, and
+//        - the coarse sampling of small reduced kernels, which costs thin
+//          lines about 176 / reducedRadius^2.
+//
+//      Checked against the full kernel over radii 4 to MAX_RADIUS on hard
+//      edges, thin lines and blocks, the estimate held for every bound from
+//      2 to 16 to within 1/255 of rounding. Levels whose reduced radius
+//      would take the box approximation are skipped, since its own error
+//      is not part of the estimate.
+//
+//      With the default bound, radius 25 blurs at 1/4 resolution with
+//      radius 6, and radii 50 and 100 at 1/8 resolution with radii 6 and 12.
+//
+//-----------------------------------------------------------------------------
+UINT
+CMilBlurEffectDuce::GetPyramidLevelCount(
+    UINT radius,
+    UINT maxError,
+    __out UINT *pReducedRadius
+    )
+{
+    double sd = radius / 3.0;
+
+    // Prefer the most levels, they are the cheapest
+    for (UINT cLevels = PYRAMID_MAX_LEVELS; cLevels > 0 && maxError > 0; cLevels--)
+    {
+        double scale = static_cast<double>(1u << cLevels);
+        double reducedVariance = sd * sd - 0.25 * scale * scale;
+
+        if (reducedVariance <= 0.0)
+        {
+            continue;
+        }
+
+        UINT reducedRadius = static_cast<UINT>(3.0 * sqrt(reducedVariance) / scale + 0.5);
+
+        if (   reducedRadius < PYRAMID_MIN_REDUCED_RADIUS
+            || reducedRadius >= BOX_APPROXIMATION_MIN_RADIUS)
+        {
+            continue;
+        }
+
+        double reducedSd = reducedRadius * scale / 3.0;
+        double effectiveSd = sqrt(reducedSd * reducedSd + 0.25 * scale * scale);
+        double error =   153.0 * fabs(effectiveSd - sd) / sd
+                       + 176.0 / (reducedRadius * reducedRadius);
+
+        if (error <= maxError)
+        {
+            *pReducedRadius = reducedRadius;
+            return cLevels;
+        }
+    }
+
+    *pReducedRadius = radius;
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::ApplyPyramidBlurSw
+//
+// Synopsis: 
+//      Blurs pInputOutputBuffer in place at a reduced resolution: averages
+//      blocks of 2^cLevels x 2^cLevels pixels, blurs the result with
+//      reducedRadius and scales it back up bilinearly. Unlike the full
+//      resolution passes, every pixel of the surface is written, including
+//      the radius wide margins.
+//
+//-----------------------------------------------------------------------------
+HRESULT
+CMilBlurEffectDuce::ApplyPyramidBlurSw(
+    __inout_ecount(sourceWidth * sourceHeight * 4) BYTE *pInputOutputBuffer,
+    UINT sourceWidth,
+    UINT sourceHeight,
+    UINT cLevels,
+    UINT reducedRadius
+    )
+{
+    HRESULT hr = S_OK;
+
+    UINT *pReduced = NULL;
+    UINT *pReducedIntermediate = NULL;
+    UINT *pBlockSums = NULL;
+    UINT *pBlurred = NULL;
+
+    UINT *pSource = reinterpret_cast<UINT*>(pInputOutputBuffer);
+
+    UINT scale = 1u << cLevels;
+    UINT scaleSquared = scale * scale;
+
+    Assert(cLevels > 0 && cLevels <= PYRAMID_MAX_LEVELS);
+    Assert(reducedRadius > 0);
+
+    //
+    // The reduced surface is padded by the reduced radius on each side so
+    // that the blur produces the whole reduced image, margins included.
+    //
+    UINT blockColumns = (sourceWidth + scale - 1) / scale;
+    UINT blockRows = (sourceHeight + scale - 1) / scale;
+    UINT reducedWidth = blockColumns + 2 * reducedRadius;
+    UINT reducedHeight = blockRows + 2 * reducedRadius;
+
+    UINT cReducedPixels = 0;
+    UINT reducedSize = 0;
+    IFC(UIntMult(reducedWidth, reducedHeight, &cReducedPixels));
+    IFC(UIntMult(sizeof(UINT), cReducedPixels, &reducedSize));
+
+    pReduced = static_cast<UINT*>WPFAlloc(ProcessHeap, Mt(BlurPyramidBuffer), reducedSize);
+    IFCOOM(pReduced);
+
+    pReducedIntermediate = static_cast<UINT*>WPFAlloc(ProcessHeap, Mt(BlurPyramidBuffer), reducedSize);
+    IFCOOM(pReducedIntermediate);
+
+    pBlockSums = static_cast<UINT*>WPFAlloc(ProcessHeap, Mt(BlurPyramidBuffer), 4 * blockColumns * sizeof(UINT));
+    IFCOOM(pBlockSums);
+
+    ZeroMemory(pReduced, reducedSize);
+
+    //
+    // Downsample. Blocks running past the edges of the surface are averaged
+    // with transparent pixels.
+    //
+    for (UINT blockRow = 0; blockRow < blockRows; blockRow++)
     {
-        IFC(InitializeBlurFunction(false, false, &s_pfnBlurFunctionBox));
-        Assert(s_pfnBlurFunctionBox);
-    }                        
+        ZeroMemory(pBlockSums, 4 * blockColumns * sizeof(UINT));
+
+        for (UINT y = blockRow * scale; y < min((blockRow + 1) * scale, sourceHeight); y++)
+        {
+            const UINT *pLine = pSource + y * sourceWidth;
+
+            for (UINT x = 0; x < sourceWidth; x++)
+            {
+                UINT pixel = pLine[x];
+                UINT *pSums = pBlockSums + 4 * (x / scale);
+
+                pSums[0] += pixel & 0xFF;
+                pSums[1] += (pixel >> 8) & 0xFF;
+                pSums[2] += (pixel >> 16) & 0xFF;
+                pSums[3] += pixel >> 24;
+            }
+        }
+
+        PackPixelRow(pBlockSums,
+                     blockColumns,
+                     scaleSquared,
+                     pReduced + (blockRow + reducedRadius) * reducedWidth + reducedRadius
+                     );
+    }
 
     //
-    // Need a buffer aligned to 16 byte boundary for SSE2 load/save operations,
-    // so make sure there's space in allocation to align the pointer.
+    // Blur at the reduced size. Gaussian blurs end up back in pReduced,
+    // box blurs in pReducedIntermediate.
     //
-    UINT alignedAllocationSize = (sourceWidth +1) * sizeof(u32x4);
+    if (m_data.m_KernelType == MilKernelType::Box)
+    {
+        IFC(ApplyBoxBlurSw(reinterpret_cast<BYTE*>(pReduced),
+                           reinterpret_cast<BYTE*>(pReducedIntermediate),
+                           reducedWidth,
+                           reducedHeight,
+                           reducedRadius
+                           ));
+        pBlurred = pReducedIntermediate;
+    }
+    else
+    {
+        IFC(ApplyGaussianBlurSw(reinterpret_cast<BYTE*>(pReduced),
+                                reinterpret_cast<BYTE*>(pReducedIntermediate),
+                                reducedWidth,
+                                reducedHeight,
+                                reducedRadius
+                                ));
+        pBlurred = pReduced;
+    }
 
-    if (!m_pBoxBlurLineBuffer || (m_boxBlurLineBufferSize < alignedAllocationSize))
     {
-        if (m_pBoxBlurLineBuffer)
+        //
+        // Upsample bilinearly. The center of pixel x maps to (x + 0.5) / scale - 0.5
+        // in the reduced image; in units of 1 / (2 * scale) that is 2x + 1 - scale,
+        // offset by the padding.
+        //
+        UINT weightUnit = 2 * scale;
+        UINT divisor = weightUnit * weightUnit;
+        UINT rounding = divisor / 2;
+
+        for (UINT y = 0; y < sourceHeight; y++)
         {
-            WPFFree(ProcessHeap, m_pBoxBlurLineBuffer);
-        }
+            UINT v = 2 * y + 1 - scale + weightUnit * reducedRadius;
+            UINT weightBottom = v % weightUnit;
+            UINT weightTop = weightUnit - weightBottom;
 
-        m_pBoxBlurLineBuffer = (BYTE *)WPFAlloc(ProcessHeap,
-                                               Mt(BoxBlurLineBuffer),
-                                               alignedAllocationSize);
+            const UINT *pTopLine = pBlurred + (v / weightUnit) * reducedWidth;
+            const UINT *pBottomLine = pTopLine + reducedWidth;
 
-        IFCOOM(m_pBoxBlurLineBuffer);
+            UINT *pLine = pSource + y * sourceWidth;
 
-        m_boxBlurLineBufferSize = alignedAllocationSize;
-    }
+            for (UINT x = 0; x < sourceWidth; x++)
+            {
+                UINT u = 2 * x + 1 - scale + weightUnit * reducedRadius;
+                UINT weightRight = u % weightUnit;
+                UINT weightLeft = weightUnit - weightRight;
+                UINT column = u / weightUnit;
 
-    // Clear the output pixels that the blur won't produce.
-    IFC(ClearMarginPixels(reinterpret_cast<UINT*>(pOutputBuffer), sourceWidth, sourceHeight, radius, radius, radius, radius));
-        
-    void *pBoxBlurLineBufferAligned = reinterpret_cast<void *>(IncrAlignTo(reinterpret_cast<uintptr_t>(m_pBoxBlurLineBuffer), SSE2_ALIGNMENT_BOUNDARY));
+                UINT rgWeights[4] =
+                {
+                    weightLeft * weightTop,
+                    weightRight * weightTop,
+                    weightLeft * weightBottom,
+                    weightRight * weightBottom
+                };
 
-    //
-    // Adjust output buffer to location of first output pixel. This is at position (radius, radius),
-    // since we know the input has been inflated by the radius beyond the output size.
-    //
-    pOutputBuffer += (sourceWidth * radius * 4) + (radius * 4);
+                UINT rgPixels[4] =
+                {
+                    pTopLine[column],
+                    pTopLine[column + 1],
+                    pBottomLine[column],
+                    pBottomLine[column + 1]
+                };
 
-    GenerateColorsBlurParams arguments;
-    arguments.pargbSource = reinterpret_cast<unsigned *>(pInputBuffer);
-    arguments.pargbDestination = reinterpret_cast<unsigned *>(pOutputBuffer);
-    arguments.sourceWidth = sourceWidth;
-    arguments.radius = radius;  
-    arguments.nOutputPixelsPerLine = sourceWidth - radius * 2;
-    arguments.nOutputLines = sourceHeight - 2 * radius;
-    arguments.pBoxBlurLineBuffer = pBoxBlurLineBufferAligned;
-    arguments.boxBlurLineBufferLength = sourceWidth;
-    arguments.pGaussianWeights = NULL;
-    arguments.vertical = 1;
+                UINT result = 0;
+
+                for (UINT shift = 0; shift < 32; shift += 8)
+                {
+                    UINT sum = rounding;
 
-    (*s_pfnBlurFunctionBox)(&arguments);
+                    for (UINT i = 0; i < 4; i++)
+                    {
+                        sum += ((rgPixels[i] >> shift) & 0xFF) * rgWeights[i];
+                    }
+
+                    result |= (sum / divisor) << shift;
+                }
+
+                pLine[x] = result;
+            }
+        }
+    }
 
 Cleanup:
+    if (pReduced)
+    {
+        WPFFree(ProcessHeap, pReduced);
+    }
+    if (pReducedIntermediate)
+    {
+        WPFFree(ProcessHeap, pReducedIntermediate);
+    }
+    if (pBlockSums)
+    {
+        WPFFree(ProcessHeap, pBlockSums);
+    }
     RRETURN(hr);
 }
 
@@ -964,6 +2057,11 @@ CMilBlurEffectDuce::ApplyEffectImpl(
     UINT radius = 0;
     GetScaledRadius(pScaleTransform, &radius);
 
+    // The number of halvings and the radius at the reduced resolution, if the
+    // blur can use a pyramid
+    UINT reducedRadius = 0;
+    UINT cPyramidLevels = GetPyramidLevelCount(radius, GetPyramidMaxError(), &reducedRadius);
+
     // If the blur radius is zero, we skip the loop below and we just need to render the source into
     // the final destination texture with a pass-through shader.
     if (radius == 0) 
@@ -1187,6 +2285,22 @@ CMilBlurEffectDuce::ApplyEffectImpl(
         IFC(pDevice->DrawTriangleStrip(0, 2));
 
     }
+    // If the RenderingBias is Performance and the radius is large, the output is low frequency and
+    // we blur at a reduced resolution instead, see ExecutePyramidPasses.
+    else if (m_data.m_RenderingBias == MilEffectRenderingBias::Performance &&
+             cPyramidLevels > 0)
+    {
+        IFC(ExecutePyramidPasses(
+            pContextState,
+            pDevice,
+            uIntermediateWidth,
+            uIntermediateHeight,
+            cPyramidLevels,
+            reducedRadius,
+            pTextureNoRef_A,
+            pFinalDestRT,
+            pPipelineDestSurface));
+    }
     // If the RenderingBias is Performance, we can execute the blur with one intermediate texture
     // and only two render target switches.  The effect is executed as follows:
     //      1) Draw all horizontal passes into an intermediate.
@@ -1346,6 +2460,219 @@ Cleanup:
     RRETURN(hr);
 }
 
+//+----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::ExecutePyramidPasses
+//
+// Synopsis: 
+//    Performance blur at a reduced resolution. The source is halved
+//    cLevels times with bilinear sampling, which averages each 2x2 block,
+//    the smallest level is blurred with reducedRadius using the performance
+//    passes, and the result is scaled back up bilinearly into the final
+//    destination or into the pipeline destination surface.
+//
+//-----------------------------------------------------------------------------
+
+HRESULT
+CMilBlurEffectDuce::ExecutePyramidPasses(
+    __in const CContextState *pContextState,
+    __in CD3DDeviceLevel1 *pDevice,
+    UINT uIntermediateWidth,
+    UINT uIntermediateHeight,
+    UINT cLevels,
+    UINT reducedRadius,
+    __in CD3DVidMemOnlyTexture *pTextureNoRef_A,
+    __in_opt CHwSurfaceRenderTarget *pFinalDestRT,
+    __in_opt CD3DSurface *pPipelineDestSurface
+    )
+{
+    HRESULT hr = S_OK;
+
+    // The level being rendered and the one it is downsampled from
+    CD3DVidMemOnlyTexture *pLevelTexture = NULL;
+    CD3DSurface *pLevelSurface = NULL;
+    CD3DVidMemOnlyTexture *pPreviousLevelTexture = NULL;
+
+    // The intermediate for the horizontal passes at the smallest level
+    CD3DVidMemOnlyTexture *pTexture_B = NULL;
+    CD3DSurface *pSurface_B = NULL;
+
+    float *pSamplingWeights = NULL;
+
+    MilColorB colBlank = 0;
+
+    UINT levelWidth = uIntermediateWidth;
+    UINT levelHeight = uIntermediateHeight;
+
+    Assert(cLevels > 0);
+
+    //
+    // 1) Downsample. Each destination pixel center falls between four source
+    //    pixels, so bilinear sampling averages them.
+    //
+    IFC(SetSamplerState(
+        pDevice, 
+        0, 
+        false,   // don't set the address mode again
+        true));  // use bilinear
+
+    IFC(pDevice->SetPassThroughPixelShader());
+    IFC(pDevice->SetAlphaBlendMode(&CD3DRenderState::sc_abmSrcCopy));
+
+    for (UINT level = 0; level < cLevels; level++)
+    {
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+
+        ReleaseInterface(pPreviousLevelTexture);
+        pPreviousLevelTexture = pLevelTexture;
+        pLevelTexture = NULL;
+        ReleaseInterface(pLevelSurface);
+
+        IFC(CreateIntermediateRT(
+            pDevice, 
+            levelWidth, 
+            levelHeight, 
+            D3DFMT_A8R8G8B8,
+            &pLevelTexture));
+
+        Assert(pLevelTexture != NULL);
+        IFC(pLevelTexture->GetD3DSurfaceLevel(0, &pLevelSurface));
+
+        IFC(SetupVertexTransform(
+            pContextState, 
+            pDevice, 
+            static_cast<float>(levelWidth), 
+            static_cast<float>(levelHeight), 
+            false /* populate for rendering into intermediates */));
+
+        IFC(pDevice->SetTexture(0, (level == 0) ? pTextureNoRef_A : pPreviousLevelTexture));
+        IFC(pDevice->SetRenderTargetForEffectPipeline(pLevelSurface));
+        IFC(pDevice->DrawTriangleStrip(0, 2));
+    }
+
+    ReleaseInterface(pPreviousLevelTexture);
+
+    //
+    // 2) Blur the smallest level: horizontal passes into B, then vertical
+    //    passes back into the level, as in the full size performance blur.
+    //
+    for (int i = 0; i < 2; i += 1)
+    {
+        IFC(SetSamplerState(
+            pDevice, 
+            i, 
+            false,   // don't set the address mode again
+            false)); // use nearest neighbor
+    }
+
+    IFC(CreateIntermediateRT(
+        pDevice, 
+        levelWidth, 
+        levelHeight, 
+        D3DFMT_A8R8G8B8,
+        &pTexture_B));
+
+    Assert(pTexture_B != NULL);
+    IFC(pTexture_B->GetD3DSurfaceLevel(0, &pSurface_B));
+
+    pSamplingWeights = new float[reducedRadius+1];
+    IFCOOM(pSamplingWeights);
+    CalculateSamplingWeights(reducedRadius, &pSamplingWeights, m_data.m_KernelType);
+
+    IFC(pDevice->SetTexture(0, pLevelTexture));
+    IFC(pDevice->SetRenderTargetForEffectPipeline(pSurface_B));
+    IFC(pDevice->SetAlphaBlendMode(&CD3DRenderState::sc_abmAddSourceColor));
+    IFC(pDevice->Clear(0, NULL, D3DCLEAR_TARGET, colBlank, 0, 0));
+
+    IFC(ExecutePasses(
+        pDevice, 
+        true /* horizontal */, 
+        false /* performance */,
+        reducedRadius, 
+        static_cast<float>(levelWidth) /* size = width */, 
+        pSamplingWeights, 
+        pLevelTexture, 
+        pTexture_B,
+        pSurface_B,
+        NULL, /* the second intermediate is not created for performance passes */
+        NULL));
+
+    IFC(pDevice->SetRenderTargetForEffectPipeline(pLevelSurface));
+    IFC(pDevice->Clear(0, NULL, D3DCLEAR_TARGET, colBlank, 0, 0));
+
+    IFC(ExecutePasses(
+        pDevice, 
+        false /* vertical */, 
+        false /* performance */,
+        reducedRadius, 
+        static_cast<float>(levelHeight) /* size = height */, 
+        pSamplingWeights, 
+        pLevelTexture, 
+        pTexture_B,
+        pSurface_B,
+        NULL, /* the second intermediate is not created for performance passes */
+        NULL));
+
+    IFC(pDevice->SetAlphaBlendMode(&CD3DRenderState::sc_abmSrcOverPremultiplied));  
+
+    //
+    // 3) Upsample the blurred level. This always samples bilinearly, whatever
+    //    the interpolation mode, since the level is smaller than the output.
+    //
+    IFC(pDevice->SetTexture(0, pLevelTexture));
+
+    IFC(SetSamplerState(
+        pDevice, 
+        0, 
+        false,   // don't set the address mode again
+        true));  // use bilinear
+
+    if (pFinalDestRT != NULL)
+    {
+        IFC(SetupVertexTransform(
+            pContextState, 
+            pDevice, 
+            static_cast<float>(uIntermediateWidth), 
+            static_cast<float>(uIntermediateHeight), 
+            true /* populate for rendering into the final destination */));
+
+        IFC(pFinalDestRT->EnsureState(pContextState));
+    }
+    else
+    {
+        Assert(pPipelineDestSurface != NULL);
+
+        IFC(SetupVertexTransform(
+            pContextState, 
+            pDevice, 
+            static_cast<float>(uIntermediateWidth), 
+            static_cast<float>(uIntermediateHeight), 
+            false /* populate for rendering into an intermediate */));
+        IFC(pDevice->SetRenderTargetForEffectPipeline(pPipelineDestSurface));
+        IFC(pDevice->Clear(0, NULL, D3DCLEAR_TARGET, colBlank, 0, 0));
+    }
+
+    IFC(pDevice->SetPassThroughPixelShader());
+    IFC(pDevice->DrawTriangleStrip(0, 2));
+
+Cleanup:
+    if (pSamplingWeights != NULL)
+    {
+        delete [] pSamplingWeights;
+        pSamplingWeights = NULL;
+    }
+
+    ReleaseInterface(pLevelTexture);
+    ReleaseInterface(pLevelSurface);
+    ReleaseInterface(pPreviousLevelTexture);
+
+    ReleaseInterface(pTexture_B);
+    ReleaseInterface(pSurface_B);
+
+    RRETURN(hr);
+}
+
 //+----------------------------------------------------------------------------
 //
 // CMilBlurEffectDuce::ExecutePasses
@@ -1622,6 +2949,10 @@ Cleanup:
 // Arguments:
 // fGaussian    - JIT compile time switch to determine whether to create a box
 //                blur or Gaussian blur
+// fFixedPoint  - JIT compile time switch to weight and divide the samples
+//                with 16 bit integer multiplies instead of converting them to
+//                floats, see CalculateFixedPointGaussianWeights and
+//                CalculateFixedPointBoxDivisor for when this is allowed
 //
 //
 // Algorithms:
@@ -1652,6 +2983,14 @@ Cleanup:
 //      cases where height >> radius, which is going to be the usual case.
 //        
 //
+// Fixed point:
+//      The Gaussian weights are quantized to 15 bits and each sample is weighted
+//      with a single pmaddwd, its channels being zero extended to 32 bits so that
+//      the other half of each pair of words contributes nothing. The box sums are
+//      divided with a 16 bit reciprocal (pmulhuw). Neither converts to or from
+//      floats. With AVX2 the Gaussian blur weights two adjacent pixels per
+//      vpmaddwd, see SampleGaussianFixedPointPair.
+//
 // Master to do list:
 // SSE4.1 optimizations for Gaussian blur (availability of integer multiply).
 // Reordering of add/multiply for Gaussian blur to see what effect the int/float conversions
@@ -1661,7 +3000,7 @@ Cleanup:
 
 
 HRESULT
-CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, GenerateColorsBlur *pProgram)
+CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, bool fFixedPoint, GenerateColorsBlur *pProgram)
 {
     HRESULT hr = S_OK;
     
@@ -1679,6 +3018,9 @@ CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, Generate
     // size, but is more compatible with debugging and profiling. 
     CJitterAccess::SetMode(CJitterAccess::sc_uidUseNegativeStackOffsets, 0);
 
+    CJitterAccess::SetMode(CJitterAccess::sc_uidUseAVX, g_fUseAVX);
+    CJitterAccess::SetMode(CJitterAccess::sc_uidUseAVX2, g_fUseAVX2);
+
     {
         C_pVoid pArguments = C_pVoid::GetpVoidArgument(0); // Get GenerateColorsBlurParams structure argument.
         
@@ -1722,6 +3064,26 @@ CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, Generate
         P_f32x1 pGaussianWeights = (pArguments.GetMemberPtr(OFFSET_OF(GenerateColorsBlurParams, pGaussianWeights))).AsP_f32x1();
         C_u32 verticalFlag = pArguments.GetMemberUINT32(OFFSET_OF(GenerateColorsBlurParams, vertical));
 
+        //
+        // Fixed point only: pGaussianWeightsFixed has the same layout as pGaussianWeights, and
+        // box sums are divided by multiplying with divisorReciprocal, see DivideAndPackResultFixedPoint.
+        //
+        P_u32 pGaussianWeightsFixed;
+        C_u16x8 divisorReciprocal;
+        C_u32x4 divisorRounding;
+        if (fFixedPoint)
+        {
+            if (fGaussian)
+            {
+                pGaussianWeightsFixed = (pArguments.GetMemberPtr(OFFSET_OF(GenerateColorsBlurParams, pGaussianWeightsFixed))).AsP_u32();
+            }
+            else
+            {
+                divisorReciprocal = pArguments.GetMemberUINT32(OFFSET_OF(GenerateColorsBlurParams, boxDivisorReciprocal)).Replicate().AsC_u16x8();
+                divisorRounding = pArguments.GetMemberUINT32(OFFSET_OF(GenerateColorsBlurParams, boxDivisorRounding)).Replicate();
+            }
+        }
+
         //
         // Determine if we're doing a vertical or horizontal Gaussian pass and set per pixel source advance appropriately
         //
@@ -1739,7 +3101,11 @@ CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, Generate
 
         // Precalculate some things that are constant per pass.
         C_u32 sampleLength = radius * 2 + 1;
-        C_f32x4 sampleLengthSquareReplicate = (sampleLength * sampleLength).Replicate().ToFloat4();
+        C_f32x4 sampleLengthSquareReplicate;
+        if (!fGaussian && !fFixedPoint)
+        {
+            sampleLengthSquareReplicate = (sampleLength * sampleLength).Replicate().ToFloat4();
+        }
 
         //
         // sampleSourceLineStart increments with each scanline
@@ -1812,17 +3178,70 @@ CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, Generate
                 // Either SetupBox or MoveBoxToNextLine has produced the first output
                 // value for this scanline, save it and advance as required
                 //
-                *pDst = DivideAndPackResult(currentSumValue, sampleLengthSquareReplicate);
+                if (fFixedPoint)
+                {
+                    *pDst = DivideAndPackResultFixedPoint(currentSumValue, divisorReciprocal, divisorRounding);
+                }
+                else
+                {
+                    *pDst = DivideAndPackResult(currentSumValue, sampleLengthSquareReplicate);
+                }
                 ++pSrc;
                 ++pDst;
                 ++pBoxBlurLineBufferCurrent;
                 --uCount;
             }
-           
+
+            if (fGaussian && fFixedPoint && g_fUseAVX2)
+            {
+                //
+                // Filter pairs of adjacent pixels in YMM registers, leaving
+                // the last pixel of odd length lines to the loop below
+                //
+                C_u32 uPairCount = uCount >> 1;
+
+                C_Branch pairBranch;
+                pairBranch.BranchOnZero(uPairCount);
+                {
+                    C_Loop pairLoop;    // do while (uPairCount != 0)
+                    {
+                        SampleGaussianFixedPointPair(pSrc,
+                                                     positionChange,
+                                                     sampleLength,
+                                                     pDst,
+                                                     pGaussianWeightsFixed
+                                                     );
+
+                        pSrc += 2;
+                        pDst += 2;
+                        --uPairCount;
+                    }
+                    pairLoop.RepeatIfNonZero(uPairCount);
+                }
+                pairBranch.BranchHere();
+
+                uCount &= 1;
+            }
+
+            C_Branch emptyLineBranch;
+            if (fGaussian && fFixedPoint && g_fUseAVX2)
+            {
+                emptyLineBranch.BranchOnZero(uCount);
+            }
+
             // The main pixel loop per line
             C_Loop loop;    // do while (uCount != 0)
             {
-                if (fGaussian)
+                if (fGaussian && fFixedPoint)
+                {
+                    SampleGaussianFixedPoint(pSrc,
+                                             positionChange,
+                                             sampleLength,
+                                             pDst, 
+                                             pGaussianWeightsFixed
+                                             );
+                }
+                else if (fGaussian)
                 {
                     SampleGaussian(pSrc,
                                    positionChange,
@@ -1838,7 +3257,10 @@ CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, Generate
                               pDst, 
                               pBoxBlurLineBufferCurrent,
                               &currentSumValue,
-                              sampleLengthSquareReplicate
+                              sampleLengthSquareReplicate,
+                              divisorReciprocal,
+                              divisorRounding,
+                              fFixedPoint
                               );
                 }
                 
@@ -1850,6 +3272,11 @@ CMilBlurEffectDuce::InitializeBlurFunction(bool fGaussian, bool fColor, Generate
             }
             loop.RepeatIfNonZero(uCount);
 
+            if (fGaussian && fFixedPoint && g_fUseAVX2)
+            {
+                emptyLineBranch.BranchHere();
+            }
+
             --uCountLines;
             pDstCurrentLine += sourceWidth;
 
@@ -2050,20 +3477,33 @@ CMilBlurEffectDuce::MoveBoxToNextLine(P_u32 pSource,
 //                        pixel
 //  pPreviousSumValue   - The previous sum value to increment
 //  sampleLengthSquareReplicate - Sample length squared replicated into all four float values
+//  divisorReciprocal   - Fixed point only, see DivideAndPackResultFixedPoint
+//  divisorRounding     - Fixed point only, see DivideAndPackResultFixedPoint
+//  fFixedPoint         - JIT compile time switch, true for the fixed point program
 //-----------------------------------------------------------------------------
 void
 CMilBlurEffectDuce::SampleBox(C_u32 sampleLength,
                               P_u32 pDst, 
                               P_u32x4 pLineSumBuffer,
                               C_u32x4 *pPreviousSumValue,
-                              C_f32x4 sampleLengthSquareReplicate
+                              C_f32x4 sampleLengthSquareReplicate,
+                              C_u16x8 divisorReciprocal,
+                              C_u32x4 divisorRounding,
+                              bool fFixedPoint
                               )
 {
     // We have the previous sum. Add the next sample along and subtract the previous one.
     *pPreviousSumValue += *(pLineSumBuffer + sampleLength - 1);
     *pPreviousSumValue -= *(pLineSumBuffer - 1);
 
-    *pDst = DivideAndPackResult(*pPreviousSumValue, sampleLengthSquareReplicate);
+    if (fFixedPoint)
+    {
+        *pDst = DivideAndPackResultFixedPoint(*pPreviousSumValue, divisorReciprocal, divisorRounding);
+    }
+    else
+    {
+        *pDst = DivideAndPackResult(*pPreviousSumValue, sampleLengthSquareReplicate);
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -2100,6 +3540,101 @@ CMilBlurEffectDuce::SampleGaussian(P_u32 pSource,
     *pDst = PackResult(lineResult);
 }
 
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::SampleGaussianFixedPoint
+//
+//  1D Gaussian blur sampler with integer weights, see SampleGaussian
+//
+// Arguments:
+//  pGaussianWeights    - Gaussian weights in units of 2^-GAUSSIAN_FIXED_POINT_SHIFT,
+//                        each below 2^15. Length must be sampleLength
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::SampleGaussianFixedPoint(P_u32 pSource, 
+                                             C_u32 sourcePositionDelta,
+                                             C_u32 sampleLength,
+                                             P_u32 pDst, 
+                                             P_u32 pGaussianWeights
+                                             )
+{   
+    static const u32x4 c_uRounding = {
+        1 << (GAUSSIAN_FIXED_POINT_SHIFT - 1),
+        1 << (GAUSSIAN_FIXED_POINT_SHIFT - 1),
+        1 << (GAUSSIAN_FIXED_POINT_SHIFT - 1),
+        1 << (GAUSSIAN_FIXED_POINT_SHIFT - 1)
+        };
+
+    C_u32 lineloopCount = sampleLength;
+    C_u32x4 lineResult = c_uZero;
+
+    C_Loop sampleLoop;
+    {
+        //
+        // Both the channels and the replicated weight are zero extended to
+        // 32 bits, so pmaddwd multiplies each channel by the weight and adds
+        // zero. The sum is at most 255 * 2^15.
+        //
+        C_u32 weight = pGaussianWeights[lineloopCount-1];
+        lineResult += Sample(pSource).AsC_u16x8().MulAdd(weight.Replicate().AsC_u16x8());
+
+        // Increment source location 
+        pSource += sourcePositionDelta;
+        -- lineloopCount;
+    }
+    sampleLoop.RepeatIfNonZero(lineloopCount);
+
+    lineResult = (lineResult + c_uRounding) >> GAUSSIAN_FIXED_POINT_SHIFT;
+
+    *pDst = PackResult(lineResult);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::SampleGaussianFixedPointPair
+//
+//  AVX2 version of SampleGaussianFixedPoint filtering pSource[0] and
+//  pSource[1] into pDst[0] and pDst[1]. Each pmaddwd weights the channels of
+//  both pixels, so a pair takes as many instructions as a single pixel does.
+//
+//-----------------------------------------------------------------------------
+void
+CMilBlurEffectDuce::SampleGaussianFixedPointPair(P_u32 pSource, 
+                                                 C_u32 sourcePositionDelta,
+                                                 C_u32 sampleLength,
+                                                 P_u32 pDst, 
+                                                 P_u32 pGaussianWeights
+                                                 )
+{   
+    C_u32 lineloopCount = sampleLength;
+
+    // Start from the rounding constant instead of adding it at the end
+    C_u32x8 lineResult = C_u32x8::Broadcast(static_cast<UINT32>(1 << (GAUSSIAN_FIXED_POINT_SHIFT - 1)));
+
+    C_Loop sampleLoop;
+    {
+        C_u32x8 sample;
+        sample.LoadUnpackBytes(pSource);
+        lineResult += sample.MulAddWords(C_u32x8::Broadcast(pGaussianWeights[lineloopCount-1]));
+
+        // Increment source location 
+        pSource += sourcePositionDelta;
+        -- lineloopCount;
+    }
+    sampleLoop.RepeatIfNonZero(lineloopCount);
+
+    lineResult = lineResult >> GAUSSIAN_FIXED_POINT_SHIFT;
+
+    C_u32x4 lowResult = lineResult.GetLow();
+    C_u32x4 highResult = lineResult.GetHigh();
+
+    // PackResult is SSE code, which must not run with the upper halves dirty
+    C_u32x8::ZeroUpper();
+
+    pDst[0] = PackResult(lowResult);
+    pDst[1] = PackResult(highResult);
+}
+
 //-----------------------------------------------------------------------------
 //
 // CMilBlurEffectDuce::PackResult
@@ -2144,6 +3679,32 @@ CMilBlurEffectDuce::DivideAndPackResult(C_u32x4 input, C_f32x4 divisor)
     return PackResult(uResult);
 }
 
+//-----------------------------------------------------------------------------
+//
+// CMilBlurEffectDuce::DivideAndPackResultFixedPoint
+//
+//  Integer version of DivideAndPackResult for sums that fit in 16 bits.
+//  Computes ((input + rounding) * reciprocal) >> 16 in each channel, see
+//  CalculateFixedPointBoxDivisor, then packs into ARGB 32-bit result.
+//
+// Arguments:
+//  input       - Input sum value, each channel below 2^16
+//  reciprocal  - The reciprocal in the low word of each channel
+//  rounding    - The rounding term in each channel
+//
+//-----------------------------------------------------------------------------
+C_u32
+CMilBlurEffectDuce::DivideAndPackResultFixedPoint(C_u32x4 input, C_u16x8 reciprocal, C_u32x4 rounding)
+{
+    //
+    // The high word of each channel is zero, so is its product. The low
+    // word holds the quotient, at most 255.
+    //
+    C_u16x8 uResult = (input + rounding).AsC_u16x8().MulHigh(reciprocal);
+
+    return PackResult(uResult.AsC_u32x4());
+}
+
 //-----------------------------------------------------------------------------
 //
 // CMilBlurEffectDuce::TakeNSamples
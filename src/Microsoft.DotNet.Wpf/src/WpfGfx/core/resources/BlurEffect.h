@@ -17,6 +17,7 @@ MtExtern(CMilBlurEffectDuce);
 class P_u32;
 class C_u32;
 class C_u32x4;
+class C_u16x8;
 class P_f32x1;
 class P_f32x4;
 class P_u32x4;
@@ -38,12 +39,43 @@ struct GenerateColorsBlurParams
     UINT boxBlurLineBufferLength;
     float *pGaussianWeights;
     UINT vertical;
+
+    //
+    // Fixed point programs only: the Gaussian weights in units of
+    // 2^-GAUSSIAN_FIXED_POINT_SHIFT, and the 16 bit reciprocal of the box
+    // divisor with its rounding term, see CalculateFixedPointBoxDivisor.
+    //
+    UINT *pGaussianWeightsFixed;
+    UINT boxDivisorReciprocal;
+    UINT boxDivisorRounding;
 };
 
 typedef void (__stdcall *GenerateColorsBlur)(
     __in GenerateColorsBlurParams *pParams
     );
 
+//
+// Shared state of the stripes of a software blur pass
+//
+struct BlurFunctionStripeContext
+{
+    GenerateColorsBlur pfnBlur;
+    const GenerateColorsBlurParams *pArguments;
+    UINT boxBlurLineBufferStride;
+};
+
+struct BoxApproximationStripeContext
+{
+    UINT *pSource;
+    UINT *pDestination;
+    UINT width;
+    UINT height;
+    UINT radius;
+    const UINT *rgBoxRadii;
+    UINT *pScratch;
+    UINT cScratchRows;
+};
+
 // Class: CMilBlurEffectDuce
 class CMilBlurEffectDuce : public CMilEffectDuce
 {
@@ -122,7 +154,19 @@ public:
         __deref_out_xcount(2*radius+1) float **ppSamplingWeights
         );
 
-    static HRESULT InitializeBlurFunction(bool fGaussian, bool fColor, GenerateColorsBlur *pProgram);
+    static HRESULT InitializeBlurFunction(bool fGaussian, bool fColor, bool fFixedPoint, GenerateColorsBlur *pProgram);
+
+    static bool CalculateFixedPointGaussianWeights(
+        UINT radius,
+        __in_ecount(2*radius+1) const float *pWeights,
+        __out_ecount(2*radius+1) UINT *pFixedWeights
+        );
+
+    static bool CalculateFixedPointBoxDivisor(
+        UINT sampleLength,
+        __out UINT *pReciprocal,
+        __out UINT *pRounding
+        );
 
     // These should probably both go in a utility class sometime.
     static HRESULT ClearMarginPixels(
@@ -140,6 +184,49 @@ public:
         __in UINT localSpaceRadius,
         __out UINT *scaledRadius
         );
+
+    static HRESULT ApplyBoxApproximatedGaussianBlurSw(
+        __inout_ecount(sourceWidth * sourceHeight * 4) BYTE *pInputOutputBuffer,
+        __inout_ecount(sourceWidth * sourceHeight * 4) BYTE *pIntermediateBuffer,
+        UINT sourceWidth,
+        UINT sourceHeight,
+        UINT radius
+        );
+
+    // The radius from which software Gaussian blurs are approximated by
+    // successive box filters rather than convolved with the full kernel.
+    static const UINT BOX_APPROXIMATION_MIN_RADIUS = 32;
+
+    // The number of box filters used per direction for the approximation.
+    static const UINT BOX_APPROXIMATION_PASSES = 3;
+
+    static UINT GetStripeCount(
+        UINT cLines,
+        UINT cPixelsPerLine
+        );
+
+    // The smallest stripe of a software pass worth handing to another thread.
+    static const UINT MIN_PIXELS_PER_STRIPE = 16384;
+
+    static UINT GetPyramidLevelCount(
+        UINT radius,
+        UINT maxError,
+        __out UINT *pReducedRadius
+        );
+
+    static UINT GetPyramidMaxError();
+
+    // The error, in 1/255 units, a Performance blur may trade for speed by
+    // blurring at a reduced resolution unless the BlurPyramidMaxError
+    // registry value overrides it. 0 turns the pyramid off.
+    static const UINT PYRAMID_DEFAULT_MAX_ERROR = 8;
+
+    // The smallest radius a blur is reduced to. Smaller kernels sample the
+    // Gaussian too coarsely for the error estimate to hold.
+    static const UINT PYRAMID_MIN_REDUCED_RADIUS = 4;
+
+    // The maximum number of times the pyramid halves the resolution.
+    static const UINT PYRAMID_MAX_LEVELS = 3;
     
 protected:
 
@@ -205,6 +292,26 @@ private:
         __in_opt CD3DSurface* pSurface_C
         );
 
+    HRESULT ExecutePyramidPasses(
+        __in const CContextState *pContextState,
+        __in CD3DDeviceLevel1 *pDevice,
+        UINT uIntermediateWidth,
+        UINT uIntermediateHeight,
+        UINT cLevels,
+        UINT reducedRadius,
+        __in CD3DVidMemOnlyTexture *pTextureNoRef_A,
+        __in_opt CHwSurfaceRenderTarget *pFinalDestRT,
+        __in_opt CD3DSurface *pPipelineDestSurface
+        );
+
+    HRESULT ApplyPyramidBlurSw(
+        __inout_ecount(sourceWidth * sourceHeight * 4) BYTE *pInputOutputBuffer,
+        UINT sourceWidth,
+        UINT sourceHeight,
+        UINT cLevels,
+        UINT reducedRadius
+        );
+
     HRESULT ApplyGaussianBlurSw(__in_ecount(sourceWidth * sourceHeight * 4) BYTE * pInputOutputBuffer,
                                 __in_ecount(sourceWidth * sourceHeight * 4) BYTE * pIntermediateBuffer,
                                 UINT sourceWidth,
@@ -217,6 +324,60 @@ private:
                            UINT sourceWidth,
                            UINT sourceHeight,
                            UINT radius);                                   
+
+    static void CalculateBoxApproximationRadii(
+        UINT radius,
+        __out_ecount(BOX_APPROXIMATION_PASSES) UINT *rgBoxRadii
+        );
+
+    static void BoxSumColumnsSw(
+        __in_ecount(stride * height) const UINT *pSource,
+        __out_ecount(stride * height) UINT *pDestination,
+        UINT width,
+        UINT stride,
+        UINT height,
+        UINT radius,
+        __in_ecount(BOX_APPROXIMATION_PASSES) const UINT *rgBoxRadii,
+        __out UINT *pScratch
+        );
+
+    static void BoxSumRowsSw(
+        __in_ecount(width * height) const UINT *pSource,
+        __inout_ecount(width * height) UINT *pDestination,
+        UINT width,
+        UINT height,
+        UINT radius,
+        __in_ecount(BOX_APPROXIMATION_PASSES) const UINT *rgBoxRadii,
+        __out_ecount(8 * width) UINT *pScratch
+        );
+
+    static void BoxSumColumnsStripe(
+        __in void *pvContext,
+        UINT iStripe,
+        UINT iFirstColumn,
+        UINT iEndColumn
+        );
+
+    static void BoxSumRowsStripe(
+        __in void *pvContext,
+        UINT iStripe,
+        UINT iFirstRow,
+        UINT iEndRow
+        );
+
+    static void ExecuteBlurFunction(
+        __in GenerateColorsBlur pfnBlur,
+        __in const GenerateColorsBlurParams *pArguments,
+        UINT cStripes,
+        UINT boxBlurLineBufferStride
+        );
+
+    static void BlurFunctionStripe(
+        __in void *pvContext,
+        UINT iStripe,
+        UINT iFirstLine,
+        UINT iEndLine
+        );
     
     static C_u32x4 SetupBox(P_u32 pSource, 
                              C_u32 sourcePositionDelta,
@@ -237,7 +398,10 @@ private:
                           P_u32 pDst, 
                           P_u32x4 pLineSumBuffer,
                           C_u32x4 *pPreviousSumValue,
-                          C_f32x4 sampleLengthSquareReplicate
+                          C_f32x4 sampleLengthSquareReplicate,
+                          C_u16x8 divisorReciprocal,
+                          C_u32x4 divisorRounding,
+                          bool fFixedPoint
                           );
 
     static void SampleGaussian(P_u32 pSource, 
@@ -247,6 +411,20 @@ private:
                                P_f32x1 pGaussianWeights
                                );
 
+    static void SampleGaussianFixedPoint(P_u32 pSource, 
+                                         C_u32 sourcePositionDelta,
+                                         C_u32 sampleLength,
+                                         P_u32 pDst, 
+                                         P_u32 pGaussianWeights
+                                         );
+
+    static void SampleGaussianFixedPointPair(P_u32 pSource, 
+                                             C_u32 sourcePositionDelta,
+                                             C_u32 sampleLength,
+                                             P_u32 pDst, 
+                                             P_u32 pGaussianWeights
+                                             );
+
     static void TakeNSamples(C_u32 sampleCount, 
                                P_u32 pSource, 
                                C_u32 sourcePositionDelta,
@@ -257,6 +435,8 @@ private:
     
     static C_u32 DivideAndPackResult(C_u32x4 uResult, C_f32x4 divisor);
 
+    static C_u32 DivideAndPackResultFixedPoint(C_u32x4 uResult, C_u16x8 reciprocal, C_u32x4 rounding);
+
     static C_u32 PackResult(C_u32x4 uResult);
     
     static C_u32x4 Sample(P_u32 pSampleSource);
@@ -269,14 +449,24 @@ private:
 
     // The maximum supported radius for a blur effect.
     static const UINT MAX_RADIUS = 100;
+
+    // Precision of the weights of the fixed point Gaussian program. Weights
+    // must stay below 2^15 for the signed 16 bit multiplies.
+    static const UINT GAUSSIAN_FIXED_POINT_SHIFT = 15;
     
     // Holds the pixel shader resources (a pair of horizontal and vertical, one
     // each for single-texture input and for multi-texture input).
     static CMilPixelShaderDuce* s_pBlurPixelShaders[4];
 
+    // The pyramid error bound, read from the registry on first use
+    static UINT s_uPyramidMaxError;
+    static bool s_fPyramidMaxErrorRead;
+
     // Holds the compiled SIMD code for the software blur and Gaussian functions
     static GenerateColorsBlur s_pfnBlurFunctionBox;
     static GenerateColorsBlur s_pfnBlurFunctionGaussian;
+    static GenerateColorsBlur s_pfnBlurFunctionBoxFixedPoint;
+    static GenerateColorsBlur s_pfnBlurFunctionGaussianFixedPoint;
 
     // Column buffer required for box blur
     BYTE *m_pBoxBlurLineBuffer;
@@ -108,6 +108,10 @@ CMilDropShadowEffectDuce::ApplyEffectSw(
     IWGXBitmapLock *pIntermediateBitmapLock = NULL;
     BYTE *pIntermediateBuffer = NULL;
 
+    UINT *pBlurBuffer = NULL;
+    float *pGaussianWeights = NULL;
+    UINT *pBlurredInput = NULL;
+
     // pARGB input buffer and size
     UINT inputBufferSize = 0;
     MILRect lockRect = { 0, 0, uIntermediateWidth, uIntermediateHeight };
@@ -225,9 +229,35 @@ CMilDropShadowEffectDuce::ApplyEffectSw(
             clampedStartX += (offsetX > 0) ? offsetX : 0;
             clampedStartY += (offsetY < 0) ? -offsetY : 0;
 
-            UINT offsetDistance = uIntermediateWidth * clampedStartY + clampedStartX;
-            UINT *pInputBufferUINTLine = reinterpret_cast<UINT*>(pInputBuffer) + offsetDistance;
-            UINT *pOutputBufferUINTLine = reinterpret_cast<UINT*>(pIntermediateBuffer) + offsetDistance;
+            UINT cStripes = CMilBlurEffectDuce::GetStripeCount(clampedHeight, clampedWidth);
+
+            if (scaledRadius >= CMilBlurEffectDuce::BOX_APPROXIMATION_MIN_RADIUS)
+            {
+                //
+                // Blurring each translucent run separately costs O(radius) per pixel. For large
+                // radii blur a copy of the whole input once with the box approximation instead,
+                // using the output as staging, and read the shadow from it below. Every shadow
+                // sample is taken at least radius pixels from the edges, where the blurred copy
+                // is valid.
+                //
+                UINT cPixels = 0;
+                UINT blurredInputSize = 0;
+                IFC(UIntMult(uIntermediateWidth, uIntermediateHeight, &cPixels));
+                IFC(UIntMult(sizeof(UINT), cPixels, &blurredInputSize));
+
+                pBlurredInput = reinterpret_cast<UINT*>WPFAlloc(ProcessHeap, Mt(CMilDropShadowEffectDuce), blurredInputSize);
+                IFCOOM(pBlurredInput);
+
+                RtlCopyMemory(pBlurredInput, pInputBuffer, blurredInputSize);
+
+                IFC(CMilBlurEffectDuce::ApplyBoxApproximatedGaussianBlurSw(
+                            reinterpret_cast<BYTE*>(pBlurredInput),
+                            pIntermediateBuffer,
+                            uIntermediateWidth,
+                            uIntermediateHeight,
+                            scaledRadius
+                            ));
+            }
 
             // Clear the pixels the dropshadow algorithm won't fill.
             IFC(CMilBlurEffectDuce::ClearMarginPixels(
@@ -245,129 +275,44 @@ CMilDropShadowEffectDuce::ApplyEffectSw(
             // here for caching simplicity - we don't want to reallocate/calculate these per sample or per line, so 
             // a bit uglier for the sake of performance 
             //
-            UINT *pBlurBuffer = reinterpret_cast<UINT*>WPFAlloc(ProcessHeap, Mt(CMilDropShadowEffectDuce), sizeof(UINT) * uIntermediateWidth);
-            IFCOOM(pBlurBuffer);
-            
-            float *pGaussianWeights = reinterpret_cast<float*>WPFAlloc(ProcessHeap, Mt(CMilBlurEffectDuce), (sizeof(float) * (2*scaledRadius + 1)));
-            IFCOOM(pGaussianWeights);
-
-            CMilBlurEffectDuce::CalculateGaussianSamplingWeightsFullKernel(scaledRadius, &pGaussianWeights);
-
-            UINT shadowColor = ConvertColor(GetColor());
-            UINT opacity = static_cast<UINT>(GetOpacity() * 255.0);
-
-            // For each line
-            for (UINT i = clampedStartY; i < clampedHeight + clampedStartY; i++)
+            if (pBlurredInput == NULL)
             {
-                UINT *pInputBufferUINT = pInputBufferUINTLine;                    
-                UINT *pOutputBufferUINT = pOutputBufferUINTLine;
-                UINT pixelCount = 0;
+                UINT blurBufferSize = 0;
+                IFC(UIntMult(sizeof(UINT) * cStripes, uIntermediateWidth, &blurBufferSize));
 
-                //
-                // This is not actually an n^2 algorithm at this point, this inner 
-                // loop will only execute as many times as the content changes from 
-                // opaque to translucent, not for every pixel in clampedWidth
-                //
-                while (pixelCount < clampedWidth)
-                {
-                    //
-                    // Copy opaque pixels - since the source is opaque and the shadow is 
-                    // always "behind" the object, these will not change
-                    //
-                    while ((pixelCount < clampedWidth) && IsOpaque(*pInputBufferUINT))
-                    {
-                        *pOutputBufferUINT++ = *pInputBufferUINT++;
-                        pixelCount++;
-                    }
-
-                    // If we're not at the end of the line, we've hit a translucent pixel
-                    if ((pixelCount < clampedWidth) && IsTranslucent(*pInputBufferUINT))
-                    {
-                        UINT translucentPixelCount = 0;
-                        UINT *pCurrentOutputBufferUINTSave = pOutputBufferUINT;
-                        UINT *pCurrentInputBufferUINTSave = pInputBufferUINT;
-                        
-                        // Collect as many contiguous transparent pixels as are available 
-                        while ((pixelCount < clampedWidth) && IsTranslucent(*pInputBufferUINT))
-                        {
-                            translucentPixelCount++;
-                            pixelCount++;
-                            pInputBufferUINT++;
-                        }
-                        pOutputBufferUINT += translucentPixelCount;
-
-                        // Ok, now we have some source pixels
-                        if (translucentPixelCount > 0)
-                        {
-                            // Input needs offset adjustment and blurring                                
-                            UINT *pAdjustedInputUINT = AdjustSourcePointer(pCurrentInputBufferUINTSave, offsetX, offsetY, uIntermediateWidth);
-                            
-                            GaussianBlurLineOfPixels(pAdjustedInputUINT,
-                                                     pBlurBuffer,
-                                                     pCurrentOutputBufferUINTSave,
-                                                     uIntermediateWidth,
-                                                     uIntermediateHeight,
-                                                     scaledRadius,
-                                                     translucentPixelCount,
-                                                     pGaussianWeights
-                                                     );
-
-                            //
-                            // Color and opacity blending of blurred offset with source
-                            //  This could be rolled up into SSE2 or MMX code, but it's pretty fast right now
-                            // Ideally since the drop shadow algorithm only uses the blurred alpha channel of the offset source texture,
-                            // the blur could be optimized to ignore the RGB channels and do vector processing of multiple alpha channels
-                            // at once. 
-                            //
-                            for (UINT j = 0; j < translucentPixelCount; j++)
-                            {
-                                //
-                                // Basic shadow algorithm.
-                                // blurPixel is the blurred source offset at the appropriate offsetX and offsetY locations
-                                // as generated by GaussianBlurLineOfPixels above
-                                //
-                                // blurPixel.rgba = blurPixel.a * opacity
-                                // blurPixel.rgb *= shadowColor.rgb
-                                // result = (1 - sourcePixel.a) * blurPixel + sourcePixel
-                                //
-                                // This is reordered to do the operations common to all color channels first, then the 
-                                // channel specific calculations afterwards
-                                //
-                                
-                                // Original source pixel
-                                UINT sourcePixel = *pCurrentInputBufferUINTSave;
-                                // Alpha channel of blurred offset pixel
-                                UINT blurredPixelAlpha = MIL_COLOR_GET_ALPHA(*pCurrentOutputBufferUINTSave);
-                                // (1 - sourcePixel.a)
-                                UINT invertedSourceAlpha = 255 - MIL_COLOR_GET_ALPHA(sourcePixel);
-                                // (1 - sourcePixel.a) * blurPixel.a * opacity
-                                LONG combination = blurredPixelAlpha * invertedSourceAlpha * opacity / 65536;
-
-                                // r = (1 - sourcePixel.a) * blurPixel.a * opacity * shadowColor.r + sourcePixel.r
-                                UINT red = combination * MIL_COLOR_GET_RED(shadowColor) / 255 + MIL_COLOR_GET_RED(sourcePixel);
-                                UINT blue = combination * MIL_COLOR_GET_BLUE(shadowColor) / 255 + MIL_COLOR_GET_BLUE(sourcePixel);
-                                UINT green = combination * MIL_COLOR_GET_GREEN(shadowColor) / 255 + MIL_COLOR_GET_GREEN(sourcePixel);
-                                UINT alpha = combination + MIL_COLOR_GET_ALPHA(sourcePixel);
-
-                                // Overwrite previous output pixel
-                                *pCurrentOutputBufferUINTSave = MIL_COLOR(alpha, red, green, blue);                                                                                                                                                
-                                
-                                pCurrentInputBufferUINTSave++;
-                                pCurrentOutputBufferUINTSave++;
-                            }                                
-                        }
-
-                        // All incrementing has already been done                            
-                    }
-                }
+                pBlurBuffer = reinterpret_cast<UINT*>WPFAlloc(ProcessHeap, Mt(CMilDropShadowEffectDuce), blurBufferSize);
+                IFCOOM(pBlurBuffer);
+                
+                pGaussianWeights = reinterpret_cast<float*>WPFAlloc(ProcessHeap, Mt(CMilBlurEffectDuce), (sizeof(float) * (2*scaledRadius + 1)));
+                IFCOOM(pGaussianWeights);
 
-                pInputBufferUINTLine += uIntermediateWidth;
-                pOutputBufferUINTLine += uIntermediateWidth;
+                CMilBlurEffectDuce::CalculateGaussianSamplingWeightsFullKernel(scaledRadius, &pGaussianWeights);
             }
 
-
-            WPFFree(ProcessHeap, pBlurBuffer);
-            WPFFree(ProcessHeap, pGaussianWeights);
+            //
+            // Lines are split into stripes blurred in parallel; Run returns once
+            // every line has been produced.
+            //
+            {
+                DropShadowStripeContext context;
+                context.pInputBuffer = reinterpret_cast<UINT*>(pInputBuffer);
+                context.pOutputBuffer = reinterpret_cast<UINT*>(pIntermediateBuffer);
+                context.pBlurredInput = pBlurredInput;
+                context.pBlurBuffers = pBlurBuffer;
+                context.pGaussianWeights = pGaussianWeights;
+                context.width = uIntermediateWidth;
+                context.height = uIntermediateHeight;
+                context.radius = scaledRadius;
+                context.clampedStartX = clampedStartX;
+                context.clampedStartY = clampedStartY;
+                context.clampedWidth = clampedWidth;
+                context.offsetX = offsetX;
+                context.offsetY = offsetY;
+                context.shadowColor = ConvertColor(GetColor());
+                context.opacity = static_cast<UINT>(GetOpacity() * 255.0);
+
+                CParallelStripes::Run(cStripes, clampedHeight, ApplyShadowToLines, &context);
+            }
 
             ReleaseInterface(pIntermediateBitmapLock);               
             ReleaseInterface(pImplicitInputLock);
@@ -406,10 +351,183 @@ Cleanup:
     ReleaseInterface(pIntermediateBitmap);
     ReleaseInterface(pBrushBitmap);
 
+    if (pBlurBuffer)
+    {
+        WPFFree(ProcessHeap, pBlurBuffer);
+    }
+    if (pGaussianWeights)
+    {
+        WPFFree(ProcessHeap, pGaussianWeights);
+    }
+    if (pBlurredInput)
+    {
+        WPFFree(ProcessHeap, pBlurredInput);
+    }
+
     RRETURN(hr);
 }
 
 
+//-----------------------------------------------------------------------------
+//
+// CMilDropShadowEffectDuce::ApplyShadowToLines
+//
+// Synopsis: 
+//      Produces lines [iFirstLine, iEndLine) of the clamped shadow area. Lines
+//      are independent, so ApplyEffectSw processes them as parallel stripes;
+//      each stripe blurs through its own line of pBlurBuffers.
+//
+//-----------------------------------------------------------------------------
+
+void
+CMilDropShadowEffectDuce::ApplyShadowToLines(
+    __in void *pvContext,
+    UINT iStripe,
+    UINT iFirstLine,
+    UINT iEndLine
+    )
+{
+    const DropShadowStripeContext *pContext = static_cast<const DropShadowStripeContext *>(pvContext);
+
+    UINT uIntermediateWidth = pContext->width;
+    UINT uIntermediateHeight = pContext->height;
+    UINT scaledRadius = pContext->radius;
+    UINT clampedWidth = pContext->clampedWidth;
+    int offsetX = pContext->offsetX;
+    int offsetY = pContext->offsetY;
+    UINT shadowColor = pContext->shadowColor;
+    UINT opacity = pContext->opacity;
+
+    UINT *pInputBuffer = pContext->pInputBuffer;
+    UINT *pBlurredInput = pContext->pBlurredInput;
+    float *pGaussianWeights = pContext->pGaussianWeights;
+    UINT *pBlurBuffer = (pContext->pBlurBuffers != NULL) ? pContext->pBlurBuffers + iStripe * uIntermediateWidth : NULL;
+
+    UINT offsetDistance = uIntermediateWidth * (pContext->clampedStartY + iFirstLine) + pContext->clampedStartX;
+    UINT *pInputBufferUINTLine = pInputBuffer + offsetDistance;
+    UINT *pOutputBufferUINTLine = pContext->pOutputBuffer + offsetDistance;
+
+    // For each line
+    for (UINT i = iFirstLine; i < iEndLine; i++)
+    {
+        UINT *pInputBufferUINT = pInputBufferUINTLine;                    
+        UINT *pOutputBufferUINT = pOutputBufferUINTLine;
+        UINT pixelCount = 0;
+
+        //
+        // This is not actually an n^2 algorithm at this point, this inner 
+        // loop will only execute as many times as the content changes from 
+        // opaque to translucent, not for every pixel in clampedWidth
+        //
+        while (pixelCount < clampedWidth)
+        {
+            //
+            // Copy opaque pixels - since the source is opaque and the shadow is 
+            // always "behind" the object, these will not change
+            //
+            while ((pixelCount < clampedWidth) && IsOpaque(*pInputBufferUINT))
+            {
+                *pOutputBufferUINT++ = *pInputBufferUINT++;
+                pixelCount++;
+            }
+
+            // If we're not at the end of the line, we've hit a translucent pixel
+            if ((pixelCount < clampedWidth) && IsTranslucent(*pInputBufferUINT))
+            {
+                UINT translucentPixelCount = 0;
+                UINT *pCurrentOutputBufferUINTSave = pOutputBufferUINT;
+                UINT *pCurrentInputBufferUINTSave = pInputBufferUINT;
+                
+                // Collect as many contiguous transparent pixels as are available 
+                while ((pixelCount < clampedWidth) && IsTranslucent(*pInputBufferUINT))
+                {
+                    translucentPixelCount++;
+                    pixelCount++;
+                    pInputBufferUINT++;
+                }
+                pOutputBufferUINT += translucentPixelCount;
+
+                // Ok, now we have some source pixels
+                if (translucentPixelCount > 0)
+                {
+                    if (pBlurredInput != NULL)
+                    {
+                        // Input was blurred up front, it only needs offset adjustment
+                        UINT *pBlurredInputUINT = pBlurredInput + (pCurrentInputBufferUINTSave - pInputBuffer);
+                        UINT *pAdjustedInputUINT = AdjustSourcePointer(pBlurredInputUINT, offsetX, offsetY, uIntermediateWidth);
+
+                        RtlCopyMemory(pCurrentOutputBufferUINTSave, pAdjustedInputUINT, sizeof(UINT) * translucentPixelCount);
+                    }
+                    else
+                    {
+                        // Input needs offset adjustment and blurring                                
+                        UINT *pAdjustedInputUINT = AdjustSourcePointer(pCurrentInputBufferUINTSave, offsetX, offsetY, uIntermediateWidth);
+                        
+                        GaussianBlurLineOfPixels(pAdjustedInputUINT,
+                                                 pBlurBuffer,
+                                                 pCurrentOutputBufferUINTSave,
+                                                 uIntermediateWidth,
+                                                 uIntermediateHeight,
+                                                 scaledRadius,
+                                                 translucentPixelCount,
+                                                 pGaussianWeights
+                                                 );
+                    }
+
+                    //
+                    // Color and opacity blending of blurred offset with source
+                    //  This could be rolled up into SSE2 or MMX code, but it's pretty fast right now
+                    // Ideally since the drop shadow algorithm only uses the blurred alpha channel of the offset source texture,
+                    // the blur could be optimized to ignore the RGB channels and do vector processing of multiple alpha channels
+                    // at once. 
+                    //
+                    for (UINT j = 0; j < translucentPixelCount; j++)
+                    {
+                        //
+                        // Basic shadow algorithm.
+                        // blurPixel is the blurred source offset at the appropriate offsetX and offsetY locations
+                        // as generated by GaussianBlurLineOfPixels above
+                        //
+                        // blurPixel.rgba = blurPixel.a * opacity
+                        // blurPixel.rgb *= shadowColor.rgb
+                        // result = (1 - sourcePixel.a) * blurPixel + sourcePixel
+                        //
+                        // This is reordered to do the operations common to all color channels first, then the 
+                        // channel specific calculations afterwards
+                        //
+                        
+                        // Original source pixel
+                        UINT sourcePixel = *pCurrentInputBufferUINTSave;
+                        // Alpha channel of blurred offset pixel
+                        UINT blurredPixelAlpha = MIL_COLOR_GET_ALPHA(*pCurrentOutputBufferUINTSave);
+                        // (1 - sourcePixel.a)
+                        UINT invertedSourceAlpha = 255 - MIL_COLOR_GET_ALPHA(sourcePixel);
+                        // (1 - sourcePixel.a) * blurPixel.a * opacity
+                        LONG combination = blurredPixelAlpha * invertedSourceAlpha * opacity / 65536;
+
+                        // r = (1 - sourcePixel.a) * blurPixel.a * opacity * shadowColor.r + sourcePixel.r
+                        UINT red = combination * MIL_COLOR_GET_RED(shadowColor) / 255 + MIL_COLOR_GET_RED(sourcePixel);
+                        UINT blue = combination * MIL_COLOR_GET_BLUE(shadowColor) / 255 + MIL_COLOR_GET_BLUE(sourcePixel);
+                        UINT green = combination * MIL_COLOR_GET_GREEN(shadowColor) / 255 + MIL_COLOR_GET_GREEN(sourcePixel);
+                        UINT alpha = combination + MIL_COLOR_GET_ALPHA(sourcePixel);
+
+                        // Overwrite previous output pixel
+                        *pCurrentOutputBufferUINTSave = MIL_COLOR(alpha, red, green, blue);                                                                                                                                                
+                        
+                        pCurrentInputBufferUINTSave++;
+                        pCurrentOutputBufferUINTSave++;
+                    }                                
+                }
+
+                // All incrementing has already been done                            
+            }
+        }
+
+        pInputBufferUINTLine += uIntermediateWidth;
+        pOutputBufferUINTLine += uIntermediateWidth;
+    }
+}
+
 UINT * 
 CMilDropShadowEffectDuce::AdjustSourcePointer(UINT *pBuffer, INT_PTR offsetX, INT_PTR offsetY, UINT width)
 {
@@ -107,6 +107,33 @@ private:
 
     static UINT * AdjustSourcePointer(UINT *pBuffer, INT_PTR offsetX, INT_PTR offsetY, UINT width);
 
+    // Shared state of the line stripes of ApplyEffectSw
+    struct DropShadowStripeContext
+    {
+        UINT *pInputBuffer;
+        UINT *pOutputBuffer;
+        UINT *pBlurredInput;
+        UINT *pBlurBuffers;
+        float *pGaussianWeights;
+        UINT width;
+        UINT height;
+        UINT radius;
+        UINT clampedStartX;
+        UINT clampedStartY;
+        UINT clampedWidth;
+        int offsetX;
+        int offsetY;
+        UINT shadowColor;
+        UINT opacity;
+    };
+
+    static void ApplyShadowToLines(
+        __in void *pvContext,
+        UINT iStripe,
+        UINT iFirstLine,
+        UINT iEndLine
+        );
+
     static HRESULT GaussianBlurLineOfPixels(
         __in_ecount(sourceWidth * sourceHeight) UINT *pInputBuffer,
         __in_ecount(nPixels + 2 * radius) UINT *pBlurIntermediateBuffer,
@@ -82,6 +82,30 @@ public:
 
     virtual bool UsesImplicitInput() { return true; }
 
+    //
+    // Software effect fusion: when the output of this effect is only used
+    // as the implicit input of pOuterEffect, both can be run in one pass
+    // without an intermediate. CanFuseWithOuterEffectSw checks whether the
+    // pair can be fused, and SetFusedEffectSw makes the next software
+    // passes of this effect output pOuterEffect(this effect) instead.
+    //
+
+    virtual HRESULT CanFuseWithOuterEffectSw(
+        __in CMilEffectDuce *pOuterEffect,
+        __out bool *pfCanFuse
+        )
+    {
+        *pfCanFuse = false;
+        return S_OK;
+    }
+
+    virtual void SetFusedEffectSw(
+        __in_opt CMilEffectDuce *pOuterEffect
+        )
+    {
+        Assert(pOuterEffect == NULL);
+    }
+
     virtual byte GetShaderMajorVersion()
     {
         //
@@ -16,6 +16,7 @@
 
 MtDefine(ShaderEffectResource, MILRender, "ShaderEffect Resource");
 MtDefine(CMilShaderEffectDuce, ShaderEffectResource, "CMilShaderEffectDuce");
+MtDefine(CMilShaderEffectDuceFusedCompiler, ShaderEffectResource, "CMilShaderEffectDuceFusedCompiler");
 
 unsigned g_uBlank = 0x00000000;
 
@@ -30,6 +31,7 @@ WarpPlatform::LockHandle g_LockJitterAccess;
 CMilShaderEffectDuce::~CMilShaderEffectDuce()
 {
     ReleaseInterface(m_pSwShaderEffectBrush);
+    ReleaseInterface(m_pFusedSwPixelShaderCompiler);
 
     FreeSamplerData();
 
@@ -1033,23 +1035,7 @@ CMilShaderEffectDuce::PrepareSoftwarePass(
     HRESULT hr = S_OK;
     IWGXBitmapLock *pSwTextureLock = NULL;
 
-    // Floating point values
-    float *pFloatValues  = m_data.m_pDependencyPropertyFloatValuesData;
-    UINT registerCount = m_data.m_cbShaderConstantFloatRegistersSize / sizeof(short);
-    const short *pRegisterIndices = m_data.m_pShaderConstantFloatRegistersData;
-
-    for (UINT i = 0; i < registerCount; i++)
-    {
-        UINT registerIndex = pRegisterIndices[i];
-        if (registerIndex >= PIXELSHADER_CONSTANTS_MAX)
-        {
-            IFC(E_INVALIDARG);
-        }
-        
-        float* pRegister = pPixelShaderState->m_rgShaderConstants[registerIndex];
-        CopyMemory(pRegister, pFloatValues, sizeof(float) * 4);
-        pFloatValues += 4;
-    }
+    IFC(SetShaderConstantsSw(pPixelShaderState));
 
     //
     // Configure sampler state
@@ -1191,7 +1177,23 @@ CMilShaderEffectDuce::PrepareSoftwarePass(
     //
 
 
-    if (m_data.m_pPixelShader != NULL)
+    if (m_pFusedEffectSwNoRef != NULL)
+    {
+        //
+        // Run the fused pair. The outer effect only needs its constants:
+        // its implicit input is this effect's output, which the fused code
+        // passes on directly, and it does not use ddx/ddy.
+        //
+
+        Assert(m_pFusedSwPixelShaderCompiler != NULL);
+        Assert(pPixelShaderState->m_pFusedShaderState != NULL);
+
+        IFC(m_pFusedEffectSwNoRef->SetShaderConstantsSw(pPixelShaderState->m_pFusedShaderState));
+
+        *ppPixelShaderCompiler = m_pFusedSwPixelShaderCompiler;
+        m_pFusedSwPixelShaderCompiler->AddRef();
+    }
+    else if (m_data.m_pPixelShader != NULL)
     {
         IFC(m_data.m_pPixelShader->GetSwPixelShader(ppPixelShaderCompiler));
     }
@@ -1207,6 +1209,201 @@ Cleanup:
 }
 
 
+//-----------------------------------------------------------------------------
+//
+// CMilShaderEffectDuce::SetShaderConstantsSw
+//
+// Description: Copies the values of the float shader constants into the
+//      pixel shader state.
+//  
+//-----------------------------------------------------------------------------
+
+HRESULT
+CMilShaderEffectDuce::SetShaderConstantsSw(
+    __inout CPixelShaderState *pPixelShaderState
+    )
+{
+    HRESULT hr = S_OK;
+
+    // Floating point values
+    float *pFloatValues  = m_data.m_pDependencyPropertyFloatValuesData;
+    UINT registerCount = m_data.m_cbShaderConstantFloatRegistersSize / sizeof(short);
+    const short *pRegisterIndices = m_data.m_pShaderConstantFloatRegistersData;
+
+    for (UINT i = 0; i < registerCount; i++)
+    {
+        UINT registerIndex = pRegisterIndices[i];
+        if (registerIndex >= PIXELSHADER_CONSTANTS_MAX)
+        {
+            IFC(E_INVALIDARG);
+        }
+        
+        float* pRegister = pPixelShaderState->m_rgShaderConstants[registerIndex];
+        CopyMemory(pRegister, pFloatValues, sizeof(float) * 4);
+        pFloatValues += 4;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilShaderEffectDuce::GetPointwiseSwPixelShader
+//
+// Description: Returns the software pixel shader if this effect can be the
+//      outer effect of a fused pair, NULL otherwise. That requires the
+//      effect to:
+//
+//      - read nothing but its implicit input, through sampler 0, and only
+//        at each pixel's own position (CPixelShaderCompiler::IsPointwise)
+//      - have no padding, so that its bounds are those of its input
+//      - map a transparent input to transparent, with its current
+//        constants. Pixels outside of the inner effect's output are
+//        transparent in the intermediate that fusion removes, and are not
+//        drawn at all when fused.
+//  
+//-----------------------------------------------------------------------------
+
+HRESULT
+CMilShaderEffectDuce::GetPointwiseSwPixelShader(
+    __deref_out_opt CPixelShaderCompiler **ppPixelShaderCompiler
+    )
+{
+    HRESULT hr = S_OK;
+    CPixelShaderCompiler *pPixelShaderCompiler = NULL;
+
+    *ppPixelShaderCompiler = NULL;
+
+    if (   m_data.m_pPixelShader == NULL
+        || m_samplerDataCount != 1
+        || m_pSamplerData[0].GetSamplerRegister() != 0
+        || m_pSamplerData[0].GetBrushNoRef() == NULL
+        || !m_pSamplerData[0].GetBrushNoRef()->IsOfType(TYPE_IMPLICITINPUTBRUSH)
+        || m_data.m_TopPadding != 0
+        || m_data.m_LeftPadding != 0
+        || m_data.m_BottomPadding != 0
+        || m_data.m_RightPadding != 0
+        || (   m_data.m_DdxUvDdyUvRegisterIndex >= 0
+            && m_data.m_DdxUvDdyUvRegisterIndex < PIXELSHADER_CONSTANTS_MAX))
+    {
+        goto Cleanup;
+    }
+
+    IFC(m_data.m_pPixelShader->GetSwPixelShader(&pPixelShaderCompiler));
+
+    if (pPixelShaderCompiler->IsPointwise())
+    {
+        CPixelShaderState pixelShaderState;
+        GenerateColorsEffectParams params;
+        unsigned uBlank = 0;
+        unsigned uOutput = 0xffffffff;
+
+        IFC(SetShaderConstantsSw(&pixelShaderState));
+        pixelShaderState.m_samplers[0].m_pargbSource = &uBlank;
+
+        params.pPixelShaderState = &pixelShaderState;
+        params.nX = 0;
+        params.nY = 0;
+        params.nCount = 1;
+        params.pPargbBuffer = &uOutput;
+
+        (*pPixelShaderCompiler->GetGenerateColorsFunction())(&params);
+
+        if (uOutput == 0)
+        {
+            *ppPixelShaderCompiler = pPixelShaderCompiler;
+            pPixelShaderCompiler = NULL;
+        }
+    }
+
+Cleanup:
+    ReleaseInterface(pPixelShaderCompiler);
+
+    RRETURN(hr);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilShaderEffectDuce::CanFuseWithOuterEffectSw
+//
+// Description: Checks whether this effect and pOuterEffect, which is
+//      applied to this effect's output, can be run in software as one
+//      fused pixel shader, and compiles the fused shader if so.
+//  
+//-----------------------------------------------------------------------------
+
+HRESULT
+CMilShaderEffectDuce::CanFuseWithOuterEffectSw(
+    __in CMilEffectDuce *pOuterEffect,
+    __out bool *pfCanFuse
+    )
+{
+    HRESULT hr = S_OK;
+    CPixelShaderCompiler *pInnerCompiler = NULL;
+    CPixelShaderCompiler *pOuterCompiler = NULL;
+
+    *pfCanFuse = false;
+
+    if (m_data.m_pPixelShader == NULL || !pOuterEffect->IsOfType(TYPE_SHADEREFFECT))
+    {
+        goto Cleanup;
+    }
+
+    IFC(static_cast<CMilShaderEffectDuce *>(pOuterEffect)->GetPointwiseSwPixelShader(&pOuterCompiler));
+
+    if (pOuterCompiler == NULL)
+    {
+        goto Cleanup;
+    }
+
+    IFC(m_data.m_pPixelShader->GetSwPixelShader(&pInnerCompiler));
+
+    //
+    // The fused compiler holds references to both shaders, so a shader that
+    // has been recompiled is never mistaken for the one it replaced.
+    //
+
+    if (   m_pFusedSwPixelShaderCompiler == NULL
+        || !m_pFusedSwPixelShaderCompiler->IsFusionOf(pInnerCompiler, pOuterCompiler))
+    {
+        // No meter heaps in the pixeljit code
+        MtSetDefault(Mt(CMilShaderEffectDuceFusedCompiler));
+
+        ReleaseInterface(m_pFusedSwPixelShaderCompiler);
+        IFC(CPixelShaderCompiler::CreateFused(pInnerCompiler, pOuterCompiler, &m_pFusedSwPixelShaderCompiler));
+    }
+
+    *pfCanFuse = true;
+
+Cleanup:
+    ReleaseInterface(pInnerCompiler);
+    ReleaseInterface(pOuterCompiler);
+
+    RRETURN(hr);
+}
+
+//-----------------------------------------------------------------------------
+//
+// CMilShaderEffectDuce::SetFusedEffectSw
+//
+// Description: Sets the effect that software passes of this effect are
+//      fused with, which CanFuseWithOuterEffectSw must have accepted.
+//      NULL ends the fusion.
+//  
+//-----------------------------------------------------------------------------
+
+void
+CMilShaderEffectDuce::SetFusedEffectSw(
+    __in_opt CMilEffectDuce *pOuterEffect
+    )
+{
+    Assert(pOuterEffect == NULL || m_pFusedSwPixelShaderCompiler != NULL);
+    Assert(pOuterEffect == NULL || pOuterEffect->IsOfType(TYPE_SHADEREFFECT));
+
+    m_pFusedEffectSwNoRef = static_cast<CMilShaderEffectDuce *>(pOuterEffect);
+}
+
 //-----------------------------------------------------------------------------
 //
 // CMilShaderEffectDuce::OnChanged
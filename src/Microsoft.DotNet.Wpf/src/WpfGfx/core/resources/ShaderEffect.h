@@ -114,6 +114,15 @@ public:
 
     override bool UsesImplicitInput();
 
+    override HRESULT CanFuseWithOuterEffectSw(
+        __in CMilEffectDuce *pOuterEffect,
+        __out bool *pfCanFuse
+        );
+
+    override void SetFusedEffectSw(
+        __in_opt CMilEffectDuce *pOuterEffect
+        );
+
     override byte GetShaderMajorVersion();
 
     static HRESULT InitializeJitterLock()
@@ -209,6 +218,14 @@ private:
         );
 
     void FreeSamplerData();
+
+    HRESULT SetShaderConstantsSw(
+        __inout CPixelShaderState *pPixelShaderState
+        );
+
+    HRESULT GetPointwiseSwPixelShader(
+        __deref_out_opt CPixelShaderCompiler **ppPixelShaderCompiler
+        );
     
 private:
 
@@ -290,6 +307,11 @@ private:
     CMILBrushShaderEffect *m_pSwShaderEffectBrush;
     float m_destinationWidthSw;
     float m_destinationHeightSw;
+
+    // Effect applied to the output of this one in software passes, and the
+    // compiler of the fused shader pair, see SetFusedEffectSw
+    CMilShaderEffectDuce *m_pFusedEffectSwNoRef;
+    CPixelShaderCompiler *m_pFusedSwPixelShaderCompiler;
 };
 
 
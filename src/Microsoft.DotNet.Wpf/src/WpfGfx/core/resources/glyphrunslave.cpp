@@ -23,6 +23,9 @@ MtDefine(GlyphBitmapBiLevel, CGlyphRunRealization, "Glyph bitmap allocation: BiL
 
 MtDefine(GlyphBlendingParameters, CDisplaySet, "GlyphBlendingParameters"); 
 
+// Glyph run alpha maps realized through DWrite glyph run analyses, see perf.h
+DeclarePerfAcc(Text_DWrite_RealizeAlphaMap);
+
 const double CGlyphRunResource::c_minAnimationDetectionBar = 0.9;
 
 #pragma warning ( default: 4700 )
@@ -44,11 +47,8 @@ const int CGlyphRunResource::c_scaleGridSize = 7;
 const float CGlyphRunResource::scaleGrid[c_scaleGridSize] = { 5.0f, 6.5f, 9.1f, 13.7f, 21.8f, 37.1f, 66.8f };
 
 
-CGlyphRunResource::CDWriteFontFaceCache::FontFaceCacheEntry CGlyphRunResource::CDWriteFontFaceCache::m_cache[c_cacheSize] = { 0 };
-
-UINT32 CGlyphRunResource::CDWriteFontFaceCache::m_cacheMRU = 0;
-
-LONG CGlyphRunResource::CDWriteFontFaceCache::m_mutex = 0;
+CGlyphRunResource::CDWriteFontFaceCache::Shard CGlyphRunResource::CDWriteFontFaceCache::m_shards[c_shardCount] = { 0 };
+volatile LONG CGlyphRunResource::CDWriteFontFaceCache::m_trimCount = 0;
 
 //+-----------------------------------------------------------------------------
 //
@@ -677,11 +677,35 @@ CGlyphRunResource::GetAvailableScale(
         IFC(CDisplaySet::CompileSettings(pDisplaySettings->pIDWriteRenderingParams, pDisplaySettings->PixelStructure, pRealization->GetAnalysisNoRef(), m_pGlyphBlendingParameters));
     }
 
+    m_pGlyphCache->RecordRealizationUse(pRealization->HasAlphaMaps());
+
     if (!pRealization->HasAlphaMaps())
     {
-        EnhancedContrastTable *pECT = NULL;
+        const EnhancedContrastTable *pECT = NULL;
         IFC(GetEnhancedContrastTable(m_pGlyphBlendingParameters->ContrastEnhanceFactor, &pECT));
-        IFC(pRealization->EnsureValidAlphaMap(pECT));
+
+        //
+        // The glyphs of a new high quality realization are rasterized on the
+        // thread pool while a realization at another scale stands in for it,
+        // the way animation quality realizations do during scale animations.
+        //
+        CGlyphRunRealization *pFallbackRealization = NULL;
+        if (   !pRealization->IsAnimationQuality()
+            && m_measuringMethod == DWRITE_MEASURING_MODE_NATURAL)
+        {
+            pFallbackRealization = FindFallbackRealizationNoRef(pRealization);
+        }
+
+        bool fPending;
+        IFC(EnsureAlphaMap(pRealization, pECT, pFallbackRealization != NULL, &fPending));
+
+        if (fPending)
+        {
+            IFC(m_pGlyphCache->RequestSubsequentPass(this));
+
+            ReplaceInterface(pRealization, pFallbackRealization);
+            pRealization->UpdateLastUsedFrame();
+        }
     }
 
     *pScaleX = pRealization->GetScaleX();
@@ -774,6 +798,267 @@ CGlyphRunResource::GetBlendMode(MilTextRenderingMode::Enum textRenderingMode,
 }
 
 
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphRunResource::EnsureAlphaMap
+//
+//  Synopsis:
+//      Gives pRealization its alpha map. Horizontal left to right runs are
+//      composed from the glyphs in the glyph atlas, so each glyph is
+//      rasterized and kept once for all the runs that use it. Their
+//      realizations only get the bounds of the run here; painters compose
+//      the run when they draw it, see ComposeAlphaMap. Animation quality
+//      realizations rely on a rotation to disable hinting, and are
+//      rasterized by DWrite as a whole, as are sideways and right to left
+//      runs.
+//
+//      With fAllowPending, glyphs missing from the atlas are rasterized on
+//      the thread pool, and *pfPending is set until they are done. The
+//      caller then needs to draw something else and ask for another pass.
+//
+//------------------------------------------------------------------------------
+HRESULT
+CGlyphRunResource::EnsureAlphaMap(
+    __in CGlyphRunRealization *pRealization,
+    __in_opt const EnhancedContrastTable *pECT,
+    bool fAllowPending,
+    __out bool *pfPending
+    )
+{
+    HRESULT hr = S_OK;
+    IDWriteFontFace *pIDWriteFontFace = NULL;
+
+    *pfPending = false;
+
+    if (pRealization->IsAnimationQuality() || IsSideways() || IsRightToLeft())
+    {
+        IFC(pRealization->EnsureValidAlphaMap(pECT));
+    }
+    else
+    {
+        CGlyphAtlas *pGlyphAtlas = m_pGlyphCache->GetGlyphAtlasNoRef();
+        CGlyphRasterizationJob *pJob = pRealization->GetRasterizationJobNoRef();
+
+        IFC(CDWriteFontFaceCache::GetFontFace(m_pIDWriteFont, &pIDWriteFontFace));
+
+        DWRITE_GLYPH_RUN glyphRun;
+        glyphRun.fontFace = pIDWriteFontFace;
+        glyphRun.fontEmSize = m_muSize;
+        glyphRun.glyphCount = m_usGlyphCount;
+        glyphRun.glyphIndices = m_pGlyphIndices;
+        glyphRun.glyphAdvances = m_pGlyphAdvances;
+        glyphRun.glyphOffsets = reinterpret_cast<const DWRITE_GLYPH_OFFSET *>(m_pGlyphOffsets);
+        glyphRun.bidiLevel = m_bidiLevel;
+        glyphRun.isSideways = FALSE;
+
+        if (pJob == NULL && fAllowPending)
+        {
+            IFC(pGlyphAtlas->BeginRasterization(
+                m_pIDWriteFont,
+                pIDWriteFontFace,
+                glyphRun,
+                pRealization->GetScaleX() / m_muSize,
+                pRealization->GetScaleY() / m_muSize,
+                pRealization->GetRenderingMode(),
+                m_measuringMethod,
+                m_pGlyphCache->GetCurrentRealizationFrame(),
+                &pJob
+                ));
+
+            pRealization->SetRasterizationJob(pJob);
+        }
+
+        if (pJob != NULL)
+        {
+            if (fAllowPending && !pJob->IsComplete())
+            {
+                *pfPending = true;
+                goto Cleanup;
+            }
+
+            pJob->Wait();
+        }
+
+        RECT boundingBox;
+        bool fIsBiLevelOnly;
+
+        hr = pGlyphAtlas->GetRunBounds(
+            m_pIDWriteFont,
+            pIDWriteFontFace,
+            glyphRun,
+            pRealization->GetScaleX() / m_muSize,
+            pRealization->GetScaleY() / m_muSize,
+            pRealization->GetRenderingMode(),
+            m_measuringMethod,
+            pJob,
+            m_pGlyphCache->GetCurrentRealizationFrame(),
+            &boundingBox,
+            &fIsBiLevelOnly
+            );
+
+        // The glyphs of the job are used up, or failed to rasterize
+        pRealization->SetRasterizationJob(NULL);
+        IFC(hr);
+
+        pRealization->SetComposedFromAtlas(boundingBox, fIsBiLevelOnly);
+    }
+
+Cleanup:
+    ReleaseInterface(pIDWriteFontFace);
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphRunResource::ComposeAlphaMap
+//
+//  Synopsis:
+//      Composes the alpha map of a realization composed from the glyph
+//      atlas into the run bitmap of pGlyphPainterMemory, for a painter to
+//      draw. The map stays valid until the run bitmap is used again.
+//
+//      originPosition moves the run origin right by that many quarters of a
+//      pixel, for the subpixel variants of HasSubpixelVariants, and is 0
+//      otherwise.
+//
+//------------------------------------------------------------------------------
+HRESULT
+CGlyphRunResource::ComposeAlphaMap(
+    __in CGlyphRunRealization *pRealization,
+    UINT originPosition,
+    __inout_ecount(1) CGlyphPainterMemory *pGlyphPainterMemory,
+    __deref_out_ecount_opt(*pAlphaMapSize) BYTE **ppAlphaMap,
+    __out UINT32 *pAlphaMapSize,
+    __out RECT *pBoundingBox
+    )
+{
+    HRESULT hr = S_OK;
+    IDWriteFontFace *pIDWriteFontFace = NULL;
+    const EnhancedContrastTable *pECT = NULL;
+
+    Assert(pRealization->IsComposedFromAtlas());
+    Assert(originPosition == 0 || HasSubpixelVariants(pRealization));
+
+    IFC(CDWriteFontFaceCache::GetFontFace(m_pIDWriteFont, &pIDWriteFontFace));
+    IFC(GetEnhancedContrastTable(m_pGlyphBlendingParameters->ContrastEnhanceFactor, &pECT));
+
+    {
+        DWRITE_GLYPH_RUN glyphRun;
+        glyphRun.fontFace = pIDWriteFontFace;
+        glyphRun.fontEmSize = m_muSize;
+        glyphRun.glyphCount = m_usGlyphCount;
+        glyphRun.glyphIndices = m_pGlyphIndices;
+        glyphRun.glyphAdvances = m_pGlyphAdvances;
+        glyphRun.glyphOffsets = reinterpret_cast<const DWRITE_GLYPH_OFFSET *>(m_pGlyphOffsets);
+        glyphRun.bidiLevel = m_bidiLevel;
+        glyphRun.isSideways = FALSE;
+
+        IFC(m_pGlyphCache->GetGlyphAtlasNoRef()->ComposeAlphaMap(
+            m_pIDWriteFont,
+            pIDWriteFontFace,
+            glyphRun,
+            pRealization->GetScaleX() / m_muSize,
+            pRealization->GetScaleY() / m_muSize,
+            pRealization->GetRenderingMode(),
+            m_measuringMethod,
+            pECT,
+            originPosition,
+            m_pGlyphCache->GetCurrentRealizationFrame(),
+            pGlyphPainterMemory,
+            ppAlphaMap,
+            pAlphaMapSize,
+            pBoundingBox
+            ));
+    }
+
+Cleanup:
+    ReleaseInterface(pIDWriteFontFace);
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphRunResource::HasSubpixelVariants
+//
+//  Synopsis:
+//      Returns true if painters may draw pRealization at a whole pixel with
+//      its origin moved by the fraction of a pixel the run is drawn at,
+//      rather than interpolating its alpha map. This is the case when the
+//      glyph cache has subpixel variants turned on and the realization is
+//      composed from the atlas at a rendering mode that positions glyphs at
+//      subpixels.
+//
+//------------------------------------------------------------------------------
+bool
+CGlyphRunResource::HasSubpixelVariants(
+    __in const CGlyphRunRealization *pRealization
+    ) const
+{
+    return    m_pGlyphCache->UseSubpixelVariants()
+           && pRealization->IsComposedFromAtlas()
+           && !pRealization->IsBiLevelOnly()
+           && m_measuringMethod == DWRITE_MEASURING_MODE_NATURAL
+           && (   pRealization->GetRenderingMode() == DWRITE_RENDERING_MODE_CLEARTYPE_NATURAL
+               || pRealization->GetRenderingMode() == DWRITE_RENDERING_MODE_CLEARTYPE_NATURAL_SYMMETRIC);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphRunResource::FindFallbackRealizationNoRef
+//
+//  Synopsis:
+//      Finds the realization with alpha maps whose scale is closest to the
+//      scale of pPendingRealization, to draw while its alpha map is being
+//      rasterized. Returns NULL if there is none.
+//
+//------------------------------------------------------------------------------
+CGlyphRunRealization *
+CGlyphRunResource::FindFallbackRealizationNoRef(
+    __in const CGlyphRunRealization *pPendingRealization
+    )
+{
+    const DynArrayIA <CGlyphRunRealization*, 2> *rgpRealizationArrays[] =
+    {
+        &m_prgHighQualityRealizationArray,
+        &m_prgAnimationQualityRealizationArray
+    };
+
+    CGlyphRunRealization *pFallbackRealization = NULL;
+    double bestQuality = 0.0;
+
+    for (UINT i = 0; i < ARRAY_SIZE(rgpRealizationArrays); i++)
+    {
+        const DynArrayIA <CGlyphRunRealization*, 2> *pRealizationArray = rgpRealizationArrays[i];
+
+        for (UINT j = 0; j < pRealizationArray->GetCount(); j++)
+        {
+            CGlyphRunRealization *pRealization = pRealizationArray->At(j);
+
+            if (pRealization != pPendingRealization && pRealization->HasAlphaMaps())
+            {
+                double quality = InspectScaleQuality(
+                    pRealization->GetScaleX(),
+                    pPendingRealization->GetScaleX(),
+                    pRealization->GetScaleY(),
+                    pPendingRealization->GetScaleY()
+                    );
+
+                if (pFallbackRealization == NULL || quality > bestQuality)
+                {
+                    pFallbackRealization = pRealization;
+                    bestQuality = quality;
+                }
+            }
+        }
+    }
+
+    return pFallbackRealization;
+}
+
 //============================================================================================================================
 
 HRESULT
@@ -887,7 +1172,7 @@ CGlyphRunResource::CreateRealization(
     pRealization = new CGlyphRunRealization(scaleX, scaleY, fAnimationQuality, m_pGlyphCache);
     IFCOOM(pRealization);
     pRealization->AddRef();    
-    pRealization->SetAnalysis(pIDWriteGlyphRunAnalysis);
+    pRealization->SetAnalysis(pIDWriteGlyphRunAnalysis, dwriteRenderingMode);
 
     DynArrayIA <CGlyphRunRealization*, 2> *pArrayToCreateIn = NULL;
     if (fBiLevelRequested)
@@ -1350,16 +1635,43 @@ CGlyphRunResource::EnsureGeometry()
         Assert(m_pIDWriteFont);
         IFC(CDWriteFontFaceCache::GetFontFace(m_pIDWriteFont, &pIDWriteFontFace));
 
-        IFC(pIDWriteFontFace->GetGlyphRunOutline(
-            m_muSize,
-            m_pGlyphIndices,
-            m_pGlyphAdvances,
-            pGlyphOffsets,
-            m_usGlyphCount,
-            !!IsSideways(),
-            !!IsRightToLeft(),
-            pGeometrySink
-            ));
+        if (IsSideways())
+        {
+            IFC(pIDWriteFontFace->GetGlyphRunOutline(
+                m_muSize,
+                m_pGlyphIndices,
+                m_pGlyphAdvances,
+                pGlyphOffsets,
+                m_usGlyphCount,
+                TRUE,
+                !!IsRightToLeft(),
+                pGeometrySink
+                ));
+        }
+        else
+        {
+            //
+            // Build the outline from the cached outlines of the glyphs, so
+            // that glyphs shared with other runs are only extracted once
+            //
+            DWRITE_GLYPH_RUN glyphRun;
+            glyphRun.fontFace = pIDWriteFontFace;
+            glyphRun.fontEmSize = m_muSize;
+            glyphRun.glyphCount = m_usGlyphCount;
+            glyphRun.glyphIndices = m_pGlyphIndices;
+            glyphRun.glyphAdvances = m_pGlyphAdvances;
+            glyphRun.glyphOffsets = pGlyphOffsets;
+            glyphRun.bidiLevel = m_bidiLevel;
+            glyphRun.isSideways = FALSE;
+
+            IFC(m_pGlyphCache->GetGlyphOutlineCacheNoRef()->GetGlyphRunOutline(
+                m_pIDWriteFont,
+                pIDWriteFontFace,
+                glyphRun,
+                m_pGlyphCache->GetCurrentRealizationFrame(),
+                pGeometrySink
+                ));
+        }
 
         // We now own the reference to the CMilGeometryDuce.
         IFC(pGeometrySink->ProduceGeometry(&m_origin, &m_pGeometry));
@@ -1420,7 +1732,7 @@ Cleanup:
 //------------------------------------------------------------------------------
 HRESULT 
 CGlyphRunResource::GetEnhancedContrastTable(float k, 
-                                            __deref_out_ecount(1) EnhancedContrastTable **ppTable)
+                                            __deref_out_ecount(1) EnhancedContrastTable const** ppTable)
 {
     HRESULT hr = S_OK; 
     *ppTable = NULL;
@@ -1552,13 +1864,16 @@ CGlyphRunRealization::CGlyphRunRealization(
 //------------------------------------------------------------------------------
 void
 CGlyphRunRealization::SetAnalysis(
-    __in IDWriteGlyphRunAnalysis *pIDWriteGlyphRunAnalysis
+    __in IDWriteGlyphRunAnalysis *pIDWriteGlyphRunAnalysis,
+    DWRITE_RENDERING_MODE renderingMode
     )
 {
     Assert(m_pIDWriteGlyphRunAnalysis == NULL);
     
     m_pIDWriteGlyphRunAnalysis = pIDWriteGlyphRunAnalysis;
     pIDWriteGlyphRunAnalysis->AddRef();
+
+    m_renderingMode = renderingMode;
 }
 
 //+-----------------------------------------------------------------------------
@@ -1572,6 +1887,9 @@ CGlyphRunRealization::SetAnalysis(
 //------------------------------------------------------------------------------
 CGlyphRunRealization::~CGlyphRunRealization()
 {
+    // Waits for the thread pool to be done with the glyphs
+    delete m_pRasterizationJob;
+
     DeleteAlphaMap();
 
     delete m_pSWGlyphRun;
@@ -1683,14 +2001,16 @@ CGlyphRunRealization::EnsureValidAlphaMap(__in const EnhancedContrastTable *pECT
 
     if (!m_fHasAlphaMaps)
     {        
+        MeasurePerf(Text_DWrite_RealizeAlphaMap, 1);
+
         FreAssert(m_pIDWriteGlyphRunAnalysis != NULL);
 
         UINT32 clearTypeTextureSize = 0, biLevelTextureSize = 0;
         RECT clearTypeAlphaMapBoundingBox = {0}, biLevelAlphaMapBoundingBox = {0};
         BYTE *pClearTypeAlphaMap = NULL, *pBiLevelAlphaMap = NULL;
 
-        IFC(RealizeAlphaBoundsAndTextures(DWRITE_TEXTURE_CLEARTYPE_3x1, pECT, &clearTypeTextureSize, &clearTypeAlphaMapBoundingBox, &pClearTypeAlphaMap));
-        IFC(RealizeAlphaBoundsAndTextures(DWRITE_TEXTURE_ALIASED_1x1, NULL, &biLevelTextureSize, &biLevelAlphaMapBoundingBox, &pBiLevelAlphaMap));
+        IFC(RealizeAlphaBoundsAndTextures(m_pIDWriteGlyphRunAnalysis, DWRITE_TEXTURE_CLEARTYPE_3x1, pECT, &clearTypeTextureSize, &clearTypeAlphaMapBoundingBox, &pClearTypeAlphaMap));
+        IFC(RealizeAlphaBoundsAndTextures(m_pIDWriteGlyphRunAnalysis, DWRITE_TEXTURE_ALIASED_1x1, NULL, &biLevelTextureSize, &biLevelAlphaMapBoundingBox, &pBiLevelAlphaMap));
 
         m_fHasAlphaMaps = true;
         m_fIsBiLevelOnly = IsRectEmpty(clearTypeAlphaMapBoundingBox) && !IsRectEmpty(biLevelAlphaMapBoundingBox);        
@@ -1795,6 +2115,36 @@ Cleanup:
     RRETURN(hr);
 }   
 
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CGlyphRunRealization::SetComposedFromAtlas
+//
+//  Synopsis:
+//      Marks the realization as composed from the glyph atlas, with the
+//      bounds of the alpha map painters compose for it. It takes no room
+//      in the glyph cache budget, the glyphs are counted by the atlas.
+//
+//------------------------------------------------------------------------------
+void
+CGlyphRunRealization::SetComposedFromAtlas(
+    __in_ecount(1) const RECT &boundingBox,
+    bool fIsBiLevelOnly
+    )
+{
+    Assert(!m_fHasAlphaMaps);
+    Assert(m_pAlphaMap == NULL);
+
+    m_textureSize = 0;
+    m_alphaMapBoundingBox = boundingBox;
+
+    m_fHasAlphaMaps = true;
+    m_fIsBiLevelOnly = fIsBiLevelOnly;
+    m_fIsComposedFromAtlas = true;
+
+    m_pGlyphCacheNoRef->AddRealization(this, m_textureSize);
+}
+
 //+-----------------------------------------------------------------------------
 //
 // Deletes alpha map bitmaps, removes them from the CMilSlaveGlyphCache realization
@@ -1817,6 +2167,7 @@ CGlyphRunRealization::DeleteAlphaMap()
         m_pGlyphCacheNoRef->RemoveRealization(this, GetTextureSize());
         m_textureSize = 0;
          m_fHasAlphaMaps = false;
+        m_fIsComposedFromAtlas = false;
 
         if (m_pSWGlyphRun)
         {
@@ -1841,11 +2192,13 @@ CGlyphRunRealization::DeleteAlphaMap()
 //      CGlyphRunRealization::RealizeAlphaBoundsAndTextures
 //
 //  Synopsis:
-//      Gets an alpha map for a particular texture type
+//      Gets an alpha map for a particular texture type of pAnalysis, with
+//      3 bytes per pixel and bounds in subpixels horizontally
 //
 //------------------------------------------------------------------------------
 HRESULT
 CGlyphRunRealization::RealizeAlphaBoundsAndTextures(
+    __in IDWriteGlyphRunAnalysis *pAnalysis,
     DWRITE_TEXTURE_TYPE textureType, 
     __in_opt const EnhancedContrastTable *pECT,
     __out UINT32 *pTextureSize,
@@ -1857,7 +2210,7 @@ CGlyphRunRealization::RealizeAlphaBoundsAndTextures(
     RECT boundingBox;
     BYTE *pAlphaValues = NULL;
     
-    IFC(m_pIDWriteGlyphRunAnalysis->GetAlphaTextureBounds(
+    IFC(pAnalysis->GetAlphaTextureBounds(
         textureType,
         &boundingBox
         ));
@@ -1889,7 +2242,7 @@ CGlyphRunRealization::RealizeAlphaBoundsAndTextures(
         TraceTagText((tagError, "CGlyphRunRealization::RealizeAlphaBoundsAndTextures, allocated bytes: %d", textureSize));
         IFCOOM(pAlphaValues);
 
-        IFC(m_pIDWriteGlyphRunAnalysis->CreateAlphaTexture(
+        IFC(pAnalysis->CreateAlphaTexture(
             textureType,
             &boundingBox,
             pAlphaValues,
@@ -1922,6 +2275,7 @@ CGlyphRunRealization::RealizeAlphaBoundsAndTextures(
                                                      Mt(GlyphBitmapBiLevel),
                                                      textureSize * 3);
             TraceTagText((tagError, "CGlyphRunRealization::RealizeAlphaBoundsAndTextures, allocated bytes: %d", textureSize * 3));
+            IFCOOM(pNewAlphaValues);
             
             for (UINT i = 0; i < textureSize; i++)
             {
@@ -1968,35 +2322,38 @@ HRESULT CGlyphRunResource::CDWriteFontFaceCache::GetFontFace(
     )
 {
     HRESULT hr = S_OK;
+    Shard *pShard = GetShard(pFont);
 
     *ppFontFace = NULL;
 
-    if (InterlockedIncrement(&m_mutex) == 1)
+    EnterShard(pShard);
+
+    for (UINT32 i = 0; i < c_entriesPerShard; i++)
     {
-        // Try the fast path first -- is caller accessing exactly the mru entry?
-        if (m_cache[m_cacheMRU].pFont == pFont)
-        {
-            m_cache[m_cacheMRU].pFontFace->AddRef();
-            *ppFontFace = m_cache[m_cacheMRU].pFontFace;
-        }
-        else
+        FontFaceCacheEntry &entry = pShard->entries[i];
+
+        if (entry.pFont == pFont)
         {
-            // No luck, do a search through the cache.
-            for (UINT32 i=0; i < c_cacheSize; i++)
-            {
-                if (m_cache[i].pFont == pFont)
-                {
-                    m_cache[i].pFontFace->AddRef();
-                    *ppFontFace = m_cache[i].pFontFace;
-                    m_cacheMRU = i;
-                    break;
-                }
-            }
+            entry.pFontFace->AddRef();
+            *ppFontFace = entry.pFontFace;
+            entry.lastUsed = ++pShard->useCount;
+            entry.lastTrim = static_cast<UINT32>(m_trimCount);
+            break;
         }
     }
-    InterlockedDecrement(&m_mutex);
 
-    // If the cache was busy or did not contain this Font, create a new FontFace.
+    if (*ppFontFace != NULL)
+    {
+        pShard->cHits++;
+    }
+    else
+    {
+        pShard->cMisses++;
+    }
+
+    LeaveShard(pShard);
+
+    // If the cache did not contain this Font, create a new FontFace.
     if (NULL == *ppFontFace)
     {
         IFC(AddFontFaceToCache(pFont, ppFontFace));
@@ -2017,18 +2374,105 @@ Cleanup:
 //------------------------------------------------------------------------------
 void CGlyphRunResource::CDWriteFontFaceCache::Reset()
 {
-    // NB: If the cache is busy, we do nothing.
-    if (InterlockedIncrement(&m_mutex) == 1)
+    for (UINT32 iShard = 0; iShard < c_shardCount; iShard++)
     {
-        for (UINT32 i=0; i < c_cacheSize; i++)
+        Shard *pShard = &m_shards[iShard];
+        FontFaceCacheEntry rgReleased[c_entriesPerShard];
+
+        // Take the entries out under the lock, release them outside of it
+        EnterShard(pShard);
+
+        for (UINT32 i = 0; i < c_entriesPerShard; i++)
+        {
+            rgReleased[i] = pShard->entries[i];
+            pShard->entries[i].pFont = NULL;
+            pShard->entries[i].pFontFace = NULL;
+        }
+
+        pShard->useCount = 0;
+
+        LeaveShard(pShard);
+
+        for (UINT32 i = 0; i < c_entriesPerShard; i++)
+        {
+            ReleaseInterface(rgReleased[i].pFont);
+            ReleaseInterface(rgReleased[i].pFontFace);
+        }
+    }
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CDWriteFontFaceCache::Trim
+//
+//  Synopsis:
+//      Releases the entries that were not used during the last
+//      c_trimsBeforeRelease calls. Called by each composition's glyph cache
+//      once per frame.
+//
+//------------------------------------------------------------------------------
+void CGlyphRunResource::CDWriteFontFaceCache::Trim()
+{
+    UINT32 trimCount = static_cast<UINT32>(InterlockedIncrement(&m_trimCount));
+
+    for (UINT32 iShard = 0; iShard < c_shardCount; iShard++)
+    {
+        Shard *pShard = &m_shards[iShard];
+        FontFaceCacheEntry rgReleased[c_entriesPerShard] = { 0 };
+
+        // Take the entries out under the lock, release them outside of it
+        EnterShard(pShard);
+
+        for (UINT32 i = 0; i < c_entriesPerShard; i++)
+        {
+            FontFaceCacheEntry &entry = pShard->entries[i];
+
+            if (entry.pFont != NULL && trimCount - entry.lastTrim > c_trimsBeforeRelease)
+            {
+                rgReleased[i] = entry;
+                entry.pFont = NULL;
+                entry.pFontFace = NULL;
+            }
+        }
+
+        LeaveShard(pShard);
+
+        for (UINT32 i = 0; i < c_entriesPerShard; i++)
         {
-            ReleaseInterface(m_cache[i].pFont);
-            ReleaseInterface(m_cache[i].pFontFace);
+            ReleaseInterface(rgReleased[i].pFont);
+            ReleaseInterface(rgReleased[i].pFontFace);
         }
+    }
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CDWriteFontFaceCache::GetStatistics
+//
+//  Synopsis:
+//      Number of GetFontFace calls since the process started that found their
+//      font face in the cache, and that had to create it.
+//
+//------------------------------------------------------------------------------
+void CGlyphRunResource::CDWriteFontFaceCache::GetStatistics(
+    __out UINT *pcHits,
+    __out UINT *pcMisses
+    )
+{
+    UINT cHits = 0;
+    UINT cMisses = 0;
 
-        m_cacheMRU = 0;
+    // Racy reads are fine for statistics
+    for (UINT32 iShard = 0; iShard < c_shardCount; iShard++)
+    {
+        cHits += m_shards[iShard].cHits;
+        cMisses += m_shards[iShard].cMisses;
     }
-    InterlockedDecrement(&m_mutex);
+
+    *pcHits = cHits;
+    *pcMisses = cMisses;
 }
 
 //+-----------------------------------------------------------------------------
@@ -2037,7 +2481,8 @@ void CGlyphRunResource::CDWriteFontFaceCache::Reset()
 //      CDWriteFontFaceCache::AddFontFaceToCache
 //
 //  Synopsis:
-//      Adds a new IDWriteFontFace to the cache, discarding an older entry if necessary.
+//      Adds a new IDWriteFontFace to the cache, discarding the least recently
+//      used entry of its shard if necessary.
 //
 //------------------------------------------------------------------------------
 HRESULT CGlyphRunResource::CDWriteFontFaceCache::AddFontFaceToCache(
@@ -2046,38 +2491,112 @@ HRESULT CGlyphRunResource::CDWriteFontFaceCache::AddFontFaceToCache(
     )
 {
     HRESULT hr = S_OK;
+    Shard *pShard = GetShard(pFont);
+    FontFaceCacheEntry released = { NULL, NULL, 0, 0 };
 
     IFC(pFont->CreateFontFace(ppFontFace));
 
-    // NB: if the cache is busy, we simply return the new FontFace
-    // without bothering to cache it.
-    if (InterlockedIncrement(&m_mutex) == 1)
+    EnterShard(pShard);
+
     {
-        // Default to a slot that is not the MRU.
-        m_cacheMRU = (m_cacheMRU + 1) % c_cacheSize;
+        UINT32 iSlot = 0;
 
-        // Look for an empty slot.
-        for (UINT32 i=0; i < c_cacheSize; i++)
+        for (UINT32 i = 0; i < c_entriesPerShard; i++)
         {
-            if (NULL == m_cache[i].pFont)
+            FontFaceCacheEntry &entry = pShard->entries[i];
+
+            if (entry.pFont == pFont)
             {
-                m_cacheMRU = i;
+                // Another thread added this font meanwhile, keep its face
+                iSlot = UINT_MAX;
                 break;
             }
+
+            // Prefer an empty slot, then the least recently used one
+            if (   pShard->entries[iSlot].pFont != NULL
+                && (   entry.pFont == NULL
+                    || entry.lastUsed < pShard->entries[iSlot].lastUsed))
+            {
+                iSlot = i;
+            }
         }
 
-        ReleaseInterface(m_cache[m_cacheMRU].pFont);
-        ReleaseInterface(m_cache[m_cacheMRU].pFontFace);
+        if (iSlot != UINT_MAX)
+        {
+            FontFaceCacheEntry &entry = pShard->entries[iSlot];
+
+            released = entry;
 
-        pFont->AddRef();
-        m_cache[m_cacheMRU].pFont = pFont;
-        (*ppFontFace)->AddRef();
-        m_cache[m_cacheMRU].pFontFace = *ppFontFace;
+            pFont->AddRef();
+            entry.pFont = pFont;
+            (*ppFontFace)->AddRef();
+            entry.pFontFace = *ppFontFace;
+            entry.lastUsed = ++pShard->useCount;
+            entry.lastTrim = static_cast<UINT32>(m_trimCount);
+        }
     }
-    InterlockedDecrement(&m_mutex);
+
+    LeaveShard(pShard);
+
+    ReleaseInterface(released.pFont);
+    ReleaseInterface(released.pFontFace);
 
 Cleanup:
     RRETURN(hr);
 }
 
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CDWriteFontFaceCache::GetShard
+//
+//  Returns:
+//      The shard that caches the face of pFont.
+//
+//------------------------------------------------------------------------------
+__out CGlyphRunResource::CDWriteFontFaceCache::Shard *
+CGlyphRunResource::CDWriteFontFaceCache::GetShard(
+    __in IDWriteFont *pFont
+    )
+{
+    // Fonts are heap allocated, so the low bits of their address carry no
+    // information. Fibonacci hashing mixes the rest into the top bits.
+    UINT32 hash = static_cast<UINT32>(reinterpret_cast<UINT_PTR>(pFont) >> 4) * 0x9E3779B9u;
+
+    return &m_shards[hash >> (32 - c_shardBits)];
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CDWriteFontFaceCache::EnterShard
+//
+//  Synopsis:
+//      Takes the lock of a shard. It is only held for a few instructions, so
+//      waiting threads spin.
+//
+//------------------------------------------------------------------------------
+void CGlyphRunResource::CDWriteFontFaceCache::EnterShard(
+    __inout Shard *pShard
+    )
+{
+    while (InterlockedCompareExchange(&pShard->lock, 1, 0) != 0)
+    {
+        YieldProcessor();
+    }
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CDWriteFontFaceCache::LeaveShard
+//
+//------------------------------------------------------------------------------
+void CGlyphRunResource::CDWriteFontFaceCache::LeaveShard(
+    __inout Shard *pShard
+    )
+{
+    InterlockedExchange(&pShard->lock, 0);
+}
+
 
@@ -117,7 +117,20 @@ public:
                           __deref_out_ecount(1) GammaTable const* * ppGammaTable);
     
     HRESULT GetEnhancedContrastTable(float k, 
-                                     __deref_out_ecount(1) EnhancedContrastTable **ppTable);
+                                     __deref_out_ecount(1) EnhancedContrastTable const** ppTable);
+
+    HRESULT ComposeAlphaMap(
+        __in CGlyphRunRealization *pRealization,
+        UINT originPosition,
+        __inout_ecount(1) CGlyphPainterMemory *pGlyphPainterMemory,
+        __deref_out_ecount_opt(*pAlphaMapSize) BYTE **ppAlphaMap,
+        __out UINT32 *pAlphaMapSize,
+        __out RECT *pBoundingBox
+        );
+
+    bool HasSubpixelVariants(
+        __in const CGlyphRunRealization *pRealization
+        ) const;
 
     // ------------------------------------------------------------------------
     //
@@ -156,6 +169,17 @@ private:
         __out CGlyphRunRealization **ppRealization
         );
 
+    HRESULT EnsureAlphaMap(
+        __in CGlyphRunRealization *pRealization,
+        __in_opt const EnhancedContrastTable *pECT,
+        bool fAllowPending,
+        __out bool *pfPending
+        );
+
+    CGlyphRunRealization *FindFallbackRealizationNoRef(
+        __in const CGlyphRunRealization *pPendingRealization
+        );
+
     static void DeleteRealizationInArray(__in DynArrayIA <CGlyphRunRealization*, 2> *pArray);
 
     void PurgeOldEntries(__in DynArrayIA <CGlyphRunRealization*, 2> *pRealizationArray);
@@ -203,11 +227,28 @@ private:
     //  The cache prevents us from exhausting available address space as each
     //  IDWriteFontFace typically maps in its corresponding file.
     //
+    //  Fonts hash to one of c_shardCount shards, each with its own lock and
+    //  c_entriesPerShard entries, so that threads resolving different fonts
+    //  rarely wait for each other.
+    //
+    //  Faces no glyph run asked for during c_trimsBeforeRelease trims are
+    //  released, see TrimFontFaceCache.
+    //
     // ------------------------------------------------------------------------
 
 public:
     static void ResetFontFaceCache() { CDWriteFontFaceCache::Reset(); }
 
+    static void TrimFontFaceCache() { CDWriteFontFaceCache::Trim(); }
+
+    static void GetFontFaceCacheStatistics(
+        __out UINT *pcHits,
+        __out UINT *pcMisses
+        )
+    {
+        CDWriteFontFaceCache::GetStatistics(pcHits, pcMisses);
+    }
+
 private:
     class CDWriteFontFaceCache
     {
@@ -220,33 +261,74 @@ private:
 
         static void Reset();
 
+        static void Trim();
+
+        static void GetStatistics(
+            __out UINT *pcHits,
+            __out UINT *pcMisses
+            );
+
     private:
 
+        struct Shard;
+
         static HRESULT AddFontFaceToCache(
             __in IDWriteFont *pFont,
             __out IDWriteFontFace **ppFontFace
             );
 
+        static __out Shard *GetShard(__in IDWriteFont *pFont);
+
+        static void EnterShard(__inout Shard *pShard);
+        static void LeaveShard(__inout Shard *pShard);
+
         struct FontFaceCacheEntry
         {
             IDWriteFont *pFont;
             IDWriteFontFace *pFontFace;
+
+            // Value of the shard's use count when the entry was last used
+            UINT32 lastUsed;
+
+            // Value of m_trimCount when the entry was last used
+            UINT32 lastTrim;
         };
 
-        // A good cache size based upon measurements of the TextFormatter micro benchmarks
-        // is 4. None of the tests allocate more than 3 IDWriteFontFaces on the render thread.
-        // However, dwrite circa win7 has an issue aggressively consuming address space and
-        // therefore we need to be conservative holding on to font references.
-        static const UINT32 c_cacheSize = 1;
+        // DWrite circa win7 has an issue aggressively consuming address space
+        // and therefore we need to be conservative holding on to font
+        // references. The cache only holds them while glyph runs exist and
+        // while they are in use. A 32 bit process holds at most 8 faces, a
+        // 64 bit one, with address space to spare, 32.
+        static const UINT32 c_shardBits = 3;
+        static const UINT32 c_shardCount = 1 << c_shardBits;
+#if defined(_WIN64)
+        static const UINT32 c_entriesPerShard = 4;
+#else
+        static const UINT32 c_entriesPerShard = 1;
+#endif
+
+        // About the frame delay of the glyph cache's bitmap trimming
+        static const UINT32 c_trimsBeforeRelease = 100;
+
+        // Shards are cache line aligned so that their locks do not share a line
+        struct DECLSPEC_ALIGN(64) Shard
+        {
+            // Guards the rest of the shard, non zero while held
+            volatile LONG lock;
+
+            UINT32 useCount;
 
-        // Cached IDwriteFontFace instances.
-        static FontFaceCacheEntry m_cache[c_cacheSize];
+            UINT cHits;
+            UINT cMisses;
+
+            // Cached IDwriteFontFace instances.
+            FontFaceCacheEntry entries[c_entriesPerShard];
+        };
 
-        // Most recently used element in the FontFace cache.
-        static UINT32 m_cacheMRU;
+        static Shard m_shards[c_shardCount];
 
-        // Guards access to m_cache.
-        static LONG m_mutex;
+        // Number of Trim calls since the process started
+        static volatile LONG m_trimCount;
     };
 
 private:
@@ -317,7 +399,10 @@ public:
                          );
     virtual ~CGlyphRunRealization();
 
-    void SetAnalysis(__in IDWriteGlyphRunAnalysis *pIDWriteGlyphRunAnalysis);
+    void SetAnalysis(
+        __in IDWriteGlyphRunAnalysis *pIDWriteGlyphRunAnalysis,
+        DWRITE_RENDERING_MODE renderingMode
+        );
 
     float GetScaleX() const { return m_scaleX; }
     float GetScaleY() const { return m_scaleY; }
@@ -380,11 +465,25 @@ public:
     }
 
     HRESULT EnsureValidAlphaMap(__in const EnhancedContrastTable *pECT);
+    void SetComposedFromAtlas(
+        __in_ecount(1) const RECT &boundingBox,
+        bool fIsBiLevelOnly
+        );
     bool HasAlphaMaps()
     {
         return m_fHasAlphaMaps;
     }
 
+    //
+    // Realizations composed from the glyph atlas keep no alpha map.
+    // Painters compose it when they draw, see
+    // CGlyphRunResource::ComposeAlphaMap.
+    //
+    bool IsComposedFromAtlas() const
+    {
+        return m_fIsComposedFromAtlas;
+    }
+
     void DeleteAlphaMap();
 
     void GetAlphaMap(
@@ -394,6 +493,7 @@ public:
         )
     {        
         Assert(m_fHasAlphaMaps);
+        Assert(!m_fIsComposedFromAtlas);
         *ppAlphaMap = m_pAlphaMap;
         *pBoundingBox = m_alphaMapBoundingBox;
         *pAlphaMapSize = m_textureSize;
@@ -414,8 +514,29 @@ public:
         return m_pIDWriteGlyphRunAnalysis;
     }
 
-private:
-     HRESULT RealizeAlphaBoundsAndTextures(  
+    DWRITE_RENDERING_MODE GetRenderingMode() const
+    {
+        return m_renderingMode;
+    }
+
+    CGlyphRasterizationJob *GetRasterizationJobNoRef() const
+    {
+        return m_pRasterizationJob;
+    }
+
+    // Takes ownership of pJob, deleting the previous job if any
+    void SetRasterizationJob(__in_opt CGlyphRasterizationJob *pJob)
+    {
+        delete m_pRasterizationJob;
+        m_pRasterizationJob = pJob;
+    }
+
+    //
+    // Also used by CGlyphAtlas for the analyses of single glyphs, so that
+    // its maps have the same format as those of realizations
+    //
+    static HRESULT RealizeAlphaBoundsAndTextures(
+        __in IDWriteGlyphRunAnalysis *pAnalysis,
         DWRITE_TEXTURE_TYPE textureType, 
         __in_opt const EnhancedContrastTable *pECT,
         __out UINT32 *pTextureSize,
@@ -423,8 +544,11 @@ private:
         __deref_out_ecount_opt(*pTextureSize) BYTE **pAlphaMap
         );
 
+private:
+
     float m_scaleX, m_scaleY;
     IDWriteGlyphRunAnalysis *m_pIDWriteGlyphRunAnalysis;
+    DWRITE_RENDERING_MODE m_renderingMode;
 
     //
     // If this glyph run has m_fIsAnimationQuality set, these
@@ -456,7 +580,11 @@ private:
 
     bool m_fHasAlphaMaps;
     bool m_fIsBiLevelOnly;
-    
+    bool m_fIsComposedFromAtlas;
+
+    // Glyphs of the alpha map being rasterized on the thread pool, if any
+    CGlyphRasterizationJob *m_pRasterizationJob;
+
     // device dependent data
     CSWGlyphRun* m_pSWGlyphRun;
     DynArrayIA<CD3DGlyphRun*, 2> m_pD3DGlyphRuns;
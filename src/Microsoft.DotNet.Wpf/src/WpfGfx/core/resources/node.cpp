@@ -49,6 +49,13 @@ CMilVisual::~CMilVisual()
 
     WPFFree(ProcessHeap, m_pScrollBag);
 
+    // The cache only knows this node by address
+    CEffectResultCache *pEffectResultCache = m_pComposition->GetEffectResultCacheNoRef();
+    if (pEffectResultCache != NULL)
+    {
+        pEffectResultCache->Invalidate(this);
+    }
+
     if (m_pScheduleRecord)
     {
         CMilScheduleManager* pScheduleManager = m_pComposition->GetScheduleManager();
@@ -995,9 +1002,8 @@ HRESULT
 CMilVisual::CollectAdditionalDirtyRegion(
     __in_ecount(1) CDirtyRegion2 *pDirtyRegion,
     __in_ecount(1) const CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::PageInPixels> *pWorldTransform,
-    int scrollX,
-    int scrollY,
-    CRectF<CoordinateSpace::PageInPixels> clipRect,
+    UINT cScrollAreas,
+    __in_ecount_opt(cScrollAreas) const ScrollAreaStruct *rgScrollAreas,
     __in_ecount_opt(1) const CRectF<CoordinateSpace::PageInPixels> *pWorldClip
     )
 {
@@ -1030,13 +1036,19 @@ CMilVisual::CollectAdditionalDirtyRegion(
             // area, and if it is, add another dirty region for it.
             // See comment on CPreComputeContext::ScrollableAreaHandling()
             //
-            if ((scrollX != 0) || (scrollY != 0))
+            for (UINT j = 0; j < cScrollAreas; j++)
             {
-                rcDirtyRectWorld.Offset(static_cast<float>(scrollX), static_cast<float>(scrollY));
+                const ScrollAreaStruct &scrollArea = rgScrollAreas[j];
 
-                if (rcDirtyRectWorld.Intersect(clipRect))
+                if ((scrollArea.scrollX != 0) || (scrollArea.scrollY != 0))
                 {
-                    IFC(pDirtyRegion->Add(&rcDirtyRectWorld));
+                    CRectF<CoordinateSpace::PageInPixels> rcScrolledDirtyRect = rcDirtyRectWorld;
+                    rcScrolledDirtyRect.Offset(static_cast<float>(scrollArea.scrollX), static_cast<float>(scrollArea.scrollY));
+
+                    if (rcScrolledDirtyRect.Intersect(scrollArea.clipRect))
+                    {
+                        IFC(pDirtyRegion->Add(&rcScrolledDirtyRect));
+                    }
                 }
             }
          }
@@ -28,6 +28,7 @@ class CMilBrushDuce;
 class CGuidelineCollection;
 class CMilAlphaMaskWrapper;
 class CMilVisualCacheSet;
+struct ScrollAreaStruct;
 
 //---------------------------------------------------------------------------------
 // class CMilVisual
@@ -290,9 +291,8 @@ protected:
     virtual HRESULT CollectAdditionalDirtyRegion(
         __in_ecount(1) CDirtyRegion2 *pDirtyRegion,
         __in_ecount(1) const CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::PageInPixels> *pWorldTransform,
-        int scrollX,
-        int scrollY,
-        CRectF<CoordinateSpace::PageInPixels> clipRect,
+        UINT cScrollAreas,
+        __in_ecount_opt(cScrollAreas) const ScrollAreaStruct *rgScrollAreas,
         __in_ecount_opt(1) const CRectF<CoordinateSpace::PageInPixels> *pWorldClip = NULL);    
 
     bool CanBeScrolled() const
@@ -418,6 +418,16 @@ private:
     // into the first entry in the array, and all further entries should do likewise.
     DWORD m_fAdditionalDirtyRectsExceeded : 1;
 
+    // Used only during the render walk, so that PostSubgraph may recognize this node as one
+    // whose Effect was fused with the Effect of its child instead of being given a layer.
+    // See comment on CDrawingContext::CanFuseEffectWithChild()
+    DWORD m_fFuseEffectWithChild : 1;
+
+    // Used only during the render walk, so that PostSubgraph may recognize this node as one
+    // whose Effect output was drawn from the CEffectResultCache instead of being given a layer.
+    // See comment on CDrawingContext::DrawEffectResult()
+    DWORD m_fUseEffectResult : 1;
+
     CMilVisualCacheSet *m_pCaches;
     CMilTransformDuce *m_pTransform;
     CMilEffectDuce *m_pEffect;
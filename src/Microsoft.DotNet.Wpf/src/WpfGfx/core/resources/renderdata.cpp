@@ -36,6 +36,9 @@ CMilSlaveRenderData::CMilSlaveRenderData(
 {
     m_pComposition = pComposition;
     m_pScheduleRecord = NULL;
+    m_cCullIndexUses = 0;
+    m_fCullIndexValid = false;
+    m_fDeferCullIndexBuild = false;
 }
 
 CMilSlaveRenderData::~CMilSlaveRenderData()
@@ -72,6 +75,13 @@ void CMilSlaveRenderData::DestroyRenderData()
         pScheduleManager->Unschedule(&m_pScheduleRecord);
     }
 
+    m_rgInstructions.Reset(FALSE);
+    m_rgpInstructionResources.Reset(FALSE);
+
+    m_rgCullSpans.Reset(FALSE);
+    m_rgCullBlockBounds.Reset(FALSE);
+    m_fCullIndexValid = false;
+
     m_instructions.Reset();
 }
 
@@ -111,6 +121,11 @@ HRESULT CMilSlaveRenderData::ProcessUpdate(
         //
         IFC(GetHandles(pHandleTable));
 
+        //
+        // Compile the validated stream into the flat instruction array
+        // walked by Draw.
+        //
+        IFC(CompileInstructions());
     }
 
     NotifyOnChanged(this);
@@ -130,6 +145,369 @@ Cleanup:
     RRETURN(hr);
 }
 
+//---------------------------------------------------------------------------------
+// CMilSlaveRenderData::ResolveHandleBatch
+//
+//    Resolves all the resource handles collected by GetHandles with a single
+//    handle table call, registers for their notifications and replaces each
+//    handle in its packet with the index of the resource in m_rgpResources.
+//
+// Return Value:
+//
+//    HRESULT
+//
+//---------------------------------------------------------------------------------
+
+HRESULT
+CMilSlaveRenderData::ResolveHandleBatch(
+    __in_ecount(1) CMilSlaveHandleTable *pHandleTable,
+    __in_ecount(1) const RenderDataHandleBatch *pBatch
+    )
+{
+    HRESULT hr = S_OK;
+
+    UINT cHandles = pBatch->rghResources.GetCount();
+    UINT iFirstResource = m_rgpResources.GetCount();
+    CMilSlaveResource **rgpNewResources = NULL;
+
+    Assert(pBatch->rgTypes.GetCount() == cHandles);
+    Assert(pBatch->rgphResources.GetCount() == cHandles);
+
+    if (cHandles == 0)
+    {
+        goto Cleanup;
+    }
+
+    //
+    // m_rgpResources zero-initializes new elements and GetResources zeroes
+    // them on failure. RegisterNNotifiers only NULLs the entries it rolled
+    // back, so the rest are cleared below; the array must never hold a
+    // resource we are not registered with.
+    //
+
+    IFC(m_rgpResources.AddMultiple(cHandles, &rgpNewResources));
+
+    IFC(pHandleTable->GetResources(
+        cHandles,
+        pBatch->rghResources.GetDataBuffer(),
+        pBatch->rgTypes.GetDataBuffer(),
+        rgpNewResources
+        ));
+
+    // RegisterNotifier adds a reference to each resource
+    hr = RegisterNNotifiers(rgpNewResources, cHandles);
+
+    if (FAILED(hr))
+    {
+        RtlZeroMemory(rgpNewResources, cHandles * sizeof(*rgpNewResources));
+        goto Cleanup;
+    }
+
+    //
+    // Duplicates are allowed in the resource array, see
+    // CMilSlaveResource::AddHandleToArrayAndReplace.
+    //
+
+    for (UINT i = 0; i < cHandles; i++)
+    {
+        *(pBatch->rgphResources[i]) = iFirstResource + i;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CMilSlaveRenderData::CompileInstructions
+//
+//    Walks the validated instruction stream once and produces the compiled
+//    form consumed by Draw: one RenderDataInstruction per packet, plus the
+//    resource pointers each packet references stored contiguously in the
+//    order Draw consumes them. Must be called after GetHandles, which has
+//    replaced the handles in the packets by indices into m_rgpResources.
+//
+// Return Value:
+//
+//    HRESULT
+//
+//---------------------------------------------------------------------------------
+
+HRESULT
+CMilSlaveRenderData::CompileInstructions()
+{
+    HRESULT hr = S_OK;
+
+    CMilDataBlockReader cmdReader(m_instructions.FlushData());
+
+    UINT nItemID;
+    PVOID pItemData;
+    UINT nItemDataSize;
+
+    CMilSlaveResource **rgpResources = m_rgpResources.GetDataBuffer();
+    UINT cResources = m_rgpResources.GetCount();
+
+    // Up to five resources are referenced by a single instruction
+    UINT rgResourceIndices[5];
+    UINT cResourceIndices;
+
+    // Culling span tracking
+    int iStackDepth = 0;
+    int iStackDepthDelta;
+    bool fNeverCull;
+    RenderDataCullSpan span;
+
+    span.iFirstInstruction = 0;
+    span.fNeverCull = false;
+
+    IFC(cmdReader.GetFirstItemSafe(&nItemID, &pItemData, &nItemDataSize));
+
+    while (hr == S_OK)
+    {
+        cResourceIndices = 0;
+        iStackDepthDelta = 0;
+        fNeverCull = false;
+
+        //
+        // GetHandles has already checked the packet sizes, so the casts below
+        // are safe. The order in which the indices are listed here must match
+        // the ppResources[] order used in Draw.
+        //
+
+        switch (nItemID)
+        {
+            default:
+                IFC(WGXERR_UCE_MALFORMEDPACKET);
+                break;
+
+            case MilDrawLine:
+            {
+                const MILCMD_DRAW_LINE *pData = static_cast<MILCMD_DRAW_LINE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                break;
+            }
+            case MilDrawLineAnimate:
+            {
+                const MILCMD_DRAW_LINE_ANIMATE *pData = static_cast<MILCMD_DRAW_LINE_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hPoint0Animations;
+                rgResourceIndices[cResourceIndices++] = pData->hPoint1Animations;
+                break;
+            }
+            case MilDrawRectangle:
+            {
+                const MILCMD_DRAW_RECTANGLE *pData = static_cast<MILCMD_DRAW_RECTANGLE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                break;
+            }
+            case MilDrawRectangleAnimate:
+            {
+                const MILCMD_DRAW_RECTANGLE_ANIMATE *pData = static_cast<MILCMD_DRAW_RECTANGLE_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                rgResourceIndices[cResourceIndices++] = pData->hRectangleAnimations;
+                break;
+            }
+            case MilDrawRoundedRectangle:
+            {
+                const MILCMD_DRAW_ROUNDED_RECTANGLE *pData = static_cast<MILCMD_DRAW_ROUNDED_RECTANGLE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                break;
+            }
+            case MilDrawRoundedRectangleAnimate:
+            {
+                const MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE *pData = static_cast<MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                rgResourceIndices[cResourceIndices++] = pData->hRectangleAnimations;
+                rgResourceIndices[cResourceIndices++] = pData->hRadiusXAnimations;
+                rgResourceIndices[cResourceIndices++] = pData->hRadiusYAnimations;
+                break;
+            }
+            case MilDrawEllipse:
+            {
+                const MILCMD_DRAW_ELLIPSE *pData = static_cast<MILCMD_DRAW_ELLIPSE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                break;
+            }
+            case MilDrawEllipseAnimate:
+            {
+                const MILCMD_DRAW_ELLIPSE_ANIMATE *pData = static_cast<MILCMD_DRAW_ELLIPSE_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                rgResourceIndices[cResourceIndices++] = pData->hCenterAnimations;
+                rgResourceIndices[cResourceIndices++] = pData->hRadiusXAnimations;
+                rgResourceIndices[cResourceIndices++] = pData->hRadiusYAnimations;
+                break;
+            }
+            case MilDrawGeometry:
+            {
+                const MILCMD_DRAW_GEOMETRY *pData = static_cast<MILCMD_DRAW_GEOMETRY *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hBrush;
+                rgResourceIndices[cResourceIndices++] = pData->hPen;
+                rgResourceIndices[cResourceIndices++] = pData->hGeometry;
+                break;
+            }
+            case MilDrawImage:
+            {
+                const MILCMD_DRAW_IMAGE *pData = static_cast<MILCMD_DRAW_IMAGE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hImageSource;
+                break;
+            }
+            case MilDrawImageAnimate:
+            {
+                const MILCMD_DRAW_IMAGE_ANIMATE *pData = static_cast<MILCMD_DRAW_IMAGE_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hImageSource;
+                rgResourceIndices[cResourceIndices++] = pData->hRectangleAnimations;
+                break;
+            }
+            case MilDrawDrawing:
+            {
+                const MILCMD_DRAW_DRAWING *pData = static_cast<MILCMD_DRAW_DRAWING *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hDrawing;
+                break;
+            }
+            case MilDrawVideo:
+            {
+                const MILCMD_DRAW_VIDEO *pData = static_cast<MILCMD_DRAW_VIDEO *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPlayer;
+                // Video playback must see every frame it is drawn in
+                fNeverCull = true;
+                break;
+            }
+            case MilDrawVideoAnimate:
+            {
+                const MILCMD_DRAW_VIDEO_ANIMATE *pData = static_cast<MILCMD_DRAW_VIDEO_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hPlayer;
+                rgResourceIndices[cResourceIndices++] = pData->hRectangleAnimations;
+                // Video playback must see every frame it is drawn in
+                fNeverCull = true;
+                break;
+            }
+            case MilDrawGlyphRun:
+            {
+                const MILCMD_DRAW_GLYPH_RUN *pData = static_cast<MILCMD_DRAW_GLYPH_RUN *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hForegroundBrush;
+                rgResourceIndices[cResourceIndices++] = pData->hGlyphRun;
+                break;
+            }
+            case MilPushOpacityMask:
+            {
+                const MILCMD_PUSH_OPACITY_MASK *pData = static_cast<MILCMD_PUSH_OPACITY_MASK *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hOpacityMask;
+                iStackDepthDelta = 1;
+                break;
+            }
+            case MilPushOpacityAnimate:
+            {
+                const MILCMD_PUSH_OPACITY_ANIMATE *pData = static_cast<MILCMD_PUSH_OPACITY_ANIMATE *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hOpacityAnimations;
+                iStackDepthDelta = 1;
+                break;
+            }
+            case MilPushTransform:
+            {
+                const MILCMD_PUSH_TRANSFORM *pData = static_cast<MILCMD_PUSH_TRANSFORM *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hTransform;
+                iStackDepthDelta = 1;
+                break;
+            }
+            case MilPushGuidelineSet:
+            {
+                const MILCMD_PUSH_GUIDELINE_SET *pData = static_cast<MILCMD_PUSH_GUIDELINE_SET *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hGuidelines;
+                iStackDepthDelta = 1;
+                break;
+            }
+            case MilPushClip:
+            {
+                const MILCMD_PUSH_CLIP *pData = static_cast<MILCMD_PUSH_CLIP *>(pItemData);
+                rgResourceIndices[cResourceIndices++] = pData->hClipGeometry;
+                iStackDepthDelta = 1;
+                break;
+            }
+
+            // Instructions without resource references
+            case MilPushGuidelineY1:
+            case MilPushGuidelineY2:
+                // Dynamic guidelines may need to schedule more render passes
+                // when drawn, so they are never culled.
+                fNeverCull = true;
+                iStackDepthDelta = 1;
+                break;
+
+            case MilPushOpacity:
+            case MilPushEffect:
+                iStackDepthDelta = 1;
+                break;
+
+            case MilPop:
+                iStackDepthDelta = -1;
+                break;
+        }
+
+        {
+            RenderDataInstruction instruction;
+
+            instruction.nItemID = nItemID;
+            instruction.nItemDataSize = nItemDataSize;
+            instruction.pItemData = pItemData;
+            instruction.iFirstResource = m_rgpInstructionResources.GetCount();
+
+            for (UINT i = 0; i < cResourceIndices; i++)
+            {
+                if (rgResourceIndices[i] >= cResources)
+                {
+                    IFC(WGXERR_UCE_MALFORMEDPACKET);
+                }
+
+                IFC(m_rgpInstructionResources.Add(rgpResources[rgResourceIndices[i]]));
+            }
+
+            IFC(m_rgInstructions.Add(instruction));
+        }
+
+        //
+        // Close the current culling span whenever we are back at depth 0.
+        // GetHandles has already rejected unbalanced streams.
+        //
+
+        iStackDepth += iStackDepthDelta;
+        span.fNeverCull |= fNeverCull;
+
+        if (iStackDepth == 0)
+        {
+            span.iEndInstruction = m_rgInstructions.GetCount();
+            span.rcBounds = CMilRectF::sc_rcInfinite;
+
+            IFC(m_rgCullSpans.Add(span));
+
+            span.iFirstInstruction = span.iEndInstruction;
+            span.fNeverCull = false;
+        }
+
+        IFC(cmdReader.GetNextItemSafe(
+            &nItemID,
+            &pItemData,
+            &nItemDataSize
+            ));
+    }
+
+    //
+    // S_FALSE means that we reached the end of the stream.
+    //
+
+    if (hr == S_FALSE)
+    {
+        hr = S_OK;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
 //+----------------------------------------------------------------------------
 //
 //  Class:
@@ -459,7 +837,9 @@ CMilSlaveRenderData::EndBoundingFrame(
 // CMilSlaveRenderData::Draw
 //
 //    This function enumerates the drawing instructions into the given
-//    IDrawingContext interface.
+//    IDrawingContext interface. When the context reports local cull bounds
+//    and there is enough content, instructions outside of those bounds are
+//    skipped.
 //
 // Return Value:
 //
@@ -474,7 +854,231 @@ CMilSlaveRenderData::Draw(
 {
     HRESULT hr = S_OK;
 
-    CMilSlaveResource **rgpResources = m_rgpResources.GetDataBuffer();
+    CMilRectF rcCullBoundsLocal;
+    bool fCull = false;
+
+    if (   m_rgCullSpans.GetCount() >= sc_cMinCullSpans
+        && pIDC->GetLocalCullBounds(&rcCullBoundsLocal))
+    {
+        IFC(EnsureCullIndex());
+        fCull = m_fCullIndexValid;
+    }
+
+    if (fCull)
+    {
+        IFC(DrawCulled(pIDC, rcCullBoundsLocal));
+    }
+    else
+    {
+        IFC(DrawInstructions(pIDC, 0, m_rgInstructions.GetCount()));
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CMilSlaveRenderData::DrawCulled
+//
+//    Draws the culling spans whose bounds intersect the given local space
+//    cull bounds, in their original order.
+//
+//---------------------------------------------------------------------------------
+
+HRESULT
+CMilSlaveRenderData::DrawCulled(
+    __in_ecount(1) IDrawingContext *pIDC,
+    __in_ecount(1) const CMilRectF &rcCullBoundsLocal
+    )
+{
+    HRESULT hr = S_OK;
+
+    const RenderDataCullSpan *rgSpans = m_rgCullSpans.GetDataBuffer();
+    const CMilRectF *rgBlockBounds = m_rgCullBlockBounds.GetDataBuffer();
+    UINT cSpans = m_rgCullSpans.GetCount();
+    UINT cBlocks = m_rgCullBlockBounds.GetCount();
+
+    Assert(m_fCullIndexValid);
+    Assert(cBlocks == (cSpans + sc_cCullSpansPerBlock - 1) / sc_cCullSpansPerBlock);
+
+    m_cCullIndexUses++;
+
+    for (UINT iBlock = 0; iBlock < cBlocks; iBlock++)
+    {
+        if (!rgBlockBounds[iBlock].DoesIntersect(rcCullBoundsLocal))
+        {
+            continue;
+        }
+
+        UINT iSpan = iBlock * sc_cCullSpansPerBlock;
+        UINT iSpanEnd = min(iSpan + sc_cCullSpansPerBlock, cSpans);
+
+        for (; iSpan < iSpanEnd; iSpan++)
+        {
+            const RenderDataCullSpan &span = rgSpans[iSpan];
+
+            if (span.fNeverCull || span.rcBounds.DoesIntersect(rcCullBoundsLocal))
+            {
+                //
+                // Coalesce runs of visible spans into a single call
+                //
+
+                UINT iFirstInstruction = span.iFirstInstruction;
+                UINT iEndInstruction = span.iEndInstruction;
+
+                while (   iSpan + 1 < iSpanEnd
+                       && (   rgSpans[iSpan + 1].fNeverCull
+                           || rgSpans[iSpan + 1].rcBounds.DoesIntersect(rcCullBoundsLocal)))
+                {
+                    iSpan++;
+                    iEndInstruction = rgSpans[iSpan].iEndInstruction;
+                }
+
+                IFC(DrawInstructions(pIDC, iFirstInstruction, iEndInstruction));
+            }
+        }
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CMilSlaveRenderData::EnsureCullIndex
+//
+//    Computes the bounds of every culling span, and the per-block unions of
+//    those, if they are not up to date. Content that changes between every
+//    draw (typically animated) would pay for a bounds pass each frame, so
+//    the rebuild is deferred until the content has stayed unchanged for one
+//    culled draw.
+//
+//---------------------------------------------------------------------------------
+
+HRESULT
+CMilSlaveRenderData::EnsureCullIndex()
+{
+    HRESULT hr = S_OK;
+
+    CContentBounder *pContentBounder = NULL;
+
+    if (m_fCullIndexValid)
+    {
+        goto Cleanup;
+    }
+
+    if (m_fDeferCullIndexBuild)
+    {
+        m_fDeferCullIndexBuild = false;
+        goto Cleanup;
+    }
+
+    {
+        UINT cSpans = m_rgCullSpans.GetCount();
+        RenderDataCullSpan *rgSpans = m_rgCullSpans.GetDataBuffer();
+
+        //
+        // Use a private content bounder: the drawing context's own bounder
+        // may be in use further up the stack.
+        //
+
+        IFC(CContentBounder::Create(m_pComposition, &pContentBounder));
+        IFC(pContentBounder->GetRenderDataSpanBounds(this, rgSpans, cSpans));
+
+        m_rgCullBlockBounds.Reset(FALSE);
+
+        for (UINT iSpan = 0; iSpan < cSpans; iSpan++)
+        {
+            if (rgSpans[iSpan].fNeverCull)
+            {
+                rgSpans[iSpan].rcBounds = CMilRectF::sc_rcInfinite;
+            }
+
+            if (iSpan % sc_cCullSpansPerBlock == 0)
+            {
+                IFC(m_rgCullBlockBounds.Add(rgSpans[iSpan].rcBounds));
+            }
+            else
+            {
+                m_rgCullBlockBounds.Last().Union(rgSpans[iSpan].rcBounds);
+            }
+        }
+
+        m_cCullIndexUses = 0;
+        m_fCullIndexValid = true;
+    }
+
+Cleanup:
+    delete pContentBounder;
+
+    if (FAILED(hr))
+    {
+        m_rgCullBlockBounds.Reset(FALSE);
+        m_fCullIndexValid = false;
+    }
+
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CMilSlaveRenderData::OnChanged
+//
+//    Any change to the render data or to a resource it references may move
+//    the instruction bounds, so the cull index is invalidated.
+//
+//---------------------------------------------------------------------------------
+
+BOOL
+CMilSlaveRenderData::OnChanged(
+    CMilSlaveResource *pSender,
+    NotificationEventArgs::Flags e
+    )
+{
+    //
+    // Content that changed again before its index was rebuilt, or whose index
+    // did not survive more than one draw, is not worth rebuilding right away.
+    //
+
+    m_fDeferCullIndexBuild = !m_fCullIndexValid || (m_cCullIndexUses <= 1);
+    m_fCullIndexValid = false;
+
+    return CMilSlaveResource::OnChanged(pSender, e);
+}
+
+//---------------------------------------------------------------------------------
+// CMilSlaveRenderData::DrawInstructions
+//
+//    This function enumerates the compiled instructions in
+//    [iFirstInstruction, iEndInstruction) into the given IDrawingContext
+//    interface. The range must be balanced with respect to Push/Pop.
+//
+// Return Value:
+//
+//    HRESULT
+//
+//---------------------------------------------------------------------------------
+
+HRESULT
+CMilSlaveRenderData::DrawInstructions(
+    __in_ecount(1) IDrawingContext *pIDC,
+    UINT iFirstInstruction,
+    UINT iEndInstruction
+    )
+{
+    HRESULT hr = S_OK;
+
+    Assert(iFirstInstruction <= iEndInstruction);
+    Assert(iEndInstruction <= m_rgInstructions.GetCount());
+
+    //
+    // ProcessUpdate compiled the stream into a flat instruction array with
+    // the resource pointers each instruction needs laid out contiguously, so
+    // the walk below neither re-decodes the data stream nor indirects through
+    // the handle indices stored in the packets.
+    //
+
+    const RenderDataInstruction *pInstruction = m_rgInstructions.GetDataBuffer() + iFirstInstruction;
+    const RenderDataInstruction *pInstructionEnd = m_rgInstructions.GetDataBuffer() + iEndInstruction;
+    CMilSlaveResource * const *rgpInstructionResources = m_rgpInstructionResources.GetDataBuffer();
 //
 //[pfx_parse] -worcaround for PREfix parse problems
 //
@@ -488,16 +1092,6 @@ CMilSlaveRenderData::Draw(
 #endif
 #endif //!_PREFIX_
 
-    //
-    // Set up the command enumeration.
-    //
-
-    CMilDataBlockReader cmdReader(m_instructions.FlushData());
-
-    UINT nItemID;
-    PVOID pItemData;
-    UINT nItemDataSize;
-
     //
     // These pointers maintain the original DC and the current DC to support nesting of
     // DC frames.  Neither of these variables maintain reference counts (note that IDrawingContext
@@ -511,20 +1105,19 @@ CMilSlaveRenderData::Draw(
     CRenderDataDrawFrame *pCurrentFrame = NULL;
     int iCurrentFrameStackDepth = 0;
 
-    //
-    // Now get the first item and start executing the render buffer.
-    //
-
-    IFC(cmdReader.GetFirstItemSafe(&nItemID, &pItemData, &nItemDataSize));
-
     //
     // Following is a trap to detect code pieces that break FPU state
     //
 
     CFloatFPU::AssertPrecisionAndRoundingMode();
 
-    while (hr == S_OK)
+    for (; pInstruction < pInstructionEnd; pInstruction++)
     {
+        const UINT nItemID = pInstruction->nItemID;
+        PVOID const pItemData = pInstruction->pItemData;
+        CMilSlaveResource * const *ppResources =
+            rgpInstructionResources + pInstruction->iFirstResource;
+
         //  Improve lazy evaluation of render state
         //   This way is simpler (and less error-prone, which is good for now).
         //   But it causes unnecessary work, e.g. between 2 repeated PopTransform operations.
@@ -536,10 +1129,10 @@ CMilSlaveRenderData::Draw(
         //
 
         //
-        // Because the render data packets have been validated when received
-        // and stored, we don't need to check that they are the correct size and that
-        // the index ranges are valid for each walk of the data. However keep
-        // these checks as asserts to guard this assumption.
+        // Because the render data packets have been validated and compiled
+        // when received, we don't need to check that they are the correct
+        // size and that the index ranges are valid for each walk of the data.
+        // However keep these checks as asserts to guard this assumption.
         //
 
         if (SUCCEEDED(hr))
@@ -547,7 +1140,7 @@ CMilSlaveRenderData::Draw(
             switch (nItemID)
             {
                 default:
-                    hr = THR(WGXERR_UCE_MALFORMEDPACKET);
+                    IFC(WGXERR_UCE_MALFORMEDPACKET);
                     break;
 
                 case MilPushEffect:
@@ -563,7 +1156,7 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawLine:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_LINE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_LINE));
 
                     const MILCMD_DRAW_LINE *pData =
                         reinterpret_cast<MILCMD_DRAW_LINE *>(pItemData);
@@ -573,7 +1166,7 @@ CMilSlaveRenderData::Draw(
                     IFC(pCurrentDC->DrawLine(
                         pData->point0,
                         pData->point1,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
+                        DYNCAST(CMilPenDuce, ppResources[0]),
                         NULL,
                         NULL
                         ));
@@ -581,7 +1174,7 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawLineAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_LINE_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_LINE_ANIMATE));
 
                     const MILCMD_DRAW_LINE_ANIMATE *pData =
                         reinterpret_cast<MILCMD_DRAW_LINE_ANIMATE *>(pItemData);
@@ -594,15 +1187,15 @@ CMilSlaveRenderData::Draw(
                     IFC(pCurrentDC->DrawLine(
                         pData->point0,
                         pData->point1,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilSlavePoint, rgpResources[pData->hPoint0Animations]),
-                        DYNCAST(CMilSlavePoint, rgpResources[pData->hPoint1Animations])
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilSlavePoint, ppResources[1]),
+                        DYNCAST(CMilSlavePoint, ppResources[2])
                         ));
                     break;
                 }
                 case MilDrawRectangle:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_RECTANGLE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_RECTANGLE));
 
                     MILCMD_DRAW_RECTANGLE *pData =
                         reinterpret_cast<MILCMD_DRAW_RECTANGLE *>(pItemData);
@@ -611,15 +1204,15 @@ CMilSlaveRenderData::Draw(
 
                     IFC(pCurrentDC->DrawRectangle(
                         pData->rectangle,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilBrushDuce, ppResources[1]),
                         NULL
                         ));
                     break;
                 }
                 case MilDrawRectangleAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_RECTANGLE_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_RECTANGLE_ANIMATE));
 
                     MILCMD_DRAW_RECTANGLE_ANIMATE *pData =
                         reinterpret_cast<MILCMD_DRAW_RECTANGLE_ANIMATE *>(pItemData);
@@ -629,15 +1222,15 @@ CMilSlaveRenderData::Draw(
 
                     IFC(pCurrentDC->DrawRectangle(
                         pData->rectangle,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
-                        DYNCAST(CMilSlaveRect, rgpResources[pData->hRectangleAnimations])
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilBrushDuce, ppResources[1]),
+                        DYNCAST(CMilSlaveRect, ppResources[2])
                         ));
                     break;
                 }
                 case MilDrawRoundedRectangle:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_ROUNDED_RECTANGLE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_ROUNDED_RECTANGLE));
 
                     MILCMD_DRAW_ROUNDED_RECTANGLE *pData =
                         reinterpret_cast<MILCMD_DRAW_ROUNDED_RECTANGLE *>(pItemData);
@@ -651,8 +1244,8 @@ CMilSlaveRenderData::Draw(
                         pData->rectangle,
                         radiusX,
                         radiusY,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilBrushDuce, ppResources[1]),
                         NULL,
                         NULL,
                         NULL
@@ -661,7 +1254,7 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawRoundedRectangleAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE));
 
                     MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE *pData =
                         reinterpret_cast<MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE *>(pItemData);
@@ -678,17 +1271,17 @@ CMilSlaveRenderData::Draw(
                         pData->rectangle,
                         radiusX,
                         radiusY,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
-                        DYNCAST(CMilSlaveRect, rgpResources[pData->hRectangleAnimations]),
-                        DYNCAST(CMilSlaveDouble, rgpResources[pData->hRadiusXAnimations]),
-                        DYNCAST(CMilSlaveDouble, rgpResources[pData->hRadiusYAnimations])
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilBrushDuce, ppResources[1]),
+                        DYNCAST(CMilSlaveRect, ppResources[2]),
+                        DYNCAST(CMilSlaveDouble, ppResources[3]),
+                        DYNCAST(CMilSlaveDouble, ppResources[4])
                         ));
                     break;
                 }
                 case MilDrawEllipse:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_ELLIPSE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_ELLIPSE));
 
                     MILCMD_DRAW_ELLIPSE *pData =
                         reinterpret_cast<MILCMD_DRAW_ELLIPSE *>(pItemData);
@@ -704,8 +1297,8 @@ CMilSlaveRenderData::Draw(
                         pData->center,
                         radiusX,
                         radiusY,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilBrushDuce, ppResources[1]),
                         NULL,
                         NULL,
                         NULL
@@ -714,7 +1307,7 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawEllipseAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_ELLIPSE_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_ELLIPSE_ANIMATE));
 
                     MILCMD_DRAW_ELLIPSE_ANIMATE *pData =
                         reinterpret_cast<MILCMD_DRAW_ELLIPSE_ANIMATE *>(pItemData);
@@ -732,17 +1325,17 @@ CMilSlaveRenderData::Draw(
                         pData->center,
                         radiusX,
                         radiusY,
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
-                        DYNCAST(CMilSlavePoint, rgpResources[pData->hCenterAnimations]),
-                        DYNCAST(CMilSlaveDouble, rgpResources[pData->hRadiusXAnimations]),
-                        DYNCAST(CMilSlaveDouble, rgpResources[pData->hRadiusYAnimations])
+                        DYNCAST(CMilPenDuce, ppResources[0]),
+                        DYNCAST(CMilBrushDuce, ppResources[1]),
+                        DYNCAST(CMilSlavePoint, ppResources[2]),
+                        DYNCAST(CMilSlaveDouble, ppResources[3]),
+                        DYNCAST(CMilSlaveDouble, ppResources[4])
                         ));
                     break;
                 }
                 case MilDrawGeometry:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_GEOMETRY));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_GEOMETRY));
 
                     MILCMD_DRAW_GEOMETRY *pData = reinterpret_cast<MILCMD_DRAW_GEOMETRY *>(pItemData);
                     Assert(   pData->hBrush < cResources
@@ -750,21 +1343,21 @@ CMilSlaveRenderData::Draw(
                            && pData->hGeometry < cResources);
 
                     IFC(pCurrentDC->DrawGeometry(
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hBrush]),
-                        DYNCAST(CMilPenDuce, rgpResources[pData->hPen]),
-                        DYNCAST(CMilGeometryDuce, rgpResources[pData->hGeometry])
+                        DYNCAST(CMilBrushDuce, ppResources[0]),
+                        DYNCAST(CMilPenDuce, ppResources[1]),
+                        DYNCAST(CMilGeometryDuce, ppResources[2])
                         ));
                     break;
                 }
                 case MilDrawImage:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_IMAGE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_IMAGE));
 
                     MILCMD_DRAW_IMAGE *pData = reinterpret_cast<MILCMD_DRAW_IMAGE*>(pItemData);
                     Assert(pData->hImageSource < cResources);
 
                     IFC(pCurrentDC->DrawImage(
-                        rgpResources[pData->hImageSource],
+                        ppResources[0],
                         &pData->rectangle,
                         NULL
                         ));
@@ -772,16 +1365,16 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawImageAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_IMAGE_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_IMAGE_ANIMATE));
 
                     MILCMD_DRAW_IMAGE_ANIMATE *pDataAnimate = reinterpret_cast<MILCMD_DRAW_IMAGE_ANIMATE*>(pItemData);
                     Assert(   pDataAnimate->hImageSource < cResources
                            && pDataAnimate->hRectangleAnimations < cResources);
 
                     IFC(pCurrentDC->DrawImage(
-                        rgpResources[pDataAnimate->hImageSource],
+                        ppResources[0],
                         &pDataAnimate->rectangle,
-                        DYNCAST(CMilSlaveRect, rgpResources[pDataAnimate->hRectangleAnimations])
+                        DYNCAST(CMilSlaveRect, ppResources[1])
                         ));
                     break;
                 }
@@ -789,15 +1382,15 @@ CMilSlaveRenderData::Draw(
                 {
                     CMilDrawingDuce *pDrawing;
 
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_DRAWING));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_DRAWING));
 
                     MILCMD_DRAW_DRAWING *pData = reinterpret_cast<MILCMD_DRAW_DRAWING *>(pItemData);
 
                     Assert(pData->hDrawing < cResources);
 
-                    if (rgpResources[pData->hDrawing])
+                    if (ppResources[0])
                     {
-                        pDrawing = DYNCAST(CMilDrawingDuce, rgpResources[pData->hDrawing]);
+                        pDrawing = DYNCAST(CMilDrawingDuce, ppResources[0]);
                         Assert(pDrawing);
 
                         IFC(pCurrentDC->DrawDrawing(pDrawing));
@@ -806,14 +1399,14 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawVideo:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_VIDEO));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_VIDEO));
 
                     MILCMD_DRAW_VIDEO *pData = reinterpret_cast<MILCMD_DRAW_VIDEO*>(pItemData);
 
                     Assert(pData->hPlayer < cResources);
 
                     IFC(pCurrentDC->DrawVideo(
-                        DYNCAST(CMilSlaveVideo, rgpResources[pData->hPlayer]),
+                        DYNCAST(CMilSlaveVideo, ppResources[0]),
                         &(pData->rectangle),
                         NULL
                         ));
@@ -821,36 +1414,36 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilDrawVideoAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_VIDEO_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_VIDEO_ANIMATE));
 
                     MILCMD_DRAW_VIDEO_ANIMATE *pDataAnimate = reinterpret_cast<MILCMD_DRAW_VIDEO_ANIMATE*>(pItemData);
                     Assert(   pDataAnimate->hPlayer < cResources
                            && pDataAnimate->hRectangleAnimations < cResources);
 
                     IFC(pCurrentDC->DrawVideo(
-                        DYNCAST(CMilSlaveVideo, rgpResources[pDataAnimate->hPlayer]),
+                        DYNCAST(CMilSlaveVideo, ppResources[0]),
                         &(pDataAnimate->rectangle),
-                        DYNCAST(CMilSlaveRect, rgpResources[pDataAnimate->hRectangleAnimations])
+                        DYNCAST(CMilSlaveRect, ppResources[1])
                         ));
                     break;
                 }
                 case MilDrawGlyphRun:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_DRAW_GLYPH_RUN));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_DRAW_GLYPH_RUN));
 
                     MILCMD_DRAW_GLYPH_RUN *pData = reinterpret_cast<MILCMD_DRAW_GLYPH_RUN*>(pItemData);
                     Assert(   pData->hForegroundBrush < cResources
                            && pData->hGlyphRun < cResources);
 
                     IFC(pCurrentDC->DrawGlyphRun(
-                        DYNCAST(CMilBrushDuce, rgpResources[pData->hForegroundBrush]),
-                        DYNCAST(CGlyphRunResource, rgpResources[pData->hGlyphRun])
+                        DYNCAST(CMilBrushDuce, ppResources[0]),
+                        DYNCAST(CGlyphRunResource, ppResources[1])
                         ));
                     break;
                 }
                 case MilPushOpacityMask:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_OPACITY_MASK));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_OPACITY_MASK));
 
                     MILCMD_PUSH_OPACITY_MASK *pData = reinterpret_cast<MILCMD_PUSH_OPACITY_MASK *>(pItemData);
 
@@ -871,7 +1464,7 @@ CMilSlaveRenderData::Draw(
                     else
                     {
                         IFC(pCurrentDC->PushOpacityMask(
-                            DYNCAST(CMilBrushDuce, rgpResources[pData->hOpacityMask]),
+                            DYNCAST(CMilBrushDuce, ppResources[0]),
                             ReinterpretNonSpaceTypeDUCERectAsLocalRenderingRect(&pData->boundingBoxCacheLocalSpace)
                             ));
 
@@ -884,7 +1477,7 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilPushOpacity:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_OPACITY));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_OPACITY));
 
                     MILCMD_PUSH_OPACITY *pData = reinterpret_cast<MILCMD_PUSH_OPACITY*>(pItemData);
 
@@ -905,7 +1498,7 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilPushOpacityAnimate:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_OPACITY_ANIMATE));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_OPACITY_ANIMATE));
 
                     MILCMD_PUSH_OPACITY_ANIMATE *pData = reinterpret_cast<MILCMD_PUSH_OPACITY_ANIMATE*>(pItemData);
                     Assert(pData->hOpacityAnimations < cResources);
@@ -914,7 +1507,7 @@ CMilSlaveRenderData::Draw(
 
                     IFC(pCurrentDC->PushOpacity(
                         opacity,
-                        DYNCAST(CMilSlaveDouble, rgpResources[pData->hOpacityAnimations])
+                        DYNCAST(CMilSlaveDouble, ppResources[0])
                         ));
 
                     // Increment the current frame depth
@@ -925,13 +1518,13 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilPushTransform:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_TRANSFORM));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_TRANSFORM));
 
                     MILCMD_PUSH_TRANSFORM *pTransform = reinterpret_cast<MILCMD_PUSH_TRANSFORM*>(pItemData);
                     Assert(pTransform->hTransform < cResources);
 
                     IFC(pCurrentDC->PushTransform(
-                        DYNCAST(CMilTransformDuce, rgpResources[pTransform->hTransform])
+                        DYNCAST(CMilTransformDuce, ppResources[0])
                         ));
 
                     // Increment the current frame depth
@@ -942,13 +1535,13 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilPushGuidelineSet:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_GUIDELINE_SET));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_GUIDELINE_SET));
 
                     MILCMD_PUSH_GUIDELINE_SET *pData= reinterpret_cast<MILCMD_PUSH_GUIDELINE_SET*>(pItemData);
                     Assert(pData->hGuidelines < cResources);
 
                     IFC(pCurrentDC->PushGuidelineCollection(
-                        DYNCAST(CMilGuidelineSetDuce, rgpResources[pData->hGuidelines])
+                        DYNCAST(CMilGuidelineSetDuce, ppResources[0])
                         ));
 
                     // Increment the current frame depth
@@ -961,7 +1554,7 @@ CMilSlaveRenderData::Draw(
                 {
                     bool fNeedMoreCycles = false;
 
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_GUIDELINE_Y1));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_GUIDELINE_Y1));
 
                     MILCMD_PUSH_GUIDELINE_Y1 *pData= reinterpret_cast<MILCMD_PUSH_GUIDELINE_Y1*>(pItemData);
                     UINT index = *(reinterpret_cast<UINT *>(&pData->coordinate));
@@ -990,7 +1583,7 @@ CMilSlaveRenderData::Draw(
                 {
                     bool fNeedMoreCycles = false;
 
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_GUIDELINE_Y2));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_GUIDELINE_Y2));
 
                     MILCMD_PUSH_GUIDELINE_Y2 *pData= reinterpret_cast<MILCMD_PUSH_GUIDELINE_Y2*>(pItemData);
                     UINT index = *(reinterpret_cast<UINT *>(&pData->leadingCoordinate));
@@ -1017,13 +1610,13 @@ CMilSlaveRenderData::Draw(
                 }
                 case MilPushClip:
                 {
-                    Assert(nItemDataSize == sizeof(MILCMD_PUSH_CLIP));
+                    Assert(pInstruction->nItemDataSize == sizeof(MILCMD_PUSH_CLIP));
 
                     MILCMD_PUSH_CLIP *pClip = reinterpret_cast<MILCMD_PUSH_CLIP*>(pItemData);
                     Assert(pClip->hClipGeometry < cResources);
 
                     IFC(pCurrentDC->PushClip(
-                        DYNCAST(CMilGeometryDuce, rgpResources[pClip->hClipGeometry])
+                        DYNCAST(CMilGeometryDuce, ppResources[0])
                         ));
 
                     // Increment the current frame depth
@@ -1073,17 +1666,11 @@ CMilSlaveRenderData::Draw(
         //
 
         CFloatFPU::AssertPrecisionAndRoundingMode();
-
-        IFC(cmdReader.GetNextItemSafe(
-            &nItemID,
-            &pItemData,
-            &nItemDataSize
-            ));
     }
 
     //
-    // S_FALSE means that we reached the end of the stream. Hence we executed the stream
-    // correctly and therefore we should return S_OK.
+    // S_FALSE means that a drawing method interrupted the execution of the
+    // render data, which is not an error.
     //
 
     if (hr == S_FALSE)
@@ -29,6 +29,87 @@ interface IDrawingContext;
 class CGuidelineCollection;
 class CRenderDataDrawFrame;
 
+//+----------------------------------------------------------------------------
+//
+//  Struct:
+//      RenderDataInstruction
+//
+//  Synopsis:
+//      One entry of the compiled form of a render data instruction stream.
+//      pItemData points at the validated packet inside the instruction
+//      stream; iFirstResource is the index of the first of the resource
+//      pointers the instruction consumes in m_rgpInstructionResources.
+//
+//-----------------------------------------------------------------------------
+
+struct RenderDataInstruction
+{
+    UINT nItemID;
+    UINT nItemDataSize;
+    PVOID pItemData;
+    UINT iFirstResource;
+};
+
+//+----------------------------------------------------------------------------
+//
+//  Struct:
+//      RenderDataHandleBatch
+//
+//  Synopsis:
+//      Resource handles collected from the packets of an instruction stream
+//      so that they can be resolved by the handle table in a single call.
+//      rgphResources points at the packet fields that receive the index of
+//      the resolved resource in m_rgpResources.
+//
+//-----------------------------------------------------------------------------
+
+struct RenderDataHandleBatch
+{
+    HRESULT Add(
+        __inout_ecount(1) HMIL_RESOURCE UNALIGNED *phResource,
+        MIL_RESOURCE_TYPE type
+        )
+    {
+        HRESULT hr = S_OK;
+
+        // NULL handles keep index 0, which always maps to a NULL resource
+        if (*phResource != HMIL_RESOURCE_NULL)
+        {
+            IFC(rghResources.Add(*phResource));
+            IFC(rgTypes.Add(type));
+            IFC(rgphResources.Add(phResource));
+        }
+
+    Cleanup:
+        RRETURN(hr);
+    }
+
+    DynArray<HMIL_RESOURCE> rghResources;
+    DynArray<MIL_RESOURCE_TYPE> rgTypes;
+    DynArray<HMIL_RESOURCE UNALIGNED *> rgphResources;
+};
+
+//+----------------------------------------------------------------------------
+//
+//  Struct:
+//      RenderDataCullSpan
+//
+//  Synopsis:
+//      A run of compiled instructions that starts and ends at stack depth 0,
+//      i.e. either a single top-level draw or a balanced Push ... Pop block.
+//      Spans are the unit of culling; rcBounds is in render data local space
+//      and is only meaningful while the cull index is valid.
+//
+//-----------------------------------------------------------------------------
+
+struct RenderDataCullSpan
+{
+    CMilRectF rcBounds;
+    UINT iFirstInstruction;
+    UINT iEndInstruction;
+    bool fNeverCull;
+};
+
 class CMilSlaveRenderData : public CMilSlaveResource
 {
     friend class CResourceFactory;
@@ -56,6 +137,12 @@ public:
 
     HRESULT Draw(__in_ecount(1) IDrawingContext *pIDC);
 
+    HRESULT DrawInstructions(
+        __in_ecount(1) IDrawingContext *pIDC,
+        UINT iFirstInstruction,
+        UINT iEndInstruction
+        );
+
 
     // ------------------------------------------------------------------------
     //
@@ -77,11 +164,30 @@ public:
 
     HRESULT ScheduleRender();
 
+protected:
+
+    override BOOL OnChanged(
+        CMilSlaveResource *pSender,
+        NotificationEventArgs::Flags e
+        );
+
 private:
 
     HRESULT GetHandles(CMilSlaveHandleTable *pHandleTable);
+    HRESULT ResolveHandleBatch(
+        __in_ecount(1) CMilSlaveHandleTable *pHandleTable,
+        __in_ecount(1) const RenderDataHandleBatch *pBatch
+        );
+    HRESULT CompileInstructions();
     void DestroyRenderData();
 
+    HRESULT EnsureCullIndex();
+
+    HRESULT DrawCulled(
+        __in_ecount(1) IDrawingContext *pIDC,
+        __in_ecount(1) const CMilRectF &rcCullBoundsLocal
+        );
+
     HRESULT BeginBoundingFrame(
         __deref_in_range(>=, 0) __deref_out_range(==, 0) int *piCurrentFrameStackDepth,
         __ecount(1) CRectF<CoordinateSpace::LocalRendering> *prcBounds,
@@ -103,6 +209,30 @@ private:
 
     DynArray<CMilSlaveResource*, TRUE> m_rgpResources;
     DynArray<CGuidelineCollection*> m_rgpGuidelineKits;
+
+    //
+    // Compiled form of m_instructions, built once per ProcessUpdate. The
+    // resource pointers are not referenced; m_rgpResources holds the refs.
+    //
+
+    DynArray<RenderDataInstruction> m_rgInstructions;
+    DynArray<CMilSlaveResource*, TRUE> m_rgpInstructionResources;
+
+    //
+    // Lazily built culling index over the compiled instructions. Span bounds
+    // are grouped in blocks of sc_cCullSpansPerBlock consecutive spans so
+    // that whole blocks can be rejected without visiting their spans, while
+    // preserving the painter's order of the instructions.
+    //
+
+    static const UINT sc_cCullSpansPerBlock = 32;
+    static const UINT sc_cMinCullSpans = 64;
+
+    DynArray<RenderDataCullSpan> m_rgCullSpans;
+    DynArray<CMilRectF> m_rgCullBlockBounds;
+    UINT m_cCullIndexUses;
+    bool m_fCullIndexValid;
+    bool m_fDeferCullIndexBuild;
 };
 
 
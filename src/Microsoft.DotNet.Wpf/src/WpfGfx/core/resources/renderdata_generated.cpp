@@ -22,6 +22,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
     PVOID pItemData;
     UINT nItemDataSize;
     int stackDepth;
+    RenderDataHandleBatch handleBatch;
 
     //
     // Set up the command enumeration.
@@ -62,7 +63,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_LINE *pData = static_cast<MILCMD_DRAW_LINE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
                 }
 
 
@@ -76,9 +77,9 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_LINE_ANIMATE *pData = static_cast<MILCMD_DRAW_LINE_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPoint0Animations), TYPE_POINTRESOURCE, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPoint1Animations), TYPE_POINTRESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
+                    IFC(handleBatch.Add(&(pData->hPoint0Animations), TYPE_POINTRESOURCE));
+                    IFC(handleBatch.Add(&(pData->hPoint1Animations), TYPE_POINTRESOURCE));
                 }
 
 
@@ -92,8 +93,8 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_RECTANGLE *pData = static_cast<MILCMD_DRAW_RECTANGLE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
                 }
 
 
@@ -107,9 +108,9 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_RECTANGLE_ANIMATE *pData = static_cast<MILCMD_DRAW_RECTANGLE_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
+                    IFC(handleBatch.Add(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE));
                 }
 
 
@@ -123,8 +124,8 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_ROUNDED_RECTANGLE *pData = static_cast<MILCMD_DRAW_ROUNDED_RECTANGLE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
                 }
 
 
@@ -138,11 +139,11 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE *pData = static_cast<MILCMD_DRAW_ROUNDED_RECTANGLE_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRadiusXAnimations), TYPE_DOUBLERESOURCE, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRadiusYAnimations), TYPE_DOUBLERESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
+                    IFC(handleBatch.Add(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE));
+                    IFC(handleBatch.Add(&(pData->hRadiusXAnimations), TYPE_DOUBLERESOURCE));
+                    IFC(handleBatch.Add(&(pData->hRadiusYAnimations), TYPE_DOUBLERESOURCE));
                 }
 
 
@@ -156,8 +157,8 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_ELLIPSE *pData = static_cast<MILCMD_DRAW_ELLIPSE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
                 }
 
 
@@ -171,11 +172,11 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_ELLIPSE_ANIMATE *pData = static_cast<MILCMD_DRAW_ELLIPSE_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hCenterAnimations), TYPE_POINTRESOURCE, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRadiusXAnimations), TYPE_DOUBLERESOURCE, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRadiusYAnimations), TYPE_DOUBLERESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
+                    IFC(handleBatch.Add(&(pData->hCenterAnimations), TYPE_POINTRESOURCE));
+                    IFC(handleBatch.Add(&(pData->hRadiusXAnimations), TYPE_DOUBLERESOURCE));
+                    IFC(handleBatch.Add(&(pData->hRadiusYAnimations), TYPE_DOUBLERESOURCE));
                 }
 
 
@@ -189,9 +190,9 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_GEOMETRY *pData = static_cast<MILCMD_DRAW_GEOMETRY*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPen), TYPE_PEN, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hGeometry), TYPE_GEOMETRY, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hPen), TYPE_PEN));
+                    IFC(handleBatch.Add(&(pData->hGeometry), TYPE_GEOMETRY));
                 }
 
 
@@ -205,7 +206,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_IMAGE *pData = static_cast<MILCMD_DRAW_IMAGE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hImageSource), TYPE_IMAGESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hImageSource), TYPE_IMAGESOURCE));
                 }
 
 
@@ -219,8 +220,8 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_IMAGE_ANIMATE *pData = static_cast<MILCMD_DRAW_IMAGE_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hImageSource), TYPE_IMAGESOURCE, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hImageSource), TYPE_IMAGESOURCE));
+                    IFC(handleBatch.Add(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE));
                 }
 
 
@@ -234,8 +235,8 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_GLYPH_RUN *pData = static_cast<MILCMD_DRAW_GLYPH_RUN*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hForegroundBrush), TYPE_BRUSH, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hGlyphRun), TYPE_GLYPHRUN, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hForegroundBrush), TYPE_BRUSH));
+                    IFC(handleBatch.Add(&(pData->hGlyphRun), TYPE_GLYPHRUN));
                 }
 
 
@@ -249,7 +250,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_DRAWING *pData = static_cast<MILCMD_DRAW_DRAWING*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hDrawing), TYPE_DRAWING, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hDrawing), TYPE_DRAWING));
                 }
 
 
@@ -263,7 +264,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_VIDEO *pData = static_cast<MILCMD_DRAW_VIDEO*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPlayer), TYPE_MEDIAPLAYER, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hPlayer), TYPE_MEDIAPLAYER));
                 }
 
 
@@ -277,8 +278,8 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_DRAW_VIDEO_ANIMATE *pData = static_cast<MILCMD_DRAW_VIDEO_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hPlayer), TYPE_MEDIAPLAYER, &m_rgpResources, pHandleTable));
-                    IFC(AddHandleToArrayAndReplace(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hPlayer), TYPE_MEDIAPLAYER));
+                    IFC(handleBatch.Add(&(pData->hRectangleAnimations), TYPE_RECTRESOURCE));
                 }
 
 
@@ -292,7 +293,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_PUSH_CLIP *pData = static_cast<MILCMD_PUSH_CLIP*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hClipGeometry), TYPE_GEOMETRY, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hClipGeometry), TYPE_GEOMETRY));
                 }
 
                 stackDepth++;
@@ -306,7 +307,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_PUSH_OPACITY_MASK *pData = static_cast<MILCMD_PUSH_OPACITY_MASK*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hOpacityMask), TYPE_BRUSH, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hOpacityMask), TYPE_BRUSH));
                 }
 
                 stackDepth++;
@@ -324,7 +325,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_PUSH_OPACITY_ANIMATE *pData = static_cast<MILCMD_PUSH_OPACITY_ANIMATE*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hOpacityAnimations), TYPE_DOUBLERESOURCE, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hOpacityAnimations), TYPE_DOUBLERESOURCE));
                 }
 
                 stackDepth++;
@@ -338,7 +339,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_PUSH_TRANSFORM *pData = static_cast<MILCMD_PUSH_TRANSFORM*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hTransform), TYPE_TRANSFORM, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hTransform), TYPE_TRANSFORM));
                 }
 
                 stackDepth++;
@@ -352,7 +353,7 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
                     }
 
                     MILCMD_PUSH_GUIDELINE_SET *pData = static_cast<MILCMD_PUSH_GUIDELINE_SET*>(pItemData);
-                    IFC(AddHandleToArrayAndReplace(&(pData->hGuidelines), TYPE_GUIDELINESET, &m_rgpResources, pHandleTable));
+                    IFC(handleBatch.Add(&(pData->hGuidelines), TYPE_GUIDELINESET));
                 }
 
                 stackDepth++;
@@ -484,6 +485,12 @@ CMilSlaveRenderData::GetHandles(CMilSlaveHandleTable *pHandleTable)
         IFC(WGXERR_UCE_MALFORMEDPACKET);
     }
 
+    //
+    // Resolve all the collected resource handles at once
+    //
+
+    IFC(ResolveHandleBatch(pHandleTable, &handleBatch));
+
 Cleanup:
 
     Assert(SUCCEEDED(hr));
@@ -473,6 +473,7 @@ private:
 
 
     CPixelShaderState m_pixelShaderState;
+    CPixelShaderState m_fusedPixelShaderState;      // of the outer shader, when fused
     CPixelShaderCompiler *m_pPixelShaderCompiler;
     GenerateColorsEffect *m_pfnGenerateColorsEffectWeakRef;
     CMILBrushShaderEffect *m_pShaderEffectBrushNoRef;
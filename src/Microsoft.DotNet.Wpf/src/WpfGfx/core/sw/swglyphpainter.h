@@ -50,8 +50,52 @@ public:
 
     float GetEffectAlpha() const {return m_flEffectAlpha;}
 
+#if DBG
+    //
+    // A glyph run as the painter blends it, recorded with tagGlyphRunRecord
+    // and replayed by CSwRenderTargetBitmap::ReplayRecordedGlyphRuns without
+    // realizing it again. In the recording each record is followed by the
+    // bytes of the alpha array, which covers rcFiltered.
+    //
+    struct GlyphRunRecord
+    {
+        MILMatrix3x2 xfGlyphWR;
+        RECT rcFiltered;
+        UINT cGlyphs;
+        UINT uGammaIndex;
+        float flEffectAlpha;
+        float flBlueSubpixelOffset;
+        BOOL fIsClearType;
+        BOOL fDisableClearType;
+        BOOL fUseBilinear;
+    };
+
+    static const char sc_szRecordingFile[];
+
+    void InitForReplay(
+        __in_ecount(1) const GlyphRunRecord &record,
+        __in_ecount(cbAlphaArray) const BYTE *pAlphaArray,
+        UINT cbAlphaArray
+        );
+#endif
+
 private:
 
+    void InitScanOps(
+        __in_ecount(1) const RECT &rcf,
+        bool fUseBilinear,
+        float flBlueSubpixelOffset
+        );
+
+#if DBG
+    void RecordGlyphRun(
+        __in_ecount(1) const RECT &rcf,
+        bool fUseBilinear,
+        float flBlueSubpixelOffset,
+        UINT cGlyphs
+        ) const;
+#endif
+
     //
     // helper routines
     //
@@ -67,49 +111,49 @@ private:
     //
     // scan operations
     //
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpGreyScaleBilinearCopy(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpGreyScaleBilinearOver(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpGreyScaleLinearCopy(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpGreyScaleLinearOver(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpClearTypeBilinearCopy(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpClearTypeBilinearOver(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpClearTypeLinearCopy(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     static VOID FASTCALL ScanOpClearTypeLinearOver(
         __in_ecount(1) const PipelineParams *pPP,
         __in_ecount(1) const ScanOpParams *pSOP
@@ -118,21 +162,21 @@ private:
     //
     // scan operation helpers
     //
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     void ApplyGreyScaleCopy(
         unsigned __int32 alpha,
         unsigned __int32 src,
         unsigned __int32 &dst
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     void ApplyGreyScaleOver(
         unsigned __int32 alpha,
         unsigned __int32 src,
         unsigned __int32 &dst
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     void ApplyClearTypeCopy(
         unsigned __int32 alphaR,
         unsigned __int32 alphaG,
@@ -142,7 +186,7 @@ private:
         unsigned __int32 &dstColor
         );
 
-    template<bool fSrcHasAlspa>
+    template<bool fSrcHasAlpha>
     void ApplyClearTypeOver(
         unsigned __int32 alphaR,
         unsigned __int32 alphaG,
@@ -151,13 +195,56 @@ private:
         unsigned __int32 &dst
         );
 
+#if defined(_BUILD_SSE_)
+    //
+    // The helpers above for four pixels at once, in SSE2 registers
+    //
+    template<bool fSrcHasAlpha>
+    void ApplyGreyScaleCopySSE2(
+        __in_ecount(4) const unsigned __int32 *pAlpha,
+        __in_ecount(4) const unsigned __int32 *pSrc,
+        __out_ecount(4) unsigned __int32 *pDst
+        );
+
+    template<bool fSrcHasAlpha>
+    void ApplyGreyScaleOverSSE2(
+        __in_ecount(4) const unsigned __int32 *pAlpha,
+        __in_ecount(4) const unsigned __int32 *pSrc,
+        __inout_ecount(4) unsigned __int32 *pDst
+        );
+
+    template<bool fSrcHasAlpha>
+    void ApplyClearTypeCopySSE2(
+        __in_ecount(4) const unsigned __int32 *pAlphaR,
+        __in_ecount(4) const unsigned __int32 *pAlphaG,
+        __in_ecount(4) const unsigned __int32 *pAlphaB,
+        __inout_ecount(4) unsigned __int32 *pSrcAndDstColor,
+        __out_ecount(4) unsigned __int32 *pDstAlpha
+        );
+
+    template<bool fSrcHasAlpha>
+    void ApplyClearTypeOverSSE2(
+        __in_ecount(4) const unsigned __int32 *pAlphaR,
+        __in_ecount(4) const unsigned __int32 *pAlphaG,
+        __in_ecount(4) const unsigned __int32 *pAlphaB,
+        __in_ecount(4) const unsigned __int32 *pSrc,
+        __inout_ecount(4) unsigned __int32 *pDst
+        );
+#endif // _BUILD_SSE_
+
     MIL_FORCEINLINE __int32 GetAlphaBilinear(__int32 s, __int32 t) const;
 
+    UINT SelectSubpixelVariant();
+
 private:
 
     CSWGlyphRun* m_pSWGlyph;           // not addreffed
     BOOL m_fIsClearType;
 
+    // Alpha array being drawn: the one of m_pSWGlyph, or the one composed
+    // from the glyph atlas for this draw
+    BYTE const *m_pAlphaArrayToDraw;
+
     UINT m_uFilteredWidth, m_uFilteredHeight; // size of filtered rectangle
 
     //
@@ -24,6 +24,8 @@ void SwShutdown();
 
 extern bool g_fUseMMX;
 extern bool g_fUseSSE2;
+extern bool g_fUseAVX;
+extern bool g_fUseAVX2;
 
 void HwShutdown();
 
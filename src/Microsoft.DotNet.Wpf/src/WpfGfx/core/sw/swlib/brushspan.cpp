@@ -1680,6 +1680,10 @@ CShaderEffectBrushSpan::Initialize(
 
     m_pShaderEffectBrushNoRef = pShaderEffectBrush;
     m_pixelShaderState = CPixelShaderState(); // Initialize the pixel shader state.   
+    m_fusedPixelShaderState = CPixelShaderState();
+
+    // Filled in by effects that run fused with the effect applied to their output
+    m_pixelShaderState.m_pFusedShaderState = &m_fusedPixelShaderState;
 
     IFC(pShaderEffectBrush->PreparePass(
         pRealizationSamplingToDevice,
@@ -24,9 +24,20 @@
 #include "precomp.hpp"
 
 DeclareTag(tagShowGlyphAreaBase, "MIL_SW", "Show glyph area");
+DeclareTag(tagGlyphRunRecord, "MIL_SW", "Record glyph runs with their alpha maps for replay");
+
+#if DBG
+const char CSWGlyphRunPainter::sc_szRecordingFile[] = "c:\\glyphRuns.bin";
+#endif
 
 #define DBG_CORRECT(alpha) IF_DBG(if (IsTagEnabled(tagShowGlyphAreaBase) && alpha < 50) alpha = 50)
 
+// Pixels blended by the scan operations of each rendering mode, see perf.h
+DeclarePerfAcc(Text_SW_GreyScaleBilinear);
+DeclarePerfAcc(Text_SW_GreyScaleLinear);
+DeclarePerfAcc(Text_SW_ClearTypeBilinear);
+DeclarePerfAcc(Text_SW_ClearTypeLinear);
+
 
 //+-----------------------------------------------------------------------------
 //
@@ -85,10 +96,6 @@ CSWGlyphRunPainter::Init(
         goto Cleanup;
     }
 
-    RECT const &rcf = m_pSWGlyph->GetFilteredRect();
-    m_uFilteredWidth = rcf.right - rcf.left;
-    m_uFilteredHeight = rcf.bottom - rcf.top;
-
     // Inspect given transformation and settings.
     // When only translation is required, we'l go thru faster branch.
 
@@ -103,7 +110,84 @@ CSWGlyphRunPainter::Init(
     int dy = CFloatFPU::SmallRound(m_xfGlyphWR.m_21);
     bool fOffsetYIsInteger = fabs(m_xfGlyphWR.m_21 - float(dy)) < .01;
 
-    if (!fTranslation || !fOffsetYIsInteger || m_fDisableClearType)
+    bool fUseBilinear = !fTranslation || !fOffsetYIsInteger || m_fDisableClearType;
+
+    RECT rcf;
+
+    if (GetRealizationNoRef()->IsComposedFromAtlas())
+    {
+        UINT originPosition = 0;
+
+        if (!fUseBilinear)
+        {
+            originPosition = SelectSubpixelVariant();
+        }
+
+        BYTE *pAlphaArray;
+        UINT32 alphaArraySize;
+
+        IFC(m_pGlyphRunResource->ComposeAlphaMap(
+            GetRealizationNoRef(),
+            originPosition,
+            GetGlyphPainterMemory(),
+            &pAlphaArray,
+            &alphaArraySize,
+            &rcf
+            ));
+
+        if (IsRectEmpty(&rcf))
+        {
+            *pfVisible = FALSE;
+            goto Cleanup;
+        }
+
+        m_pAlphaArrayToDraw = pAlphaArray;
+    }
+    else
+    {
+        m_pAlphaArrayToDraw = m_pSWGlyph->GetAlphaArray();
+        rcf = m_pSWGlyph->GetFilteredRect();
+    }
+
+    InitScanOps(rcf, fUseBilinear, pars.pGlyphRun->BlueSubpixelOffset());
+
+    IFC(pars.pGlyphRun->GetGammaTable(pDisplaySettings, &m_pGammaTable));
+    Assert(m_pGammaTable);
+
+#if DBG
+    if (IsTagEnabled(tagGlyphRunRecord))
+    {
+        RecordGlyphRun(rcf, fUseBilinear, pars.pGlyphRun->BlueSubpixelOffset(), pars.pGlyphRun->GetGlyphCount());
+    }
+#endif
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::InitScanOps
+//
+//  Synopsis:
+//      Set up the mapping from render space to the alpha array being drawn,
+//      which covers filtered rectangle rcf, and choose the scan operations.
+//      Bilinear ones are used unless the glyph run is only translated, by
+//      an integer offset along Y.
+//
+//------------------------------------------------------------------------------
+void
+CSWGlyphRunPainter::InitScanOps(
+    __in_ecount(1) const RECT &rcf,
+    bool fUseBilinear,
+    float flBlueSubpixelOffset
+    )
+{
+    m_uFilteredWidth = rcf.right - rcf.left;
+    m_uFilteredHeight = rcf.bottom - rcf.top;
+
+    if (fUseBilinear)
     {
         // Complex transformation handling.
 
@@ -167,7 +251,7 @@ CSWGlyphRunPainter::Init(
         }
         else
         {
-            float blueSubpixelOffset = pars.pGlyphRun->BlueSubpixelOffset()*float(0x10000);
+            float blueSubpixelOffset = flBlueSubpixelOffset*float(0x10000);
             m_ds = CFloatFPU::Trunc(xfGlyphRT.m_00*blueSubpixelOffset);
             m_dt = CFloatFPU::Trunc(xfGlyphRT.m_01*blueSubpixelOffset);
         }
@@ -199,6 +283,8 @@ CSWGlyphRunPainter::Init(
         // calculate offsets to transform rendering space to glyph texture
         // 
 
+        int dy = CFloatFPU::SmallRound(m_xfGlyphWR.m_21);
+
         float offsetS = -3*m_xfGlyphWR.m_20 - float(rcf.left) + 1;
         m_offsetS = CFloatFPU::SmallFloor(offsetS);
         m_fractionS = CFloatFPU::SmallFloor((offsetS - float(m_offsetS))*0x10000);
@@ -231,12 +317,126 @@ CSWGlyphRunPainter::Init(
         m_rcfGlyphRun.top = static_cast<float>(rcf.top);
         m_rcfGlyphRun.bottom = static_cast<float>(rcf.bottom);
     }
+}
 
-    IFC(pars.pGlyphRun->GetGammaTable(pDisplaySettings, &m_pGammaTable));
-    Assert(m_pGammaTable);
+#if DBG
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::RecordGlyphRun
+//
+//  Synopsis:
+//      Append the glyph run, as it is about to be blended, and its alpha
+//      array to the recording. Failing to write only loses the record.
+//
+//------------------------------------------------------------------------------
+void
+CSWGlyphRunPainter::RecordGlyphRun(
+    __in_ecount(1) const RECT &rcf,
+    bool fUseBilinear,
+    float flBlueSubpixelOffset,
+    UINT cGlyphs
+    ) const
+{
+    GlyphRunRecord record;
+
+    record.xfGlyphWR = m_xfGlyphWR;
+    record.rcFiltered = rcf;
+    record.cGlyphs = cGlyphs;
+    record.uGammaIndex = static_cast<UINT>(m_pGammaTable - g_GammaHandler.GetGammaTable(0));
+    record.flEffectAlpha = m_flEffectAlpha;
+    record.flBlueSubpixelOffset = flBlueSubpixelOffset;
+    record.fIsClearType = m_fIsClearType;
+    record.fDisableClearType = m_fDisableClearType;
+    record.fUseBilinear = fUseBilinear;
+
+    Assert(record.uGammaIndex <= MAX_GAMMA_INDEX);
+
+    FILE *pFile = fopen(sc_szRecordingFile, "ab");
+    if (pFile)
+    {
+        fwrite(&record, sizeof(record), 1, pFile);
+        fwrite(m_pAlphaArrayToDraw, 1, m_uFilteredWidth*m_uFilteredHeight, pFile);
+        fclose(pFile);
+    }
+}
 
-Cleanup:
-    RRETURN(hr);
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::InitForReplay
+//
+//  Synopsis:
+//      Prepare to blend a recorded glyph run, instead of Init. The painter
+//      has no realization, so only the scan operations can be used.
+//
+//------------------------------------------------------------------------------
+void
+CSWGlyphRunPainter::InitForReplay(
+    __in_ecount(1) const GlyphRunRecord &record,
+    __in_ecount(cbAlphaArray) const BYTE *pAlphaArray,
+    UINT cbAlphaArray
+    )
+{
+    Assert(record.uGammaIndex <= MAX_GAMMA_INDEX);
+    Assert(cbAlphaArray == static_cast<UINT>(
+                               (record.rcFiltered.right - record.rcFiltered.left)
+                             * (record.rcFiltered.bottom - record.rcFiltered.top)
+                             ));
+
+    m_xfGlyphWR = record.xfGlyphWR;
+    m_fIsClearType = record.fIsClearType;
+    m_fDisableClearType = !!record.fDisableClearType;
+    m_flEffectAlpha = record.flEffectAlpha;
+
+    m_pSWGlyph = NULL;
+    m_pAlphaArrayToDraw = pAlphaArray;
+    m_pGammaTable = g_GammaHandler.GetGammaTable(record.uGammaIndex);
+
+    InitScanOps(record.rcFiltered, !!record.fUseBilinear, record.flBlueSubpixelOffset);
+}
+#endif
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::SelectSubpixelVariant
+//
+//  Synopsis:
+//      For translation-only rendering of a realization with subpixel
+//      variants, returns the run origin position, in quarters of a pixel,
+//      closest to the fractional part of the X offset, and moves the X
+//      offset to a whole pixel. The alpha map composed at that position is
+//      then copied rather than interpolated between texels, so text moved
+//      by fractions of a pixel keeps its sharpness. Returns 0 otherwise.
+//
+//------------------------------------------------------------------------------
+UINT
+CSWGlyphRunPainter::SelectSubpixelVariant()
+{
+    static const UINT c_cPositions = CGlyphAtlas::sc_cSubpixelPositions;
+
+    UINT position = 0;
+
+    float const offsetX = m_xfGlyphWR.m_20;
+    float pixelX = floorf(offsetX);
+
+    if (   offsetX != pixelX
+        && m_pGlyphRunResource->HasSubpixelVariants(GetRealizationNoRef()))
+    {
+        position = CFloatFPU::SmallRound((offsetX - pixelX) * c_cPositions);
+        if (position == c_cPositions)
+        {
+            position = 0;
+            pixelX += 1;
+        }
+
+        // The variant carries the fraction of a pixel, draw it at a whole one
+        m_xfGlyphWR.m_20 = pixelX;
+        m_xfGlyphRW.SetInverse(m_xfGlyphWR);
+    }
+
+    return position;
 }
 
 //+-----------------------------------------------------------------------------
@@ -329,7 +529,7 @@ CSWGlyphRunPainter::GetAlphaBilinear(__int32 s, __int32 t) const
 
     unsigned width  = m_uFilteredWidth;
     unsigned height = m_uFilteredHeight;
-    unsigned char const *pAlpha = m_pSWGlyph->GetAlphaArray() + it*(int)width + is;
+    unsigned char const *pAlpha = m_pAlphaArrayToDraw + it*(int)width + is;
 
     __int32 alpha00, alpha01, alpha10, alpha11;
     if ((unsigned)is < width-1 && (unsigned)it < height-1)
@@ -788,6 +988,748 @@ CSWGlyphRunPainter::ApplyClearTypeOver(
          | (dst_ab       );
 }
 
+#if defined(_BUILD_SSE_)
+
+//
+// The SSE2 helpers below blend four pixels at once, with results identical
+// to the scalar helpers above. The pixels are kept in two registers of 16
+// bit lanes, pixels 0 and 1 in the low one and 2 and 3 in the high one,
+// each pixel in memory order (B, G, R, A). Only the reciprocals for
+// unpremultiplying and the gamma polynom rows are looked up per pixel or
+// channel; everything else, special cases included, is computed for all
+// lanes and selected with masks.
+//
+
+#define DBG_CORRECT_SSE2(alpha) IF_DBG(if (IsTagEnabled(tagShowGlyphAreaBase)) alpha = _mm_max_epi16(alpha, _mm_set1_epi32(50)))
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      SelectSSE2
+//
+//  Synopsis:
+//      Take the bits of ifSet where mask is set and those of ifClear
+//      elsewhere.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE __m128i
+SelectSSE2(
+    __m128i mask,
+    __m128i ifSet,
+    __m128i ifClear
+    )
+{
+    return _mm_or_si128(_mm_and_si128(mask, ifSet), _mm_andnot_si128(mask, ifClear));
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      BroadcastWordSSE2
+//
+//  Synopsis:
+//      Copy 16 bit lane iWord of each pixel (lanes 0-3 and 4-7) to all four
+//      lanes of that pixel.
+//
+//------------------------------------------------------------------------------
+template<int iWord>
+MIL_FORCEINLINE __m128i
+BroadcastWordSSE2(
+    __m128i x
+    )
+{
+    static const int c_shuffle = iWord * 0x55;
+
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, c_shuffle), c_shuffle);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      UnpremultiplySSE2
+//
+//  Synopsis:
+//      Unpremultiply the colors of the two pixels in color by their alpha in
+//      colorA, the way GetReciprocal is used by the scalar helpers.
+//
+//      The reciprocal is split in 16 bit halves: since its high half is at
+//      most 255, (color * reciprocal) >> 16 is
+//      color * high + ((color * low) >> 16), and both fit in 16 bits for
+//      premultiplied colors. The alpha lanes get garbage.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE __m128i
+UnpremultiplySSE2(
+    __m128i color,
+    __m128i reciprocals
+    )
+{
+    return _mm_add_epi16(
+        _mm_mullo_epi16(color, BroadcastWordSSE2<1>(reciprocals)),
+        _mm_mulhi_epu16(color, BroadcastWordSSE2<0>(reciprocals))
+        );
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      UnpackAndUnpremultiplySSE2
+//
+//  Synopsis:
+//      Unpack four brush pixels to 16 bit lanes, unpremultiplied if
+//      fSrcHasAlpha, with 0x100 in the alpha lanes so that a premultiply by
+//      the corrected alpha leaves the corrected alpha there.
+//
+//------------------------------------------------------------------------------
+template<bool fSrcHasAlpha>
+MIL_FORCEINLINE void
+UnpackAndUnpremultiplySSE2(
+    __m128i src,
+    __m128i colorA,
+    __out_ecount(1) __m128i &colorLo,
+    __out_ecount(1) __m128i &colorHi
+    )
+{
+    __m128i zero = _mm_setzero_si128();
+
+    colorLo = _mm_unpacklo_epi8(src, zero);
+    colorHi = _mm_unpackhi_epi8(src, zero);
+
+    if (fSrcHasAlpha)
+    {
+        __m128i reciprocals = _mm_set_epi32(
+            UnpremultiplyTable[_mm_extract_epi16(colorA, 6)],
+            UnpremultiplyTable[_mm_extract_epi16(colorA, 4)],
+            UnpremultiplyTable[_mm_extract_epi16(colorA, 2)],
+            UnpremultiplyTable[_mm_extract_epi16(colorA, 0)]
+            );
+
+        colorLo = UnpremultiplySSE2(colorLo, _mm_unpacklo_epi32(reciprocals, reciprocals));
+        colorHi = UnpremultiplySSE2(colorHi, _mm_unpackhi_epi32(reciprocals, reciprocals));
+    }
+
+    __m128i colorMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    __m128i alphaLanes = _mm_set_epi16(0x100, 0, 0, 0, 0x100, 0, 0, 0);
+
+    colorLo = _mm_or_si128(_mm_and_si128(colorLo, colorMask), alphaLanes);
+    colorHi = _mm_or_si128(_mm_and_si128(colorHi, colorMask), alphaLanes);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      GammaRowSSE2
+//
+//  Synopsis:
+//      The gamma polynom row of an alpha, f1 in the low byte and f2 in the
+//      high one.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE int
+GammaRowSSE2(
+    __in_ecount(1) const GammaTable *pGammaTable,
+    int alpha
+    )
+{
+    C_ASSERT(sizeof(GammaTable::Row) == sizeof(UINT16));
+
+    return *reinterpret_cast<const UINT16 *>(&pGammaTable->Polynom[alpha]);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      GetGreyScaleGammaRowsSSE2
+//
+//  Synopsis:
+//      Look up the gamma polynom rows of the combined alpha of four pixels,
+//      one per 32 bit lane, and spread each to the four lanes of its pixel.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE void
+GetGreyScaleGammaRowsSSE2(
+    __in_ecount(1) const GammaTable *pGammaTable,
+    __m128i alphaCombined,
+    __out_ecount(1) __m128i &rowsLo,
+    __out_ecount(1) __m128i &rowsHi
+    )
+{
+    __m128i rows = _mm_cvtsi32_si128(GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 0)));
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 2)), 1);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 4)), 2);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 6)), 3);
+
+    rows = _mm_unpacklo_epi16(rows, rows);
+    rowsLo = _mm_unpacklo_epi32(rows, rows);
+    rowsHi = _mm_unpackhi_epi32(rows, rows);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      GetClearTypeGammaRowsSSE2
+//
+//  Synopsis:
+//      Look up the gamma polynom rows of the combined alphas of the color
+//      lanes of two pixels. The alpha lanes are not corrected: their row has
+//      the alpha as f1 and 0 as f2.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE __m128i
+GetClearTypeGammaRowsSSE2(
+    __in_ecount(1) const GammaTable *pGammaTable,
+    __m128i alphaCombined
+    )
+{
+    __m128i rows = _mm_and_si128(alphaCombined, _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0));
+
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 0)), 0);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 1)), 1);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 2)), 2);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 4)), 4);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 5)), 5);
+    rows = _mm_insert_epi16(rows, GammaRowSSE2(pGammaTable, _mm_extract_epi16(alphaCombined, 6)), 6);
+
+    return rows;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      CorrectAlphaSSE2
+//
+//  Synopsis:
+//      f1 + (f2 * correctionColor >> 8) for each 16 bit lane, which is
+//      ApplyAlphaCorrection given the gamma polynom rows.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE __m128i
+CorrectAlphaSSE2(
+    __m128i rows,
+    __m128i correctionColor
+    )
+{
+    __m128i f1 = _mm_and_si128(rows, _mm_set1_epi16(0xFF));
+    __m128i f2 = _mm_srli_epi16(rows, 8);
+
+    return _mm_add_epi16(f1, _mm_srli_epi16(_mm_mullo_epi16(f2, correctionColor), 8));
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      PremultiplySSE2
+//
+//  Synopsis:
+//      color * alpha >> 8 for each 16 bit lane. All products fit in 16 bits:
+//      colors and alphas are at most 255, and color is 0x100 in alpha lanes.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE __m128i
+PremultiplySSE2(
+    __m128i color,
+    __m128i alpha
+    )
+{
+    return _mm_srli_epi16(_mm_mullo_epi16(color, alpha), 8);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      BlendOverSSE2
+//
+//  Synopsis:
+//      (dst * (255 - alpha) >> 8) + premultiplied for each 16 bit lane.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE __m128i
+BlendOverSSE2(
+    __m128i dst,
+    __m128i alpha,
+    __m128i premultiplied
+    )
+{
+    __m128i alphaInv = _mm_sub_epi16(_mm_set1_epi16(0xFF), alpha);
+
+    return _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(dst, alphaInv), 8), premultiplied);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      GetGreyScaleCorrectedSSE2
+//
+//  Synopsis:
+//      The corrected alphas of four pixels for grey scale smoothing, spread
+//      to the four lanes of each pixel. Like ApplyGreyScaleCopy, the
+//      correction uses the average luminance (R + 2G + B) / 4.
+//
+//------------------------------------------------------------------------------
+MIL_FORCEINLINE void
+GetGreyScaleCorrectedSSE2(
+    __in_ecount(1) const GammaTable *pGammaTable,
+    __m128i alphaCombined,
+    __m128i colorLo,
+    __m128i colorHi,
+    __out_ecount(1) __m128i &correctedLo,
+    __out_ecount(1) __m128i &correctedHi
+    )
+{
+    // (B + 2G) and R in 32 bit lanes, summed per pixel in the low one
+    __m128i weights = _mm_set_epi16(0, 1, 2, 1, 0, 1, 2, 1);
+    __m128i sumLo = _mm_madd_epi16(colorLo, weights);
+    __m128i sumHi = _mm_madd_epi16(colorHi, weights);
+    sumLo = _mm_add_epi32(sumLo, _mm_srli_epi64(sumLo, 32));
+    sumHi = _mm_add_epi32(sumHi, _mm_srli_epi64(sumHi, 32));
+
+    __m128i averageLo = BroadcastWordSSE2<0>(_mm_srli_epi32(sumLo, 2));
+    __m128i averageHi = BroadcastWordSSE2<0>(_mm_srli_epi32(sumHi, 2));
+
+    __m128i rowsLo, rowsHi;
+    GetGreyScaleGammaRowsSSE2(pGammaTable, alphaCombined, rowsLo, rowsHi);
+
+    correctedLo = CorrectAlphaSSE2(rowsLo, averageLo);
+    correctedHi = CorrectAlphaSSE2(rowsHi, averageHi);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Function:
+//      UnpackClearTypeAlphaSSE2
+//
+//  Synopsis:
+//      Spread the glyph alphas of four pixels to the (B, G, R, A) lanes of
+//      two registers, combined with the brush alpha if fSrcHasAlpha.
+//
+//------------------------------------------------------------------------------
+template<bool fSrcHasAlpha>
+MIL_FORCEINLINE void
+UnpackClearTypeAlphaSSE2(
+    __m128i alphaR,
+    __m128i alphaG,
+    __m128i alphaB,
+    __m128i alphaA,
+    __m128i src,
+    __out_ecount(1) __m128i &alphaLo,
+    __out_ecount(1) __m128i &alphaHi
+    )
+{
+    __m128i alphaBG = _mm_or_si128(alphaB, _mm_slli_epi32(alphaG, 16));
+    __m128i alphaRA = _mm_or_si128(alphaR, _mm_slli_epi32(alphaA, 16));
+
+    alphaLo = _mm_unpacklo_epi32(alphaBG, alphaRA);
+    alphaHi = _mm_unpackhi_epi32(alphaBG, alphaRA);
+
+    if (fSrcHasAlpha)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i colorALo = BroadcastWordSSE2<3>(_mm_unpacklo_epi8(src, zero));
+        __m128i colorAHi = BroadcastWordSSE2<3>(_mm_unpackhi_epi8(src, zero));
+
+        alphaLo = _mm_srli_epi16(_mm_mullo_epi16(alphaLo, colorALo), 8);
+        alphaHi = _mm_srli_epi16(_mm_mullo_epi16(alphaHi, colorAHi), 8);
+    }
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::ApplyGreyScaleCopySSE2
+//
+//  Synopsis:
+//      ApplyGreyScaleCopy for four pixels, with identical results.
+//
+//------------------------------------------------------------------------------
+template<bool fSrcHasAlpha>
+void
+CSWGlyphRunPainter::ApplyGreyScaleCopySSE2(
+    __in_ecount(4) const unsigned __int32 *pAlpha,
+    __in_ecount(4) const unsigned __int32 *pSrc,
+    __out_ecount(4) unsigned __int32 *pDst
+    )
+{
+#if DBG
+    // Result of the scalar path, which the scan ops use for the tail of
+    // each span, to check that both paths blend alike
+    unsigned __int32 rgDstExpected[4];
+    for (UINT i = 0; i < 4; i++)
+    {
+        ApplyGreyScaleCopy<fSrcHasAlpha>(pAlpha[i], pSrc[i], rgDstExpected[i]);
+    }
+#endif
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i opaque = _mm_set1_epi32(0xFF);
+
+    __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlpha));
+    DBG_CORRECT_SSE2(alpha);
+
+    __m128i fTransparent = _mm_cmpeq_epi32(alpha, zero);
+    __m128i fOpaque = _mm_cmpeq_epi32(alpha, opaque);
+
+    __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc));
+    __m128i result = fSrcHasAlpha ? src : _mm_or_si128(src, _mm_set1_epi32(static_cast<int>(0xFF000000)));
+
+    if (_mm_movemask_epi8(_mm_or_si128(fTransparent, fOpaque)) != 0xFFFF)
+    {
+        __m128i colorA = _mm_srli_epi32(src, 24);
+        __m128i alphaCombined = alpha;
+
+        if (fSrcHasAlpha)
+        {
+            alphaCombined = _mm_srli_epi32(_mm_mullo_epi16(alpha, colorA), 8);
+        }
+
+        __m128i colorLo, colorHi;
+        UnpackAndUnpremultiplySSE2<fSrcHasAlpha>(src, colorA, colorLo, colorHi);
+
+        __m128i correctedLo, correctedHi;
+        GetGreyScaleCorrectedSSE2(m_pGammaTable, alphaCombined, colorLo, colorHi, correctedLo, correctedHi);
+
+        __m128i blended = _mm_packus_epi16(
+            PremultiplySSE2(colorLo, correctedLo),
+            PremultiplySSE2(colorHi, correctedHi)
+            );
+
+        if (fSrcHasAlpha)
+        {
+            blended = _mm_andnot_si128(_mm_cmpeq_epi32(colorA, zero), blended);
+        }
+
+        result = SelectSSE2(fOpaque, result, blended);
+    }
+
+    result = _mm_andnot_si128(fTransparent, result);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst), result);
+
+#if DBG
+    for (UINT i = 0; i < 4; i++)
+    {
+        Assert(pDst[i] == rgDstExpected[i]);
+    }
+#endif
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::ApplyGreyScaleOverSSE2
+//
+//  Synopsis:
+//      ApplyGreyScaleOver for four pixels, with identical results.
+//
+//------------------------------------------------------------------------------
+template<bool fSrcHasAlpha>
+void
+CSWGlyphRunPainter::ApplyGreyScaleOverSSE2(
+    __in_ecount(4) const unsigned __int32 *pAlpha,
+    __in_ecount(4) const unsigned __int32 *pSrc,
+    __inout_ecount(4) unsigned __int32 *pDst
+    )
+{
+#if DBG
+    // Result of the scalar path, which the scan ops use for the tail of
+    // each span, to check that both paths blend alike
+    unsigned __int32 rgDstExpected[4];
+    for (UINT i = 0; i < 4; i++)
+    {
+        rgDstExpected[i] = pDst[i];
+        ApplyGreyScaleOver<fSrcHasAlpha>(pAlpha[i], pSrc[i], rgDstExpected[i]);
+    }
+#endif
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i opaque = _mm_set1_epi32(0xFF);
+
+    __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlpha));
+    DBG_CORRECT_SSE2(alpha);
+
+    __m128i fTransparent = _mm_cmpeq_epi32(alpha, zero);
+
+    if (_mm_movemask_epi8(fTransparent) != 0xFFFF)
+    {
+        __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc));
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pDst));
+        __m128i colorA = _mm_srli_epi32(src, 24);
+        __m128i fOpaque;
+
+        if (fSrcHasAlpha)
+        {
+            fTransparent = _mm_or_si128(fTransparent, _mm_cmpeq_epi32(colorA, zero));
+            fOpaque = _mm_cmpeq_epi32(_mm_and_si128(alpha, colorA), opaque);
+        }
+        else
+        {
+            fOpaque = _mm_cmpeq_epi32(alpha, opaque);
+        }
+
+        __m128i result = src;
+
+        if (_mm_movemask_epi8(_mm_or_si128(fTransparent, fOpaque)) != 0xFFFF)
+        {
+            __m128i alphaCombined = alpha;
+
+            if (fSrcHasAlpha)
+            {
+                alphaCombined = _mm_srli_epi32(_mm_mullo_epi16(alpha, colorA), 8);
+            }
+
+            __m128i colorLo, colorHi;
+            UnpackAndUnpremultiplySSE2<fSrcHasAlpha>(src, colorA, colorLo, colorHi);
+
+            __m128i correctedLo, correctedHi;
+            GetGreyScaleCorrectedSSE2(m_pGammaTable, alphaCombined, colorLo, colorHi, correctedLo, correctedHi);
+
+            __m128i blendedLo = BlendOverSSE2(
+                _mm_unpacklo_epi8(dst, zero),
+                correctedLo,
+                PremultiplySSE2(colorLo, correctedLo)
+                );
+            __m128i blendedHi = BlendOverSSE2(
+                _mm_unpackhi_epi8(dst, zero),
+                correctedHi,
+                PremultiplySSE2(colorHi, correctedHi)
+                );
+
+            result = SelectSSE2(fOpaque, result, _mm_packus_epi16(blendedLo, blendedHi));
+        }
+
+        result = SelectSSE2(fTransparent, dst, result);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst), result);
+    }
+
+#if DBG
+    for (UINT i = 0; i < 4; i++)
+    {
+        Assert(pDst[i] == rgDstExpected[i]);
+    }
+#endif
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::ApplyClearTypeCopySSE2
+//
+//  Synopsis:
+//      ApplyClearTypeCopy for four pixels, with identical results. Like
+//      ScanOpClearTypeLinearCopy, the brush colors are overwritten with the
+//      output colors.
+//
+//------------------------------------------------------------------------------
+template<bool fSrcHasAlpha>
+void
+CSWGlyphRunPainter::ApplyClearTypeCopySSE2(
+    __in_ecount(4) const unsigned __int32 *pAlphaR,
+    __in_ecount(4) const unsigned __int32 *pAlphaG,
+    __in_ecount(4) const unsigned __int32 *pAlphaB,
+    __inout_ecount(4) unsigned __int32 *pSrcAndDstColor,
+    __out_ecount(4) unsigned __int32 *pDstAlpha
+    )
+{
+#if DBG
+    // Result of the scalar path, which the scan ops use for the tail of
+    // each span, to check that both paths blend alike
+    unsigned __int32 rgDstAlphaExpected[4];
+    unsigned __int32 rgDstColorExpected[4];
+    for (UINT i = 0; i < 4; i++)
+    {
+        ApplyClearTypeCopy<fSrcHasAlpha>(
+            pAlphaR[i],
+            pAlphaG[i],
+            pAlphaB[i],
+            pSrcAndDstColor[i],
+            rgDstAlphaExpected[i],
+            rgDstColorExpected[i]
+            );
+    }
+#endif
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i opaque = _mm_set1_epi32(0xFF);
+    __m128i colorMask = _mm_set1_epi32(0xFFFFFF);
+
+    __m128i alphaR = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlphaR));
+    __m128i alphaG = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlphaG));
+    __m128i alphaB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlphaB));
+    DBG_CORRECT_SSE2(alphaR);
+    DBG_CORRECT_SSE2(alphaG);
+    DBG_CORRECT_SSE2(alphaB);
+
+    __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrcAndDstColor));
+    __m128i colorA = _mm_srli_epi32(src, 24);
+
+    __m128i alphaAll = _mm_and_si128(_mm_and_si128(alphaR, alphaG), alphaB);
+    __m128i fTransparent;
+    __m128i fOpaque;
+
+    if (fSrcHasAlpha)
+    {
+        fTransparent = _mm_or_si128(
+            _mm_cmpeq_epi32(_mm_or_si128(_mm_or_si128(alphaR, alphaG), alphaB), zero),
+            _mm_cmpeq_epi32(colorA, zero)
+            );
+        fOpaque = _mm_cmpeq_epi32(_mm_and_si128(alphaAll, colorA), opaque);
+    }
+    else
+    {
+        fTransparent = zero;
+        fOpaque = _mm_cmpeq_epi32(alphaAll, opaque);
+    }
+
+    __m128i resultAlpha = colorMask;
+    __m128i resultColor = _mm_and_si128(src, colorMask);
+
+    if (_mm_movemask_epi8(_mm_or_si128(fTransparent, fOpaque)) != 0xFFFF)
+    {
+        __m128i alphaLo, alphaHi;
+        UnpackClearTypeAlphaSSE2<fSrcHasAlpha>(alphaR, alphaG, alphaB, zero, src, alphaLo, alphaHi);
+
+        __m128i colorLo, colorHi;
+        UnpackAndUnpremultiplySSE2<fSrcHasAlpha>(src, colorA, colorLo, colorHi);
+
+        // The alpha lanes stay zero: both outputs have zero there
+        __m128i correctedLo = CorrectAlphaSSE2(GetClearTypeGammaRowsSSE2(m_pGammaTable, alphaLo), colorLo);
+        __m128i correctedHi = CorrectAlphaSSE2(GetClearTypeGammaRowsSSE2(m_pGammaTable, alphaHi), colorHi);
+
+        resultAlpha = SelectSSE2(
+            fOpaque,
+            resultAlpha,
+            _mm_packus_epi16(correctedLo, correctedHi)
+            );
+        resultColor = SelectSSE2(
+            fOpaque,
+            resultColor,
+            _mm_packus_epi16(PremultiplySSE2(colorLo, correctedLo), PremultiplySSE2(colorHi, correctedHi))
+            );
+    }
+
+    resultAlpha = _mm_andnot_si128(fTransparent, resultAlpha);
+    resultColor = _mm_andnot_si128(fTransparent, resultColor);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pDstAlpha), resultAlpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pSrcAndDstColor), resultColor);
+
+#if DBG
+    for (UINT i = 0; i < 4; i++)
+    {
+        Assert(pDstAlpha[i] == rgDstAlphaExpected[i]);
+        Assert(pSrcAndDstColor[i] == rgDstColorExpected[i]);
+    }
+#endif
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSWGlyphRunPainter::ApplyClearTypeOverSSE2
+//
+//  Synopsis:
+//      ApplyClearTypeOver for four pixels, with identical results.
+//
+//------------------------------------------------------------------------------
+template<bool fSrcHasAlpha>
+void
+CSWGlyphRunPainter::ApplyClearTypeOverSSE2(
+    __in_ecount(4) const unsigned __int32 *pAlphaR,
+    __in_ecount(4) const unsigned __int32 *pAlphaG,
+    __in_ecount(4) const unsigned __int32 *pAlphaB,
+    __in_ecount(4) const unsigned __int32 *pSrc,
+    __inout_ecount(4) unsigned __int32 *pDst
+    )
+{
+#if DBG
+    // Result of the scalar path, which the scan ops use for the tail of
+    // each span, to check that both paths blend alike
+    unsigned __int32 rgDstExpected[4];
+    for (UINT i = 0; i < 4; i++)
+    {
+        rgDstExpected[i] = pDst[i];
+        ApplyClearTypeOver<fSrcHasAlpha>(pAlphaR[i], pAlphaG[i], pAlphaB[i], pSrc[i], rgDstExpected[i]);
+    }
+#endif
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i opaque = _mm_set1_epi32(0xFF);
+
+    __m128i alphaR = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlphaR));
+    __m128i alphaG = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlphaG));
+    __m128i alphaB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pAlphaB));
+    DBG_CORRECT_SSE2(alphaR);
+    DBG_CORRECT_SSE2(alphaG);
+    DBG_CORRECT_SSE2(alphaB);
+
+    __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc));
+    __m128i colorA = _mm_srli_epi32(src, 24);
+
+    __m128i alphaAll = _mm_and_si128(_mm_and_si128(alphaR, alphaG), alphaB);
+    __m128i fTransparent;
+    __m128i fOpaque;
+
+    if (fSrcHasAlpha)
+    {
+        fTransparent = _mm_or_si128(
+            _mm_cmpeq_epi32(_mm_or_si128(_mm_or_si128(alphaR, alphaG), alphaB), zero),
+            _mm_cmpeq_epi32(colorA, zero)
+            );
+        fOpaque = _mm_cmpeq_epi32(_mm_and_si128(alphaAll, colorA), opaque);
+    }
+    else
+    {
+        fTransparent = zero;
+        fOpaque = _mm_cmpeq_epi32(alphaAll, opaque);
+    }
+
+    if (_mm_movemask_epi8(fTransparent) != 0xFFFF)
+    {
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pDst));
+        __m128i result = _mm_or_si128(src, _mm_set1_epi32(static_cast<int>(0xFF000000)));
+
+        if (_mm_movemask_epi8(_mm_or_si128(fTransparent, fOpaque)) != 0xFFFF)
+        {
+            // Overall alpha is taken from the green channel, see
+            // ApplyClearTypeOver, and is not gamma corrected
+            __m128i alphaLo, alphaHi;
+            UnpackClearTypeAlphaSSE2<fSrcHasAlpha>(alphaR, alphaG, alphaB, alphaG, src, alphaLo, alphaHi);
+
+            __m128i colorLo, colorHi;
+            UnpackAndUnpremultiplySSE2<fSrcHasAlpha>(src, colorA, colorLo, colorHi);
+
+            __m128i correctedLo = CorrectAlphaSSE2(GetClearTypeGammaRowsSSE2(m_pGammaTable, alphaLo), colorLo);
+            __m128i correctedHi = CorrectAlphaSSE2(GetClearTypeGammaRowsSSE2(m_pGammaTable, alphaHi), colorHi);
+
+            __m128i blendedLo = BlendOverSSE2(
+                _mm_unpacklo_epi8(dst, zero),
+                correctedLo,
+                PremultiplySSE2(colorLo, correctedLo)
+                );
+            __m128i blendedHi = BlendOverSSE2(
+                _mm_unpackhi_epi8(dst, zero),
+                correctedHi,
+                PremultiplySSE2(colorHi, correctedHi)
+                );
+
+            result = SelectSSE2(fOpaque, result, _mm_packus_epi16(blendedLo, blendedHi));
+        }
+
+        result = SelectSSE2(fTransparent, dst, result);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst), result);
+    }
+
+#if DBG
+    for (UINT i = 0; i < 4; i++)
+    {
+        Assert(pDst[i] == rgDstExpected[i]);
+    }
+#endif
+}
+
+#endif // _BUILD_SSE_
+
 //+========================================================================
 //+
 //+                         SCAN OPERATIONS
@@ -846,6 +1788,8 @@ CSWGlyphRunPainter::ScanOpGreyScaleBilinearCopy(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_GreyScaleBilinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -858,7 +1802,30 @@ CSWGlyphRunPainter::ScanOpGreyScaleBilinearCopy(
     __int32 s = x*pThis->m_m00 + y*pThis->m_m10 + pThis->m_m20;
     __int32 t = x*pThis->m_m01 + y*pThis->m_m11 + pThis->m_m21;
 
-    for (UINT i = 0; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
+    UINT i = 0;
+
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned __int32 rgAlpha[4];
+
+            for (int j = 0; j < 4; j++, s += pThis->m_m00, t += pThis->m_m01)
+            {
+                rgAlpha[j] = pThis->GetAlphaBilinear(s, t);
+            }
+
+            pThis->ApplyGreyScaleCopySSE2<fSrcHasAlpha>(
+                rgAlpha,
+                &((unsigned __int32*)pSrc)[i],
+                &((unsigned __int32*)pDst)[i]
+                );
+        }
+    }
+#endif
+
+    for (; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
     {
         unsigned __int32  src = ((unsigned __int32*)pSrc)[i];
         unsigned __int32& dst = ((unsigned __int32*)pDst)[i];
@@ -894,6 +1861,8 @@ CSWGlyphRunPainter::ScanOpGreyScaleBilinearOver(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_GreyScaleBilinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -906,7 +1875,30 @@ CSWGlyphRunPainter::ScanOpGreyScaleBilinearOver(
     __int32 s = x*pThis->m_m00 + y*pThis->m_m10 + pThis->m_m20;
     __int32 t = x*pThis->m_m01 + y*pThis->m_m11 + pThis->m_m21;
 
-    for (UINT i = 0; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
+    UINT i = 0;
+
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned __int32 rgAlpha[4];
+
+            for (int j = 0; j < 4; j++, s += pThis->m_m00, t += pThis->m_m01)
+            {
+                rgAlpha[j] = pThis->GetAlphaBilinear(s, t);
+            }
+
+            pThis->ApplyGreyScaleOverSSE2<fSrcHasAlpha>(
+                rgAlpha,
+                &((unsigned __int32*)pSrc)[i],
+                &((unsigned __int32*)pDst)[i]
+                );
+        }
+    }
+#endif
+
+    for (; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
     {
         unsigned __int32  src = ((unsigned __int32*)pSrc)[i];
         unsigned __int32& dst = ((unsigned __int32*)pDst)[i];
@@ -941,6 +1933,8 @@ CSWGlyphRunPainter::ScanOpGreyScaleLinearCopy(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_GreyScaleLinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -965,7 +1959,7 @@ CSWGlyphRunPainter::ScanOpGreyScaleLinearCopy(
     }
 
     UINT width  = pThis->m_uFilteredWidth;
-    const BYTE *pAlphaRow = pThis->m_pSWGlyph->GetAlphaArray() + t*width;
+    const BYTE *pAlphaRow = pThis->m_pAlphaArrayToDraw + t*width;
     int fractionS = pThis->m_fractionS;
 
     // Regular loop:
@@ -992,6 +1986,25 @@ CSWGlyphRunPainter::ScanOpGreyScaleLinearCopy(
         pThis->ApplyGreyScaleCopy<fSrcHasAlpha>(alpha, pSrc[i], pDst[i]);
     }
 
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; s + 9 < sMax; i += 4, s += 12)
+        {
+            unsigned __int32 rgAlpha[4];
+
+            for (int j = 0; j < 4; j++)
+            {
+                __int32 alpha0 = pAlphaRow[s + j*3    ];
+                __int32 alpha1 = pAlphaRow[s + j*3 + 1];
+                rgAlpha[j] = alpha0 + ((alpha1 - alpha0)*fractionS >> 16);
+            }
+
+            pThis->ApplyGreyScaleCopySSE2<fSrcHasAlpha>(rgAlpha, &pSrc[i], &pDst[i]);
+        }
+    }
+#endif
+
     for (; s < sMax; i++, s += 3)
     {
         __int32 alpha0 = pAlphaRow[s  ];
@@ -1036,6 +2049,8 @@ CSWGlyphRunPainter::ScanOpGreyScaleLinearOver(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_GreyScaleLinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -1056,7 +2071,7 @@ CSWGlyphRunPainter::ScanOpGreyScaleLinearOver(
     }
 
     UINT width  = pThis->m_uFilteredWidth;
-    const BYTE *pAlphaRow = pThis->m_pSWGlyph->GetAlphaArray() + t*width;
+    const BYTE *pAlphaRow = pThis->m_pAlphaArrayToDraw + t*width;
     int fractionS = pThis->m_fractionS;
 
     // Regular loop:
@@ -1083,6 +2098,25 @@ CSWGlyphRunPainter::ScanOpGreyScaleLinearOver(
         pThis->ApplyGreyScaleOver<fSrcHasAlpha>(alpha, pSrc[i], pDst[i]);
     }
 
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; s + 9 < sMax; i += 4, s += 12)
+        {
+            unsigned __int32 rgAlpha[4];
+
+            for (int j = 0; j < 4; j++)
+            {
+                __int32 alpha0 = pAlphaRow[s + j*3    ];
+                __int32 alpha1 = pAlphaRow[s + j*3 + 1];
+                rgAlpha[j] = alpha0 + ((alpha1 - alpha0)*fractionS >> 16);
+            }
+
+            pThis->ApplyGreyScaleOverSSE2<fSrcHasAlpha>(rgAlpha, &pSrc[i], &pDst[i]);
+        }
+    }
+#endif
+
     for (; s < sMax; i++, s += 3)
     {
         __int32 alpha0 = pAlphaRow[s  ];
@@ -1128,6 +2162,8 @@ CSWGlyphRunPainter::ScanOpClearTypeBilinearCopy(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_ClearTypeBilinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -1140,7 +2176,34 @@ CSWGlyphRunPainter::ScanOpClearTypeBilinearCopy(
     __int32 s = x*pThis->m_m00 + y*pThis->m_m10 + pThis->m_m20;
     __int32 t = x*pThis->m_m01 + y*pThis->m_m11 + pThis->m_m21;
 
-    for (UINT i = 0; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
+    UINT i = 0;
+
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned __int32 rgAlphaR[4], rgAlphaG[4], rgAlphaB[4];
+
+            for (int j = 0; j < 4; j++, s += pThis->m_m00, t += pThis->m_m01)
+            {
+                rgAlphaR[j] = pThis->GetAlphaBilinear(s - pThis->m_ds, t - pThis->m_dt);
+                rgAlphaG[j] = pThis->GetAlphaBilinear(s              , t              );
+                rgAlphaB[j] = pThis->GetAlphaBilinear(s + pThis->m_ds, t + pThis->m_dt);
+            }
+
+            pThis->ApplyClearTypeCopySSE2<fSrcHasAlpha>(
+                rgAlphaR,
+                rgAlphaG,
+                rgAlphaB,
+                &((unsigned __int32*)pSrc)[i],
+                &((unsigned __int32*)pDstAlpha)[i]
+                );
+        }
+    }
+#endif
+
+    for (; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
     {
         unsigned __int32& dstAlpha = ((unsigned __int32*)pDstAlpha)[i];
         unsigned __int32& dstColor = ((unsigned __int32*)pSrc)[i];
@@ -1180,6 +2243,8 @@ CSWGlyphRunPainter::ScanOpClearTypeBilinearOver(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_ClearTypeBilinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -1192,7 +2257,34 @@ CSWGlyphRunPainter::ScanOpClearTypeBilinearOver(
     __int32 s = x*pThis->m_m00 + y*pThis->m_m10 + pThis->m_m20;
     __int32 t = x*pThis->m_m01 + y*pThis->m_m11 + pThis->m_m21;
 
-    for (UINT i = 0; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
+    UINT i = 0;
+
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned __int32 rgAlphaR[4], rgAlphaG[4], rgAlphaB[4];
+
+            for (int j = 0; j < 4; j++, s += pThis->m_m00, t += pThis->m_m01)
+            {
+                rgAlphaR[j] = pThis->GetAlphaBilinear(s - pThis->m_ds, t - pThis->m_dt);
+                rgAlphaG[j] = pThis->GetAlphaBilinear(s              , t              );
+                rgAlphaB[j] = pThis->GetAlphaBilinear(s + pThis->m_ds, t + pThis->m_dt);
+            }
+
+            pThis->ApplyClearTypeOverSSE2<fSrcHasAlpha>(
+                rgAlphaR,
+                rgAlphaG,
+                rgAlphaB,
+                &((unsigned __int32*)pSrc)[i],
+                &((unsigned __int32*)pDst)[i]
+                );
+        }
+    }
+#endif
+
+    for (; i < count; i++, s += pThis->m_m00, t += pThis->m_m01)
     {
         unsigned __int32& dst = ((unsigned __int32*)pDst)[i];
         unsigned __int32& src = ((unsigned __int32*)pSrc)[i];
@@ -1231,6 +2323,8 @@ CSWGlyphRunPainter::ScanOpClearTypeLinearCopy(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_ClearTypeLinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -1254,7 +2348,7 @@ CSWGlyphRunPainter::ScanOpClearTypeLinearCopy(
     }
 
     UINT width  = pThis->m_uFilteredWidth;
-    const BYTE *pAlphaRow = pThis->m_pSWGlyph->GetAlphaArray() + t*width;
+    const BYTE *pAlphaRow = pThis->m_pAlphaArrayToDraw + t*width;
     int fractionS = pThis->m_fractionS;
 
     // Regular loop:
@@ -1300,6 +2394,30 @@ CSWGlyphRunPainter::ScanOpClearTypeLinearCopy(
         pThis->ApplyClearTypeCopy<fSrcHasAlpha>(alphaR, alphaG, alphaB, src, dstAlpha, dstColor);
     }
 
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; s + 9 < sMax; i += 4, s += 12)
+        {
+            unsigned __int32 rgAlphaR[4], rgAlphaG[4], rgAlphaB[4];
+
+            for (int j = 0; j < 4; j++)
+            {
+                __int32 alpha0 = pAlphaRow[s + j*3 - 1];
+                __int32 alpha1 = pAlphaRow[s + j*3    ];
+                __int32 alpha2 = pAlphaRow[s + j*3 + 1];
+                __int32 alpha3 = pAlphaRow[s + j*3 + 2];
+
+                rgAlphaR[j] = alpha0 + ((alpha1 - alpha0)*fractionS >> 16);
+                rgAlphaG[j] = alpha1 + ((alpha2 - alpha1)*fractionS >> 16);
+                rgAlphaB[j] = alpha2 + ((alpha3 - alpha2)*fractionS >> 16);
+            }
+
+            pThis->ApplyClearTypeCopySSE2<fSrcHasAlpha>(rgAlphaR, rgAlphaG, rgAlphaB, &pSrc[i], &pDstAlpha[i]);
+        }
+    }
+#endif
+
     for (; s < sMax; i++, s += 3)
     {
         unsigned __int32& dstAlpha = pDstAlpha[i];
@@ -1363,6 +2481,8 @@ CSWGlyphRunPainter::ScanOpClearTypeLinearOver(
     __in_ecount(1) const ScanOpParams *pSOP
     )
 {
+    MeasurePerf(Text_SW_ClearTypeLinear, pPP->m_uiCount);
+
     CSWGlyphRunPainter* pThis = DYNCAST(CSWGlyphRunPainter, pSOP->m_posd);
     Assert(pThis);
 
@@ -1382,7 +2502,7 @@ CSWGlyphRunPainter::ScanOpClearTypeLinearOver(
     }
 
     UINT width  = pThis->m_uFilteredWidth;
-    const BYTE *pAlphaRow = pThis->m_pSWGlyph->GetAlphaArray() + t*width;
+    const BYTE *pAlphaRow = pThis->m_pAlphaArrayToDraw + t*width;
     int fractionS = pThis->m_fractionS;
 
     // Regular loop:
@@ -1426,6 +2546,30 @@ CSWGlyphRunPainter::ScanOpClearTypeLinearOver(
         pThis->ApplyClearTypeOver<fSrcHasAlpha>(alphaR, alphaG, alphaB, src, dst);
     }
 
+#if defined(_BUILD_SSE_)
+    if (CCPUInfo::HasSSE2())
+    {
+        for (; s + 9 < sMax; i += 4, s += 12)
+        {
+            unsigned __int32 rgAlphaR[4], rgAlphaG[4], rgAlphaB[4];
+
+            for (int j = 0; j < 4; j++)
+            {
+                __int32 alpha0 = pAlphaRow[s + j*3 - 1];
+                __int32 alpha1 = pAlphaRow[s + j*3    ];
+                __int32 alpha2 = pAlphaRow[s + j*3 + 1];
+                __int32 alpha3 = pAlphaRow[s + j*3 + 2];
+
+                rgAlphaR[j] = alpha0 + ((alpha1 - alpha0)*fractionS >> 16);
+                rgAlphaG[j] = alpha1 + ((alpha2 - alpha1)*fractionS >> 16);
+                rgAlphaB[j] = alpha2 + ((alpha3 - alpha2)*fractionS >> 16);
+            }
+
+            pThis->ApplyClearTypeOverSSE2<fSrcHasAlpha>(rgAlphaR, rgAlphaG, rgAlphaB, &pSrc[i], &pDst[i]);
+        }
+    }
+#endif
+
     for (; s < sMax; i++, s += 3)
     {
         unsigned __int32& dst = pDst[i];
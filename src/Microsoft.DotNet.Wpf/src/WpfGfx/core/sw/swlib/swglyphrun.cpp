@@ -56,12 +56,14 @@ CSWGlyphRun::Validate(
     
     IFC( pPainter->PrepareTransforms());
 
-    if (!IsAlphaValid())
+    // Realizations composed from the glyph atlas keep no alpha array, the
+    // painter composes it for every draw
+    if (!IsAlphaValid() && !pPainter->GetRealizationNoRef()->IsComposedFromAtlas())
     {
         // need [re]rasterize
         DiscardAlphaArray();
 
-        pPainter->MakeAlphaMap(this);
+        IFC(pPainter->MakeAlphaMap(this));
         pPainter->GetAlphaArray(&m_pAlphaArray, &m_alphaArraySize);
 
         SetAlphaValid();
@@ -23,6 +23,8 @@
 
 bool g_fUseMMX = false;
 bool g_fUseSSE2 = false;
+bool g_fUseAVX = false;
+bool g_fUseAVX2 = false;
 
 //+-----------------------------------------------------------------------------
 //
@@ -39,6 +41,7 @@ SwStartup()
     HRESULT hr = S_OK;
     DWORD dwDisableMMX = 0;
     DWORD dwDisableSSE2 = 0;
+    DWORD dwDisableAVX = 0;
 
 #if PRERELEASE
     HKEY hKeyAvalonGraphics = NULL;
@@ -86,6 +89,22 @@ SwStartup()
             dwDisableSSE2 = dwValue;
         }
 
+        dwDataSize = sizeof(dwValue);
+
+        r = RegQueryValueEx(
+            hKeyAvalonGraphics,
+            _T("DisableAVXForSwRast"),
+            NULL,
+            NULL,
+            (LPBYTE)&dwValue,
+            &dwDataSize
+            );
+
+        if (r == ERROR_SUCCESS && dwDataSize == sizeof(dwValue))
+        {
+            dwDisableAVX = dwValue;
+        }
+
         RegCloseKey(hKeyAvalonGraphics);
     }
 #endif
@@ -100,6 +119,22 @@ SwStartup()
         g_fUseSSE2 = true;
     }
 
+    //
+    // With AVX the jitter encodes SSE operations in their three operand
+    // forms, saving the register copies that the two operand forms need.
+    //
+    if (dwDisableAVX == 0 && CCPUInfo::HasAVXForEffects())
+    {
+        g_fUseAVX = true;
+        CPixelShaderCompiler::SetTargetFeatures(PIXELSHADER_TARGET_SSE2 | PIXELSHADER_TARGET_AVX);
+
+        //
+        // AVX2 widens the integer operations to 256 bits, which the blur
+        // effect uses to filter two pixels at once.
+        //
+        g_fUseAVX2 = CCPUInfo::HasAVX2ForEffects();
+    }
+
     IFC(CMilShaderEffectDuce::InitializeJitterLock());
 
 Cleanup:
@@ -485,10 +485,11 @@ HRESULT CSwPresenter32bppGDI::ScrollBlt(
 
     if (fDeferFrontBufferScroll)
     {
-        Assert(!m_fHasDeferredScroll);
-        m_fHasDeferredScroll = true;
-        m_sourceScrollRect = *prcSource;
-        m_destinationScrollRect = *prcDest;        
+        DeferredScroll deferredScroll;
+        deferredScroll.rcSource = *prcSource;
+        deferredScroll.rcDestination = *prcDest;
+
+        IFC(m_rgDeferredScrolls.Add(deferredScroll));
     }
     else
     {
@@ -545,7 +546,9 @@ Cleanup:
 //------------------------------------------------------------------------------
 
 HRESULT CSwPresenter32bppGDI::RemoveForegroundWindowScrollArtifacts(
-    __in_ecount(1) HDC hdcFront
+    __in_ecount(1) HDC hdcFront,
+    __in_ecount(1) CMILSurfaceRect const *prcSource,
+    __in_ecount(1) CMILSurfaceRect const *prcDest
     )
 {
     HRESULT hr = S_OK;
@@ -587,11 +590,11 @@ HRESULT CSwPresenter32bppGDI::RemoveForegroundWindowScrollArtifacts(
     // 2. Find the source scroll region (need to translate to screen
     //    coordinates).
     //
-    topLeft.y = m_sourceScrollRect.top;
-    topLeft.x = m_sourceScrollRect.left;
+    topLeft.y = prcSource->top;
+    topLeft.x = prcSource->left;
     IFCW32(ClientToScreen(hwnd, &topLeft));
-    bottomRight.y = m_sourceScrollRect.bottom;
-    bottomRight.x = m_sourceScrollRect.right;
+    bottomRight.y = prcSource->bottom;
+    bottomRight.x = prcSource->right;
     IFCW32(ClientToScreen(hwnd, &bottomRight));
     IFCW32(coveredScrollSourceRegion = CreateRectRgn(topLeft.x, 
                                                      topLeft.y,
@@ -625,8 +628,8 @@ HRESULT CSwPresenter32bppGDI::RemoveForegroundWindowScrollArtifacts(
     //    take the bounding box.
     //
     IFCW32(OffsetRgn(coveredScrollSourceRegion,
-                     m_destinationScrollRect.left - m_sourceScrollRect.left,
-                     m_destinationScrollRect.top - m_sourceScrollRect.top) != ERROR);
+                     prcDest->left - prcSource->left,
+                     prcDest->top - prcSource->top) != ERROR);
     IFCW32(GetRgnBox(coveredScrollSourceRegion, &coveredScrollSourceBounds));
 
     //
@@ -757,13 +760,17 @@ HRESULT CSwPresenter32bppGDI::Present(
             ));
     }
 
-    // Perform deferred scroll if there is one
-    if (m_fHasDeferredScroll)
+    // Perform deferred scrolls if there are any. They are done in the order
+    // they were issued, matching the scrolls already done in the back buffer.
+    for (UINT i = 0; i < m_rgDeferredScrolls.GetCount(); i++)
     {
-        IFC(ScrollBlt(&m_sourceScrollRect, &m_destinationScrollRect, false, false));
-        IFC(RemoveForegroundWindowScrollArtifacts(hdcFront));
-        m_fHasDeferredScroll = false;
+        const DeferredScroll &deferredScroll = m_rgDeferredScrolls[i];
+
+        IFC(ScrollBlt(&deferredScroll.rcSource, &deferredScroll.rcDestination, false, false));
+        IFC(RemoveForegroundWindowScrollArtifacts(hdcFront, &deferredScroll.rcSource, &deferredScroll.rcDestination));
     }
+
+    m_rgDeferredScrolls.Reset(FALSE);
     
     if (m_eWindowLayerType == MilWindowLayerType::ApplicationManagedLayer)
     {
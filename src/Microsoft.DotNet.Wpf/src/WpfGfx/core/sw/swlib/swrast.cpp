@@ -391,12 +391,9 @@ HRESULT CSoftwareRasterizer::DrawGlyphRun(
     HRESULT hr = S_OK;
     CSWGlyphRunPainter painter;
     BOOL fVisible = FALSE;
-    CColorSource *pColorSource = NULL;
 
     CMILSurfaceRect rcClipBounds;
 
-    MilPointAndSizeL rcBounds;
-
     if (pfClearTypeUsedToRender) 
     {
         *pfClearTypeUsedToRender = false;
@@ -436,18 +433,53 @@ HRESULT CSoftwareRasterizer::DrawGlyphRun(
 
     if (!fVisible) goto Cleanup;
 
+    IFC(RasterizeGlyphRun(
+        pSpanSink,
+        pSpanClipper,
+        pars.pContextState,
+        painter,
+        pBrush
+        ));
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSoftwareRasterizer::RasterizeGlyphRun
+//
+//  Synopsis:
+//      Scan convert the glyph run of an initialized painter into the provided
+//      Render Target.
+//
+//------------------------------------------------------------------------------
+HRESULT CSoftwareRasterizer::RasterizeGlyphRun(
+    __inout_ecount(1) CSpanSink *pSpanSink,
+    __in_ecount(1) CSpanClipper *pSpanClipper,
+    __in_ecount(1) const CContextState *pContextState,
+    __inout_ecount(1) CSWGlyphRunPainter &painter,
+    __inout_ecount(1) CMILBrush *pBrush
+    )
+{
+    HRESULT hr = S_OK;
+    CColorSource *pColorSource = NULL;
+
+    MilPointAndSizeL rcBounds;
+
     //
     // For text rendering, local rendering and world sampling spaces are identical
     //
 
     const CMatrix<CoordinateSpace::BaseSampling,CoordinateSpace::Device> &
         matBaseSamplingToDevice =
-        ReinterpretLocalRenderingAsBaseSampling(pars.pContextState->WorldToDevice);
+        ReinterpretLocalRenderingAsBaseSampling(pContextState->WorldToDevice);
 
     IFC( GetCS_Brush(
         pBrush,
         matBaseSamplingToDevice,
-        pars.pContextState,
+        pContextState,
         &pColorSource
         ) );
 
@@ -460,7 +492,7 @@ HRESULT CSoftwareRasterizer::DrawGlyphRun(
         IFC(shapeGlyphRun.AddRect(rcfGlyphRun));
 
         {
-            MilAntiAliasMode::Enum antiAliasMode = pars.pContextState->RenderState->AntiAliasMode;
+            MilAntiAliasMode::Enum antiAliasMode = pContextState->RenderState->AntiAliasMode;
 
             CRectF<CoordinateSpace::Device> rcShapeBoundsDeviceSpace;
             CShape scratchClipperShape;
@@ -476,7 +508,7 @@ HRESULT CSoftwareRasterizer::DrawGlyphRun(
 
             IFC( pSpanSink->SetupPipelineForText(
                 pColorSource,
-                pars.pContextState->RenderState->CompositingMode,
+                pContextState->RenderState->CompositingMode,
                 painter,
                 antiAliasMode != MilAntiAliasMode::None && clipper.ShapeHasBeenCorrected()
                 ) );
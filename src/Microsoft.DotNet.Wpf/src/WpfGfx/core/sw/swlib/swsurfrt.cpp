@@ -18,6 +18,8 @@ MtDefine(CSwRenderTargetSurface, MILRender, "CSwRenderTargetSurface");
 MtDefine(CSwRenderTargetBitmap, MILRender, "CSwRenderTargetBitmap");
 MtDefine(MSwRenderTargetScanlineBuffers, MILRawMemory, "MSwRenderTargetScanlineBuffers");
 
+DeclareTag(tagGlyphRunReplay, "MIL_SW", "Replay recorded glyph runs on the first glyph run drawn");
+
 
 CSwRenderTargetSurface::CSwRenderTargetSurface(
     DisplayId associatedDisplay
@@ -1053,6 +1055,18 @@ STDMETHODIMP CSwRenderTargetSurface::DrawGlyphs(
     CMILBrush *pBrushNoRef;
     float flAlphaScale;
 
+#if DBG
+    if (IsTagEnabled(tagGlyphRunReplay))
+    {
+        static LONG s_fReplayed = FALSE;
+
+        if (!InterlockedExchange(&s_fReplayed, TRUE))
+        {
+            CSwRenderTargetBitmap::ReplayRecordedGlyphRuns();
+        }
+    }
+#endif
+
     if (!UpdateCurrentClip( pars.pContextState->AliasedClip, &Clipper ))
     {
         // Clipping yields no area; so be done
@@ -1121,6 +1135,50 @@ Cleanup:
     RRETURN(hr);
 }
 
+#if DBG
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSwRenderTargetSurface::ReplayGlyphRun
+//
+//  Synopsis:
+//      Draw a glyph run replayed by the given painter, the way DrawGlyphs
+//      does once the painter is initialized
+//
+//------------------------------------------------------------------------------
+HRESULT
+CSwRenderTargetSurface::ReplayGlyphRun(
+    __in_ecount(1) const CContextState *pContextState,
+    __inout_ecount(1) CMILBrush *pBrush,
+    __inout_ecount(1) CSWGlyphRunPainter &painter
+    )
+{
+    HRESULT hr = S_OK;
+
+    CRectClipper Clipper;
+
+    if (!UpdateCurrentClip(pContextState->AliasedClip, &Clipper))
+    {
+        goto Cleanup;
+    }
+
+    IFC(LockInternalSurface(NULL, MilBitmapLock::Write | MilBitmapLock::Read));
+
+    IFC(m_sr.RasterizeGlyphRun(
+        this,
+        &Clipper,
+        pContextState,
+        painter,
+        pBrush
+        ));
+
+Cleanup:
+    UnlockInternalSurface();
+
+    RRETURN(hr);
+}
+#endif
+
 //+-----------------------------------------------------------------------------
 //
 //  Function:
@@ -1999,6 +2057,248 @@ Cleanup:
     RRETURN(hr);
 }
 
+#if DBG
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CSwRenderTargetBitmap::ReplayRecordedGlyphRuns
+//
+//  Synopsis:
+//      Draw the glyph runs recorded with tagGlyphRunRecord into an offscreen
+//      render target, and trace glyphs per second and the time spent
+//      drawing for each rendering mode.
+//
+//      Runs come with their alpha maps, so neither realization nor the
+//      glyph caches are involved: the time is that of rasterizing and
+//      blending. Each run is moved by whole pixels to the top left corner
+//      of the target, which keeps its subpixel position, and is drawn with
+//      opaque black over white.
+//
+
+void CSwRenderTargetBitmap::ReplayRecordedGlyphRuns()
+{
+    HRESULT hr = S_OK;
+
+    // Recordings are replayed this many times, so that short ones still
+    // take long enough to time
+    static const UINT sc_cPasses = 16;
+    static const UINT sc_uTargetSize = 1024;
+
+    // Indexed by 2*fIsClearType + fUseBilinear
+    static const char * const sc_rgszModes[] =
+    {
+        "GreyScaleLinear",
+        "GreyScaleBilinear",
+        "ClearTypeLinear",
+        "ClearTypeBilinear"
+    };
+
+    struct ModeResult
+    {
+        UINT cRuns;
+        UINT cGlyphs;
+        LONGLONG llTicks;
+    };
+
+    typedef CSWGlyphRunPainter::GlyphRunRecord GlyphRunRecord;
+
+    ModeResult rgResults[ARRAY_SIZE(sc_rgszModes)];
+    DynArray<BYTE> rgRecording;
+    DynArray<UINT> rgRecordOffsets;
+    FILE *pFile = NULL;
+    IMILRenderTargetBitmap *pIRenderTarget = NULL;
+    CMILBrushSolid *pBrush = NULL;
+    LARGE_INTEGER liFrequency;
+
+    CFloatFPU oGuard;
+
+    ZeroMemory(rgResults, sizeof(rgResults));
+
+    //
+    // Read the recording and find its records
+    //
+
+    pFile = fopen(CSWGlyphRunPainter::sc_szRecordingFile, "rb");
+    if (!pFile)
+    {
+        IFC(E_FAIL);
+    }
+
+    {
+        BYTE rgBuffer[4096];
+        size_t cbRead;
+
+        while ((cbRead = fread(rgBuffer, 1, sizeof(rgBuffer), pFile)) > 0)
+        {
+            IFC(rgRecording.AddMultipleAndSet(rgBuffer, static_cast<UINT>(cbRead)));
+        }
+    }
+
+    for (UINT uOffset = 0; uOffset < rgRecording.GetCount(); )
+    {
+        if (rgRecording.GetCount() - uOffset < sizeof(GlyphRunRecord))
+        {
+            IFC(E_INVALIDARG);
+        }
+
+        const GlyphRunRecord *pRecord =
+            reinterpret_cast<const GlyphRunRecord *>(&rgRecording[uOffset]);
+
+        const RECT &rcf = pRecord->rcFiltered;
+
+        if (   rcf.right <= rcf.left
+            || rcf.bottom <= rcf.top
+            || static_cast<UINT>(rcf.right - rcf.left) > 3*sc_uTargetSize
+            || static_cast<UINT>(rcf.bottom - rcf.top) > sc_uTargetSize
+            || pRecord->uGammaIndex > MAX_GAMMA_INDEX
+               )
+        {
+            IFC(E_INVALIDARG);
+        }
+
+        UINT cbAlphaArray = (rcf.right - rcf.left) * (rcf.bottom - rcf.top);
+
+        if (rgRecording.GetCount() - uOffset - sizeof(GlyphRunRecord) < cbAlphaArray)
+        {
+            IFC(E_INVALIDARG);
+        }
+
+        IFC(rgRecordOffsets.Add(uOffset));
+        uOffset += sizeof(GlyphRunRecord) + cbAlphaArray;
+    }
+
+    //
+    // Set up the target, and a default context state to draw with
+    //
+
+    IFC(CSwRenderTargetBitmap::Create(
+        sc_uTargetSize,
+        sc_uTargetSize,
+        MilPixelFormat::PBGRA32bpp,
+        96.0f,
+        96.0f,
+        DisplayId::None,
+        &pIRenderTarget
+        DBG_STEP_RENDERING_COMMA_PARAM(NULL)
+        ));
+
+    {
+        CSwRenderTargetBitmap *pRenderTarget = static_cast<CSwRenderTargetBitmap*>(pIRenderTarget);
+
+        MilColorF colorWhite = {1.0f, 1.0f, 1.0f, 1.0f};
+        MilColorF colorBlack = {0.0f, 0.0f, 0.0f, 1.0f};
+
+        IFC(pRenderTarget->Clear(&colorWhite, NULL));
+        IFC(CMILBrushSolid::Create(NULL, &colorBlack, &pBrush));
+
+        CContextState contextState(TRUE /* => basic initialization only */);
+        CRenderState renderState;
+
+        contextState.RenderState = &renderState;
+        contextState.AliasedClip = CAliasedClip(NULL);
+
+        //
+        // Replay
+        //
+
+        for (UINT uPass = 0; uPass < sc_cPasses; uPass++)
+        {
+            for (UINT i = 0; i < rgRecordOffsets.GetCount(); i++)
+            {
+                GlyphRunRecord record =
+                    *reinterpret_cast<const GlyphRunRecord *>(&rgRecording[rgRecordOffsets[i]]);
+
+                const BYTE *pAlphaArray = &rgRecording[rgRecordOffsets[i] + sizeof(GlyphRunRecord)];
+
+                const RECT &rcf = record.rcFiltered;
+                UINT cbAlphaArray = (rcf.right - rcf.left) * (rcf.bottom - rcf.top);
+
+                //
+                // Move the device bounds of the run to the origin
+                //
+
+                float rgX[2] = {rcf.left * (1.0f/3), rcf.right * (1.0f/3)};
+                float rgY[2] = {static_cast<float>(rcf.top), static_cast<float>(rcf.bottom)};
+                float xMin = FLT_MAX;
+                float yMin = FLT_MAX;
+
+                for (UINT j = 0; j < 4; j++)
+                {
+                    float x = rgX[j & 1];
+                    float y = rgY[j >> 1];
+
+                    xMin = min(xMin, x*record.xfGlyphWR.m_00 + y*record.xfGlyphWR.m_10 + record.xfGlyphWR.m_20);
+                    yMin = min(yMin, x*record.xfGlyphWR.m_01 + y*record.xfGlyphWR.m_11 + record.xfGlyphWR.m_21);
+                }
+
+                record.xfGlyphWR.m_20 -= static_cast<float>(CFloatFPU::Floor(xMin));
+                record.xfGlyphWR.m_21 -= static_cast<float>(CFloatFPU::Floor(yMin));
+
+                CSWGlyphRunPainter painter;
+                painter.InitForReplay(record, pAlphaArray, cbAlphaArray);
+
+                LARGE_INTEGER liStart, liEnd;
+
+                IFCW32(QueryPerformanceCounter(&liStart));
+                IFC(pRenderTarget->ReplayGlyphRun(&contextState, pBrush, painter));
+                IFCW32(QueryPerformanceCounter(&liEnd));
+
+                ModeResult &result = rgResults[2*!!record.fIsClearType + !!record.fUseBilinear];
+
+                result.cRuns++;
+                result.cGlyphs += record.cGlyphs;
+                result.llTicks += liEnd.QuadPart - liStart.QuadPart;
+            }
+        }
+    }
+
+    //
+    // Report
+    //
+
+    IFCW32(QueryPerformanceFrequency(&liFrequency));
+
+    TraceTag((tagGlyphRunReplay,
+              "Glyph run replay: %u recorded runs drawn %u times",
+              rgRecordOffsets.GetCount(),
+              sc_cPasses
+              ));
+
+    for (UINT i = 0; i < ARRAY_SIZE(sc_rgszModes); i++)
+    {
+        const ModeResult &result = rgResults[i];
+
+        if (result.cRuns == 0)
+        {
+            continue;
+        }
+
+        TraceTag((tagGlyphRunReplay,
+                  "Glyph run replay, %s: %u runs, %u glyphs, %I64d us drawing, %I64d glyphs/s",
+                  sc_rgszModes[i],
+                  result.cRuns,
+                  result.cGlyphs,
+                  result.llTicks * 1000000 / liFrequency.QuadPart,
+                  result.llTicks > 0 ? result.cGlyphs * liFrequency.QuadPart / result.llTicks : 0
+                  ));
+    }
+
+Cleanup:
+    if (pFile)
+    {
+        fclose(pFile);
+    }
+
+    ReleaseInterface(pBrush);
+    ReleaseInterface(pIRenderTarget);
+
+    if (FAILED(hr))
+    {
+        TraceTag((tagGlyphRunReplay, "Glyph run replay failed: 0x%08x", hr));
+    }
+}
+#endif
+
 //+-----------------------------------------------------------------------------
 //
 //  Member:
@@ -140,7 +140,9 @@ private:
         );
     
     HRESULT CSwPresenter32bppGDI::RemoveForegroundWindowScrollArtifacts(
-        __in_ecount(1) HDC hdcFront
+        __in_ecount(1) HDC hdcFront,
+        __in_ecount(1) CMILSurfaceRect const *prcSource,
+        __in_ecount(1) CMILSurfaceRect const *prcDest
         );
 
 private:
@@ -197,11 +199,16 @@ private:
     MilWindowLayerType::Enum m_eWindowLayerType;
 
     //
-    // Deferred scrolling for front buffer
+    // Deferred scrolling for front buffer. One entry per scrolled area of the
+    // frame, in the order they were scrolled in the back buffer.
     //
-    bool m_fHasDeferredScroll;
-    CMILSurfaceRect m_sourceScrollRect;
-    CMILSurfaceRect m_destinationScrollRect;
+    struct DeferredScroll
+    {
+        CMILSurfaceRect rcSource;
+        CMILSurfaceRect rcDestination;
+    };
+
+    DynArray<DeferredScroll> m_rgDeferredScrolls;
     
 };
 
@@ -547,6 +547,14 @@ public:
         __out_opt bool* pfClearTypeUsedToRender = NULL
         );
 
+    HRESULT RasterizeGlyphRun(
+        __inout_ecount(1) CSpanSink *pSpanSink,
+        __in_ecount(1) CSpanClipper *pSpanClipper,
+        __in_ecount(1) const CContextState *pContextState,
+        __inout_ecount(1) CSWGlyphRunPainter &painter,
+        __inout_ecount(1) CMILBrush *pBrush
+        );
+
     // Clear the device.
 
     HRESULT Clear(
@@ -207,6 +207,14 @@ protected:
 
     void UnlockInternalSurface();
 
+#if DBG
+    HRESULT ReplayGlyphRun(
+        __in_ecount(1) const CContextState *pContextState,
+        __inout_ecount(1) CMILBrush *pBrush,
+        __inout_ecount(1) CSWGlyphRunPainter &painter
+        );
+#endif
+
 private:
 
     HRESULT ClearLockedSurface(
@@ -344,6 +352,10 @@ public:
         DBG_STEP_RENDERING_COMMA_PARAM(__inout_ecount_opt(1) ISteppedRenderingDisplayRT *pDisplayRTParent)
         );
 
+#if DBG
+    static void ReplayRecordedGlyphRuns();
+#endif
+
     DECLARE_METERHEAP_ALLOC(ProcessHeap, Mt(CSwRenderTargetBitmap));
 
     // IUnknown implementation. This disambiguates multiply inherited IUnknown
@@ -0,0 +1,280 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      Cache of the output of Effects on visuals whose subtree did not change.
+//
+//------------------------------------------------------------------------------
+
+#include "precomp.hpp"
+
+MtDefine(CEffectResultCache, MILRender, "CEffectResultCache");
+
+//+-----------------------------------------------------------------------------
+//
+//    Member:
+//        CEffectResultCache constructor
+//
+//------------------------------------------------------------------------------
+
+CEffectResultCache::CEffectResultCache()
+{
+    m_cbTotal = 0;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//    Member:
+//        CEffectResultCache destructor
+//
+//------------------------------------------------------------------------------
+
+CEffectResultCache::~CEffectResultCache()
+{
+    NotifyDeviceLost();
+}
+
+//+-----------------------------------------------------------------------------
+//
+//    Member:
+//        CEffectResultCache::Create
+//
+//    Synopsis:
+//        Static.  Effect result cache factory.
+//
+//------------------------------------------------------------------------------
+
+HRESULT
+CEffectResultCache::Create(
+    __deref_out_ecount(1) CEffectResultCache **ppEffectResultCache
+    )
+{
+    HRESULT hr = S_OK;
+
+    CEffectResultCache *pEffectResultCache = new CEffectResultCache();
+    IFCOOM(pEffectResultCache);
+
+    SetInterface(*ppEffectResultCache, pEffectResultCache); // add a reference
+    pEffectResultCache = NULL;
+
+Cleanup:
+    ReleaseInterface(pEffectResultCache);
+
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------
+//
+//  Member:
+//      CEffectResultCache::Lookup
+//
+//  Synopsis:
+//      Returns the output of the Effect of pVisual if it was stored with the
+//      same key and has not been invalidated since.
+//
+//------------------------------------------------------------------------
+
+bool
+CEffectResultCache::Lookup(
+    __in_ecount(1) const CMilVisual *pVisual,
+    __in_ecount(1) const EffectResultKey &key,
+    __deref_out_ecount(1) IMILRenderTargetBitmap **ppIRTB
+    )
+{
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        Entry &entry = m_rgEntries[i];
+
+        if (entry.pVisualNoRef == pVisual)
+        {
+            if (   entry.key.pEffectNoRef != key.pEffectNoRef
+                || entry.key.rScaleX != key.rScaleX
+                || entry.key.rScaleY != key.rScaleY
+                || entry.key.rcSurface.X != key.rcSurface.X
+                || entry.key.rcSurface.Y != key.rcSurface.Y
+                || entry.key.rcSurface.Width != key.rcSurface.Width
+                || entry.key.rcSurface.Height != key.rcSurface.Height
+                || entry.key.antiAliasMode != key.antiAliasMode
+                || entry.key.interpolationMode != key.interpolationMode
+                || entry.key.textRenderingMode != key.textRenderingMode
+                || entry.key.textHintingMode != key.textHintingMode
+                || entry.key.fPrefilterEnable != key.fPrefilterEnable
+                || entry.key.fClearTypeHint != key.fClearTypeHint)
+            {
+                return false;
+            }
+
+            entry.lastUsedFrame = CComposition::GetFrameLastComposed();
+
+            SetInterface(*ppIRTB, entry.pIRTB);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//+-----------------------------------------------------------------------
+//
+//  Member:
+//      CEffectResultCache::Store
+//
+//  Synopsis:
+//      Keeps pIRTB as the output of the Effect of pVisual, replacing any
+//      earlier output. Outputs are evicted, least recently used first, until
+//      the new one fits the budget. An output that cannot fit even in an
+//      empty cache is not stored.
+//
+//------------------------------------------------------------------------
+
+HRESULT
+CEffectResultCache::Store(
+    __in_ecount(1) const CMilVisual *pVisual,
+    __in_ecount(1) const EffectResultKey &key,
+    __in_ecount(1) IMILRenderTargetBitmap *pIRTB
+    )
+{
+    HRESULT hr = S_OK;
+
+    Invalidate(pVisual);
+
+    UINT cbSize;
+    IFC(MultiplyUINT(static_cast<UINT>(key.rcSurface.Width), static_cast<UINT>(key.rcSurface.Height), cbSize));
+    IFC(MultiplyUINT(cbSize, 4, cbSize));
+
+    if (cbSize > sc_cbBudget)
+    {
+        goto Cleanup;
+    }
+
+    while (m_cbTotal + cbSize > sc_cbBudget)
+    {
+        Assert(m_rgEntries.GetCount() > 0);
+
+        UINT iOldest = 0;
+        for (UINT i = 1; i < m_rgEntries.GetCount(); i++)
+        {
+            if (m_rgEntries[i].lastUsedFrame < m_rgEntries[iOldest].lastUsedFrame)
+            {
+                iOldest = i;
+            }
+        }
+
+        RemoveEntry(iOldest);
+    }
+
+    {
+        Entry entry;
+        entry.pVisualNoRef = pVisual;
+        entry.key = key;
+        entry.pIRTB = pIRTB;
+        entry.cbSize = cbSize;
+        entry.lastUsedFrame = CComposition::GetFrameLastComposed();
+
+        IFC(m_rgEntries.Add(entry));
+
+        pIRTB->AddRef();
+        m_cbTotal += cbSize;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+-----------------------------------------------------------------------
+//
+//  Member:
+//      CEffectResultCache::Invalidate
+//
+//  Synopsis:
+//      Releases the output of the Effect of pVisual, if any.
+//
+//------------------------------------------------------------------------
+
+void
+CEffectResultCache::Invalidate(
+    __in_ecount(1) const CMilVisual *pVisual
+    )
+{
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        if (m_rgEntries[i].pVisualNoRef == pVisual)
+        {
+            RemoveEntry(i);
+            break;
+        }
+    }
+}
+
+//+-----------------------------------------------------------------------
+//
+//  Member:
+//      CEffectResultCache::Trim
+//
+//  Synopsis:
+//      Releases the outputs that have not been drawn in the last
+//      sc_cFramesUnusedMax frames, e.g. because their visual is scrolled
+//      out of view or no longer has its Effect.
+//
+//------------------------------------------------------------------------
+
+void
+CEffectResultCache::Trim()
+{
+    UTC_TIME frameCurrent = CComposition::GetFrameLastComposed();
+
+    for (UINT i = m_rgEntries.GetCount(); i > 0; i--)
+    {
+        if (frameCurrent - m_rgEntries[i - 1].lastUsedFrame > sc_cFramesUnusedMax)
+        {
+            RemoveEntry(i - 1);
+        }
+    }
+}
+
+//+-----------------------------------------------------------------------
+//
+//  Member:
+//      CEffectResultCache::NotifyDeviceLost
+//
+//  Synopsis:
+//      Releases all outputs. They are stored again as they are rendered.
+//
+//------------------------------------------------------------------------
+
+void
+CEffectResultCache::NotifyDeviceLost()
+{
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        ReleaseInterface(m_rgEntries[i].pIRTB);
+    }
+
+    m_rgEntries.Reset(FALSE);
+    m_cbTotal = 0;
+}
+
+//+-----------------------------------------------------------------------
+//
+//  Member:
+//      CEffectResultCache::RemoveEntry
+//
+//------------------------------------------------------------------------
+
+void
+CEffectResultCache::RemoveEntry(UINT i)
+{
+    Assert(m_cbTotal >= m_rgEntries[i].cbSize);
+
+    m_cbTotal -= m_rgEntries[i].cbSize;
+    ReleaseInterface(m_rgEntries[i].pIRTB);
+
+    IGNORE_HR(m_rgEntries.RemoveAt(i));
+}
+
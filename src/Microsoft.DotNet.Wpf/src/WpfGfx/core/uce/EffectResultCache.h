@@ -0,0 +1,130 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      Cache of the output of Effects on visuals whose subtree did not change.
+//
+//------------------------------------------------------------------------------
+MtExtern(CEffectResultCache);
+
+//+-----------------------------------------------------------------------------
+//
+//  Structure:
+//      EffectResultKey
+//
+//  Synopsis:
+//      What the output of an Effect depends on besides the visual's subtree,
+//      which is tracked by precompute. The rest of the world transform is an
+//      integer translation that is applied when the output is drawn, so the
+//      output can be reused after the visual or an ancestor moved.
+//
+//------------------------------------------------------------------------------
+
+struct EffectResultKey
+{
+    CMilEffectDuce *pEffectNoRef;
+
+    // Scale component of the world transform
+    float rScaleX;
+    float rScaleY;
+
+    // Bounds of the Effect output in the scaled space of its layer
+    MilPointAndSizeL rcSurface;
+
+    // Render options inherited from the ancestors, whose changes do not
+    // dirty the subtree
+    MilAntiAliasMode::Enum antiAliasMode;
+    MilBitmapInterpolationMode::Enum interpolationMode;
+    MilTextRenderingMode::Enum textRenderingMode;
+    MilTextHintingMode::Enum textHintingMode;
+    bool fPrefilterEnable;
+    bool fClearTypeHint;
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CEffectResultCache
+//
+//  Synopsis:
+//      Keeps the last output of the Effects of visuals, one per visual, in
+//      intermediates that are drawn instead of rendering the subtree and
+//      running the Effect again. Precompute invalidates the output of a
+//      visual whenever anything below its Effect changed.
+//
+//      The intermediates are accounted against sc_cbBudget. Least recently
+//      used outputs are evicted to stay within it, and outputs that have not
+//      been used for sc_cFramesUnusedMax frames are released by Trim.
+//
+//------------------------------------------------------------------------------
+
+class CEffectResultCache : public CMILRefCountBase
+{
+private:
+    CEffectResultCache();
+
+    virtual ~CEffectResultCache();
+
+protected:
+    DECLARE_METERHEAP_CLEAR(ProcessHeap, Mt(CEffectResultCache));
+
+public:
+    static HRESULT Create(
+        __deref_out_ecount(1) CEffectResultCache **ppEffectResultCache
+        );
+
+    bool Lookup(
+        __in_ecount(1) const CMilVisual *pVisual,
+        __in_ecount(1) const EffectResultKey &key,
+        __deref_out_ecount(1) IMILRenderTargetBitmap **ppIRTB
+        );
+
+    HRESULT Store(
+        __in_ecount(1) const CMilVisual *pVisual,
+        __in_ecount(1) const EffectResultKey &key,
+        __in_ecount(1) IMILRenderTargetBitmap *pIRTB
+        );
+
+    void Invalidate(
+        __in_ecount(1) const CMilVisual *pVisual
+        );
+
+    void Trim();
+
+    void NotifyDeviceLost();
+
+    UINT GetSize() const
+    {
+        return m_cbTotal;
+    }
+
+private:
+    struct Entry
+    {
+        const CMilVisual *pVisualNoRef;
+        EffectResultKey key;
+        IMILRenderTargetBitmap *pIRTB;
+        UINT cbSize;
+        UTC_TIME lastUsedFrame;
+    };
+
+    void RemoveEntry(UINT i);
+
+    // Bytes of intermediates all outputs may use together
+    static const UINT sc_cbBudget = 16 * 1024 * 1024;
+
+    // Frames after which an output that is not drawn is released
+    static const UINT sc_cFramesUnusedMax = 60;
+
+    DynArray<Entry> m_rgEntries;
+
+    // Bytes used by the intermediates in m_rgEntries
+    UINT m_cbTotal;
+};
+
@@ -247,6 +247,84 @@ Cleanup:
     RRETURN(hr);
 }
 
+//+-----------------------------------------------------------------------
+//
+//  Member:     CContentBounder::GetRenderDataSpanBounds
+//
+//  Synopsis:   Retrieves the local space bounds of each of the given
+//              instruction spans of a render data in a single bounds pass.
+//              Spans whose bounds can't be determined are set infinite.
+//
+//------------------------------------------------------------------------
+HRESULT
+CContentBounder::GetRenderDataSpanBounds(
+    __in_ecount(1) CMilSlaveRenderData *pRenderData,  // Render data owning the spans
+    __inout_ecount(cSpans) RenderDataCullSpan *rgSpans, // Spans to set the bounds of
+    UINT cSpans
+    )
+{
+    HRESULT hr = S_OK;
+
+    // Assert that this object isn't already in a bounds call
+    WHEN_DBG(Assert(!m_fInUse));
+
+    // Set debug-only in-use flag
+    WHEN_DBG(m_fInUse = TRUE);
+
+    // See GetContentBounds for why this is lazy
+    if (NULL == m_pDrawingContext)
+    {
+        Assert (NULL == m_pBoundsRenderTarget);
+
+        IFC(Initialize(m_pComposition));
+    }
+
+    Assert(m_pBoundsRenderTarget && m_pDrawingContext);
+
+    IFC(m_pDrawingContext->BeginFrame(
+        m_pBoundsRenderTarget
+        DBG_ANALYSIS_COMMA_PARAM(CoordinateSpaceId::PageInPixels)
+        ));
+
+    for (UINT i = 0; i < cSpans; i++)
+    {
+        m_pBoundsRenderTarget->ResetBounds();
+
+        //
+        // Spans are balanced with respect to Push/Pop, so the drawing
+        // context state is back to identity after each of them.
+        //
+
+        IFC(pRenderData->DrawInstructions(
+            m_pDrawingContext,
+            rgSpans[i].iFirstInstruction,
+            rgSpans[i].iEndInstruction
+            ));
+
+        rgSpans[i].rcBounds = m_pBoundsRenderTarget->GetAccumulatedBounds();
+        if (!(rgSpans[i].rcBounds.IsWellOrdered()))
+        {
+            rgSpans[i].rcBounds = CMilRectF::sc_rcInfinite;
+        }
+    }
+
+Cleanup:
+
+    if (m_pDrawingContext)
+    {
+        m_pDrawingContext->EndFrame();
+    }
+
+    if (m_pBoundsRenderTarget)
+    {
+        m_pBoundsRenderTarget->ResetBounds();
+    }
+
+    WHEN_DBG(m_fInUse = FALSE);
+
+    RRETURN(hr);
+}
+
 //+-----------------------------------------------------------------------------
 //
 //  Member:     CMilRenderContext::GetVisualInnerBounds
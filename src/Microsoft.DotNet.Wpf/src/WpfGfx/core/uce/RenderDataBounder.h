@@ -17,6 +17,7 @@ MtExtern(CContentBounder);
 
 // Forward declaration types used in GetContentBounds
 class CMilSlaveRenderData;
+struct RenderDataCullSpan;
 class CMilDrawingDuce;
 class CMilVisual;
 
@@ -56,6 +57,12 @@ public:
         __out_ecount(1) CMilRectF *prcBounds
         );
 
+    HRESULT GetRenderDataSpanBounds(
+        __in_ecount(1) CMilSlaveRenderData *pRenderData,
+        __inout_ecount(cSpans) RenderDataCullSpan *rgSpans,
+        UINT cSpans
+        );
+
     HRESULT GetVisualInnerBounds(
         __in_ecount(1) CMilVisual* pNode,
         __out_ecount(1) CMilRectF *prcBounds
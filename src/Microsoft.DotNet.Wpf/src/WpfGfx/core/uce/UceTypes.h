@@ -13,6 +13,7 @@
 
 class CContentBounder;
 class CMilEffectDuce;
+class CMilVisual;
 
 //+-----------------------------------------------------------------------------
 //
@@ -42,6 +43,8 @@ struct CLayer
         rAlpha = rAlphaIn;
         pAlphaMaskBrush = pAlphaMaskBrushIn;
         pEffect = pEffectIn;
+        pFusedEffect = NULL;
+        pEffectResultVisualNoRef = NULL;
         if (pBoundsIn)
         {
             rcBounds = *pBoundsIn;
@@ -84,6 +87,14 @@ struct CLayer
 
     CMilEffectDuce *pEffect;     // Pointer to the Bitmap Effect, if present
 
+    CMilEffectDuce *pFusedEffect;           // Effect of the parent visual that is run
+                                            // together with pEffect, if present. See
+                                            // CDrawingContext::CanFuseEffectWithChild.
+
+    CMilVisual *pEffectResultVisualNoRef;   // Visual under which the output of pEffect is
+                                            // stored in CEffectResultCache, if present. See
+                                            // CDrawingContext::StoreEffectResult.
+
     CShape *pGeometricMaskShape;            // Pointer to the geometric mask, if present
     CRectF<CoordinateSpace::LocalRendering> rcBounds;   // Bounds of the PushOpacityMask
     BOOL fHasBounds;
@@ -141,6 +141,8 @@ CVisualCacheManager::UpdateCaches()
             // walk could have been kicked off by a VisualBrush/BitmapCacheBrush within an
             // updating cache's subtree.  Update() protects against such cycles.
         }
+
+        m_pCompositionNoRef->GetFrameTimingRecorder()->Counters().cVisualCacheUpdates += cCaches;
     }
     
 Cleanup:
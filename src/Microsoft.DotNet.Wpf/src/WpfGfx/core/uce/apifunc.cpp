@@ -869,6 +869,67 @@ HRESULT WINAPI MilCompositionEngine_GetComposedEventId(
     return GetCompositionEngineComposedEventId(pcEventId);
 }
 
+//+------------------------------------------------------------------------
+//
+//  Member: MilCompositionEngine_GetFrameTimings
+//
+//  Synopsis:  Drains up to cFramesMax of the oldest per frame timings
+//             recorded by the composition engine in this process.
+//             *pcFramesDropped receives the number of frames that were
+//             overwritten because the log was not drained often enough.
+//
+//             rgFrames[0].cbSize gives the size of the caller's
+//             MilFrameTiming and the stride of rgFrames. Each frame
+//             receives only that many bytes of the engine's structure.
+//
+//------------------------------------------------------------------------
+HRESULT WINAPI MilCompositionEngine_GetFrameTimings(
+    UINT cFramesMax,
+    __inout_bcount(cFramesMax * rgFrames->cbSize) MilFrameTiming *rgFrames,
+    __out_ecount(1) UINT *pcFrames,
+    __out_ecount(1) UINT *pcFramesDropped
+    )
+{
+    HRESULT hr = S_OK;
+    UINT cbFrame = sizeof(MilFrameTiming);
+
+    CHECKPTRARG(pcFrames);
+    CHECKPTRARG(pcFramesDropped);
+
+    *pcFrames = 0;
+    *pcFramesDropped = 0;
+
+    if (cFramesMax > 0)
+    {
+        CHECKPTRARG(rgFrames);
+
+        cbFrame = rgFrames->cbSize;
+
+        //
+        // The caller's structure must at least hold the frame number, and
+        // its size must keep the 64 bit fields of later elements aligned.
+        //
+
+        if (   cbFrame < offsetof(MilFrameTiming, qpcFrameStart)
+            || cbFrame % __alignof(MilFrameTiming) != 0
+            || cFramesMax > UINT_MAX / cbFrame)
+        {
+            IFC(E_INVALIDARG);
+        }
+    }
+
+    CFrameTimingLog::Drain(
+        cFramesMax,
+        cbFrame,
+        reinterpret_cast<BYTE *>(rgFrames),
+        pcFrames,
+        pcFramesDropped
+        );
+
+Cleanup:
+    RRETURN(hr);
+}
+
 // Ignore deprecation of D3DMATRIX on method prototypes defined
 // in windows/published, where CMILMatrix isn't defined.
 #pragma warning (push)
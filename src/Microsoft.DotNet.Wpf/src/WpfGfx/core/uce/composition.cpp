@@ -90,6 +90,7 @@ CComposition::~CComposition()
     ReleaseInterface(m_pFactory);
     ReleaseInterface(m_pRenderTargetManager);
     ReleaseInterface(m_pVisualCacheManager);
+    ReleaseInterface(m_pEffectResultCache);
 }
 
 
@@ -127,6 +128,9 @@ CComposition::Initialize()
             &m_pVisualCacheManager
             ));
 
+    // Create the cache of Effect outputs.
+    IFC(CEffectResultCache::Create(&m_pEffectResultCache));
+
     // Create the glyph cache
     IFC(CMilSlaveGlyphCache::Create(this, &m_pGlyphCache));
 
@@ -237,6 +241,9 @@ CComposition::ProcessCommandBatch(
     MILCMD nCmdType = MilCmdInvalid;
     LPCVOID pcvData = NULL;
     UINT cbSize = 0;
+    UINT cCommands = 0;
+
+    QPC_TIME qpcBatchStart = m_frameTiming.BeginPhase();
 
 #if ENABLE_INLINE_FUZZING && PRERELEASE && !DBG
     static UINT c_FuzzThreshold = 0;
@@ -386,6 +393,8 @@ CComposition::ProcessCommandBatch(
         //      pHandleTable    -- the channel's handle table
         //
 
+        cCommands++;
+
         //
         // Ignore false-positive PreFast warning about possible infinite loop when using
         // IFC macro inside this .inl file - PreFast can't seem to parse this correctly.
@@ -492,6 +501,10 @@ Cleanup:
     }
 
 
+    m_frameTiming.Counters().cBatchesProcessed++;
+    m_frameTiming.Counters().cCommandsProcessed += cCommands;
+    m_frameTiming.EndPhase(FrameTimingPhase::ProcessBatches, qpcBatchStart);
+
     //
     // No matter what free the batch and assign it to the lookaside.
     //
@@ -651,6 +664,7 @@ HRESULT CComposition::ProcessComposition(
         // then override and lie to listeners that displays are valid.
         IFC(m_pRenderTargetManager->NotifyDisplaySetChange(doRenderPass, displayCount));
         GetVisualCacheManagerNoRef()->NotifyDeviceLost();
+        m_pEffectResultCache->NotifyDeviceLost();
     }
     else
     {
@@ -781,6 +795,10 @@ CComposition::Compose(
     // Increment the composition frame counter
     s_frameLastComposed++;
 
+    m_frameTiming.BeginFrame(s_frameLastComposed);
+
+    QPC_TIME qpcComposeStart = m_frameTiming.BeginPhase();
+
 #if ENABLE_PARTITION_MANAGER_LOG
     CPartitionManager::LogEvent(PartitionManagerEvent::Composing, static_cast<DWORD>(reinterpret_cast<UINT_PTR>(this)));
 #endif /* ENABLE_PARTITION_MANAGER_LOG */
@@ -817,6 +835,14 @@ CComposition::Compose(
 
 Cleanup:
 
+    m_frameTiming.EndPhase(FrameTimingPhase::Compose, qpcComposeStart);
+
+    if (FAILED(hr) || !fPresentNeeded)
+    {
+        // There will be no Present for this frame, report it now
+        m_frameTiming.EndFrame();
+    }
+
     if (SUCCEEDED(hr))
     {
         hr = S_OK; // don't return success codes other than S_OK
@@ -975,6 +1001,7 @@ CComposition::Present(
 {
     HRESULT hr = S_OK;
     QPC_TIME qpcPresentationTime = UINT64_MAX;
+    QPC_TIME qpcPresentStart = m_frameTiming.BeginPhase();
 
     if (m_deviceState == MilCompositionDeviceState::Occluded)
     {
@@ -1057,6 +1084,18 @@ Cleanup:
     // Give glyph caches opportunity to trim their realization size if necessary.
     m_pGlyphCache->TrimCache();
 
+    CGlyphRunResource::GetFontFaceCacheStatistics(
+        &m_frameTiming.Counters().cFontFaceCacheHits,
+        &m_frameTiming.Counters().cFontFaceCacheMisses
+        );
+
+    // Release Effect outputs that are no longer drawn.
+    m_pEffectResultCache->Trim();
+    m_frameTiming.Counters().cbEffectResultCache = m_pEffectResultCache->GetSize();
+
+    m_frameTiming.EndPhase(FrameTimingPhase::Present, qpcPresentStart);
+    m_frameTiming.EndFrame();
+
     //
     // ERROR HANDLING NOTE: any failure error code returned from this
     // method will result in putting the current partition into zombie
@@ -2239,6 +2278,7 @@ CComposition::ProcessRenderingStatus(RENDERING_STATUS status)
         case RENDERING_STATUS_DEVICE_RELEASED:
         {
             GetVisualCacheManagerNoRef()->NotifyDeviceLost();
+            m_pEffectResultCache->NotifyDeviceLost();
             stateNew = MilCompositionDeviceState::NoDevice;
         }
         break;
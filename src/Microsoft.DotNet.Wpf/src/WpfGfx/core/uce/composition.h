@@ -29,6 +29,7 @@ MtExtern(CComposition);
 
 class CRenderTargetManager;
 class CVisualCacheManager;
+class CEffectResultCache;
 class CSlaveEtwEventResource;
 class CDrawingContext;
 class CMilSlaveVideo;
@@ -233,6 +234,16 @@ public:
 
     CVisualCacheManager* GetVisualCacheManagerNoRef();
 
+    __out_ecount(1) CEffectResultCache *GetEffectResultCacheNoRef()
+    {
+        return m_pEffectResultCache;
+    }
+
+    __out_ecount(1) CFrameTimingRecorder *GetFrameTimingRecorder()
+    {
+        return &m_frameTiming;
+    }
+
     CRenderTargetManager* GetRenderTargetManagerNoRef();
 
     bool GetLastForceSoftwareForProcessValue()
@@ -345,6 +356,11 @@ protected:
 
     static UTC_TIME s_frameLastComposed;
 
+    // Phase timings and counters of the frame being composed. The frame is
+    // committed to CFrameTimingLog when it is presented, or at the end of
+    // Compose if no present is needed.
+    CFrameTimingRecorder m_frameTiming;
+
 
     //+-------------------------------------------------------------------------
     //
@@ -501,6 +517,8 @@ private:
     DynArray<CSlaveEtwEventResource*, TRUE> m_rgpEtwEvent;
 
     CVisualCacheManager* m_pVisualCacheManager;
+
+    CEffectResultCache *m_pEffectResultCache;
     
     bool m_bNeedBadShaderNotification;
 
@@ -13,6 +13,9 @@
 
 DeclareTag(tagTintPushOpacitySurfaces, "MIL", "Tint PushOpacity intermediate surfaces");
 MtDefine(CDrawingContext, MILRender, "CDrawingContext");
+MtDefine(MILScrollMetrics, Metrics, "MIL accelerated scroll");
+MtDefine(ScrolledAreasPerFrame, MILScrollMetrics, "Scrolled areas per frame");
+MtDefine(AcceleratedScrollsPerFrame, MILScrollMetrics, "Accelerated scrolls per frame");
 
 //---------------------------------------------------------------------------------
 // Dirty region control/debug flags
@@ -73,6 +76,8 @@ CDrawingContext::CDrawingContext(
 
     m_pScratchBitmapBrush = NULL;
 
+    m_pEffectFusionParentNoRef = NULL;
+
     m_renderedRegionCount = 0;
 
     for (UINT i = 0; i < CDirtyRegion2::MaxDirtyRegionCount; i++)
@@ -555,6 +560,59 @@ CDrawingContext::GetClipBoundsWorld(
     m_clipStack.Top(pClipBounds);
 }
 
+//+-----------------------------------------------------------------------------
+//
+//  Member:    GetLocalCullBounds
+//
+//  Synopsis:  Returns the current world clip, inflated for anti-aliasing and
+//             transformed back to local space. Content entirely outside of
+//             these bounds cannot affect the target. Returns false when
+//             bounding, or when the clip is unbounded or cannot be mapped
+//             back to local space.
+//
+//------------------------------------------------------------------------------
+
+bool
+CDrawingContext::GetLocalCullBounds(
+    __out_ecount(1) CMilRectF *prcCullBoundsLocal
+    )
+{
+    CRectF<CoordinateSpace::PageInPixels> rcClipWorld;
+    CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::PageInPixels> matLocalToWorld;
+    CMatrix<CoordinateSpace::PageInPixels,CoordinateSpace::LocalRendering> matWorldToLocal;
+    CRectF<CoordinateSpace::LocalRendering> rcClipLocal;
+
+    if (IsBounding())
+    {
+        return false;
+    }
+
+    GetClipBoundsWorld(&rcClipWorld);
+
+    if (rcClipWorld.IsInfinite())
+    {
+        return false;
+    }
+
+    if (!rcClipWorld.IsEmpty())
+    {
+        InflateRectF_InPlace(&rcClipWorld);
+    }
+
+    m_transformStack.Top(&matLocalToWorld);
+
+    if (!matWorldToLocal.Invert(matLocalToWorld))
+    {
+        return false;
+    }
+
+    matWorldToLocal.Transform2DBoundsConservative(rcClipWorld, OUT rcClipLocal);
+
+    *prcCullBoundsLocal = rcClipLocal;
+
+    return true;
+}
+
 //+-----------------------------------------------------------------------------
 //
 //  Member:    TemporarilySetWorldTransform
@@ -3101,6 +3159,21 @@ HRESULT CDrawingContext::PushLayer(
                 goto Cleanup;
             }       
 
+            // The output of the Effect can only be stored if the layer holds all of it.
+            if (layer.pEffectResultVisualNoRef != NULL)
+            {
+                CRectF<CoordinateSpace::PageInPixels> unclippedBoundsWorldSpace;
+                layer.scaleMatrix.Transform2DBounds(*pSurfaceBoundsLocalSpace, OUT unclippedBoundsWorldSpace);
+
+                if (   unclippedBoundsWorldSpace.left != surfaceBoundsWorldSpace.left
+                    || unclippedBoundsWorldSpace.top != surfaceBoundsWorldSpace.top
+                    || unclippedBoundsWorldSpace.right != surfaceBoundsWorldSpace.right
+                    || unclippedBoundsWorldSpace.bottom != surfaceBoundsWorldSpace.bottom)
+                {
+                    layer.pEffectResultVisualNoRef = NULL;
+                }
+            }
+
             // Set the clip to the inflated bounds returned from the Effect.
             rcClip = surfaceBoundsWorldSpace;
         }
@@ -3348,6 +3421,9 @@ HRESULT CDrawingContext::PushLayer(
             if (layer.surfaceScaleX != 1.0f || layer.surfaceScaleY != 1.0f)
             {
                 layer.scaleMatrix.Scale(layer.surfaceScaleX, layer.surfaceScaleY);
+
+                // A scaled down output is not worth keeping.
+                layer.pEffectResultVisualNoRef = NULL;
             }
 
             // Store the intermediate size on the layer.
@@ -3825,6 +3901,12 @@ HRESULT CDrawingContext::DrawEffectLayer(
 
     ApplyRenderState();
 
+    // If the output can be reused, run the Effect into an intermediate of its own.
+    if (layer.pEffectResultVisualNoRef != NULL)
+    {
+        IFC(StoreEffectResult(layer));
+        goto Cleanup;
+    }
 
     // Temporarily set the world transform to apply the rest of the world transform
     // (rotate+offset) for the ComposeEffect call. 
@@ -3862,7 +3944,12 @@ HRESULT CDrawingContext::DrawEffectLayer(
         
     }
     
-    IFC(m_pIRenderTarget->ComposeEffect(
+    if (layer.pFusedEffect != NULL)
+    {
+        layer.pEffect->SetFusedEffectSw(layer.pFusedEffect);
+    }
+
+    MIL_THR(m_pIRenderTarget->ComposeEffect(
         &m_contextState, 
         &layer.scaleMatrix, 
         layer.pEffect,
@@ -3871,6 +3958,13 @@ HRESULT CDrawingContext::DrawEffectLayer(
         layer.prtbmOutput
         ));
 
+    if (layer.pFusedEffect != NULL)
+    {
+        layer.pEffect->SetFusedEffectSw(NULL);
+    }
+
+    IFC(hr);
+
 Cleanup:
 
     // Undo TemporarilySet* by resetting the current transform and clip
@@ -4373,9 +4467,13 @@ CDrawingContext::DrawVisualTree(
 {
     HRESULT hr = S_OK;
     bool fWasDrawingIntoVisualBrush = m_fDrawingIntoVisualBrush;
+    CMilVisual *pEffectFusionParentNoRef = m_pEffectFusionParentNoRef;
 
     m_fDrawingIntoVisualBrush = fDrawingIntoVisualBrush;
 
+    // A failed walk may have left a fusion pending
+    m_pEffectFusionParentNoRef = NULL;
+
     AssertConstMsg(m_pGraphIterator, "There is a problem with using the render context from the UiThread. You can only call this for visuals.");
 
     // This rectangle may represent either a dirty rectangle or the bounds of
@@ -4430,6 +4528,7 @@ CDrawingContext::DrawVisualTree(
 
 Cleanup:
     m_fDrawingIntoVisualBrush = fWasDrawingIntoVisualBrush;
+    m_pEffectFusionParentNoRef = pEffectFusionParentNoRef;
  
     RRETURN(hr);
 }
@@ -4725,6 +4824,484 @@ Cleanup:
     RRETURN(hr);
 } 
 
+//---------------------------------------------------------------------------------
+// CDrawingContext::CanFuseEffectWithChild
+//
+//  Returns true if the Effect of pNode can be run together with the Effect
+//  of its only child, on the child's layer, instead of rendering the child's
+//  Effect into a layer of its own for pNode's Effect to read. This saves an
+//  intermediate the size of pNode's bounds and a pass over it.
+//
+//  This is only done in software and only when the result is the same:
+//
+//  - pNode's Effect is point-wise: it only reads its implicit input at each
+//    pixel's own position and maps transparent to transparent (see
+//    CMilShaderEffectDuce::GetPointwiseSwPixelShader). Pixels that the
+//    child's Effect does not produce are then left untouched.
+//  - Nothing is drawn into pNode's layer but the child's Effect output, and
+//    nothing is applied to that output in between: pNode has no content,
+//    opacity, opacity mask, clip or cache, and the child has no transform,
+//    clip, cache or scrolling.
+//  - The child's layer is composited at an integral translation, so that
+//    its pixels are those pNode's Effect would have read.
+//---------------------------------------------------------------------------------
+
+HRESULT
+CDrawingContext::CanFuseEffectWithChild(
+    __in_ecount(1) CMilVisual *pNode,
+    __in_ecount(1) CRectF<CoordinateSpace::PageInPixels> const *prcBoundsWorld,
+    __out_ecount(1) bool *pfCanFuse
+    )
+{
+    HRESULT hr = S_OK;
+
+    *pfCanFuse = false;
+
+    Assert(pNode->m_pEffect != NULL);
+
+    if (   IsBounding()
+        || m_dwInternalRenderTargetType != SWRasterRenderTarget
+        || !pNode->m_pEffect->UsesImplicitInput()
+        || pNode->m_pClip != NULL
+        || pNode->m_pAlphaMaskWrapper != NULL
+        || !IsCloseReal(static_cast<float>(pNode->m_alpha), 1.0f)
+        || pNode->m_pCaches != NULL
+        || pNode->m_pContent != NULL
+        || pNode->GetChildrenCount() != 1)
+    {
+        goto Cleanup;
+    }
+
+    {
+        CMilVisual *pChild = pNode->GetChildren()[0];
+
+        if (   pChild->m_pEffect == NULL
+            || !pChild->m_pEffect->UsesImplicitInput()
+            || pChild->m_pTransform != NULL
+            || pChild->m_pScrollBag != NULL
+            || pChild->m_pCaches != NULL
+            || pChild->m_pClip != NULL)
+        {
+            goto Cleanup;
+        }
+
+        EffectCompositionMode effectCompositionMode;
+        IFC(DetermineEffectCompositionMode(pChild->m_pEffect, &effectCompositionMode));
+        if (effectCompositionMode != RenderCompatible)
+        {
+            goto Cleanup;
+        }
+
+        const CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::PageInPixels> *pWorldTransform = m_transformStack.GetTopByReference();
+
+        if (   !pWorldTransform->IsTranslateOrScale()
+            || pWorldTransform->_11 <= 0.0f
+            || pWorldTransform->_22 <= 0.0f)
+        {
+            goto Cleanup;
+        }
+
+        float rTranslateX = pWorldTransform->_41;
+        float rTranslateY = pWorldTransform->_42;
+        float rChildOffsetX = pWorldTransform->_11 * pChild->m_offsetX;
+        float rChildOffsetY = pWorldTransform->_22 * pChild->m_offsetY;
+
+        if (   rTranslateX != static_cast<float>(CFloatFPU::Round(rTranslateX))
+            || rTranslateY != static_cast<float>(CFloatFPU::Round(rTranslateY))
+            || rChildOffsetX != static_cast<float>(CFloatFPU::Round(rChildOffsetX))
+            || rChildOffsetY != static_cast<float>(CFloatFPU::Round(rChildOffsetY)))
+        {
+            goto Cleanup;
+        }
+
+        // pNode's layer would have been scaled down to fit, which fusing
+        // does not reproduce
+        if (   prcBoundsWorld->Width() > MAX_EFFECT_SW_INTERMEDIATE_SIZE
+            || prcBoundsWorld->Height() > MAX_EFFECT_SW_INTERMEDIATE_SIZE)
+        {
+            goto Cleanup;
+        }
+
+        IFC(pChild->m_pEffect->CanFuseWithOuterEffectSw(pNode->m_pEffect, pfCanFuse));
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::PushFusedImageEffect
+//
+//  Pushes the layer for an image effect that is run together with
+//  pFusedEffect, the Effect of the parent visual, when the layer is popped.
+//---------------------------------------------------------------------------------
+
+HRESULT
+CDrawingContext::PushFusedImageEffect(
+    __in_ecount(1) CMilEffectDuce *pEffect,
+    __in_ecount(1) CMilEffectDuce *pFusedEffect,
+    __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcBounds
+    )
+{
+    HRESULT hr = S_OK;
+
+    Assert(!IsBounding());
+
+    CLayer layer(1.0f, NULL, NULL, pEffect, prcBounds);
+    layer.pFusedEffect = pFusedEffect;
+
+    IFC(PushLayer(layer, prcBounds));
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::GetEffectResultKey
+//
+//  Returns false if the output of the Effect of pNode cannot be stored in or
+//  drawn from CEffectResultCache. Otherwise returns the key of the output and
+//  the translation at which it is drawn.
+//
+//  Outputs are only reused in software, when the world transform is a scale
+//  followed by an integer translation, so that drawing them is pixel exact.
+//---------------------------------------------------------------------------------
+
+bool
+CDrawingContext::GetEffectResultKey(
+    __in_ecount(1) CMilVisual *pNode,
+    __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcEffectBounds,
+    __out_ecount(1) EffectResultKey *pKey,
+    __out_ecount(1) MilPoint2F *pptTranslation
+    )
+{
+    Assert(pNode->m_pEffect != NULL);
+
+    if (   IsBounding()
+        || m_pComposition == NULL
+        || m_dwInternalRenderTargetType != SWRasterRenderTarget
+        || m_renderState.CompositingMode != MilCompositingMode::SourceOver
+        || !pNode->m_pEffect->UsesImplicitInput()
+        || pNode->m_pCaches != NULL
+        || pNode->m_pScrollBag != NULL
+        || (pNode->m_pParent != NULL && pNode->m_pParent == m_pEffectFusionParentNoRef))
+    {
+        return false;
+    }
+
+    const CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::PageInPixels> *pWorldTransform =
+        m_transformStack.GetTopByReference();
+
+    if (   !pWorldTransform->IsTranslateOrScale()
+        || pWorldTransform->_11 <= 0.0f
+        || pWorldTransform->_22 <= 0.0f)
+    {
+        return false;
+    }
+
+    // Same decomposition as SetupEffectTransform
+    CMILMatrix matScale;
+    CMILMatrix matRest;
+    BOOL fCanDecompose;
+    pWorldTransform->DecomposeMatrixIntoScaleAndRest(&matScale, &matRest, &fCanDecompose);
+
+    if (   !fCanDecompose
+        || !matRest.IsPureTranslate()
+        || matRest._41 != static_cast<float>(CFloatFPU::Round(matRest._41))
+        || matRest._42 != static_cast<float>(CFloatFPU::Round(matRest._42)))
+    {
+        return false;
+    }
+
+    CRectF<CoordinateSpace::PageInPixels> rcSurfaceF;
+    matScale.Transform2DBounds(*prcEffectBounds, OUT rcSurfaceF);
+
+    MilPointAndSizeL rcSurface;
+    if (FAILED(InflateRectFToPointAndSizeL(rcSurfaceF, OUT rcSurface)))
+    {
+        return false;
+    }
+
+    SetEffectResultKey(pNode->m_pEffect, matScale._11, matScale._22, rcSurface, pKey);
+
+    pptTranslation->X = matRest._41;
+    pptTranslation->Y = matRest._42;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::SetEffectResultKey
+//
+//  Fills in the key of an Effect output with the given layer and the render
+//  options currently in effect.
+//---------------------------------------------------------------------------------
+
+void
+CDrawingContext::SetEffectResultKey(
+    __in_ecount(1) CMilEffectDuce *pEffect,
+    float rScaleX,
+    float rScaleY,
+    __in_ecount(1) const MilPointAndSizeL &rcSurface,
+    __out_ecount(1) EffectResultKey *pKey
+    )
+{
+    pKey->pEffectNoRef = pEffect;
+    pKey->rScaleX = rScaleX;
+    pKey->rScaleY = rScaleY;
+    pKey->rcSurface = rcSurface;
+    pKey->antiAliasMode = m_renderState.AntiAliasMode;
+    pKey->interpolationMode = m_renderState.InterpolationMode;
+    pKey->textRenderingMode = m_renderState.TextRenderingMode;
+    pKey->textHintingMode = m_renderState.TextHintingMode;
+    pKey->fPrefilterEnable = !!m_renderState.PrefilterEnable;
+    pKey->fClearTypeHint = !!m_fClearTypeHint;
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::DrawEffectResult
+//
+//  Draws the stored output of the Effect of pNode, if there is one, and sets
+//  m_fUseEffectResult on the node so that its subtree is not rendered.
+//  Otherwise returns whether the output should be stored once it is run.
+//---------------------------------------------------------------------------------
+
+HRESULT
+CDrawingContext::DrawEffectResult(
+    __in_ecount(1) CMilVisual *pNode,
+    __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcEffectBounds,
+    __out_ecount(1) bool *pfStoreResult
+    )
+{
+    HRESULT hr = S_OK;
+    IMILRenderTargetBitmap *pIRTB = NULL;
+
+    EffectResultKey key;
+    MilPoint2F ptTranslation;
+
+    *pfStoreResult = false;
+
+    if (!GetEffectResultKey(pNode, prcEffectBounds, &key, &ptTranslation))
+    {
+        goto Cleanup;
+    }
+
+    if (!m_pComposition->GetEffectResultCacheNoRef()->Lookup(pNode, key, &pIRTB))
+    {
+        *pfStoreResult = true;
+        goto Cleanup;
+    }
+
+    IFC(DrawEffectResultBitmap(pIRTB, key.rcSurface, ptTranslation));
+
+    pNode->m_fUseEffectResult = TRUE;
+
+    {
+        CFrameTimingRecorder *pFrameTiming = m_pComposition->GetFrameTimingRecorder();
+        if (pFrameTiming)
+        {
+            pFrameTiming->Counters().cEffectResultsReused++;
+        }
+    }
+
+Cleanup:
+    ReleaseInterface(pIRTB);
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::PushCacheableImageEffect
+//
+//  Pushes the layer for the Effect of pNode, whose output is stored in
+//  CEffectResultCache when the layer is popped if the layer covers the whole
+//  output.
+//---------------------------------------------------------------------------------
+
+HRESULT
+CDrawingContext::PushCacheableImageEffect(
+    __in_ecount(1) CMilVisual *pNode,
+    __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcBounds
+    )
+{
+    HRESULT hr = S_OK;
+
+    Assert(!IsBounding());
+
+    CLayer layer(1.0f, NULL, NULL, pNode->m_pEffect, prcBounds);
+    layer.pEffectResultVisualNoRef = pNode;
+
+    IFC(PushLayer(layer, prcBounds));
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::StoreEffectResult
+//
+//  Runs the Effect of layer into an intermediate of its own, stores the
+//  intermediate in CEffectResultCache and draws it in place of the Effect.
+//---------------------------------------------------------------------------------
+
+HRESULT
+CDrawingContext::StoreEffectResult(
+    __in_ecount(1) const CLayer &layer
+    )
+{
+    HRESULT hr = S_OK;
+    IMILRenderTargetBitmap *pIRTB = NULL;
+    IRenderTargetInternal *pIRT = NULL;
+
+    CAliasedClip savedClip = m_contextState.AliasedClip;
+    bool fClipChanged = false;
+
+    Assert(layer.surfaceScaleX == 1.0f && layer.surfaceScaleY == 1.0f);
+
+    MilPointAndSizeL rcSurface;
+    rcSurface.X = layer.ptLayerPosition.X;
+    rcSurface.Y = layer.ptLayerPosition.Y;
+    rcSurface.Width = static_cast<INT>(layer.uIntermediateWidth);
+    rcSurface.Height = static_cast<INT>(layer.uIntermediateHeight);
+
+    IntermediateRTUsage rtUsage;
+    rtUsage.flags = IntermediateRTUsage::ForBlending;
+    rtUsage.wrapMode = MilBitmapWrapMode::Extend;
+
+    IFC(m_pIRenderTarget->CreateRenderTargetBitmap(
+        layer.uIntermediateWidth,
+        layer.uIntermediateHeight,
+        rtUsage,
+        MilRTInitialization::SoftwareOnly,
+        &pIRTB
+        ));
+
+    IFC(pIRTB->QueryInterface(
+        IID_IRenderTargetInternal,
+        reinterpret_cast<void **>(&pIRT)
+        ));
+
+    {
+        MilColorF colBlank = {0, 0, 0, 0};
+        IFC(pIRT->Clear(&colBlank));
+    }
+
+    // The whole output is composed at the origin of the intermediate.
+    {
+        CMilRectF rcIntermediate(
+            0,
+            0,
+            static_cast<FLOAT>(layer.uIntermediateWidth),
+            static_cast<FLOAT>(layer.uIntermediateHeight),
+            XYWH_Parameters
+            );
+
+        m_contextState.AliasedClip = CAliasedClip(&rcIntermediate);
+        fClipChanged = true;
+
+        TemporarilySetWorldTransform(
+            CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::PageInPixels>(true)
+            );
+    }
+
+    IFC(pIRT->ComposeEffect(
+        &m_contextState,
+        &layer.scaleMatrix,
+        layer.pEffect,
+        layer.uIntermediateWidth,
+        layer.uIntermediateHeight,
+        layer.prtbmOutput
+        ));
+
+    m_contextState.AliasedClip = savedClip;
+    fClipChanged = false;
+
+    {
+        EffectResultKey key;
+        SetEffectResultKey(layer.pEffect, layer.scaleMatrix._11, layer.scaleMatrix._22, rcSurface, &key);
+
+        IFC(m_pComposition->GetEffectResultCacheNoRef()->Store(
+            layer.pEffectResultVisualNoRef,
+            key,
+            pIRTB
+            ));
+    }
+
+    // Undo TemporarilySetWorldTransform before drawing
+    ApplyRenderState();
+
+    {
+        MilPoint2F ptTranslation;
+        ptTranslation.X = layer.restMatrix._41;
+        ptTranslation.Y = layer.restMatrix._42;
+
+        IFC(DrawEffectResultBitmap(pIRTB, rcSurface, ptTranslation));
+    }
+
+Cleanup:
+    if (fClipChanged)
+    {
+        m_contextState.AliasedClip = savedClip;
+    }
+
+    ReleaseInterface(pIRT);
+    ReleaseInterface(pIRTB);
+    RRETURN(hr);
+}
+
+//---------------------------------------------------------------------------------
+// CDrawingContext::DrawEffectResultBitmap
+//
+//  Draws an Effect output, whose intermediate covers rcSurface in the scaled
+//  space of its layer, translated by ptTranslation in the current target.
+//---------------------------------------------------------------------------------
+
+HRESULT
+CDrawingContext::DrawEffectResultBitmap(
+    __in_ecount(1) IMILRenderTargetBitmap *pIRTB,
+    __in_ecount(1) const MilPointAndSizeL &rcSurface,
+    __in_ecount(1) const MilPoint2F &ptTranslation
+    )
+{
+    HRESULT hr = S_OK;
+    IWGXBitmapSource *pBitmapSource = NULL;
+    bool fPushedTransform = false;
+
+    IFC(pIRTB->GetBitmapSource(&pBitmapSource));
+
+    {
+        CMILMatrix matSurfaceToTarget(true);
+        matSurfaceToTarget.SetTranslation(
+            ptTranslation.X + static_cast<float>(rcSurface.X),
+            ptTranslation.Y + static_cast<float>(rcSurface.Y)
+            );
+
+        // Replace the world transform, the scale is already in the output
+        IFC(PushTransform(&matSurfaceToTarget, false));
+        fPushedTransform = true;
+    }
+
+    {
+        CMilRectF rcBitmap(
+            0,
+            0,
+            static_cast<FLOAT>(rcSurface.Width),
+            static_cast<FLOAT>(rcSurface.Height),
+            XYWH_Parameters
+            );
+
+        IFC(DrawBitmap(pBitmapSource, &rcBitmap, &rcBitmap, 1.0f));
+    }
+
+Cleanup:
+    if (fPushedTransform)
+    {
+        PopTransform();
+    }
+
+    ReleaseInterface(pBitmapSource);
+    RRETURN(hr);
+}
+
 //---------------------------------------------------------------------------------
 // IGraphIteratorSink PreSubgraph
 //
@@ -4756,6 +5333,8 @@ CDrawingContext::PreSubgraph(__out_ecount(1) BOOL *pfVisitChildren)
     *pfVisitChildren = TRUE;
     pNode->m_fSkipNodeRender = FALSE;
     pNode->m_fUseCacheAsEffectInput = FALSE;
+    pNode->m_fFuseEffectWithChild = FALSE;
+    pNode->m_fUseEffectResult = FALSE;
     bool fSkipNodeRenderBelowEffect = false;
      
     //
@@ -4924,9 +5503,23 @@ CDrawingContext::PreSubgraph(__out_ecount(1) BOOL *pfVisitChildren)
             EffectCompositionMode effectCompositionMode;
             IFC(DetermineEffectCompositionMode(pNode->m_pEffect, &effectCompositionMode));
 
+            // If the output of the Effect was stored in an earlier frame and nothing below
+            // the Effect changed since, draw that instead of rendering the subtree.
+            bool fStoreEffectResult = false;
+            if (   !fSkipNodeRenderBelowEffect
+                && !pNode->m_fUseCacheAsEffectInput
+                && effectCompositionMode == RenderCompatible)
+            {
+                IFC(DrawEffectResult(pNode, &rcEffectBounds, &fStoreEffectResult));
+            }
+
             // If we can render the effect without creating an intermediate render target, do
             // that here.
-            if (fSkipNodeRenderBelowEffect || pNode->m_fUseCacheAsEffectInput)
+            if (pNode->m_fUseEffectResult)
+            {
+                // Already drawn.
+            }
+            else if (fSkipNodeRenderBelowEffect || pNode->m_fUseCacheAsEffectInput)
             {   
                 switch (effectCompositionMode)
                 {
@@ -4965,9 +5558,44 @@ CDrawingContext::PreSubgraph(__out_ecount(1) BOOL *pfVisitChildren)
                 switch (effectCompositionMode)
                 {
                     case RenderCompatible:
-                        // If we can render the effect, push the layer for the image effect to be executed on.  
-                        // We will create a compatible render target for the effect in PushLayer.
-                        IFC(PushImageEffect(pNode->m_pEffect, &rcEffectBounds));
+                        if (   pNode->m_pParent != NULL
+                            && pNode->m_pParent == m_pEffectFusionParentNoRef)
+                        {
+                            // Our parent's Effect runs on our layer, together with ours.
+                            IFC(PushFusedImageEffect(pNode->m_pEffect, m_pEffectFusionParentNoRef->m_pEffect, &rcEffectBounds));
+                            m_pEffectFusionParentNoRef = NULL;
+                        }
+                        else
+                        {
+                            bool fFuseEffectWithChild;
+                            IFC(CanFuseEffectWithChild(pNode, &clippedBoundsWorldAAInflated, &fFuseEffectWithChild));
+
+                            if (fFuseEffectWithChild)
+                            {
+                                // Our Effect runs on our child's layer, see CanFuseEffectWithChild.
+                                pNode->m_fFuseEffectWithChild = TRUE;
+                                m_pEffectFusionParentNoRef = pNode;
+
+                                CFrameTimingRecorder *pFrameTiming = m_pComposition ? m_pComposition->GetFrameTimingRecorder() : NULL;
+                                if (pFrameTiming)
+                                {
+                                    pFrameTiming->Counters().cFusedEffects++;
+                                    pFrameTiming->Counters().cbEffectIntermediatesSaved += static_cast<UINT>(
+                                        clippedBoundsWorldAAInflated.Width() * clippedBoundsWorldAAInflated.Height()) * 4;
+                                }
+                            }
+                            else if (fStoreEffectResult)
+                            {
+                                // Same as below, and the output is stored when the layer is popped.
+                                IFC(PushCacheableImageEffect(pNode, &rcEffectBounds));
+                            }
+                            else
+                            {
+                                // If we can render the effect, push the layer for the image effect to be executed on.  
+                                // We will create a compatible render target for the effect in PushLayer.
+                                IFC(PushImageEffect(pNode->m_pEffect, &rcEffectBounds));
+                            }
+                        }
                         break;
                         
                     case SkipRender:
@@ -5046,7 +5674,7 @@ CDrawingContext::PreSubgraph(__out_ecount(1) BOOL *pfVisitChildren)
     Assert(pNode->m_pCaches == NULL || pNode->m_pCaches->IsValid());
 
     // If we don't need to realize the implicit input for our Effect, stop rendering.
-    if (fSkipNodeRenderBelowEffect || pNode->m_fUseCacheAsEffectInput)
+    if (fSkipNodeRenderBelowEffect || pNode->m_fUseCacheAsEffectInput || pNode->m_fUseEffectResult)
     {
         Assert(pNode->m_pEffect != NULL);
         *pfVisitChildren = FALSE;
@@ -5130,7 +5758,9 @@ CDrawingContext::PostSubgraph()
                 
                 // If we optimized the Effect layer away using a cache or because we didn't need to realize the
                 // implicit input, we don't need to pop the Effect nor anything below it.
-                if (!fSkipNodeRenderBelowEffect && !pNode->m_fUseCacheAsEffectInput)
+                if (   !fSkipNodeRenderBelowEffect
+                    && !pNode->m_fUseCacheAsEffectInput
+                    && !pNode->m_fUseEffectResult)
                 {
                     // Otherwise, pop all the layers we pushed for effects and the other properties.
                     if (pNode->m_pAlphaMaskWrapper != NULL || opacity != 1.0f)
@@ -5138,8 +5768,21 @@ CDrawingContext::PostSubgraph()
                         IFC(PopEffects());
                     }
                     
-                    // Pop the image effect
-                    IFC(PopEffects());
+                    // Pop the image effect, unless it was run by our child's layer.
+                    if (pNode->m_fFuseEffectWithChild)
+                    {
+                        pNode->m_fFuseEffectWithChild = FALSE;
+
+                        // Our child may not have been rendered at all
+                        if (m_pEffectFusionParentNoRef == pNode)
+                        {
+                            m_pEffectFusionParentNoRef = NULL;
+                        }
+                    }
+                    else
+                    {
+                        IFC(PopEffects());
+                    }
                 }
 
                 // Whenever an effect is rendered, we need to check to see if a dummy software layer 
@@ -5665,7 +6308,7 @@ CDrawingContext::PreCompute(
     __in_ecount_opt(uNumInvalidTargetRegions) MilRectF const *rgInvalidTargetRegions,
     float allowedDirtyRegionOverhead,
     BOOL fFullRender,
-    __in_opt ScrollArea *pScrollArea    
+    __in_opt ScrollAreaList *pScrollAreas
     )
 {
     HRESULT hr = S_OK;
@@ -5685,7 +6328,7 @@ CDrawingContext::PreCompute(
             rgInvalidTargetRegions, 
             allowedDirtyRegionOverhead, 
             DefaultInterpolationMode,
-            pScrollArea,
+            pScrollAreas,
             fFullRender         // No dirty region collection if it's a full render
             ));
     }
@@ -5939,7 +6582,12 @@ CDrawingContext::Render(
             }            
         }    
         
-        ScrollArea scrollArea = {0};
+        ScrollAreaList scrollAreas;
+        scrollAreas.cScrollAreas = 0;
+        scrollAreas.cScrollCandidates = 0;
+
+        CFrameTimingRecorder *pFrameTiming = m_pComposition ? m_pComposition->GetFrameTimingRecorder() : NULL;
+        QPC_TIME qpcPhaseStart = pFrameTiming ? pFrameTiming->BeginPhase() : 0;
 
         IFC(PreCompute(
                 pRoot,
@@ -5948,25 +6596,48 @@ CDrawingContext::Render(
                 rgInvalidTargetRegions,
                 50000.0f,
                 fFullRender,
-                (fCanAccelerateScroll && !fFullRender) ? &scrollArea : NULL
+                (fCanAccelerateScroll && !fFullRender) ? &scrollAreas : NULL
                 ));        
 
+        //
+        // Report the accelerated scroll hit rate for this frame. Scrolled areas
+        // that are not accelerated are redrawn through regular dirty regions.
+        //
+        MtSet(Mt(ScrolledAreasPerFrame), scrollAreas.cScrollCandidates, 0);
+        MtSet(Mt(AcceleratedScrollsPerFrame), scrollAreas.cScrollAreas, 0);
+
+        if (pFrameTiming)
+        {
+            pFrameTiming->EndPhase(FrameTimingPhase::PreCompute, qpcPhaseStart);
+            pFrameTiming->Counters().cScrolledAreas += scrollAreas.cScrollCandidates;
+            pFrameTiming->Counters().cAcceleratedScrolls += scrollAreas.cScrollAreas;
+
+            qpcPhaseStart = pFrameTiming->BeginPhase();
+        }
+
         // ETW end trace event
         EventWriteWClientUcePrecomputeEnd(data);
 
         // ETW start trace event
         EventWriteWClientUceRenderBegin(data);
 
-        if (   fCanAccelerateScroll
-            && scrollArea.fDoScroll)
+        if (fCanAccelerateScroll)
         {
-            Assert(pIMILRenderTargetHWND != NULL);
-            
-            // We have a scroll change, and we have only software render targets. This means we can accelerate scrolls            
+            // We have scroll changes, and we have only software render targets. This means we can accelerate scrolls            
             // Scroll the backbuffer only, for now
             // We scroll the front buffer only when we're about to present the other dirty regions. This
             // hopefully helps GDI batch the changes so we don't have tearing.
-            IFC(pIMILRenderTargetHWND->ScrollBlt(&(scrollArea.source), &(scrollArea.destination)));
+            // The areas don't overlap, and are blitted in the order PreCompute found them.
+            for (UINT i = 0; i < scrollAreas.cScrollAreas; i++)
+            {
+                Assert(pIMILRenderTargetHWND != NULL);
+                Assert(scrollAreas.rgScrollAreas[i].fDoScroll);
+
+                IFC(pIMILRenderTargetHWND->ScrollBlt(
+                    &(scrollAreas.rgScrollAreas[i].source),
+                    &(scrollAreas.rgScrollAreas[i].destination)
+                    ));
+            }
         }
 
         // Update any caches marked dirty in the PreCompute walk.
@@ -6012,6 +6683,19 @@ CDrawingContext::Render(
 
         EventWriteWClientUceRenderEnd(data);
 
+        if (pFrameTiming)
+        {
+            pFrameTiming->EndPhase(FrameTimingPhase::Render, qpcPhaseStart);
+            pFrameTiming->Counters().cDirtyRects += m_renderedRegionCount;
+
+            for (UINT i = 0; i < m_renderedRegionCount; i++)
+            {
+                pFrameTiming->Counters().cDirtyPixels += static_cast<UINT>(
+                    m_renderedRegions[i].Width() * m_renderedRegions[i].Height()
+                    );
+            }
+        }
+
         // If the dirty region analysis is disabled or if the user wants to clear before every render, then
         // we need to indicate to the calling code that we rendered everything.
         // The caller of this function (currently only the render target), then must present the whole surface.
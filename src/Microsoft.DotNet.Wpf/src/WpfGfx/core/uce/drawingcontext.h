@@ -21,6 +21,7 @@ class CMilCameraDuce;
 class CPreComputeContext;
 class CMilGeometryDuce;
 class CMilEffectDuce;
+struct EffectResultKey;
 
 typedef CMatrix<CoordinateSpace::LocalRendering,CoordinateSpace::LocalRendering> CLocalRenderingMatrix;
 
@@ -255,6 +256,10 @@ public:
         return (m_dwInternalRenderTargetType & BoundsRenderTarget);
     }
 
+    override bool GetLocalCullBounds(
+        __out_ecount(1) CMilRectF *prcCullBoundsLocal
+        );
+
 
     HRESULT BeginFrame(
         __in_ecount(1) IMILRenderTarget *pIRenderTarget
@@ -332,7 +337,7 @@ protected:
         __in_ecount_opt(uNumInvalidTargetRegions) MilRectF const *rgInvalidTargetRegions,
         float allowedDirtyRegionOverhead,
         BOOL fFullRender,
-        __in_opt ScrollArea *pScrollArea
+        __in_opt ScrollAreaList *pScrollAreas
         );
     
     void GetClipBoundsWorld(__out_ecount(1) CRectF<CoordinateSpace::PageInPixels> *pClipBounds);
@@ -489,6 +494,54 @@ private:
         __in_ecount(1) CMilVisual const *pNode,
         __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcBounds
         );
+
+    HRESULT CanFuseEffectWithChild(
+        __in_ecount(1) CMilVisual *pNode,
+        __in_ecount(1) CRectF<CoordinateSpace::PageInPixels> const *prcBoundsWorld,
+        __out_ecount(1) bool *pfCanFuse
+        );
+
+    HRESULT PushFusedImageEffect(
+        __in_ecount(1) CMilEffectDuce *pEffect,
+        __in_ecount(1) CMilEffectDuce *pFusedEffect,
+        __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcBounds
+        );
+
+    bool GetEffectResultKey(
+        __in_ecount(1) CMilVisual *pNode,
+        __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcEffectBounds,
+        __out_ecount(1) EffectResultKey *pKey,
+        __out_ecount(1) MilPoint2F *pptTranslation
+        );
+
+    void SetEffectResultKey(
+        __in_ecount(1) CMilEffectDuce *pEffect,
+        float rScaleX,
+        float rScaleY,
+        __in_ecount(1) const MilPointAndSizeL &rcSurface,
+        __out_ecount(1) EffectResultKey *pKey
+        );
+
+    HRESULT DrawEffectResult(
+        __in_ecount(1) CMilVisual *pNode,
+        __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcEffectBounds,
+        __out_ecount(1) bool *pfStoreResult
+        );
+
+    HRESULT PushCacheableImageEffect(
+        __in_ecount(1) CMilVisual *pNode,
+        __in_ecount(1) CRectF<CoordinateSpace::LocalRendering> const *prcBounds
+        );
+
+    HRESULT StoreEffectResult(
+        __in_ecount(1) const CLayer &layer
+        );
+
+    HRESULT DrawEffectResultBitmap(
+        __in_ecount(1) IMILRenderTargetBitmap *pIRTB,
+        __in_ecount(1) const MilPointAndSizeL &rcSurface,
+        __in_ecount(1) const MilPoint2F &ptTranslation
+        );
     
     static HRESULT SetupEffectTransform(
         __in_ecount(1) CMilEffectDuce *pEffect,
@@ -623,6 +676,14 @@ protected:
     // visual (and not multiple times within content).
     CContentBounder *m_pContentBounder;
 
+    //
+    // Visual whose Effect is fused with the Effect of its only child, from
+    // the parent's PreSubgraph until the child's PreSubgraph pushes the
+    // fused layer. See CanFuseEffectWithChild.
+    //
+
+    CMilVisual *m_pEffectFusionParentNoRef;
+
     //
     // Precompute context for the tree walk.
     //
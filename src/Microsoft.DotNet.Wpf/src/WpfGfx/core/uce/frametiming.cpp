@@ -0,0 +1,287 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      Per frame phase timings and counters of the composition pipeline.
+//
+//------------------------------------------------------------------------------
+
+#include "precomp.hpp"
+
+CFrameTimingLog::Entry CFrameTimingLog::s_rgEntries[CFrameTimingLog::sc_cEntries];
+volatile LONGLONG CFrameTimingLog::s_cWritten = 0;
+volatile LONGLONG CFrameTimingLog::s_cRead = 0;
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingLog::Append
+//
+//  Synopsis:
+//      Adds a frame to the log, overwriting the oldest frame if the log is
+//      full. May be called concurrently from any number of threads.
+//
+//------------------------------------------------------------------------------
+
+void
+CFrameTimingLog::Append(
+    __in_ecount(1) const MilFrameTiming *pTiming
+    )
+{
+    C_ASSERT((sc_cEntries & (sc_cEntries - 1)) == 0);
+
+    LONGLONG iEntry = InterlockedIncrement64(&s_cWritten) - 1;
+    Entry &entry = s_rgEntries[iEntry & (sc_cEntries - 1)];
+
+    //
+    // An odd sequence marks the entry as being written. The interlocked
+    // exchanges are full barriers, so a reader that sees the final even
+    // sequence also sees the complete timing.
+    //
+
+    InterlockedExchange64(&entry.sequence, 2 * iEntry + 1);
+
+    entry.timing = *pTiming;
+
+    InterlockedExchange64(&entry.sequence, 2 * iEntry + 2);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingLog::Drain
+//
+//  Synopsis:
+//      Removes up to cTimingsMax of the oldest frames from the log, oldest
+//      first. *pcTimingsDropped receives the number of frames that were
+//      overwritten before they could be drained.
+//
+//      pbTimings is an array of cbTiming sized elements, each receiving the
+//      first cbTiming bytes of a MilFrameTiming with cbSize set to cbTiming.
+//
+//      A frame that is still being written ends the drain, so that it is
+//      returned by the next call. Concurrent drains each return a disjoint
+//      set of frames.
+//
+//------------------------------------------------------------------------------
+
+void
+CFrameTimingLog::Drain(
+    UINT cTimingsMax,
+    UINT cbTiming,
+    __out_bcount(cTimingsMax * cbTiming) BYTE *pbTimings,
+    __out_ecount(1) UINT *pcTimings,
+    __out_ecount(1) UINT *pcTimingsDropped
+    )
+{
+    Assert(cbTiming >= sizeof(UINT));
+
+    UINT cbCopy = min(cbTiming, static_cast<UINT>(sizeof(MilFrameTiming)));
+    UINT cTimings = 0;
+    UINT cTimingsDropped = 0;
+
+    for (;;)
+    {
+        LONGLONG cRead = s_cRead;
+        LONGLONG cWritten = s_cWritten;
+        LONGLONG iEntry = cRead;
+
+        cTimings = 0;
+        cTimingsDropped = 0;
+
+        // Skip the frames that have already been overwritten
+        if (cWritten - iEntry > sc_cEntries)
+        {
+            cTimingsDropped = static_cast<UINT>(cWritten - sc_cEntries - iEntry);
+            iEntry = cWritten - sc_cEntries;
+        }
+
+        while (iEntry < cWritten && cTimings < cTimingsMax)
+        {
+            const Entry &entry = s_rgEntries[iEntry & (sc_cEntries - 1)];
+            LONGLONG sequence = entry.sequence;
+
+            if (sequence < 2 * iEntry + 2)
+            {
+                // Reserved but not published yet
+                break;
+            }
+
+            if (sequence == 2 * iEntry + 2)
+            {
+                BYTE *pbTiming = pbTimings + cTimings * cbTiming;
+
+                RtlCopyMemory(pbTiming, &entry.timing, cbCopy);
+
+                MemoryBarrier();
+
+                if (entry.sequence == sequence)
+                {
+                    reinterpret_cast<MilFrameTiming *>(pbTiming)->cbSize = cbTiming;
+                    cTimings++;
+                    iEntry++;
+                    continue;
+                }
+            }
+
+            // The entry has been reused by a later frame
+            cTimingsDropped++;
+            iEntry++;
+        }
+
+        if (InterlockedCompareExchange64(&s_cRead, iEntry, cRead) == cRead)
+        {
+            break;
+        }
+
+        // Another drain consumed these frames first, start over
+    }
+
+    *pcTimings = cTimings;
+    *pcTimingsDropped = cTimingsDropped;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingRecorder::CFrameTimingRecorder
+//
+//------------------------------------------------------------------------------
+
+CFrameTimingRecorder::CFrameTimingRecorder()
+{
+    ZeroMemory(&m_timing, sizeof(m_timing));
+    ZeroMemory(m_rgqpcPhases, sizeof(m_rgqpcPhases));
+
+    m_timing.cbSize = sizeof(m_timing);
+
+    m_fQPCSupported = !!QueryPerformanceFrequency(&m_qpcFrequency);
+    m_fInFrame = false;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingRecorder::BeginFrame
+//
+//  Synopsis:
+//      Starts recording a new frame. Anything accumulated since the last
+//      commit, such as batches processed between frames, is kept and
+//      attributed to this frame.
+//
+//------------------------------------------------------------------------------
+
+void
+CFrameTimingRecorder::BeginFrame(UINT64 frameNumber)
+{
+    if (m_fInFrame)
+    {
+        // The previous frame was never committed, report it now
+        EndFrame();
+    }
+
+    m_timing.frameNumber = frameNumber;
+    m_timing.qpcFrameStart = BeginPhase();
+
+    m_fInFrame = true;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingRecorder::EndFrame
+//
+//------------------------------------------------------------------------------
+
+void
+CFrameTimingRecorder::EndFrame()
+{
+    if (!m_fInFrame)
+    {
+        return;
+    }
+
+    if (m_fQPCSupported && m_qpcFrequency.QuadPart > 0)
+    {
+        UINT *rgusPhases[FrameTimingPhase::Count] =
+        {
+            &m_timing.usProcessBatches,
+            &m_timing.usCompose,
+            &m_timing.usPreCompute,
+            &m_timing.usRender,
+            &m_timing.usPresent
+        };
+
+        for (UINT i = 0; i < FrameTimingPhase::Count; i++)
+        {
+            UINT64 us = static_cast<UINT64>(m_rgqpcPhases[i]) * 1000000 / static_cast<UINT64>(m_qpcFrequency.QuadPart);
+            *rgusPhases[i] = static_cast<UINT>(min(us, static_cast<UINT64>(UINT_MAX)));
+        }
+    }
+
+    CFrameTimingLog::Append(&m_timing);
+
+    ZeroMemory(&m_timing, sizeof(m_timing));
+    ZeroMemory(m_rgqpcPhases, sizeof(m_rgqpcPhases));
+
+    m_timing.cbSize = sizeof(m_timing);
+
+    m_fInFrame = false;
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingRecorder::BeginPhase
+//
+//  Synopsis:
+//      Returns the start time to pass to EndPhase.
+//
+//------------------------------------------------------------------------------
+
+QPC_TIME
+CFrameTimingRecorder::BeginPhase() const
+{
+    LARGE_INTEGER qpcNow;
+
+    if (!m_fQPCSupported || !QueryPerformanceCounter(&qpcNow))
+    {
+        qpcNow.QuadPart = 0;
+    }
+
+    return static_cast<QPC_TIME>(qpcNow.QuadPart);
+}
+
+//+-----------------------------------------------------------------------------
+//
+//  Member:
+//      CFrameTimingRecorder::EndPhase
+//
+//  Synopsis:
+//      Adds the time elapsed since qpcPhaseStart to the given phase. Phases
+//      entered several times per frame, e.g. once per render target, are
+//      summed.
+//
+//------------------------------------------------------------------------------
+
+void
+CFrameTimingRecorder::EndPhase(
+    FrameTimingPhase::Enum phase,
+    QPC_TIME qpcPhaseStart
+    )
+{
+    Assert(phase < FrameTimingPhase::Count);
+
+    QPC_TIME qpcNow = BeginPhase();
+
+    if (qpcNow > qpcPhaseStart)
+    {
+        m_rgqpcPhases[phase] += qpcNow - qpcPhaseStart;
+    }
+}
@@ -0,0 +1,140 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------------
+//
+
+//
+//  Abstract:
+//      Per frame phase timings and counters of the composition pipeline.
+//      Each composition device records its frames into a CFrameTimingRecorder
+//      and commits them to the process wide CFrameTimingLog, from which they
+//      are drained through MilCompositionEngine_GetFrameTimings.
+//
+//      MilFrameTiming and the export are published in wgx_render_types.h
+//      and wgx_render.h.
+//
+//------------------------------------------------------------------------------
+
+#pragma once
+
+//+-----------------------------------------------------------------------------
+//
+//  Enumeration:
+//      FrameTimingPhase
+//
+//  Synopsis:
+//      The phases of a frame that CFrameTimingRecorder measures.
+//
+//------------------------------------------------------------------------------
+
+namespace FrameTimingPhase
+{
+    enum Enum
+    {
+        ProcessBatches,
+        Compose,
+        PreCompute,
+        Render,
+        Present,
+
+        Count
+    };
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CFrameTimingLog
+//
+//  Synopsis:
+//      Process wide, lock free ring buffer of the most recent frame timings.
+//
+//      Writers reserve an entry by incrementing the write count and publish it
+//      with a sequence number, which is odd while the entry is being written.
+//      Readers copy an entry and keep it only if its sequence is unchanged, so
+//      neither side ever blocks. When the readers fall behind by more than
+//      sc_cEntries frames, the oldest frames are overwritten and reported as
+//      dropped.
+//
+//------------------------------------------------------------------------------
+
+class CFrameTimingLog
+{
+public:
+    static void Append(
+        __in_ecount(1) const MilFrameTiming *pTiming
+        );
+
+    static void Drain(
+        UINT cTimingsMax,
+        UINT cbTiming,
+        __out_bcount(cTimingsMax * cbTiming) BYTE *pbTimings,
+        __out_ecount(1) UINT *pcTimings,
+        __out_ecount(1) UINT *pcTimingsDropped
+        );
+
+private:
+    // Must be a power of two
+    static const UINT sc_cEntries = 128;
+
+    struct Entry
+    {
+        volatile LONGLONG sequence;
+        MilFrameTiming timing;
+    };
+
+    static Entry s_rgEntries[sc_cEntries];
+
+    // Number of frames ever appended, and the number consumed by Drain
+    static volatile LONGLONG s_cWritten;
+    static volatile LONGLONG s_cRead;
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CFrameTimingRecorder
+//
+//  Synopsis:
+//      Accumulates the timings and counters of the frame currently being
+//      composed by one composition device. Only used on the thread that
+//      composes the device.
+//
+//------------------------------------------------------------------------------
+
+class CFrameTimingRecorder
+{
+public:
+    CFrameTimingRecorder();
+
+    void BeginFrame(UINT64 frameNumber);
+
+    // Commits the current frame to CFrameTimingLog. Does nothing if no frame
+    // has been begun since the last commit.
+    void EndFrame();
+
+    QPC_TIME BeginPhase() const;
+
+    void EndPhase(
+        FrameTimingPhase::Enum phase,
+        QPC_TIME qpcPhaseStart
+        );
+
+    // Counters of the current frame, updated directly by the pipeline stages
+    MilFrameTiming &Counters()
+    {
+        return m_timing;
+    }
+
+private:
+    MilFrameTiming m_timing;
+
+    QPC_TIME m_rgqpcPhases[FrameTimingPhase::Count];
+
+    LARGE_INTEGER m_qpcFrequency;
+    bool m_fQPCSupported;
+    bool m_fInFrame;
+};
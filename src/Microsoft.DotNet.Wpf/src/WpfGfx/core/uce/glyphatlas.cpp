@@ -0,0 +1,1267 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------
+//
+
+//
+//  Description:
+//
+//    class CGlyphAtlas implementation.
+//    See comments in glyphatlas.h.
+//
+
+#include "precomp.hpp"
+
+MtDefine(CGlyphAtlas, MILRender, "CGlyphAtlas");
+MtDefine(GlyphAtlasPage, CGlyphAtlas, "Glyph atlas page");
+MtDefine(CGlyphRasterizationJob, CGlyphAtlas, "CGlyphRasterizationJob");
+
+MtExtern(GlyphBitmapClearType);
+
+// Glyphs of the runs composed from the atlas, including the time to
+// rasterize the missing ones, see perf.h
+DeclarePerfAcc(Text_Atlas_ComposeAlphaMap);
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::CGlyphAtlas
+//
+//  Synopsis:   Constructor
+//
+//-------------------------------------------------------------------------
+CGlyphAtlas::CGlyphAtlas(__in IDWriteFactory *pDWriteFactory)
+{
+    m_pDWriteFactory = pDWriteFactory;
+    m_pDWriteFactory->AddRef();
+
+    m_iPageCurrent = UINT_MAX;
+    m_cbTotal = 0;
+    m_cbSubpixelVariants = 0;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::~CGlyphAtlas
+//
+//  Synopsis:   Destructor
+//
+//-------------------------------------------------------------------------
+CGlyphAtlas::~CGlyphAtlas()
+{
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        m_rgEntries[i].key.pFont->Release();
+    }
+
+    for (UINT i = 0; i < m_rgPages.GetCount(); i++)
+    {
+        WPFFree(ProcessHeap, m_rgPages[i].pData);
+    }
+
+    ReleaseInterface(m_pDWriteFactory);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::GetRunBounds
+//
+//  Synopsis:   Makes sure that all the glyphs of a run are in the atlas,
+//              and returns the bounds of the alpha map ComposeAlphaMap
+//              makes for it at originPosition 0, in subpixels horizontally
+//              and pixels vertically. The bounds are empty if the run has
+//              no pixels.
+//
+//              pJob, if any, is a completed job from BeginRasterization for
+//              the same run; its glyphs are added to the atlas first. The
+//              glyphs still missing are rasterized in parallel stripes.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::GetRunBounds(
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace,
+    __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+    float rScaleX,
+    float rScaleY,
+    DWRITE_RENDERING_MODE renderingMode,
+    DWRITE_MEASURING_MODE measuringMode,
+    __in_opt CGlyphRasterizationJob *pJob,
+    UTC_TIME currentFrame,
+    __out RECT *pBoundingBox,
+    __out bool *pfIsBiLevelOnly
+    )
+{
+    HRESULT hr = S_OK;
+    DynArray<GlyphPlacement> rgPlacements;
+    bool fHasClearType;
+
+    IFC(PlaceGlyphs(
+        pFont,
+        pFontFace,
+        glyphRun,
+        rScaleX,
+        rScaleY,
+        renderingMode,
+        measuringMode,
+        pJob,
+        0,      // originPosition
+        currentFrame,
+        &rgPlacements,
+        pBoundingBox,
+        &fHasClearType
+        ));
+
+    *pfIsBiLevelOnly = !IsRectEmpty(*pBoundingBox) && !fHasClearType;
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::ComposeAlphaMap
+//
+//  Synopsis:   Builds the alpha map of a glyph run from the alpha maps of
+//              its glyphs in the atlas, in the run bitmap of
+//              pGlyphPainterMemory. The result has the layout of the alpha
+//              maps that CGlyphRunRealization gets from DWrite for the
+//              whole run, and stays valid until the run bitmap is used
+//              again. Glyphs trimmed from the atlas since GetRunBounds are
+//              rasterized again.
+//
+//              glyphRun must be a horizontal, left to right run whose
+//              transform is the scale rScaleX, rScaleY. The origin of each
+//              glyph is rounded to whole pixels vertically, and to
+//              1/sc_cSubpixelPositions pixels horizontally for the rendering
+//              modes that position glyphs at subpixels.
+//
+//              originPosition moves the run origin right by that many
+//              1/sc_cSubpixelPositions pixels, for the subpixel variants
+//              the software painter draws. It must be 0 for the rendering
+//              modes that do not position glyphs at subpixels.
+//
+//              The coverage of overlapping glyphs is summed before pECT is
+//              applied, and bi-level glyphs are added after it, matching
+//              CGlyphRunRealization::EnsureValidAlphaMap. Because contrast
+//              applies to the sum, runs are composed into a bitmap rather
+//              than drawn glyph by glyph.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::ComposeAlphaMap(
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace,
+    __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+    float rScaleX,
+    float rScaleY,
+    DWRITE_RENDERING_MODE renderingMode,
+    DWRITE_MEASURING_MODE measuringMode,
+    __in_opt const EnhancedContrastTable *pECT,
+    UINT originPosition,
+    UTC_TIME currentFrame,
+    __inout_ecount(1) CGlyphPainterMemory *pGlyphPainterMemory,
+    __deref_out_ecount_opt(*pAlphaMapSize) BYTE **ppAlphaMap,
+    __out UINT32 *pAlphaMapSize,
+    __out RECT *pBoundingBox
+    )
+{
+    HRESULT hr = S_OK;
+    DynArray<GlyphPlacement> rgPlacements;
+    RECT rcRun;
+    bool fHasClearType;
+
+    MeasurePerf(Text_Atlas_ComposeAlphaMap, glyphRun.glyphCount);
+
+    *ppAlphaMap = NULL;
+    *pAlphaMapSize = 0;
+    ZeroMemory(pBoundingBox, sizeof(*pBoundingBox));
+
+    IFC(PlaceGlyphs(
+        pFont,
+        pFontFace,
+        glyphRun,
+        rScaleX,
+        rScaleY,
+        renderingMode,
+        measuringMode,
+        NULL,   // pJob
+        originPosition,
+        currentFrame,
+        &rgPlacements,
+        &rcRun,
+        &fHasClearType
+        ));
+
+    if (!IsRectEmpty(rcRun))
+    {
+        UINT32 width = rcRun.right - rcRun.left;
+        UINT32 height = rcRun.bottom - rcRun.top;
+        UINT32 textureSize;
+        IFC(MultiplyUINT(width, height, textureSize));
+
+        BYTE *pAlphaMap = pGlyphPainterMemory->AllocRunBitmap(textureSize);
+        IFCOOM(pAlphaMap);
+        memset(pAlphaMap, 0, textureSize);
+
+        //
+        // Neighboring glyphs may overlap by a few subpixels. Their
+        // coverage adds up, as when DWrite rasterizes the whole run,
+        // and only the sum is contrast enhanced.
+        //
+        for (UINT i = 0; i < rgPlacements.GetCount(); i++)
+        {
+            const GlyphPlacement &placement = rgPlacements[i];
+            const Entry &entry = m_rgEntries[placement.iEntry];
+
+            if (!IsRectEmpty(entry.rcClearType))
+            {
+                AddMap(m_rgPages[entry.iPage].pData + entry.offset, entry.rcClearType, placement, rcRun, pAlphaMap);
+            }
+        }
+
+        if (fHasClearType && pECT)
+        {
+            pECT->RenormalizeAndApplyContrast(pAlphaMap, width, height, width, textureSize);
+        }
+
+        for (UINT i = 0; i < rgPlacements.GetCount(); i++)
+        {
+            const GlyphPlacement &placement = rgPlacements[i];
+            const Entry &entry = m_rgEntries[placement.iEntry];
+
+            if (!IsRectEmpty(entry.rcBiLevel))
+            {
+                AddMap(
+                    m_rgPages[entry.iPage].pData + entry.offset + GetMapSize(entry.rcClearType),
+                    entry.rcBiLevel,
+                    placement,
+                    rcRun,
+                    pAlphaMap
+                    );
+            }
+        }
+
+        *ppAlphaMap = pAlphaMap;
+        *pAlphaMapSize = textureSize;
+        *pBoundingBox = rcRun;
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::PlaceGlyphs
+//
+//  Synopsis:   Finds the entry and position of each glyph of the run,
+//              realizing the glyphs that are not in the atlas yet, and
+//              computes the bounds of the run and whether it has ClearType
+//              pixels.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::PlaceGlyphs(
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace,
+    __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+    float rScaleX,
+    float rScaleY,
+    DWRITE_RENDERING_MODE renderingMode,
+    DWRITE_MEASURING_MODE measuringMode,
+    __in_opt CGlyphRasterizationJob *pJob,
+    UINT originPosition,
+    UTC_TIME currentFrame,
+    __inout_ecount(1) DynArray<GlyphPlacement> *prgPlacements,
+    __out RECT *prcRun,
+    __out bool *pfHasClearType
+    )
+{
+    HRESULT hr = S_OK;
+    DynArray<RasterizedGlyph> rgMisses;
+
+    ZeroMemory(prcRun, sizeof(*prcRun));
+    *pfHasClearType = false;
+
+    if (pJob != NULL)
+    {
+        Assert(pJob->IsComplete());
+
+        IFC(AddRasterizedGlyphs(&pJob->m_rgGlyphs, currentFrame));
+    }
+
+    IFC(CollectGlyphs(
+        pFont,
+        glyphRun,
+        rScaleX,
+        rScaleY,
+        renderingMode,
+        measuringMode,
+        originPosition,
+        currentFrame,
+        prgPlacements,
+        &rgMisses
+        ));
+
+    if (rgMisses.GetCount() > 0)
+    {
+        RasterizeStripeContext context;
+        context.pDWriteFactory = m_pDWriteFactory;
+        context.pFontFace = pFontFace;
+        context.rgGlyphs = rgMisses.GetDataBuffer();
+
+        CParallelStripes::Run(
+            CParallelStripes::GetStripeCount(rgMisses.GetCount(), sc_cMinGlyphsPerStripe),
+            rgMisses.GetCount(),
+            RasterizeStripe,
+            &context
+            );
+
+        IFC(AddRasterizedGlyphs(&rgMisses, currentFrame));
+
+        if (originPosition != 0)
+        {
+            for (UINT i = 0; i < rgMisses.GetCount(); i++)
+            {
+                Entry &entry = m_rgEntries[rgMisses[i].iEntry];
+
+                if (!entry.fSubpixelVariant)
+                {
+                    entry.fSubpixelVariant = true;
+                    m_cbSubpixelVariants += GetMapSize(entry.rcClearType) + GetMapSize(entry.rcBiLevel);
+                }
+            }
+        }
+    }
+
+    {
+        UINT cPlaced = 0;
+
+        //
+        // Entries were only added since CollectGlyphs, so the indices of the
+        // entries found there are still valid.
+        //
+        for (UINT i = 0; i < prgPlacements->GetCount(); i++)
+        {
+            GlyphPlacement &placement = (*prgPlacements)[i];
+
+            if (placement.iMiss != UINT_MAX)
+            {
+                placement.iEntry = rgMisses[placement.iMiss].iEntry;
+            }
+
+            const Entry &entry = m_rgEntries[placement.iEntry];
+            const RECT *rgrcMaps[] = { &entry.rcClearType, &entry.rcBiLevel };
+
+            for (UINT j = 0; j < ARRAYSIZE(rgrcMaps); j++)
+            {
+                if (!IsRectEmpty(*rgrcMaps[j]))
+                {
+                    RECT rcMap = *rgrcMaps[j];
+                    OffsetRect(&rcMap, placement.x, placement.y);
+
+                    if (cPlaced == 0)
+                    {
+                        *prcRun = rcMap;
+                    }
+                    else
+                    {
+                        UnionRect(prcRun, prcRun, &rcMap);
+                    }
+
+                    cPlaced++;
+                }
+            }
+
+            *pfHasClearType |= !IsRectEmpty(entry.rcClearType);
+        }
+    }
+
+Cleanup:
+    FreeRasterizedGlyphs(&rgMisses);
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::BeginRasterization
+//
+//  Synopsis:   Starts rasterizing the glyphs of a run that are not in the
+//              atlas yet on the thread pool. Returns a NULL job if all of
+//              them are. Once the job is complete, GetRunBounds adds them
+//              the run without calling DWrite.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::BeginRasterization(
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace,
+    __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+    float rScaleX,
+    float rScaleY,
+    DWRITE_RENDERING_MODE renderingMode,
+    DWRITE_MEASURING_MODE measuringMode,
+    UTC_TIME currentFrame,
+    __deref_out_ecount_opt(1) CGlyphRasterizationJob **ppJob
+    )
+{
+    HRESULT hr = S_OK;
+    CGlyphRasterizationJob *pJob = NULL;
+
+    *ppJob = NULL;
+
+    pJob = new CGlyphRasterizationJob(m_pDWriteFactory, pFont, pFontFace);
+    IFCOOM(pJob);
+
+    IFC(CollectGlyphs(
+        pFont,
+        glyphRun,
+        rScaleX,
+        rScaleY,
+        renderingMode,
+        measuringMode,
+        0,      // originPosition
+        currentFrame,
+        NULL,
+        &pJob->m_rgGlyphs
+        ));
+
+    if (pJob->m_rgGlyphs.GetCount() > 0)
+    {
+        pJob->Start();
+
+        *ppJob = pJob;
+        pJob = NULL;
+    }
+
+Cleanup:
+    delete pJob;
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::Trim
+//
+//  Synopsis:   Once the pages exceed cbBudget, releases the least recently
+//              used pages, and the glyphs in them, until the atlas is back
+//              under 3/4 of it. Pages used in the current frame are kept.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphAtlas::Trim(
+    UTC_TIME currentFrame,
+    UINT32 cbBudget
+    )
+{
+    if (m_cbTotal <= cbBudget)
+    {
+        return;
+    }
+
+    while (m_cbTotal > cbBudget - cbBudget / 4)
+    {
+        UTC_TIME oldestFrame = currentFrame;
+
+        for (UINT i = 0; i < m_rgPages.GetCount(); i++)
+        {
+            if (m_rgPages[i].pData != NULL && m_rgPages[i].lastUsedFrame < oldestFrame)
+            {
+                oldestFrame = m_rgPages[i].lastUsedFrame;
+            }
+        }
+
+        if (oldestFrame >= currentFrame)
+        {
+            break;
+        }
+
+        RemovePages(oldestFrame);
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::CollectGlyphs
+//
+//  Synopsis:   Computes the atlas key and position of each glyph of the
+//              run. Glyphs found in the atlas get their entry; the others
+//              are added once to prgMisses, to be rasterized.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::CollectGlyphs(
+    __in IDWriteFont *pFont,
+    __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+    float rScaleX,
+    float rScaleY,
+    DWRITE_RENDERING_MODE renderingMode,
+    DWRITE_MEASURING_MODE measuringMode,
+    UINT originPosition,
+    UTC_TIME currentFrame,
+    __inout_ecount_opt(1) DynArray<GlyphPlacement> *prgPlacements,
+    __inout_ecount(1) DynArray<RasterizedGlyph> *prgMisses
+    )
+{
+    HRESULT hr = S_OK;
+
+    Assert(!glyphRun.isSideways);
+    Assert(glyphRun.bidiLevel % 2 == 0);
+    Assert(originPosition < sc_cSubpixelPositions);
+
+    if (m_rgBuckets.GetCount() == 0)
+    {
+        IFC(m_rgBuckets.AddAndSet(sc_cInitialBuckets, UINT_MAX));
+    }
+
+    {
+        bool fSubpixelPositioning =
+               renderingMode == DWRITE_RENDERING_MODE_CLEARTYPE_NATURAL
+            || renderingMode == DWRITE_RENDERING_MODE_CLEARTYPE_NATURAL_SYMMETRIC;
+
+        Assert(fSubpixelPositioning || originPosition == 0);
+
+        GlyphAtlasKey key;
+        ZeroMemory(&key, sizeof(key));
+        key.pFont = pFont;
+        key.rEmSize = glyphRun.fontEmSize;
+        key.rScaleX = rScaleX;
+        key.rScaleY = rScaleY;
+        key.renderingMode = static_cast<BYTE>(renderingMode);
+        key.measuringMode = static_cast<BYTE>(measuringMode);
+
+        float rPenX = 0.0f;
+
+        for (UINT i = 0; i < glyphRun.glyphCount; i++)
+        {
+            float rX = rPenX;
+            float rY = 0.0f;
+
+            if (glyphRun.glyphOffsets != NULL)
+            {
+                rX += glyphRun.glyphOffsets[i].advanceOffset;
+                rY -= glyphRun.glyphOffsets[i].ascenderOffset;
+            }
+
+            rPenX += glyphRun.glyphAdvances[i];
+
+            INT x;
+            key.subpixelPosition = 0;
+
+            if (fSubpixelPositioning)
+            {
+                INT xSubpixel =
+                      CFloatFPU::Round(rX * rScaleX * sc_cSubpixelPositions)
+                    + static_cast<INT>(originPosition);
+
+                // Floor division, the position may be negative
+                x = (xSubpixel >= 0) ? xSubpixel / static_cast<INT>(sc_cSubpixelPositions)
+                                     : -((-xSubpixel + static_cast<INT>(sc_cSubpixelPositions) - 1) / static_cast<INT>(sc_cSubpixelPositions));
+                key.subpixelPosition = static_cast<BYTE>(xSubpixel - x * static_cast<INT>(sc_cSubpixelPositions));
+            }
+            else
+            {
+                x = CFloatFPU::Round(rX * rScaleX);
+            }
+
+            key.glyphIndex = glyphRun.glyphIndices[i];
+
+            GlyphPlacement placement;
+            placement.iEntry = FindGlyph(key, currentFrame);
+            placement.iMiss = UINT_MAX;
+            placement.x = x * 3;
+            placement.y = CFloatFPU::Round(rY * rScaleY);
+
+            if (placement.iEntry == UINT_MAX)
+            {
+                // Runs repeat few distinct glyphs, a linear search is enough
+                for (UINT j = 0; j < prgMisses->GetCount(); j++)
+                {
+                    if (KeysEqual((*prgMisses)[j].key, key))
+                    {
+                        placement.iMiss = j;
+                        break;
+                    }
+                }
+
+                if (placement.iMiss == UINT_MAX)
+                {
+                    RasterizedGlyph miss;
+                    ZeroMemory(&miss, sizeof(miss));
+                    miss.key = key;
+                    miss.iEntry = UINT_MAX;
+
+                    IFC(prgMisses->Add(miss));
+
+                    placement.iMiss = prgMisses->GetCount() - 1;
+                }
+            }
+
+            if (prgPlacements != NULL)
+            {
+                IFC(prgPlacements->Add(placement));
+            }
+        }
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::FindGlyph
+//
+//  Synopsis:   Returns the entry of the glyph and marks it used in
+//              currentFrame, or UINT_MAX if the glyph is not in the atlas.
+//
+//-------------------------------------------------------------------------
+UINT
+CGlyphAtlas::FindGlyph(
+    __in_ecount(1) const GlyphAtlasKey &key,
+    UTC_TIME currentFrame
+    )
+{
+    UINT iBucket = HashKey(key) & (m_rgBuckets.GetCount() - 1);
+
+    for (UINT i = m_rgBuckets[iBucket]; i != UINT_MAX; i = m_rgEntries[i].iNextInBucket)
+    {
+        Entry &entry = m_rgEntries[i];
+
+        if (KeysEqual(entry.key, key))
+        {
+            entry.lastUsedFrame = currentFrame;
+            if (entry.iPage != UINT_MAX)
+            {
+                m_rgPages[entry.iPage].lastUsedFrame = currentFrame;
+            }
+
+            return i;
+        }
+    }
+
+    return UINT_MAX;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::AddRasterizedGlyphs
+//
+//  Synopsis:   Adds rasterized glyphs to the atlas and sets their iEntry.
+//              Fails with the error of the first glyph that could not be
+//              rasterized.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::AddRasterizedGlyphs(
+    __inout_ecount(1) DynArray<RasterizedGlyph> *prgGlyphs,
+    UTC_TIME currentFrame
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (m_rgBuckets.GetCount() == 0)
+    {
+        IFC(m_rgBuckets.AddAndSet(sc_cInitialBuckets, UINT_MAX));
+    }
+
+    for (UINT i = 0; i < prgGlyphs->GetCount(); i++)
+    {
+        RasterizedGlyph &glyph = (*prgGlyphs)[i];
+
+        IFC(glyph.hr);
+        IFC(AddGlyph(glyph, currentFrame, &glyph.iEntry));
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::AddGlyph
+//
+//  Synopsis:   Packs the alpha maps of a rasterized glyph into a page. A
+//              glyph rasterized by several runs at once is kept only once.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::AddGlyph(
+    __in_ecount(1) const RasterizedGlyph &glyph,
+    UTC_TIME currentFrame,
+    __out UINT *piEntry
+    )
+{
+    HRESULT hr = S_OK;
+
+    *piEntry = FindGlyph(glyph.key, currentFrame);
+
+    if (*piEntry == UINT_MAX)
+    {
+        Entry entry;
+        ZeroMemory(&entry, sizeof(entry));
+        entry.key = glyph.key;
+        entry.lastUsedFrame = currentFrame;
+        entry.iPage = UINT_MAX;
+
+        if (glyph.pClearTypeMap != NULL || glyph.pBiLevelMap != NULL)
+        {
+            IFC(Allocate(glyph.cbClearType + glyph.cbBiLevel, &entry.iPage, &entry.offset));
+
+            BYTE *pData = m_rgPages[entry.iPage].pData + entry.offset;
+
+            if (glyph.pClearTypeMap != NULL)
+            {
+                memcpy(pData, glyph.pClearTypeMap, glyph.cbClearType);
+                entry.rcClearType = glyph.rcClearType;
+            }
+
+            if (glyph.pBiLevelMap != NULL)
+            {
+                memcpy(pData + glyph.cbClearType, glyph.pBiLevelMap, glyph.cbBiLevel);
+                entry.rcBiLevel = glyph.rcBiLevel;
+            }
+
+            m_rgPages[entry.iPage].lastUsedFrame = currentFrame;
+        }
+
+        UINT iBucket = HashKey(glyph.key) & (m_rgBuckets.GetCount() - 1);
+        entry.iNextInBucket = m_rgBuckets[iBucket];
+
+        IFC(m_rgEntries.Add(entry));
+
+        glyph.key.pFont->AddRef();
+
+        *piEntry = m_rgEntries.GetCount() - 1;
+        m_rgBuckets[iBucket] = *piEntry;
+
+        if (m_rgEntries.GetCount() > 2 * m_rgBuckets.GetCount())
+        {
+            IFC(GrowBuckets());
+        }
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::RasterizeStripe
+//
+//  Synopsis:   CParallelStripes callback rasterizing the missing glyphs
+//              [iFirst, iEnd) of PlaceGlyphs.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphAtlas::RasterizeStripe(
+    __in void *pvContext,
+    UINT iStripe,
+    UINT iFirst,
+    UINT iEnd
+    )
+{
+    UNREFERENCED_PARAMETER(iStripe);
+
+    const RasterizeStripeContext *pContext = static_cast<const RasterizeStripeContext *>(pvContext);
+
+    for (UINT i = iFirst; i < iEnd; i++)
+    {
+        RasterizedGlyph *pGlyph = &pContext->rgGlyphs[i];
+
+        pGlyph->hr = RasterizeGlyph(pContext->pDWriteFactory, pContext->pFontFace, pGlyph);
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::RasterizeGlyph
+//
+//  Synopsis:   Has DWrite rasterize a single glyph at its subpixel
+//              position. Only touches its arguments, so glyphs can be
+//              rasterized on any thread.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::RasterizeGlyph(
+    __in IDWriteFactory *pDWriteFactory,
+    __in IDWriteFontFace *pFontFace,
+    __inout_ecount(1) RasterizedGlyph *pGlyph
+    )
+{
+    HRESULT hr = S_OK;
+    IDWriteGlyphRunAnalysis *pAnalysis = NULL;
+
+    const GlyphAtlasKey &key = pGlyph->key;
+
+    UINT16 glyphIndex = key.glyphIndex;
+    FLOAT glyphAdvance = 0.0f;
+
+    DWRITE_GLYPH_RUN glyphRun;
+    glyphRun.fontFace = pFontFace;
+    glyphRun.fontEmSize = key.rEmSize;
+    glyphRun.glyphCount = 1;
+    glyphRun.glyphIndices = &glyphIndex;
+    glyphRun.glyphAdvances = &glyphAdvance;
+    glyphRun.glyphOffsets = NULL;
+    glyphRun.isSideways = FALSE;
+    glyphRun.bidiLevel = 0;
+
+    DWRITE_MATRIX transform;
+    transform.m11 = key.rScaleX;
+    transform.m12 = 0.0f;
+    transform.m21 = 0.0f;
+    transform.m22 = key.rScaleY;
+    transform.dx = static_cast<FLOAT>(key.subpixelPosition) / sc_cSubpixelPositions;
+    transform.dy = 0.0f;
+
+    IFC(pDWriteFactory->CreateGlyphRunAnalysis(
+        &glyphRun,
+        1,                                      // pixelsPerDip
+        &transform,
+        static_cast<DWRITE_RENDERING_MODE>(key.renderingMode),
+        static_cast<DWRITE_MEASURING_MODE>(key.measuringMode),
+        0.0,
+        0.0,
+        &pAnalysis
+        ));
+
+    // Contrast is applied once the glyphs of a run are composed
+    IFC(CGlyphRunRealization::RealizeAlphaBoundsAndTextures(
+        pAnalysis,
+        DWRITE_TEXTURE_CLEARTYPE_3x1,
+        NULL,
+        &pGlyph->cbClearType,
+        &pGlyph->rcClearType,
+        &pGlyph->pClearTypeMap
+        ));
+
+    IFC(CGlyphRunRealization::RealizeAlphaBoundsAndTextures(
+        pAnalysis,
+        DWRITE_TEXTURE_ALIASED_1x1,
+        NULL,
+        &pGlyph->cbBiLevel,
+        &pGlyph->rcBiLevel,
+        &pGlyph->pBiLevelMap
+        ));
+
+Cleanup:
+    ReleaseInterface(pAnalysis);
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::AddMap
+//
+//  Synopsis:   Adds the coverage of a glyph map, saturated, to the alpha
+//              map of the run bounded by rcRun. Bi-level coverage is 0 or
+//              255, so adding it is the same as the OR of
+//              CGlyphRunRealization::EnsureValidAlphaMap.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphAtlas::AddMap(
+    __in const BYTE *pSource,
+    __in_ecount(1) const RECT &rcMap,
+    __in_ecount(1) const GlyphPlacement &placement,
+    __in_ecount(1) const RECT &rcRun,
+    __inout BYTE *pAlphaMap
+    )
+{
+    UINT srcStride = rcMap.right - rcMap.left;
+    UINT destStride = rcRun.right - rcRun.left;
+    BYTE *pCurrentDestLine =
+          pAlphaMap
+        + (rcMap.top + placement.y - rcRun.top) * destStride
+        + (rcMap.left + placement.x - rcRun.left);
+
+    for (INT row = rcMap.top; row < rcMap.bottom; row++)
+    {
+        for (UINT j = 0; j < srcStride; j++)
+        {
+            UINT sum = pCurrentDestLine[j] + *pSource++;
+            pCurrentDestLine[j] = static_cast<BYTE>(min(sum, 255u));
+        }
+
+        pCurrentDestLine += destStride;
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::FreeRasterizedGlyphs
+//
+//-------------------------------------------------------------------------
+void
+CGlyphAtlas::FreeRasterizedGlyphs(
+    __inout_ecount(1) DynArray<RasterizedGlyph> *prgGlyphs
+    )
+{
+    for (UINT i = 0; i < prgGlyphs->GetCount(); i++)
+    {
+        WPFFree(ProcessHeap, (*prgGlyphs)[i].pClearTypeMap);
+        (*prgGlyphs)[i].pClearTypeMap = NULL;
+
+        WPFFree(ProcessHeap, (*prgGlyphs)[i].pBiLevelMap);
+        (*prgGlyphs)[i].pBiLevelMap = NULL;
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::Allocate
+//
+//  Synopsis:   Reserves cbSize bytes in the current page, or in a new page
+//              if the current one is full. Maps larger than a page get a
+//              page of their own.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::Allocate(
+    UINT32 cbSize,
+    __out UINT *piPage,
+    __out UINT32 *pOffset
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE *pData = NULL;
+
+    if (   m_iPageCurrent != UINT_MAX
+        && cbSize <= m_rgPages[m_iPageCurrent].cbSize - m_rgPages[m_iPageCurrent].cbUsed)
+    {
+        *piPage = m_iPageCurrent;
+    }
+    else
+    {
+        UINT32 cbPage = max(cbSize, sc_cbPage);
+
+        pData = (BYTE *)WPFAlloc(ProcessHeap, Mt(GlyphAtlasPage), cbPage);
+        IFCOOM(pData);
+
+        Page page;
+        page.pData = pData;
+        page.cbSize = cbPage;
+        page.cbUsed = 0;
+        page.lastUsedFrame = 0;
+
+        // Reuse the slot of a released page
+        UINT iPage = UINT_MAX;
+        for (UINT i = 0; i < m_rgPages.GetCount(); i++)
+        {
+            if (m_rgPages[i].pData == NULL)
+            {
+                iPage = i;
+                break;
+            }
+        }
+
+        if (iPage == UINT_MAX)
+        {
+            IFC(m_rgPages.Add(page));
+            iPage = m_rgPages.GetCount() - 1;
+        }
+        else
+        {
+            m_rgPages[iPage] = page;
+        }
+
+        pData = NULL;
+        m_cbTotal += cbPage;
+
+        // A dedicated page is full already, keep filling the current one
+        if (cbSize < sc_cbPage || m_iPageCurrent == UINT_MAX)
+        {
+            m_iPageCurrent = iPage;
+        }
+
+        *piPage = iPage;
+    }
+
+    *pOffset = m_rgPages[*piPage].cbUsed;
+    m_rgPages[*piPage].cbUsed += cbSize;
+
+Cleanup:
+    WPFFree(ProcessHeap, pData);
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::GrowBuckets
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphAtlas::GrowBuckets()
+{
+    HRESULT hr = S_OK;
+
+    IFC(m_rgBuckets.AddAndSet(m_rgBuckets.GetCount(), UINT_MAX));
+
+    RebuildBuckets();
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::RemovePages
+//
+//  Synopsis:   Releases the pages last used at or before lastUsedFrameMax
+//              and removes the glyphs in them, as well as the glyphs
+//              without pixels that were not used since.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphAtlas::RemovePages(UTC_TIME lastUsedFrameMax)
+{
+    for (UINT i = 0; i < m_rgPages.GetCount(); i++)
+    {
+        Page &page = m_rgPages[i];
+
+        if (page.pData != NULL && page.lastUsedFrame <= lastUsedFrameMax)
+        {
+            WPFFree(ProcessHeap, page.pData);
+            page.pData = NULL;
+
+            Assert(m_cbTotal >= page.cbSize);
+            m_cbTotal -= page.cbSize;
+
+            if (m_iPageCurrent == i)
+            {
+                m_iPageCurrent = UINT_MAX;
+            }
+        }
+    }
+
+    UINT cEntries = 0;
+
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        const Entry &entry = m_rgEntries[i];
+
+        bool fRemove = (entry.iPage != UINT_MAX) ? (m_rgPages[entry.iPage].pData == NULL)
+                                                 : (entry.lastUsedFrame <= lastUsedFrameMax);
+
+        if (fRemove)
+        {
+            if (entry.fSubpixelVariant)
+            {
+                UINT32 cbEntry = GetMapSize(entry.rcClearType) + GetMapSize(entry.rcBiLevel);
+
+                Assert(m_cbSubpixelVariants >= cbEntry);
+                m_cbSubpixelVariants -= cbEntry;
+            }
+
+            entry.key.pFont->Release();
+        }
+        else
+        {
+            m_rgEntries[cEntries++] = entry;
+        }
+    }
+
+    m_rgEntries.SetCount(cEntries);
+
+    RebuildBuckets();
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::RebuildBuckets
+//
+//-------------------------------------------------------------------------
+void
+CGlyphAtlas::RebuildBuckets()
+{
+    UINT cBuckets = m_rgBuckets.GetCount();
+
+    for (UINT i = 0; i < cBuckets; i++)
+    {
+        m_rgBuckets[i] = UINT_MAX;
+    }
+
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        UINT iBucket = HashKey(m_rgEntries[i].key) & (cBuckets - 1);
+
+        m_rgEntries[i].iNextInBucket = m_rgBuckets[iBucket];
+        m_rgBuckets[iBucket] = i;
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::HashKey
+//
+//-------------------------------------------------------------------------
+UINT
+CGlyphAtlas::HashKey(__in_ecount(1) const GlyphAtlasKey &key)
+{
+    UINT hash = static_cast<UINT>(reinterpret_cast<UINT_PTR>(key.pFont) >> 4);
+
+    hash = hash * 31 + *reinterpret_cast<const UINT *>(&key.rEmSize);
+    hash = hash * 31 + *reinterpret_cast<const UINT *>(&key.rScaleX);
+    hash = hash * 31 + *reinterpret_cast<const UINT *>(&key.rScaleY);
+    hash = hash * 31 + key.glyphIndex;
+    hash = hash * 31 + key.subpixelPosition;
+    hash = hash * 31 + key.renderingMode;
+
+    // Spread the low bits, which select the bucket
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+
+    return hash;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphAtlas::KeysEqual
+//
+//-------------------------------------------------------------------------
+bool
+CGlyphAtlas::KeysEqual(
+    __in_ecount(1) const GlyphAtlasKey &key1,
+    __in_ecount(1) const GlyphAtlasKey &key2
+    )
+{
+    return    key1.pFont == key2.pFont
+           && key1.glyphIndex == key2.glyphIndex
+           && key1.subpixelPosition == key2.subpixelPosition
+           && key1.rEmSize == key2.rEmSize
+           && key1.rScaleX == key2.rScaleX
+           && key1.rScaleY == key2.rScaleY
+           && key1.renderingMode == key2.renderingMode
+           && key1.measuringMode == key2.measuringMode;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphRasterizationJob::CGlyphRasterizationJob
+//
+//  Synopsis:   Constructor
+//
+//-------------------------------------------------------------------------
+CGlyphRasterizationJob::CGlyphRasterizationJob(
+    __in IDWriteFactory *pDWriteFactory,
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace
+    )
+{
+    m_pDWriteFactory = pDWriteFactory;
+    m_pDWriteFactory->AddRef();
+
+    m_pFont = pFont;
+    m_pFont->AddRef();
+
+    m_pFontFace = pFontFace;
+    m_pFontFace->AddRef();
+
+    m_pThreadpoolWork = NULL;
+    m_fComplete = FALSE;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphRasterizationJob::~CGlyphRasterizationJob
+//
+//  Synopsis:   Destructor. Waits for the thread pool to be done with the
+//              job.
+//
+//-------------------------------------------------------------------------
+CGlyphRasterizationJob::~CGlyphRasterizationJob()
+{
+    Wait();
+
+    CGlyphAtlas::FreeRasterizedGlyphs(&m_rgGlyphs);
+
+    ReleaseInterface(m_pFontFace);
+    ReleaseInterface(m_pFont);
+    ReleaseInterface(m_pDWriteFactory);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphRasterizationJob::Start
+//
+//  Synopsis:   Submits the job to the thread pool, or rasterizes the glyphs
+//              right away if the thread pool cannot take it.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphRasterizationJob::Start()
+{
+    Assert(m_pThreadpoolWork == NULL);
+
+    m_pThreadpoolWork = CreateThreadpoolWork(ThreadpoolWorkCallback, this, NULL);
+
+    if (m_pThreadpoolWork != NULL)
+    {
+        SubmitThreadpoolWork(m_pThreadpoolWork);
+    }
+    else
+    {
+        Rasterize();
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphRasterizationJob::Wait
+//
+//  Synopsis:   Returns once the glyphs are rasterized.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphRasterizationJob::Wait()
+{
+    if (m_pThreadpoolWork != NULL)
+    {
+        WaitForThreadpoolWorkCallbacks(m_pThreadpoolWork, FALSE);
+        CloseThreadpoolWork(m_pThreadpoolWork);
+        m_pThreadpoolWork = NULL;
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphRasterizationJob::Rasterize
+//
+//-------------------------------------------------------------------------
+void
+CGlyphRasterizationJob::Rasterize()
+{
+    for (UINT i = 0; i < m_rgGlyphs.GetCount(); i++)
+    {
+        RasterizedGlyph *pGlyph = &m_rgGlyphs[i];
+
+        pGlyph->hr = CGlyphAtlas::RasterizeGlyph(m_pDWriteFactory, m_pFontFace, pGlyph);
+    }
+
+    // Publishes the glyphs to the render thread
+    InterlockedExchange(&m_fComplete, TRUE);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphRasterizationJob::ThreadpoolWorkCallback
+//
+//-------------------------------------------------------------------------
+VOID CALLBACK
+CGlyphRasterizationJob::ThreadpoolWorkCallback(
+    __inout PTP_CALLBACK_INSTANCE pInstance,
+    __inout_opt PVOID pvJob,
+    __inout PTP_WORK pThreadpoolWork
+    )
+{
+    UNREFERENCED_PARAMETER(pInstance);
+    UNREFERENCED_PARAMETER(pThreadpoolWork);
+
+    static_cast<CGlyphRasterizationJob *>(pvJob)->Rasterize();
+}
+
@@ -0,0 +1,417 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------
+//
+
+//
+//  Description:
+//
+//    Alpha maps of individual glyphs, shared by all glyph runs of a
+//    composition. Glyph runs are composed from these when they are drawn
+//    instead of asking DWrite to rasterize and keep a bitmap for every
+//    run, so the same glyph in the same font and size is rasterized and
+//    stored only once.
+//
+//------------------------------------------------------------------------
+
+#pragma once
+
+MtExtern(CGlyphAtlas);
+MtExtern(CGlyphRasterizationJob);
+
+//+-----------------------------------------------------------------------------
+//
+//  Structure:
+//      GlyphAtlasKey
+//
+//  Synopsis:
+//      Everything the alpha map of a single glyph depends on.
+//
+//------------------------------------------------------------------------------
+
+struct GlyphAtlasKey
+{
+    IDWriteFont *pFont;             // AddRef'd by the atlas entry
+
+    float rEmSize;
+
+    // Scale of the DWrite transform
+    float rScaleX;
+    float rScaleY;
+
+    UINT16 glyphIndex;
+
+    // Horizontal position of the glyph origin within a pixel, in units of
+    // 1/CGlyphAtlas::sc_cSubpixelPositions pixels
+    BYTE subpixelPosition;
+
+    BYTE renderingMode;             // DWRITE_RENDERING_MODE
+    BYTE measuringMode;             // DWRITE_MEASURING_MODE
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Structure:
+//      RasterizedGlyph
+//
+//  Synopsis:
+//      Alpha maps of a single glyph produced by CGlyphAtlas::RasterizeGlyph,
+//      before they are packed into the atlas. Bounds are relative to the
+//      glyph origin, in subpixels horizontally and pixels vertically.
+//
+//------------------------------------------------------------------------------
+
+struct RasterizedGlyph
+{
+    GlyphAtlasKey key;
+    HRESULT hr;
+
+    // NULL if the glyph has no ClearType pixels
+    BYTE *pClearTypeMap;
+    UINT32 cbClearType;
+    RECT rcClearType;
+
+    // NULL if the glyph has no bi-level pixels
+    BYTE *pBiLevelMap;
+    UINT32 cbBiLevel;
+    RECT rcBiLevel;
+
+    // Entry of the glyph once it is in the atlas
+    UINT iEntry;
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CGlyphRasterizationJob
+//
+//  Synopsis:
+//      Rasterizes the glyphs of a glyph run that are missing from the atlas
+//      on the process thread pool, so that the render thread does not wait
+//      for DWrite. The job only touches its own references to the font and
+//      font face; the glyphs enter the atlas when the job is passed to
+//      CGlyphAtlas::GetRunBounds on the render thread.
+//
+//------------------------------------------------------------------------------
+
+class CGlyphRasterizationJob
+{
+    friend class CGlyphAtlas;
+
+public:
+    DECLARE_METERHEAP_CLEAR(ProcessHeap, Mt(CGlyphRasterizationJob));
+
+    ~CGlyphRasterizationJob();
+
+    bool IsComplete() const
+    {
+        return m_fComplete != FALSE;
+    }
+
+    void Wait();
+
+private:
+    CGlyphRasterizationJob(
+        __in IDWriteFactory *pDWriteFactory,
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace
+        );
+
+    void Start();
+
+    void Rasterize();
+
+    static VOID CALLBACK ThreadpoolWorkCallback(
+        __inout PTP_CALLBACK_INSTANCE pInstance,
+        __inout_opt PVOID pvJob,
+        __inout PTP_WORK pThreadpoolWork
+        );
+
+    IDWriteFactory *m_pDWriteFactory;
+
+    // Keeps the font of the glyph keys alive
+    IDWriteFont *m_pFont;
+    IDWriteFontFace *m_pFontFace;
+
+    DynArray<RasterizedGlyph> m_rgGlyphs;
+
+    PTP_WORK m_pThreadpoolWork;
+    volatile LONG m_fComplete;
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CGlyphAtlas
+//
+//  Synopsis:
+//      Keeps the ClearType and bi-level alpha maps of individual glyphs in
+//      the format of CGlyphRunRealization::RealizeAlphaBoundsAndTextures,
+//      3 bytes per pixel. Contrast enhancement is not applied to them but
+//      to the composed run, after the coverage of overlapping glyphs has
+//      been summed, as DWrite does for whole runs.
+//
+//      Maps are packed back to back into pages of sc_cbPage bytes, and are
+//      found through a hash of their GlyphAtlasKey. When the pages exceed
+//      the budget given to Trim, the least recently used pages are released
+//      with all the glyphs in them.
+//
+//      Realizations composed from the atlas only keep the bounds that
+//      GetRunBounds gives them. Painters compose the run into their
+//      CGlyphPainterMemory with ComposeAlphaMap when they draw it, so the
+//      glyph memory of these runs grows with the distinct glyphs in the
+//      atlas rather than with the runs. Glyphs trimmed since are rasterized
+//      again on the spot.
+//
+//      The atlas itself belongs to the render thread. Only the rasterization
+//      of missing glyphs, which does not touch the atlas, runs on the thread
+//      pool.
+//
+//------------------------------------------------------------------------------
+
+class CGlyphAtlas
+{
+    friend class CGlyphRasterizationJob;
+
+public:
+    DECLARE_METERHEAP_CLEAR(ProcessHeap, Mt(CGlyphAtlas));
+
+    CGlyphAtlas(__in IDWriteFactory *pDWriteFactory);
+    ~CGlyphAtlas();
+
+    HRESULT GetRunBounds(
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace,
+        __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+        float rScaleX,
+        float rScaleY,
+        DWRITE_RENDERING_MODE renderingMode,
+        DWRITE_MEASURING_MODE measuringMode,
+        __in_opt CGlyphRasterizationJob *pJob,
+        UTC_TIME currentFrame,
+        __out RECT *pBoundingBox,
+        __out bool *pfIsBiLevelOnly
+        );
+
+    HRESULT ComposeAlphaMap(
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace,
+        __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+        float rScaleX,
+        float rScaleY,
+        DWRITE_RENDERING_MODE renderingMode,
+        DWRITE_MEASURING_MODE measuringMode,
+        __in_opt const EnhancedContrastTable *pECT,
+        UINT originPosition,
+        UTC_TIME currentFrame,
+        __inout_ecount(1) CGlyphPainterMemory *pGlyphPainterMemory,
+        __deref_out_ecount_opt(*pAlphaMapSize) BYTE **ppAlphaMap,
+        __out UINT32 *pAlphaMapSize,
+        __out RECT *pBoundingBox
+        );
+
+    HRESULT BeginRasterization(
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace,
+        __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+        float rScaleX,
+        float rScaleY,
+        DWRITE_RENDERING_MODE renderingMode,
+        DWRITE_MEASURING_MODE measuringMode,
+        UTC_TIME currentFrame,
+        __deref_out_ecount_opt(1) CGlyphRasterizationJob **ppJob
+        );
+
+    void Trim(
+        UTC_TIME currentFrame,
+        UINT32 cbBudget
+        );
+
+    UINT32 GetSize() const
+    {
+        return m_cbTotal;
+    }
+
+    // Bytes of the glyphs first rasterized for a run origin moved by a
+    // fraction of a pixel, part of GetSize
+    UINT32 GetSubpixelVariantSize() const
+    {
+        return m_cbSubpixelVariants;
+    }
+
+    // Horizontal positions at which each glyph is rasterized
+    static const UINT sc_cSubpixelPositions = 4;
+
+private:
+    struct Entry
+    {
+        GlyphAtlasKey key;
+        UINT iNextInBucket;
+
+        // Location of the ClearType map, followed by the bi-level map.
+        // UINT_MAX if the glyph has no pixels.
+        UINT iPage;
+        UINT32 offset;
+
+        // Bounds of the maps relative to the glyph origin, in subpixels
+        // horizontally and pixels vertically, empty if there is no map
+        RECT rcClearType;
+        RECT rcBiLevel;
+
+        UTC_TIME lastUsedFrame;
+
+        // Rasterized for a run origin moved by a fraction of a pixel
+        bool fSubpixelVariant;
+    };
+
+    struct Page
+    {
+        BYTE *pData;
+        UINT32 cbSize;
+        UINT32 cbUsed;
+        UTC_TIME lastUsedFrame;
+    };
+
+    // Placement of a glyph of the run being composed, relative to the run
+    // origin. Either iEntry or iMiss is UINT_MAX.
+    struct GlyphPlacement
+    {
+        UINT iEntry;
+        UINT iMiss;
+        INT x;      // in subpixels
+        INT y;
+    };
+
+    struct RasterizeStripeContext
+    {
+        IDWriteFactory *pDWriteFactory;
+        IDWriteFontFace *pFontFace;
+        RasterizedGlyph *rgGlyphs;
+    };
+
+    HRESULT PlaceGlyphs(
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace,
+        __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+        float rScaleX,
+        float rScaleY,
+        DWRITE_RENDERING_MODE renderingMode,
+        DWRITE_MEASURING_MODE measuringMode,
+        __in_opt CGlyphRasterizationJob *pJob,
+        UINT originPosition,
+        UTC_TIME currentFrame,
+        __inout_ecount(1) DynArray<GlyphPlacement> *prgPlacements,
+        __out RECT *prcRun,
+        __out bool *pfHasClearType
+        );
+
+    HRESULT CollectGlyphs(
+        __in IDWriteFont *pFont,
+        __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+        float rScaleX,
+        float rScaleY,
+        DWRITE_RENDERING_MODE renderingMode,
+        DWRITE_MEASURING_MODE measuringMode,
+        UINT originPosition,
+        UTC_TIME currentFrame,
+        __inout_ecount_opt(1) DynArray<GlyphPlacement> *prgPlacements,
+        __inout_ecount(1) DynArray<RasterizedGlyph> *prgMisses
+        );
+
+    UINT FindGlyph(
+        __in_ecount(1) const GlyphAtlasKey &key,
+        UTC_TIME currentFrame
+        );
+
+    HRESULT AddRasterizedGlyphs(
+        __inout_ecount(1) DynArray<RasterizedGlyph> *prgGlyphs,
+        UTC_TIME currentFrame
+        );
+
+    HRESULT AddGlyph(
+        __in_ecount(1) const RasterizedGlyph &glyph,
+        UTC_TIME currentFrame,
+        __out UINT *piEntry
+        );
+
+    static void RasterizeStripe(
+        __in void *pvContext,
+        UINT iStripe,
+        UINT iFirst,
+        UINT iEnd
+        );
+
+    static HRESULT RasterizeGlyph(
+        __in IDWriteFactory *pDWriteFactory,
+        __in IDWriteFontFace *pFontFace,
+        __inout_ecount(1) RasterizedGlyph *pGlyph
+        );
+
+    static void AddMap(
+        __in const BYTE *pSource,
+        __in_ecount(1) const RECT &rcMap,
+        __in_ecount(1) const GlyphPlacement &placement,
+        __in_ecount(1) const RECT &rcRun,
+        __inout BYTE *pAlphaMap
+        );
+
+    static UINT32 GetMapSize(__in_ecount(1) const RECT &rcMap)
+    {
+        return IsRectEmpty(rcMap) ? 0 : (rcMap.right - rcMap.left) * (rcMap.bottom - rcMap.top);
+    }
+
+    static void FreeRasterizedGlyphs(
+        __inout_ecount(1) DynArray<RasterizedGlyph> *prgGlyphs
+        );
+
+    HRESULT Allocate(
+        UINT32 cbSize,
+        __out UINT *piPage,
+        __out UINT32 *pOffset
+        );
+
+    HRESULT GrowBuckets();
+
+    void RemovePages(UTC_TIME lastUsedFrameMax);
+
+    void RebuildBuckets();
+
+    static UINT HashKey(__in_ecount(1) const GlyphAtlasKey &key);
+
+    static bool KeysEqual(
+        __in_ecount(1) const GlyphAtlasKey &key1,
+        __in_ecount(1) const GlyphAtlasKey &key2
+        );
+
+    // Size of the pages that alpha maps are packed into. Larger maps get a
+    // page of their own.
+    static const UINT32 sc_cbPage = 16 * 1024;
+
+    static const UINT sc_cInitialBuckets = 1024;
+
+    // Fewer missing glyphs than this are rasterized on the render thread alone
+    static const UINT sc_cMinGlyphsPerStripe = 8;
+
+    IDWriteFactory *m_pDWriteFactory;
+
+    DynArray<Entry> m_rgEntries;
+
+    // Index of the first entry of each hash bucket, UINT_MAX if empty
+    DynArray<UINT> m_rgBuckets;
+
+    // Pages with a NULL pData have been released and their slot can be reused
+    DynArray<Page> m_rgPages;
+
+    // Page that small maps are currently packed into, UINT_MAX if none
+    UINT m_iPageCurrent;
+
+    // Bytes of all pages
+    UINT32 m_cbTotal;
+
+    // Bytes of the maps of entries with fSubpixelVariant set
+    UINT32 m_cbSubpixelVariants;
+};
+
@@ -28,13 +28,32 @@ MtDefine(CMilSlaveGlyphCache, MILRender, "CMilSlaveGlyphCache");
 //-------------------------------------------------------------------------
 CMilSlaveGlyphCache::CMilSlaveGlyphCache(__in CComposition *pComposition)
 { 
-    // Allow for cache to expand up to 1MB of glyph bitmaps
-    m_cMaximumBitmapStorageSize = 1000000;
-    // Then trim to 800k
-    m_cBitmapTargetSize = 800000;
-    // After the oldest is 100 frames or more old
+    // Allow for cache to expand up to 1MB of glyph bitmaps, unless the
+    // registry sets another budget
+    m_cMaximumBitmapStorageSize = c_cbDefaultMaximumBitmapStorageSize;
+
+    CDisplayRegKey keyGraphics(HKEY_LOCAL_MACHINE, _T(""));
+    DWORD dwBudget;
+
+    if (   keyGraphics.ReadDWORD(_T("GlyphCacheSize"), &dwBudget)
+        && dwBudget > 0)
+    {
+        m_cMaximumBitmapStorageSize = static_cast<INT32>(min(dwBudget, static_cast<DWORD>(INT_MAX)));
+    }
+
+    // Start trimming old bitmaps at 80% of it
+    m_cBitmapTargetSize = m_cMaximumBitmapStorageSize - m_cMaximumBitmapStorageSize / 5;
+    // That are 100 frames or more old
     m_cFrameDelayBeforeCleanup = 100;
 
+    // Realizations composed from the glyph atlas may be drawn at quarter
+    // pixel origins, which the atlas rasterizes glyphs for on demand
+    DWORD dwUseSubpixelVariants;
+
+    m_fUseSubpixelVariants =
+           keyGraphics.ReadDWORD(_T("SubpixelGlyphVariants"), &dwUseSubpixelVariants)
+        && dwUseSubpixelVariants != 0;
+
     m_pComposition = pComposition;
 }
 
@@ -65,6 +84,12 @@ CMilSlaveGlyphCache::Create(__in CComposition *pComposition, __out CMilSlaveGlyp
             reinterpret_cast<void**>(&(pGlyphCache->m_pDWriteFactory))
             ));                
 
+    pGlyphCache->m_pGlyphAtlas = new CGlyphAtlas(pGlyphCache->m_pDWriteFactory);
+    IFCOOM(pGlyphCache->m_pGlyphAtlas);
+
+    pGlyphCache->m_pGlyphOutlineCache = new CGlyphOutlineCache();
+    IFCOOM(pGlyphCache->m_pGlyphOutlineCache);
+
     *ppGlyphCache = pGlyphCache;
     pGlyphCache = NULL;
 
@@ -83,6 +108,8 @@ Cleanup:
 //-------------------------------------------------------------------------
 CMilSlaveGlyphCache::~CMilSlaveGlyphCache()
 {
+    delete m_pGlyphAtlas;
+    delete m_pGlyphOutlineCache;
     ReleaseInterface(m_pDWriteFactory);
 }
 
@@ -92,43 +119,84 @@ CMilSlaveGlyphCache::~CMilSlaveGlyphCache()
 //
 //  Synopsis:   Trims bitmaps from the cache according to LRU.
 //
+//              Above the target size, bitmaps unused for
+//              m_cFrameDelayBeforeCleanup frames are trimmed, at most
+//              c_cbMaximumTrimPerFrame bytes per frame. Above the budget,
+//              any bitmap not used in the current frame is trimmed until
+//              the cache fits again.
+//
+//              The glyph atlas gets most of the budget, since realizations
+//              composed from it keep no bitmap of their own. The bitmaps of
+//              the remaining realizations (animated, sideways or
+//              right-to-left runs) get whatever the atlas leaves, so that
+//              together they stay within the budget.
+//
+//              Font faces that glyph runs stopped using are released too.
+//
 //-------------------------------------------------------------------------
 void CMilSlaveGlyphCache::TrimCache()
 {
-    if (m_totalGlyphBitmapStorageSize > m_cMaximumBitmapStorageSize)
-    {
-        if ((!m_realizationListNoRef.IsEmpty()) && (static_cast<LONG>(GetCurrentRealizationFrame() - m_realizationListNoRef.PeekAtHead()->LastUsedFrame()) > static_cast<LONG>(m_cFrameDelayBeforeCleanup)))
-        {
+    UTC_TIME currentRealizationFrame = GetCurrentRealizationFrame();
+    MilFrameTiming &counters = m_pComposition->GetFrameTimingRecorder()->Counters();
+
+    m_pGlyphAtlas->Trim(
+        currentRealizationFrame,
+        static_cast<UINT32>(m_cMaximumBitmapStorageSize - m_cMaximumBitmapStorageSize / c_wholeRunBudgetDivisor)
+        );
+    m_pGlyphOutlineCache->Trim(currentRealizationFrame);
+    CGlyphRunResource::TrimFontFaceCache();
+
+    INT32 cbAtlas = static_cast<INT32>(min(m_pGlyphAtlas->GetSize(), static_cast<UINT32>(m_cMaximumBitmapStorageSize)));
+    INT32 cMaximumBitmapStorageSize = m_cMaximumBitmapStorageSize - cbAtlas;
+    INT32 cBitmapTargetSize = max(m_cBitmapTargetSize - cbAtlas, 0);
+
 #ifdef DBG            
-            INT32 debugTotalGlyphStorageSizeBefore = m_totalGlyphBitmapStorageSize;
+    INT32 debugTotalGlyphStorageSizeBefore = m_totalGlyphBitmapStorageSize;
 #endif
-            INT32 sizeToLose = m_totalGlyphBitmapStorageSize - m_cBitmapTargetSize;
-            INT32 sizeLost = 0;
-
-            //
-            // New items are inserted at the tail, so start at the head
-            //
-            CGlyphRunRealization *pCurrent = m_realizationListNoRef.PeekAtHead();
-                
-            while ((sizeLost < sizeToLose) && (pCurrent != NULL) && (static_cast<LONG>(GetCurrentRealizationFrame() - pCurrent->LastUsedFrame()) > static_cast<LONG>(m_cFrameDelayBeforeCleanup)))
+    INT32 sizeLost = 0;
+
+    //
+    // New items are inserted at the tail, and used ones move there, so the
+    // least recently used are at the head
+    //
+    CGlyphRunRealization *pCurrent = m_realizationListNoRef.PeekAtHead();
+
+    while ((m_totalGlyphBitmapStorageSize > cBitmapTargetSize) && (pCurrent != NULL))
+    {
+        LONG age = static_cast<LONG>(currentRealizationFrame - pCurrent->LastUsedFrame());
+
+        if (m_totalGlyphBitmapStorageSize > cMaximumBitmapStorageSize)
+        {
+            // Never trim what is drawn this frame, it would be rasterized again
+            // right away
+            if (age <= 0)
             {
-                CGlyphRunRealization *pNext = NULL;
-                pNext = m_realizationListNoRef.PeekNext(pCurrent);
-                sizeLost += pCurrent->GetTextureSize();
-
-                // DeleteAlphaMap also calls back into CMilSlaveGlyphCache and removes that realization
-                // from the linked list, so we don't need to do it here.
-                pCurrent->DeleteAlphaMap();
-                pCurrent = pNext;
+                break;
             }
+        }
+        else if ((age <= static_cast<LONG>(m_cFrameDelayBeforeCleanup)) || (sizeLost >= c_cbMaximumTrimPerFrame))
+        {
+            break;
+        }
+
+        CGlyphRunRealization *pNext = NULL;
+        pNext = m_realizationListNoRef.PeekNext(pCurrent);
+        sizeLost += pCurrent->GetTextureSize();
+        counters.cGlyphRealizationsTrimmed++;
+
+        // DeleteAlphaMap also calls back into CMilSlaveGlyphCache and removes that realization
+        // from the linked list, so we don't need to do it here.
+        pCurrent->DeleteAlphaMap();
+        pCurrent = pNext;
+    }
+
 #ifdef DBG
-            // Confirm that we trimmed exactly sizeLost amount of bytes from the cache.
-            Assert(debugTotalGlyphStorageSizeBefore - m_totalGlyphBitmapStorageSize == sizeLost);
+    // Confirm that we trimmed exactly sizeLost amount of bytes from the cache.
+    Assert(debugTotalGlyphStorageSizeBefore - m_totalGlyphBitmapStorageSize == sizeLost);
 #endif 
 
-            
-        }
-    }
+    counters.cbGlyphRealizations = static_cast<UINT>(m_totalGlyphBitmapStorageSize);
+    counters.cbGlyphSubpixelVariants = m_pGlyphAtlas->GetSubpixelVariantSize();
 }
 
 //+------------------------------------------------------------------------
@@ -293,6 +361,30 @@ CMilSlaveGlyphCache::RemoveRealization(__in CGlyphRunRealization *pRealization,
     }
 }
 
+//+------------------------------------------------------------------------
+//
+//  Member:     CMilSlaveGlyphCache::RecordRealizationUse
+//
+//  Sunopsis:   Counts a realization drawn with the bitmaps it already had,
+//              or one that needed them rasterized first, in the frame
+//              timings of the composition
+//
+//-------------------------------------------------------------------------
+void
+CMilSlaveGlyphCache::RecordRealizationUse(bool fHit)
+{
+    MilFrameTiming &counters = m_pComposition->GetFrameTimingRecorder()->Counters();
+
+    if (fHit)
+    {
+        counters.cGlyphRealizationHits++;
+    }
+    else
+    {
+        counters.cGlyphRealizationMisses++;
+    }
+}
+
 //+------------------------------------------------------------------------
 //
 //  Member:     CMilSlaveGlyphCache::FindAnimatingGlyphRunIndex
@@ -14,6 +14,20 @@
 //    and this class remembers their sizes, and if necessary
 //    walks through them and trims bitmaps.
 //
+//    The bitmaps of all realizations share a byte budget, which can be set
+//    with HKLM\Software\Microsoft\Avalon.Graphics\GlyphCacheSize. The
+//    least recently used bitmaps are trimmed a few at a time once the cache
+//    grows past its target size, and at once when it exceeds the budget.
+//    The glyph atlas counts against the same budget, and gets most of it:
+//    realizations composed from the atlas keep no bitmap of their own, the
+//    painters compose them from atlas pages when they draw.
+//
+//    Setting HKLM\Software\Microsoft\Avalon.Graphics\SubpixelGlyphVariants
+//    to a nonzero value has the software painter compose such runs at the
+//    quarter pixel origin closest to where they are drawn, so that text
+//    moved by fractions of a pixel stays sharp. The glyphs rasterized for
+//    those origins live in the atlas, within its share of the budget.
+//
 //------------------------------------------------------------------------
 
 #pragma once
@@ -76,8 +90,33 @@ public:
         return m_pDWriteFactory;        
     }
 
+    __out CGlyphAtlas *GetGlyphAtlasNoRef()
+    {
+        return m_pGlyphAtlas;
+    }
+
+    __out CGlyphOutlineCache *GetGlyphOutlineCacheNoRef()
+    {
+        return m_pGlyphOutlineCache;
+    }
+
     void AddRealization(__in CGlyphRunRealization *pRealization, UINT32 textureSize);
     void RemoveRealization(__in CGlyphRunRealization *pRealization, UINT32 textureSize);
+
+    //
+    // Counts a realization drawn with the bitmaps it already had (a hit) or
+    // one that needed them rasterized first (a miss)
+    //
+    void RecordRealizationUse(bool fHit);
+
+    //
+    // Whether realizations composed from the glyph atlas may be drawn at
+    // quarter pixel origins
+    //
+    bool UseSubpixelVariants() const
+    {
+        return m_fUseSubpixelVariants;
+    }
         
     static const UINT c_invalidHandleValue = (FontFaceHandle)(-1);
 
@@ -97,18 +136,38 @@ private:
     
     INT32 m_totalGlyphBitmapStorageSize;
 
-    // If glyph storage exceeds cMaximumBitmapStorageSize we'll trigger cleanup
+    // If glyph storage exceeds cMaximumBitmapStorageSize we'll trim whatever
+    // was not drawn this frame
     INT32 m_cMaximumBitmapStorageSize;
-    // We'll keep cleaning up until we hit cBitmapTargetSize
+    // Above cBitmapTargetSize we'll trim old bitmaps, a few per frame
     INT32 m_cBitmapTargetSize;
 
-    // If we exceed the maximum storage size, if the delta between the current frame
-    // and the oldest frame is less than this amount, we still won't cleanup.
+    // Above the target size, bitmaps are only trimmed once they have not been
+    // used for this many frames
     INT32 m_cFrameDelayBeforeCleanup;
+
+    // Above the target size, bitmaps are trimmed no faster than this many
+    // bytes per frame, so that the cache shrinks over several frames
+    static const INT32 c_cbMaximumTrimPerFrame = 128 * 1024;
+
+    static const INT32 c_cbDefaultMaximumBitmapStorageSize = 1000000;
+
+    // This fraction of the bitmap budget is kept for realizations that have
+    // their own bitmap, the glyph atlas may use the rest
+    static const INT32 c_wholeRunBudgetDivisor = 4;
+
+    bool m_fUseSubpixelVariants;
     
     UTC_TIME m_lastCompositionFrame;     // For lifetime management: increments each time we compose
     UTC_TIME m_currentRealizationFrame;  // Increments each time we compose AND process realizations
 
     IDWriteFactory *m_pDWriteFactory;    
+
+    // Alpha maps of individual glyphs that glyph run realizations are
+    // composed from
+    CGlyphAtlas *m_pGlyphAtlas;
+
+    // Outlines of individual glyphs that glyph run geometries are built from
+    CGlyphOutlineCache *m_pGlyphOutlineCache;
 };
 
@@ -0,0 +1,666 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------
+//
+
+//
+//  Description:
+//
+//    classes CGlyphOutlineCache and CGlyphOutlineRecorder implementation.
+//    See comments in glyphoutlinecache.h.
+//
+
+#include "precomp.hpp"
+
+MtDefine(CGlyphOutlineCache, MILRender, "CGlyphOutlineCache");
+MtDefine(GlyphOutline, CGlyphOutlineCache, "Glyph outline");
+MtDefine(CGlyphOutlineRecorder, CGlyphOutlineCache, "CGlyphOutlineRecorder");
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::CGlyphOutlineCache
+//
+//  Synopsis:   Constructor
+//
+//-------------------------------------------------------------------------
+CGlyphOutlineCache::CGlyphOutlineCache()
+{
+    m_pRecorder = NULL;
+    m_cbTotal = 0;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::~CGlyphOutlineCache
+//
+//  Synopsis:   Destructor
+//
+//-------------------------------------------------------------------------
+CGlyphOutlineCache::~CGlyphOutlineCache()
+{
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        m_rgEntries[i].pFont->Release();
+        WPFFree(ProcessHeap, m_rgEntries[i].pData);
+    }
+
+    ReleaseInterface(m_pRecorder);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::GetGlyphRunOutline
+//
+//  Synopsis:   Sends the outline of a glyph run to pSink, as
+//              IDWriteFontFace::GetGlyphRunOutline would, from the cached
+//              outlines of its glyphs. The outlines of glyphs that are not
+//              cached yet are extracted from pFontFace first.
+//
+//              glyphRun must not be sideways and must have glyph advances.
+//              The sink is not closed.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphOutlineCache::GetGlyphRunOutline(
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace,
+    __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+    UTC_TIME currentFrame,
+    __in IDWriteGeometrySink *pSink
+    )
+{
+    HRESULT hr = S_OK;
+
+    Assert(!glyphRun.isSideways);
+    Assert(glyphRun.glyphAdvances != NULL);
+
+    DWRITE_FONT_METRICS fontMetrics;
+    pFontFace->GetMetrics(&fontMetrics);
+
+    float rDesignUnitsPerEm = static_cast<float>(fontMetrics.designUnitsPerEm);
+    float rScale = glyphRun.fontEmSize / rDesignUnitsPerEm;
+    bool fRightToLeft = (glyphRun.bidiLevel & 1) != 0;
+
+    if (m_rgBuckets.GetCount() == 0)
+    {
+        IFC(m_rgBuckets.AddAndSet(sc_cInitialBuckets, UINT_MAX));
+    }
+
+    if (m_pRecorder == NULL)
+    {
+        IFC(CGlyphOutlineRecorder::Create(&m_pRecorder));
+    }
+
+    {
+        // Position of the pen along the baseline
+        float rPenX = 0.0f;
+
+        for (UINT i = 0; i < glyphRun.glyphCount; i++)
+        {
+            float rAdvance = glyphRun.glyphAdvances[i];
+            float rAdvanceOffset = 0.0f;
+            float rAscenderOffset = 0.0f;
+
+            if (glyphRun.glyphOffsets != NULL)
+            {
+                rAdvanceOffset = glyphRun.glyphOffsets[i].advanceOffset;
+                rAscenderOffset = glyphRun.glyphOffsets[i].ascenderOffset;
+            }
+
+            //
+            // Right to left glyphs lie to the left of the pen, and their
+            // advance offsets move them further left
+            //
+            float x;
+
+            if (fRightToLeft)
+            {
+                x = rPenX - rAdvance - rAdvanceOffset;
+                rPenX -= rAdvance;
+            }
+            else
+            {
+                x = rPenX + rAdvanceOffset;
+                rPenX += rAdvance;
+            }
+
+            UINT iEntry;
+            IFC(FindOrAddOutline(
+                pFont,
+                pFontFace,
+                glyphRun.glyphIndices[i],
+                rDesignUnitsPerEm,
+                currentFrame,
+                &iEntry
+                ));
+
+            ReplayOutline(m_rgEntries[iEntry], rScale, x, -rAscenderOffset, pSink);
+        }
+    }
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::Trim
+//
+//  Synopsis:   Releases the least recently used outlines until the cache
+//              is back under sc_cbTrimTarget. Outlines used in the current
+//              frame are kept.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineCache::Trim(UTC_TIME currentFrame)
+{
+    if (m_cbTotal <= sc_cbBudget)
+    {
+        return;
+    }
+
+    while (m_cbTotal > sc_cbTrimTarget)
+    {
+        UTC_TIME oldestFrame = currentFrame;
+
+        for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+        {
+            if (m_rgEntries[i].lastUsedFrame < oldestFrame)
+            {
+                oldestFrame = m_rgEntries[i].lastUsedFrame;
+            }
+        }
+
+        if (oldestFrame >= currentFrame)
+        {
+            break;
+        }
+
+        RemoveEntries(oldestFrame);
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::FindOrAddOutline
+//
+//  Synopsis:   Returns the entry of the outline of a glyph and marks it
+//              used in currentFrame, extracting the outline from pFontFace
+//              if it is not cached yet.
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphOutlineCache::FindOrAddOutline(
+    __in IDWriteFont *pFont,
+    __in IDWriteFontFace *pFontFace,
+    UINT16 glyphIndex,
+    float rDesignUnitsPerEm,
+    UTC_TIME currentFrame,
+    __out UINT *piEntry
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE *pData = NULL;
+
+    UINT iBucket = HashKey(pFont, glyphIndex) & (m_rgBuckets.GetCount() - 1);
+
+    for (UINT i = m_rgBuckets[iBucket]; i != UINT_MAX; i = m_rgEntries[i].iNextInBucket)
+    {
+        Entry &entry = m_rgEntries[i];
+
+        if (entry.pFont == pFont && entry.glyphIndex == glyphIndex)
+        {
+            entry.lastUsedFrame = currentFrame;
+            *piEntry = i;
+            goto Cleanup;
+        }
+    }
+
+    {
+        //
+        // At an em size of one design unit per DIP the outline comes out in
+        // design units
+        //
+        FLOAT rAdvance = 0.0f;
+
+        m_pRecorder->Reset();
+
+        IFC(pFontFace->GetGlyphRunOutline(
+            rDesignUnitsPerEm,
+            &glyphIndex,
+            &rAdvance,
+            NULL,
+            1,
+            FALSE,
+            FALSE,
+            m_pRecorder
+            ));
+
+        IFC(m_pRecorder->m_hr);
+
+        Entry entry;
+        ZeroMemory(&entry, sizeof(entry));
+        entry.pFont = pFont;
+        entry.glyphIndex = glyphIndex;
+        entry.cCommands = m_pRecorder->m_rgCommands.GetCount();
+        entry.lastUsedFrame = currentFrame;
+
+        if (entry.cCommands > 0)
+        {
+            UINT32 cbCommands = entry.cCommands * sizeof(UINT);
+            UINT32 cbPoints = m_pRecorder->m_rgPoints.GetCount() * sizeof(D2D1_POINT_2F);
+
+            entry.cbData = cbCommands + cbPoints;
+
+            pData = WPFAllocType(BYTE *, ProcessHeap, Mt(GlyphOutline), entry.cbData);
+            IFCOOM(pData);
+
+            memcpy(pData, m_pRecorder->m_rgCommands.GetDataBuffer(), cbCommands);
+
+            if (cbPoints > 0)
+            {
+                memcpy(pData + cbCommands, m_pRecorder->m_rgPoints.GetDataBuffer(), cbPoints);
+            }
+
+            entry.pData = pData;
+        }
+
+        entry.iNextInBucket = m_rgBuckets[iBucket];
+
+        IFC(m_rgEntries.Add(entry));
+
+        pData = NULL;
+        pFont->AddRef();
+        m_cbTotal += GetEntrySize(entry);
+
+        *piEntry = m_rgEntries.GetCount() - 1;
+        m_rgBuckets[iBucket] = *piEntry;
+
+        if (m_rgEntries.GetCount() > 2 * m_rgBuckets.GetCount())
+        {
+            // Failing to grow only makes the chains longer
+            if (SUCCEEDED(m_rgBuckets.AddAndSet(m_rgBuckets.GetCount(), UINT_MAX)))
+            {
+                RebuildBuckets();
+            }
+        }
+    }
+
+Cleanup:
+    WPFFree(ProcessHeap, pData);
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::ReplayOutline
+//
+//  Synopsis:   Sends a recorded outline to pSink, scaled by rScale and
+//              moved to (x, y).
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineCache::ReplayOutline(
+    __in_ecount(1) const Entry &entry,
+    float rScale,
+    float x,
+    float y,
+    __in IDWriteGeometrySink *pSink
+    )
+{
+    const UINT *pCommands = reinterpret_cast<const UINT *>(entry.pData);
+    const D2D1_POINT_2F *pPoints = reinterpret_cast<const D2D1_POINT_2F *>(entry.pData + entry.cCommands * sizeof(UINT));
+
+    // Points are transformed in batches; a multiple of 3 keeps beziers whole
+    D2D1_POINT_2F rgTransformed[48];
+
+    for (UINT i = 0; i < entry.cCommands; i++)
+    {
+        UINT argument = pCommands[i] >> 8;
+
+        switch (pCommands[i] & 0xFF)
+        {
+        case CGlyphOutlineRecorder::SetFillModeCommand:
+            pSink->SetFillMode(static_cast<D2D1_FILL_MODE>(argument));
+            break;
+
+        case CGlyphOutlineRecorder::SetSegmentFlagsCommand:
+            pSink->SetSegmentFlags(static_cast<D2D1_PATH_SEGMENT>(argument));
+            break;
+
+        case CGlyphOutlineRecorder::BeginFigureCommand:
+            rgTransformed[0].x = pPoints->x * rScale + x;
+            rgTransformed[0].y = pPoints->y * rScale + y;
+            pPoints++;
+
+            pSink->BeginFigure(rgTransformed[0], static_cast<D2D1_FIGURE_BEGIN>(argument));
+            break;
+
+        case CGlyphOutlineRecorder::AddLinesCommand:
+        case CGlyphOutlineRecorder::AddBeziersCommand:
+            {
+                bool fBeziers = (pCommands[i] & 0xFF) == CGlyphOutlineRecorder::AddBeziersCommand;
+                UINT cPoints = fBeziers ? 3 * argument : argument;
+
+                while (cPoints > 0)
+                {
+                    UINT cBatch = min(cPoints, static_cast<UINT>(ARRAYSIZE(rgTransformed)));
+
+                    for (UINT j = 0; j < cBatch; j++)
+                    {
+                        rgTransformed[j].x = pPoints[j].x * rScale + x;
+                        rgTransformed[j].y = pPoints[j].y * rScale + y;
+                    }
+
+                    if (fBeziers)
+                    {
+                        pSink->AddBeziers(reinterpret_cast<const D2D1_BEZIER_SEGMENT *>(rgTransformed), cBatch / 3);
+                    }
+                    else
+                    {
+                        pSink->AddLines(rgTransformed, cBatch);
+                    }
+
+                    pPoints += cBatch;
+                    cPoints -= cBatch;
+                }
+            }
+            break;
+
+        case CGlyphOutlineRecorder::EndFigureCommand:
+            pSink->EndFigure(static_cast<D2D1_FIGURE_END>(argument));
+            break;
+
+        default:
+            Assert(false);
+        }
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::RemoveEntries
+//
+//  Synopsis:   Releases the outlines last used at or before
+//              lastUsedFrameMax.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineCache::RemoveEntries(UTC_TIME lastUsedFrameMax)
+{
+    UINT cEntries = 0;
+
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        const Entry &entry = m_rgEntries[i];
+
+        if (entry.lastUsedFrame <= lastUsedFrameMax)
+        {
+            Assert(m_cbTotal >= GetEntrySize(entry));
+            m_cbTotal -= GetEntrySize(entry);
+
+            entry.pFont->Release();
+            WPFFree(ProcessHeap, entry.pData);
+        }
+        else
+        {
+            m_rgEntries[cEntries++] = entry;
+        }
+    }
+
+    m_rgEntries.SetCount(cEntries);
+
+    RebuildBuckets();
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::RebuildBuckets
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineCache::RebuildBuckets()
+{
+    UINT cBuckets = m_rgBuckets.GetCount();
+
+    for (UINT i = 0; i < cBuckets; i++)
+    {
+        m_rgBuckets[i] = UINT_MAX;
+    }
+
+    for (UINT i = 0; i < m_rgEntries.GetCount(); i++)
+    {
+        UINT iBucket = HashKey(m_rgEntries[i].pFont, m_rgEntries[i].glyphIndex) & (cBuckets - 1);
+
+        m_rgEntries[i].iNextInBucket = m_rgBuckets[iBucket];
+        m_rgBuckets[iBucket] = i;
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineCache::HashKey
+//
+//-------------------------------------------------------------------------
+UINT
+CGlyphOutlineCache::HashKey(
+    __in IDWriteFont *pFont,
+    UINT16 glyphIndex
+    )
+{
+    UINT hash = static_cast<UINT>(reinterpret_cast<UINT_PTR>(pFont) >> 4);
+
+    hash = hash * 31 + glyphIndex;
+
+    // Spread the low bits, which select the bucket
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+
+    return hash;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::CGlyphOutlineRecorder
+//
+//  Synopsis:   Constructor
+//
+//-------------------------------------------------------------------------
+CGlyphOutlineRecorder::CGlyphOutlineRecorder()
+{
+    m_hr = S_OK;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::Create
+//
+//  Synopsis:   Static Factory
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphOutlineRecorder::Create(
+    __deref_out CGlyphOutlineRecorder **ppRecorder
+    )
+{
+    HRESULT hr = S_OK;
+
+    CGlyphOutlineRecorder *pRecorder = new CGlyphOutlineRecorder();
+    IFCOOM(pRecorder);
+
+    pRecorder->AddRef();
+
+    *ppRecorder = pRecorder; // Transitioning ref count to out argument
+
+Cleanup:
+    RRETURN(hr);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::HrFindInterface
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphOutlineRecorder::HrFindInterface(
+    __in_ecount(1) REFIID riid, __deref_out void **ppvObject
+    )
+{
+    return E_NOTIMPL;
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::Reset
+//
+//  Synopsis:   Forgets the recorded outline, to record another one.
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::Reset()
+{
+    m_hr = S_OK;
+    m_rgCommands.Reset(FALSE);
+    m_rgPoints.Reset(FALSE);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::AddCommand
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::AddCommand(
+    UINT command,
+    UINT argument
+    )
+{
+    if (argument > (UINT_MAX >> 8))
+    {
+        MIL_THRX(m_hr, WGXERR_BADNUMBER);
+    }
+
+    if (SUCCEEDED(m_hr))
+    {
+        MIL_THRX(m_hr, m_rgCommands.Add(command | (argument << 8)));
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::SetFillMode
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::SetFillMode(
+    D2D1_FILL_MODE fillMode
+    )
+{
+    AddCommand(SetFillModeCommand, fillMode);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::SetSegmentFlags
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::SetSegmentFlags(
+    D2D1_PATH_SEGMENT vertexFlags
+    )
+{
+    AddCommand(SetSegmentFlagsCommand, vertexFlags);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::BeginFigure
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::BeginFigure(
+    D2D1_POINT_2F startPoint,
+    D2D1_FIGURE_BEGIN figureBegin
+    )
+{
+    AddCommand(BeginFigureCommand, figureBegin);
+
+    if (SUCCEEDED(m_hr))
+    {
+        MIL_THRX(m_hr, m_rgPoints.Add(startPoint));
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::AddLines
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::AddLines(
+    __in_ecount(pointsCount) CONST D2D1_POINT_2F *points,
+    UINT pointsCount
+    )
+{
+    AddCommand(AddLinesCommand, pointsCount);
+
+    if (SUCCEEDED(m_hr))
+    {
+        MIL_THRX(m_hr, m_rgPoints.AddMultipleAndSet(points, pointsCount));
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::AddBeziers
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::AddBeziers(
+    __in_ecount(beziersCount) CONST D2D1_BEZIER_SEGMENT *beziers,
+    UINT beziersCount
+    )
+{
+    AddCommand(AddBeziersCommand, beziersCount);
+
+    if (SUCCEEDED(m_hr))
+    {
+        UINT cPoints;
+
+        MIL_THRX(m_hr, MultiplyUINT(beziersCount, 3, cPoints));
+
+        if (SUCCEEDED(m_hr))
+        {
+            MIL_THRX(m_hr, m_rgPoints.AddMultipleAndSet(reinterpret_cast<const D2D1_POINT_2F *>(beziers), cPoints));
+        }
+    }
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::EndFigure
+//
+//-------------------------------------------------------------------------
+void
+CGlyphOutlineRecorder::EndFigure(
+    D2D1_FIGURE_END figureEnd
+    )
+{
+    AddCommand(EndFigureCommand, figureEnd);
+}
+
+//+------------------------------------------------------------------------
+//
+//  Member:     CGlyphOutlineRecorder::Close
+//
+//-------------------------------------------------------------------------
+HRESULT
+CGlyphOutlineRecorder::Close()
+{
+    RRETURN(m_hr);
+}
+
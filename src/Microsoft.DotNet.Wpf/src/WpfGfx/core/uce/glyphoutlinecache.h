@@ -0,0 +1,225 @@
+// Licensed to the .NET Foundation under one or more agreements.
+// The .NET Foundation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+
+//+-----------------------------------------------------------------------
+//
+
+//
+//  Description:
+//
+//    Outlines of individual glyphs in font design units, shared by all
+//    glyph runs of a composition. Glyph runs too large for bitmaps build
+//    their geometry from these instead of asking DWrite for the outline of
+//    every run, so the outline of a glyph is extracted only once.
+//
+//------------------------------------------------------------------------
+
+#pragma once
+
+MtExtern(CGlyphOutlineCache);
+MtExtern(CGlyphOutlineRecorder);
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CGlyphOutlineRecorder
+//
+//  Synopsis:
+//      Geometry sink that records the outline DWrite produces for a single
+//      glyph as a list of commands and points, to be replayed later.
+//
+//------------------------------------------------------------------------------
+
+class CGlyphOutlineRecorder
+    : public CMILCOMBase
+    , public IDWriteGeometrySink
+{
+    friend class CGlyphOutlineCache;
+
+public:
+    DECLARE_METERHEAP_CLEAR(ProcessHeap, Mt(CGlyphOutlineRecorder));
+
+    static HRESULT Create(
+        __deref_out CGlyphOutlineRecorder **ppRecorder
+        );
+
+//
+// CMILCOMBase interface
+//
+    DECLARE_COM_BASE
+
+    override STDMETHOD(HrFindInterface)(
+        __in_ecount(1) REFIID riid, __deref_out void **ppvObject
+        );
+
+//
+// ID2D1SimplifiedGeometrySink interface
+//
+    override STDMETHOD_(void, SetFillMode)(
+        D2D1_FILL_MODE fillMode
+        );
+
+    override STDMETHOD_(void, SetSegmentFlags)(
+        D2D1_PATH_SEGMENT vertexFlags
+        );
+
+    override STDMETHOD_(void, BeginFigure)(
+        D2D1_POINT_2F startPoint,
+        D2D1_FIGURE_BEGIN figureBegin
+        );
+
+    override STDMETHOD_(void, AddLines)(
+        __in_ecount(pointsCount) CONST D2D1_POINT_2F *points,
+        UINT pointsCount
+        );
+
+    override STDMETHOD_(void, AddBeziers)(
+        __in_ecount(beziersCount) CONST D2D1_BEZIER_SEGMENT *beziers,
+        UINT beziersCount
+        );
+
+    override STDMETHOD_(void, EndFigure)(
+        D2D1_FIGURE_END figureEnd
+        );
+
+    override STDMETHOD(Close)(
+        );
+
+private:
+    CGlyphOutlineRecorder();
+
+    void Reset();
+
+    void AddCommand(
+        UINT command,
+        UINT argument
+        );
+
+    // Commands are stored in the low byte of a UINT, with their argument
+    // (a count of points or a D2D1 enumeration value) in the upper bytes
+    enum Command
+    {
+        SetFillModeCommand,
+        SetSegmentFlagsCommand,
+        BeginFigureCommand,     // followed by 1 point
+        AddLinesCommand,        // followed by argument points
+        AddBeziersCommand,      // followed by 3 * argument points
+        EndFigureCommand
+    };
+
+    // First failure seen by the sink methods, which cannot return it
+    HRESULT m_hr;
+
+    DynArray<UINT> m_rgCommands;
+    DynArray<D2D1_POINT_2F> m_rgPoints;
+};
+
+//+-----------------------------------------------------------------------------
+//
+//  Class:
+//      CGlyphOutlineCache
+//
+//  Synopsis:
+//      Keeps the outlines of individual glyphs, keyed on font and glyph
+//      index, in font design units. The outline of a glyph run is the
+//      outlines of its glyphs, scaled to the em size and moved to their
+//      positions in the run.
+//
+//      Outlines are found through a hash of their key. When the entries,
+//      counted with their outlines, exceed sc_cbBudget, Trim releases the
+//      least recently used ones.
+//
+//------------------------------------------------------------------------------
+
+class CGlyphOutlineCache
+{
+public:
+    DECLARE_METERHEAP_CLEAR(ProcessHeap, Mt(CGlyphOutlineCache));
+
+    CGlyphOutlineCache();
+    ~CGlyphOutlineCache();
+
+    HRESULT GetGlyphRunOutline(
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace,
+        __in_ecount(1) const DWRITE_GLYPH_RUN &glyphRun,
+        UTC_TIME currentFrame,
+        __in IDWriteGeometrySink *pSink
+        );
+
+    void Trim(UTC_TIME currentFrame);
+
+    UINT32 GetSize() const
+    {
+        return m_cbTotal;
+    }
+
+private:
+    struct Entry
+    {
+        IDWriteFont *pFont;            // Referenced by the entry
+        UINT16 glyphIndex;
+
+        UINT iNextInBucket;
+
+        // Commands followed by points, NULL if the glyph has no outline
+        BYTE *pData;
+        UINT32 cbData;
+        UINT cCommands;
+
+        UTC_TIME lastUsedFrame;
+    };
+
+    HRESULT FindOrAddOutline(
+        __in IDWriteFont *pFont,
+        __in IDWriteFontFace *pFontFace,
+        UINT16 glyphIndex,
+        float rDesignUnitsPerEm,
+        UTC_TIME currentFrame,
+        __out UINT *piEntry
+        );
+
+    static void ReplayOutline(
+        __in_ecount(1) const Entry &entry,
+        float rScale,
+        float x,
+        float y,
+        __in IDWriteGeometrySink *pSink
+        );
+
+    void RemoveEntries(UTC_TIME lastUsedFrameMax);
+
+    // Bytes an entry counts against sc_cbBudget, so that glyphs without an
+    // outline are not free
+    static UINT32 GetEntrySize(__in_ecount(1) const Entry &entry)
+    {
+        return sizeof(Entry) + entry.cbData;
+    }
+
+    void RebuildBuckets();
+
+    static UINT HashKey(
+        __in IDWriteFont *pFont,
+        UINT16 glyphIndex
+        );
+
+    // Bytes of entries above which Trim releases outlines, and the size it
+    // trims to
+    static const UINT32 sc_cbBudget = 2 * 1024 * 1024;
+    static const UINT32 sc_cbTrimTarget = 3 * 512 * 1024;
+
+    static const UINT sc_cInitialBuckets = 256;
+
+    CGlyphOutlineRecorder *m_pRecorder;
+
+    DynArray<Entry> m_rgEntries;
+
+    // Index of the first entry of each hash bucket, UINT_MAX if empty
+    DynArray<UINT> m_rgBuckets;
+
+    // Bytes of all entries, see GetEntrySize
+    UINT32 m_cbTotal;
+};
+
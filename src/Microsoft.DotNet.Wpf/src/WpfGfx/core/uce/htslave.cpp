@@ -40,7 +40,7 @@ HRESULT CMilSlaveHandleTable::CreateEmptyResource(
     HRESULT hr = S_OK;
 
     CMilSlaveResource *pResource = NULL;
-    HANDLE_ENTRY *pHandleEntry = NULL;
+    bool fEntryAllocated = false;
 
     //
     // Allocate a handle and create the requested resource...
@@ -48,10 +48,11 @@ HRESULT CMilSlaveHandleTable::CreateEmptyResource(
 
     IFC(AllocateEntryAtHandle(
         pCmd->Handle, 
-        pCmd->resType, 
-        &pHandleEntry
+        pCmd->resType
         ));
 
+    fEntryAllocated = true;
+
     IFC(CResourceFactory::Create(
         pDevice,
         this,
@@ -76,7 +77,7 @@ HRESULT CMilSlaveHandleTable::CreateEmptyResource(
     EventWriteCreateWpfGfxResource(pResource, pChannel->GetChannel(), pCmd->Handle, pCmd->resType);
 
     pResource = NULL; // Transfering the ref-count to the out argument.
-    pHandleEntry = NULL;
+    fEntryAllocated = false;
 
 Cleanup:
     if (FAILED(hr)) 
@@ -87,7 +88,7 @@ Cleanup:
         // addref'ed the resource, DeleteHandle will take care of that).
         //
 
-        if (pHandleEntry != NULL) 
+        if (fEntryAllocated) 
         {
             //
             // It is safe to ignore the DeleteHandle result as it can only fail
@@ -110,7 +111,9 @@ Cleanup:
 **************************************************************************/
 
 CMilSlaveHandleTable::CMilSlaveHandleTable() :
-    m_handletable(sizeof(HANDLE_ENTRY)),
+    m_rgType(NULL),
+    m_rgpResource(NULL),
+    m_cHandleCount(0),
     m_pComposition(NULL),
     m_cyclicResourceList()
 {
@@ -137,51 +140,120 @@ CMilSlaveHandleTable::~CMilSlaveHandleTable()
     // eg. an island existing in resource graph.
     //
     BreakLinksForCyclicResources();
+
+    FreeHeap(m_rgType);
+    FreeHeap(m_rgpResource);
 }
 
 
 /**************************************************************************
 *
 * Name:
-*   CMilSlaveHandleTable::GetObjectType()
+*   CMilSlaveHandleTable::GetResources()
+*
+* Description:
+*    Resolves an array of handles in one call, ensuring each resource is
+*    of the corresponding requested type. NULL handles resolve to NULL.
+*    Fails without partial results if any non-NULL handle is invalid.
 *
-*  returns the type of the object
-***************************************************************************/
+**************************************************************************/
 
-MIL_RESOURCE_TYPE CMilSlaveHandleTable::GetObjectType(HMIL_OBJECT object)
+HRESULT
+CMilSlaveHandleTable::GetResources(
+    UINT cResources,
+    __in_ecount(cResources) const HMIL_RESOURCE *rghResources,
+    __in_ecount(cResources) const MIL_RESOURCE_TYPE *rgTypes,
+    __out_ecount(cResources) CMilSlaveResource **rgpResources
+    ) const
 {
-    return (MIL_RESOURCE_TYPE)m_handletable.GetObjectType(object);
+    HRESULT hr = S_OK;
+
+    for (UINT i = 0; i < cResources; i++)
+    {
+        HMIL_RESOURCE hResource = rghResources[i];
+
+        if (hResource == HMIL_RESOURCE_NULL)
+        {
+            rgpResources[i] = NULL;
+        }
+        else
+        {
+            rgpResources[i] = GetResource(hResource, rgTypes[i]);
+
+            if (rgpResources[i] == NULL)
+            {
+                IFC(WGXERR_UCE_MALFORMEDPACKET);
+            }
+        }
+    }
+
+Cleanup:
+    if (FAILED(hr))
+    {
+        RtlZeroMemory(rgpResources, cResources * sizeof(*rgpResources));
+    }
+
+    RRETURN(hr);
 }
 
 /**************************************************************************
 *
 * Name:
-*   CMilSlaveHandleTable::GetResource()
+*   CMilSlaveHandleTable::ResizeToFit
 *
 * Description:
-*    Gets the resource at the specified handle ensuring it is of the
-*    requested type
+*   Grows both handle table arrays so that the given handle is addressable.
+*   The growth is amortized the same way HANDLE_TABLE does it.
 *
 **************************************************************************/
 
-__out_ecount_opt(1) CMilSlaveResource *
-CMilSlaveHandleTable::GetResource(
-    HMIL_RESOURCE hres,
-    MIL_RESOURCE_TYPE type
-    ) const
+HRESULT CMilSlaveHandleTable::ResizeToFit(
+    HMIL_RESOURCE hres
+    )
 {
-    if (m_handletable.ValidEntry(hres))
-    {
-        HANDLE_ENTRY *pEntry = (HANDLE_ENTRY*)ENTRY_RECORD(m_handletable, hres);
+    HRESULT hr = S_OK;
 
-        if (pEntry->pResource != NULL
-            && pEntry->pResource->IsOfType(type)) 
-        {
-            return pEntry->pResource;
-        }
+    UINT cNewSize = 0;
+    UINT cbNewTypes = 0;
+    UINT cbNewResources = 0;
+    MIL_RESOURCE_TYPE *rgNewType = NULL;
+    CMilSlaveResource **rgpNewResource = NULL;
+
+    if (hres >= MIL_HANDLE_TABLE_SIZE_MAX)
+    {
+        IFC(WGXERR_UCE_OUTOFHANDLES);
     }
 
-    return NULL;
+    IFC(UIntAdd(hres, MIL_HANDLE_TABLE_SIZE_INC, &cNewSize));
+
+    cNewSize = max(cNewSize, MIL_HANDLE_TABLE_SIZE_MIN);
+    cNewSize = min(cNewSize, MIL_HANDLE_TABLE_SIZE_MAX);
+
+    Assert(cNewSize > m_cHandleCount);
+
+    IFC(MultiplyUINT(cNewSize, sizeof(*m_rgType), cbNewTypes));
+    IFC(MultiplyUINT(cNewSize, sizeof(*m_rgpResource), cbNewResources));
+
+    //
+    // Reallocate both arrays before publishing either of them so that a
+    // failure leaves the table consistent.
+    //
+
+    rgNewType = static_cast<MIL_RESOURCE_TYPE *>(ReallocHeap(m_rgType, cbNewTypes));
+    IFCOOM(rgNewType);
+    m_rgType = rgNewType;
+
+    rgpNewResource = static_cast<CMilSlaveResource **>(ReallocHeap(m_rgpResource, cbNewResources));
+    IFCOOM(rgpNewResource);
+    m_rgpResource = rgpNewResource;
+
+    RtlZeroMemory(m_rgType + m_cHandleCount, (cNewSize - m_cHandleCount) * sizeof(*m_rgType));
+    RtlZeroMemory(m_rgpResource + m_cHandleCount, (cNewSize - m_cHandleCount) * sizeof(*m_rgpResource));
+
+    m_cHandleCount = cNewSize;
+
+Cleanup:
+    RRETURN(hr);
 }
 
 /**************************************************************************
@@ -196,33 +268,45 @@ CMilSlaveHandleTable::GetResource(
 
 HRESULT CMilSlaveHandleTable::AllocateEntryAtHandle(
     HMIL_RESOURCE hres,
-    MIL_RESOURCE_TYPE type,
-    HANDLE_ENTRY **ppEntry
+    MIL_RESOURCE_TYPE type
     )
 {
+    HRESULT hr = S_OK;
+
     //
-    // Assign the table index to this new resource. Grow the table if necessary.
+    // Cannot assign an invalid entry, cannot assign the NULL handle.
     //
 
-    HRESULT hr = THR(m_handletable.AssignEntry(hres, type));
-
-    if (SUCCEEDED(hr))
+    if (type == TYPE_NULL || hres == 0)
     {
-        //
-        // Retrieve the address of the entry.
-        //
+        RIP("Cannot assign empty entries, cannot assign to the NULL handle.");
+        IFC(E_INVALIDARG);
+    }
 
-        HANDLE_ENTRY *pEntry = (HANDLE_ENTRY*)ENTRY_RECORD(m_handletable, hres);
+    //
+    // Grow the table if necessary.
+    //
 
-        //
-        // Initialize the fields.
-        //
+    if (hres >= m_cHandleCount)
+    {
+        IFC(ResizeToFit(hres));
+    }
 
-        pEntry->pResource = NULL;
+    //
+    // Ensure that the requested location is actually empty. If not
+    // we would leak some object.
+    //
 
-        *ppEntry = pEntry;
+    if (m_rgType[hres] != TYPE_NULL)
+    {
+        RIP("Attempt to overwrite a reserved handle table entry.");
+        IFC(E_INVALIDARG);
     }
 
+    m_rgType[hres] = type;
+    m_rgpResource[hres] = NULL;
+
+Cleanup:
     RRETURN(hr);
 }
 
@@ -244,16 +328,14 @@ HRESULT CMilSlaveHandleTable::InitializeHandle(
     HRESULT hr = E_HANDLE;
 
     Assert(pResource);
-    Assert(m_handletable.ValidEntry(hResource));
+    Assert(IsAllocatedEntry(hResource));
 
-    HANDLE_ENTRY *phe = GetEntry(hResource);
-    if (phe)
+    if (IsAllocatedEntry(hResource))
     {
         hr = S_OK;
-        Assert(phe->type != TYPE_NULL);
-        Assert(phe->pResource == NULL);
+        Assert(m_rgpResource[hResource] == NULL);
 
-        phe->pResource = pResource;
+        m_rgpResource[hResource] = pResource;
         pResource->AddRef();
     }
     RRETURN(hr);
@@ -319,29 +401,30 @@ HRESULT CMilSlaveHandleTable::DuplicateHandle(
 {
     HRESULT hr = S_OK;
 
-    HANDLE_ENTRY* pOriginalEntry = NULL;
-    HANDLE_ENTRY* pDuplicateEntry = NULL;
+    CMilSlaveResource *pOriginalResource = NULL;
 
     //
-    // Allocate the duplicated entry (the handle table storage could get
-    // reallocated, so do not fetch the original entry before allocation). 
+    // Allocate the duplicated entry.
     //
     CMilSlaveHandleTable *pTargetHandleTable = pTargetChannel->GetChannelTable();
     IFC(pTargetHandleTable->AllocateEntryAtHandle(
         hDuplicate,
-        GetObjectType(hOriginal),
-        &pDuplicateEntry
+        GetObjectType(hOriginal)
         ));
 
 
     //
-    // Fetch and validate the original entry.
+    // Fetch and validate the original entry (the handle table storage could
+    // have been reallocated by the allocation above if both channels share
+    // the table, so do not fetch it earlier).
     //
 
-    pOriginalEntry = GetEntry(hOriginal);
+    if (IsAllocatedEntry(hOriginal))
+    {
+        pOriginalResource = m_rgpResource[hOriginal];
+    }
 
-    CHECKPTR(pOriginalEntry);
-    CHECKPTR(pOriginalEntry->pResource);
+    CHECKPTR(pOriginalResource);
 
 
     //
@@ -350,8 +433,8 @@ HRESULT CMilSlaveHandleTable::DuplicateHandle(
     // a partition.
     //
 
-    pDuplicateEntry->pResource = pOriginalEntry->pResource;
-    pDuplicateEntry->pResource->AddRef();
+    pTargetHandleTable->m_rgpResource[hDuplicate] = pOriginalResource;
+    pOriginalResource->AddRef();
 
 Cleanup:
     RRETURN(hr);
@@ -372,20 +455,19 @@ HRESULT CMilSlaveHandleTable::DeleteHandle(HMIL_RESOURCE hResource)
 {
     HRESULT hr = E_HANDLE;
 
-    HANDLE_ENTRY *phe = GetEntry(hResource);
-    if (phe && phe->type != TYPE_NULL)
+    if (IsAllocatedEntry(hResource))
     {
-        if (phe->pResource) 
+        if (m_rgpResource[hResource]) 
         {
-            phe->pResource->Release();
-            phe->pResource = NULL;
+            m_rgpResource[hResource]->Release();
+            m_rgpResource[hResource] = NULL;
         }
 
         //
         // clear the entry
         //
 
-        m_handletable.DestroyHandle(hResource);
+        DestroyEntry(hResource);
 
         hr = S_OK;
     }
@@ -394,28 +476,6 @@ HRESULT CMilSlaveHandleTable::DeleteHandle(HMIL_RESOURCE hResource)
 }
 
 
-/**************************************************************************
-*
-* Name:
-*   CMilSlaveHandleTable::GetEntry
-*
-* Description:
-*   Retrieves the entry from the table for the given resource
-*
-**************************************************************************/
-
-CMilSlaveHandleTable::HANDLE_ENTRY *
-CMilSlaveHandleTable::GetEntry(HMIL_RESOURCE hres)
-{
-    if (m_handletable.ValidEntry(hres))
-    {
-        HANDLE_ENTRY *pEntry = (HANDLE_ENTRY*)ENTRY_RECORD(m_handletable, hres);
-        return pEntry;
-    }
-
-    return NULL;
-}
-
 /**************************************************************************
 *
 * Name:
@@ -430,15 +490,15 @@ bool CMilSlaveHandleTable::ReleaseHandleTableEntries(
     __in_ecount_opt(1) const CComposition *pComposition
     )
 {
-    HANDLE_ENTRY *pEntry = NULL;
     bool fReleased = false;
 
-    for (UINT i = 0; i < m_handletable.m_cHandleCount; i++)
+    for (UINT i = 0; i < m_cHandleCount; i++)
     {
-        pEntry = GetEntry(i);
-        if (pEntry)
+        if (IsAllocatedEntry(i))
         {
-            if (pEntry->pResource)
+            CMilSlaveResource *pResource = m_rgpResource[i];
+
+            if (pResource)
             {
                 if (pComposition)
                 {
@@ -452,15 +512,15 @@ bool CMilSlaveHandleTable::ReleaseHandleTableEntries(
                     IGNORE_HR(pComposition->ReleaseResource(
                                   this,
                                   static_cast<HMIL_RESOURCE>(i),
-                                  pEntry->pResource,
+                                  pResource,
                                   true // fCleanupShutdown
                                   ));
                 }
                 else
                 {
-                    ReleaseInterfaceNoNULL(pEntry->pResource);
+                    ReleaseInterfaceNoNULL(pResource);
 
-                    m_handletable.DestroyHandle(i);
+                    DestroyEntry(i);
                 }
 
                 fReleased = true;
@@ -46,13 +46,51 @@ public:
         __deref_out_ecount(1) CMilSlaveResource **ppResource
         );
 
-    MIL_RESOURCE_TYPE GetObjectType(HMIL_OBJECT object);
+    MIL_RESOURCE_TYPE GetObjectType(HMIL_OBJECT object) const
+    {
+        return (object < m_cHandleCount) ? m_rgType[object] : TYPE_NULL;
+    }
+
+    //
+    // GetResource is on the path of every command packet that references
+    // another resource, so the common case -- the entry was created with
+    // exactly the requested type -- is resolved from the type tag array
+    // without calling into the resource. Entry 0 is never assigned, so the
+    // NULL handle always fails the type check.
+    //
 
     __out_ecount_opt(1) CMilSlaveResource *GetResource(
         HMIL_RESOURCE hResource,
         MIL_RESOURCE_TYPE type
-        ) const;
+        ) const
+    {
+        if (hResource < m_cHandleCount)
+        {
+            MIL_RESOURCE_TYPE entryType = m_rgType[hResource];
+            CMilSlaveResource *pResource = m_rgpResource[hResource];
+
+            if (entryType == type)
+            {
+                return pResource;
+            }
+
+            if (   entryType != TYPE_NULL
+                && pResource != NULL
+                && pResource->IsOfType(type))
+            {
+                return pResource;
+            }
+        }
+
+        return NULL;
+    }
 
+    HRESULT GetResources(
+        UINT cResources,
+        __in_ecount(cResources) const HMIL_RESOURCE *rghResources,
+        __in_ecount(cResources) const MIL_RESOURCE_TYPE *rgTypes,
+        __out_ecount(cResources) CMilSlaveResource **rgpResources
+        ) const;
 
     BOOL IsValidResource(
         HMIL_RESOURCE hResource,
@@ -102,25 +140,38 @@ protected:
 
 protected:
 
-    struct HANDLE_ENTRY
-    {
-        MIL_RESOURCE_TYPE type; // type must be the first field in the entry.
-        CMilSlaveResource *pResource;
-    };
-
     HRESULT AllocateEntryAtHandle(
         HMIL_RESOURCE hres,
-        MIL_RESOURCE_TYPE type,
-        HANDLE_ENTRY **ppHandle
+        MIL_RESOURCE_TYPE type
         );
 
-    HANDLE_ENTRY *GetEntry(HMIL_RESOURCE hResource);
+    bool IsAllocatedEntry(HMIL_RESOURCE hres) const
+    {
+        return (hres != 0) && (hres < m_cHandleCount) && (m_rgType[hres] != TYPE_NULL);
+    }
+
+    HRESULT ResizeToFit(HMIL_RESOURCE hres);
+
+    void DestroyEntry(HMIL_RESOURCE hres)
+    {
+        Assert(IsAllocatedEntry(hres));
+
+        m_rgType[hres] = TYPE_NULL;
+        m_rgpResource[hres] = NULL;
+    }
 
     //
-    // The handle table data.
+    // The handle table data. Handles are assigned by the client, so the
+    // table is indexed directly by handle. The type tags and the resource
+    // pointers are kept in separate arrays: validation only touches the
+    // densely packed tags, and the pointer array is only read once an entry
+    // has passed validation. TYPE_NULL marks an unused entry.
     //
 
-    HANDLE_TABLE m_handletable;
+    MIL_RESOURCE_TYPE *m_rgType;
+    CMilSlaveResource **m_rgpResource;
+    UINT m_cHandleCount;
+
     CComposition *m_pComposition;
 
 private:
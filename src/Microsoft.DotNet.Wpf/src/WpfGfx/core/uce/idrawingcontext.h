@@ -138,6 +138,18 @@ interface __declspec(novtable) IDrawingContext
         return false;
     };
 
+    //
+    // Returns the local space bounds outside of which drawing has no visible
+    // effect, or false when content drawn to this context must not be culled.
+    //
+
+    virtual bool GetLocalCullBounds(
+        __out_ecount(1) CMilRectF *prcCullBoundsLocal
+        )
+    {
+        return false;
+    }
+
     //
     // This function is an implementation detail on the surface contexts. It is
     // used to lazily apply the clip realizations so that multiple chained
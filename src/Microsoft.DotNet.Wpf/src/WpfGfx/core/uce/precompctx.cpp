@@ -78,7 +78,7 @@ CPreComputeContext::PreCompute(
     __in_ecount_opt(uNumInvalidTargetRegions) MilRectF const *rgInvalidTargetRegions,
     float allowedDirtyRegionOverhead,
     MilBitmapInterpolationMode::Enum defaultInterpolationMode,
-    __in_opt ScrollArea *pScrollArea,
+    __in_opt ScrollAreaList *pScrollAreas,
     BOOL fDisableDirtyRegionOptimization
     )
 {
@@ -98,15 +98,21 @@ CPreComputeContext::PreCompute(
     m_rootDirtyRegion.Initialize(prcSurfaceBounds, allowedDirtyRegionOverhead);
     m_dirtyRegionStack.Push(&m_rootDirtyRegion);
 
-    m_pScrollAreaParameters = pScrollArea;
+    m_pScrollAreas = pScrollAreas;
 
     // Can't do scroll optimization in cases where dirty regions are turned off.
     // Can't have invalid regions and scroll
-    if (pScrollArea && (fDisableDirtyRegionOptimization || uNumInvalidTargetRegions > 0))
+    if (pScrollAreas && (fDisableDirtyRegionOptimization || uNumInvalidTargetRegions > 0))
     {
         IFC(E_INVALIDARG);
     }
 
+    if (pScrollAreas)
+    {
+        pScrollAreas->cScrollAreas = 0;
+        pScrollAreas->cScrollCandidates = 0;
+    }
+
     m_surfaceBounds = *prcSurfaceBounds;
 
     if (   !fDisableDirtyRegionOptimization
@@ -126,7 +132,8 @@ CPreComputeContext::PreCompute(
         m_rootDirtyRegion.Disable();
     }
 
-    Assert(m_fScrollHasBegun == false);
+    Assert(!ScrollHasBegun());
+    Assert(!ScrollHasCompleted());
     m_effectCount = 0;
 
     //
@@ -148,9 +155,6 @@ CPreComputeContext::PreCompute(
     // Can't have scrolls occurring if accelerated scrolling isn't enabled
     Assert(IsAcceleratedScrollEnabled() || !ScrollHasCompleted());
 
-    m_fScrollHasCompleted = false;
-    m_fScrollHasBegun = false;
-
 Cleanup:
     // (SUCCEEDED(hr) => (m_transformStack.IsEmpty())
     Assert(!SUCCEEDED(hr) || (m_transformStack.IsEmpty()));
@@ -160,6 +164,9 @@ Cleanup:
     // (Note that the graph iterator cleans itself up if it fails).
     m_transformStack.Clear();
 
+    m_cScrollsCompleted = 0;
+    m_fScrollInProgress = false;
+
     RRETURN(hr);
 }
 
@@ -215,10 +222,19 @@ CPreComputeContext::PreSubgraph(
         // and handle this in the regular way.
         //
         bool fScrollOccurred = false;
+
+        if (   IsAcceleratedScrollEnabled()
+            && pNode->HasScrollableArea()
+            && pNode->m_pScrollBag->scrollOccurred)
+        {
+            // Count every scrolled area, so the per frame hit rate reflects the
+            // scrolls that fell back to regular dirty region handling too.
+            m_pScrollAreas->cScrollCandidates++;
+        }
         
-        if (ScrollHandlingRequired(pNode))
+        if (ScrollHandlingRequired(pNode, pDirtyRegion))
         {            
-            ScrollableAreaHandling(pNode, pDirtyRegion, &fScrollOccurred);
+            IFC(ScrollableAreaHandling(pNode, pDirtyRegion, &fScrollOccurred));
         }
 
         if (!fScrollOccurred)
@@ -259,20 +275,32 @@ CPreComputeContext::PreSubgraph(
         // Convert old bounds to world space, intersect with clip
         CRectF<CoordinateSpace::PageInPixels> bboxWorld;
         TransformBoundsToWorldAndClip(&pNode->m_Bounds, &bboxWorld);
-        CRectF<CoordinateSpace::PageInPixels> bboxWorldClipped = bboxWorld;
 
-        // If the bounds of this node are intersecting the previously scrolled area, 
-        if (bboxWorldClipped.Intersect(m_scrolledClipArea))
+        bool fOverlapsScrolledArea = false;
+
+        for (UINT i = 0; i < m_cScrollsCompleted; i++)
+        {
+            const ScrollArea &scrollArea = m_pScrollAreas->rgScrollAreas[i];
+            CRectF<CoordinateSpace::PageInPixels> bboxWorldClipped = bboxWorld;
+
+            // If the bounds of this node are intersecting a previously scrolled area, 
+            if (bboxWorldClipped.Intersect(scrollArea.clipRect))
+            {
+                // Take old bounds, scroll offset, then interset with scroll clip, add to dirty region
+                CRectF<CoordinateSpace::PageInPixels> offsetBounds = bboxWorldClipped;
+                offsetBounds.Offset(static_cast<float>(scrollArea.scrollX), static_cast<float>(scrollArea.scrollY));
+
+                IFC(pDirtyRegion->Add(&offsetBounds));
+
+                fOverlapsScrolledArea = true;
+            }
+        }
+
+        if (fOverlapsScrolledArea)
         {
             // Take old bounds add to dirty region (so we can disable the children of this node from getting walked
             // and checked by this logic)
             IFC(pDirtyRegion->Add(&bboxWorld));            
-        
-            // Take old bounds, scroll offset, then interset with scroll clip, add to dirty region
-            CRectF<CoordinateSpace::PageInPixels> offsetBounds = bboxWorldClipped;
-            offsetBounds.Offset(static_cast<float>(m_pScrollAreaParameters->scrollX), static_cast<float>(m_pScrollAreaParameters->scrollY));
-
-            IFC(pDirtyRegion->Add(&offsetBounds));
 
             pNode->m_fHasBoundingBoxAdded = TRUE;
             pDirtyRegion->Disable();
@@ -394,9 +422,8 @@ CPreComputeContext::PostSubgraph()
 
         IFC(pNode->CollectAdditionalDirtyRegion(pDirtyRegion, 
                                                 pTop, 
-                                                ScrollHasCompleted() ? m_pScrollAreaParameters->scrollX : 0,
-                                                ScrollHasCompleted() ? m_pScrollAreaParameters->scrollY : 0,
-                                                m_scrolledClipArea,
+                                                m_cScrollsCompleted,
+                                                ScrollHasCompleted() ? m_pScrollAreas->rgScrollAreas : NULL,
                                                 pClip
                                                 ));
     }
@@ -437,16 +464,7 @@ CPreComputeContext::PostSubgraph()
         || (pNode->m_fIsDirtyForRenderInSubgraph && pNode->m_pEffect != NULL)
        )
     {
-        if (pNode->m_fNodeWasScrolled)
-        {
-            m_fScrollHasCompleted = true;
-
-            // Save the area which was scrolled, so that we can detect overlapping content 
-            // that is a "peer" (ie not in the child chain of this node) in the rest of the
-            // precompute walk and treat it appropriately for dirtiness.
-            m_scrolledClipArea = m_pScrollAreaParameters->clipRect;
-        }
-        else
+        if (!pNode->m_fNodeWasScrolled)
         {                
             pDirtyRegion->Enable();
 
@@ -469,8 +487,15 @@ CPreComputeContext::PostSubgraph()
         Assert(IsAcceleratedScrollEnabled());
         Assert(pNode->m_pScrollBag);
 
-        // Scroll has completed. Mark this in the precompute context
-        m_fScrollHasCompleted = true;
+        Assert(m_fScrollInProgress);
+        Assert(m_cScrollsCompleted + 1 == m_pScrollAreas->cScrollAreas);
+
+        // Scroll has completed. Mark this in the precompute context, so that we can
+        // detect overlapping content that is a "peer" (ie not in the child chain of
+        // this node) in the rest of the precompute walk and treat it appropriately
+        // for dirtiness.
+        m_cScrollsCompleted++;
+        m_fScrollInProgress = false;
     }
 
     if (pNode->m_pScrollBag)
@@ -485,6 +510,20 @@ CPreComputeContext::PostSubgraph()
         PopEffect();
     }
 
+    //
+    // The stored output of this node's Effect is stale if anything below the
+    // Effect changed. Changes of the offset alone are applied when the output
+    // is drawn and keep it valid.
+    //
+    if (pNode->m_pEffect != NULL
+        && (   pNode->m_fIsDirtyForRenderInSubgraph
+            || pNode->m_fHasContentChanged
+            || pNode->m_fHasAdditionalDirtyRegion
+            || pNode->m_fHasStateOtherThanOffsetChanged))
+    {
+        pNode->m_pComposition->GetEffectResultCacheNoRef()->Invalidate(pNode);
+    }
+
     pNode->m_fIsDirtyForRender = FALSE;
     pNode->m_fIsDirtyForRenderInSubgraph = FALSE;
     pNode->m_fNeedsBoundingBoxUpdate = FALSE;
@@ -1021,8 +1060,9 @@ Cleanup:
 //           - Presence of other intermediates - DB/VB do not end up passing the enabling arguments to PreCompute, and are
 //             thus automatically excluded
 //           - Presence of a rotation transform anywhere above the visual
-//           - No previous accelerated scrolls have occurred for this frame (multiple "scroll areas" can be set simultaneously,
-//             just not scrolled on the same frame)
+//           - The visual is not nested inside another area being scrolled on this frame, and neither its clip nor its
+//             bounds overlap an area scrolled earlier on this frame (up to MAX_SCROLL_AREAS_PER_FRAME disjoint areas
+//             can be scrolled on the same frame)
 //      5. If all preconditions are met when precompute arrives at the Visual on which the scroll has occurred, this function
 //         gets called! (ScrollableAreaHandling)
 //           - This function will calculate the area of the clip, then use the pixel snapped offset (calculate in world space by 
@@ -1030,7 +1070,7 @@ Cleanup:
 //             rectangles.
 //           - This function will also calculate the "newly exposed area" that still must be added as a dirty region, and add
 //             it to te dirty region collector.
-//           - It also stores the scroll parameters it calculated on CPreComputeContext::m_pScrollAreaParameters for later use
+//           - It also appends the scroll parameters it calculated to CPreComputeContext::m_pScrollAreas for later use
 //      6. After this function returns, it notifies PreSubgraph via the pScrollOccurred out argument, whether an accelerated
 //         scroll can occur. If it can, PreSubgraph makes a number of behavior modifications based on that information:
 //           - It doesn't add the bounding box of the visual to the dirty region 
@@ -1055,7 +1095,8 @@ Cleanup:
 //      9. From here, things thankfully get simpler. Once the precompute walk is complete we have the information required
 //         to perform the accelerated scroll, and a complete set of additional dirty regions that need to be redrawn after the
 //         scroll occurs
-//      A. Before render, we issue the ScrollBlt to the software render target. The render target will scroll all associated buffers
+//      A. Before render, we issue one ScrollBlt per accelerated area to the software render target, in the order the areas
+//         were found by the walk. The render target will scroll all associated buffers
 //         (front buffer, back buffer, and any color conversion buffers) so that they are all synchronized (which is necessary in case
 //         we present again in future without rendering in response to a WM_PAINT, etc. It may defer the scroll to the front buffer until
 //         after rendering so that all the GDI operations on the FB get batched together and there is less chance of tearing.
@@ -1072,10 +1113,10 @@ HRESULT CPreComputeContext::ScrollableAreaHandling(
     HRESULT hr = S_OK;
     
     Assert(pNode);
-    Assert(ScrollHandlingRequired(pNode));
-    Assert(m_fScrollHasBegun == false);
+    Assert(ScrollHandlingRequired(pNode, pDirtyRegion));
+    Assert(!ScrollHasBegun());
     Assert(pNode->m_fNodeWasScrolled == false);
-    Assert(m_pScrollAreaParameters->fDoScroll == false);            
+    Assert(m_pScrollAreas->cScrollAreas < MAX_SCROLL_AREAS_PER_FRAME);
 
     bool fScrollOccurred = false;
 
@@ -1225,23 +1266,55 @@ HRESULT CPreComputeContext::ScrollableAreaHandling(
         scrollClipRectFinalF.top = static_cast<float>(static_cast<int>(scrollClipRectFinal.top));
         scrollClipRectFinalF.bottom = static_cast<float>(static_cast<int>(scrollClipRectFinal.bottom));
 
-        m_pScrollAreaParameters->destination = dest;
-        m_pScrollAreaParameters->source = source;
-        m_pScrollAreaParameters->fDoScroll = true;
-        m_pScrollAreaParameters->clipRect = scrollClipRectFinalF;
-        m_pScrollAreaParameters->scrollX = offsetX;
-        m_pScrollAreaParameters->scrollY = offsetY;
+        //
+        // The ScrollBlts of one frame are issued back to back before anything is
+        // rendered, so an area may only be accelerated if neither its clip nor
+        // the old bounds of its node touch an area scrolled earlier in the walk.
+        // Otherwise the second blt would move pixels that the first one left
+        // stale, and the peer overlap handling in PreSubgraph would invalidate
+        // the whole node anyway.
+        //
+        CRectF<CoordinateSpace::PageInPixels> bboxOldWorld;
+        TransformBoundsToWorldAndClip(&pNode->m_Bounds, &bboxOldWorld);
+
+        bool fOverlapsScrolledArea = false;
+
+        for (UINT i = 0; i < m_cScrollsCompleted; i++)
+        {
+            const CRectF<CoordinateSpace::PageInPixels> &scrolledClip = m_pScrollAreas->rgScrollAreas[i].clipRect;
+
+            if (   scrollClipRectFinalF.DoesIntersect(scrolledClip)
+                || bboxOldWorld.DoesIntersect(scrolledClip))
+            {
+                fOverlapsScrolledArea = true;
+                break;
+            }
+        }
+
+        if (!fOverlapsScrolledArea)
+        {
+            ScrollArea *pScrollArea = &m_pScrollAreas->rgScrollAreas[m_pScrollAreas->cScrollAreas];
 
-        m_fScrollHasBegun = true;
-        pNode->m_fNodeWasScrolled = true;
+            pScrollArea->destination = dest;
+            pScrollArea->source = source;
+            pScrollArea->fDoScroll = true;
+            pScrollArea->clipRect = scrollClipRectFinalF;
+            pScrollArea->scrollX = offsetX;
+            pScrollArea->scrollY = offsetY;
 
-        CRectF<CoordinateSpace::PageInPixels> bboxWorld = CRectF<CoordinateSpace::PageInPixels>::ReinterpretNonSpaceTyped(verticalScrollRectF);
-        IFC(pDirtyRegion->Add(&bboxWorld));
+            m_pScrollAreas->cScrollAreas++;
 
-        bboxWorld = CRectF<CoordinateSpace::PageInPixels>::ReinterpretNonSpaceTyped(horizontalScrollRectF);
-        IFC(pDirtyRegion->Add(&bboxWorld));
+            m_fScrollInProgress = true;
+            pNode->m_fNodeWasScrolled = true;
 
-        fScrollOccurred = true;
+            CRectF<CoordinateSpace::PageInPixels> bboxWorld = CRectF<CoordinateSpace::PageInPixels>::ReinterpretNonSpaceTyped(verticalScrollRectF);
+            IFC(pDirtyRegion->Add(&bboxWorld));
+
+            bboxWorld = CRectF<CoordinateSpace::PageInPixels>::ReinterpretNonSpaceTyped(horizontalScrollRectF);
+            IFC(pDirtyRegion->Add(&bboxWorld));
+
+            fScrollOccurred = true;
+        }
     }
 
     *pScrollOccurred = fScrollOccurred;
@@ -1254,14 +1327,23 @@ Cleanup:
 
 bool 
 CPreComputeContext::ScrollHandlingRequired(
-        __in CMilVisual const *pNode
+        __in CMilVisual const *pNode,
+        __in CDirtyRegion2 const *pDirtyRegion
         )
 {
+    //
+    // ScrollBlts operate on the target, so only scrolls whose exposed areas are
+    // collected into the root dirty region can be accelerated. Scrolls nested
+    // in an area that is already being scrolled this frame are left to the
+    // regular dirty region handling, as are any beyond the per frame limit.
+    //
     return (   pNode->CanBeScrolled() 
-            && (m_pScrollAreaParameters != NULL) 
+            && (m_pScrollAreas != NULL) 
             && (pNode->m_pScrollBag->scrollOccurred)
             && !EffectsInParentChain()
-            && (m_fScrollHasBegun == false)
+            && !ScrollHasBegun()
+            && (m_pScrollAreas->cScrollAreas < MAX_SCROLL_AREAS_PER_FRAME)
+            && (pDirtyRegion == &m_rootDirtyRegion)
             );
 }
 
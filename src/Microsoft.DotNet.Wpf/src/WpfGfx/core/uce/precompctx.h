@@ -62,6 +62,28 @@ typedef struct ScrollAreaStruct
     CMILSurfaceRect destination;
 } ScrollArea;
 
+// Maximum number of scrollable areas that can be accelerated in one frame.
+// Further scrolls in the same frame are rendered through dirty regions.
+#define MAX_SCROLL_AREAS_PER_FRAME 8
+
+//----------------------------------------------------------------------------------
+//  Struct:
+//      ScrollAreaList
+//
+//  Synopsis:
+//      The accelerated scrolls collected by one precompute walk, in the order
+//      in which their ScrollBlts must be issued. cScrollCandidates counts the
+//      scrolled areas encountered by the walk, whether or not they could be
+//      accelerated, so that the hit rate can be reported per frame.
+//----------------------------------------------------------------------------------
+
+typedef struct ScrollAreaListStruct
+{
+    UINT cScrollAreas;
+    UINT cScrollCandidates;
+    ScrollArea rgScrollAreas[MAX_SCROLL_AREAS_PER_FRAME];
+} ScrollAreaList;
+
 
 //----------------------------------------------------------------------------------
 // Meters
@@ -118,7 +140,7 @@ public:
         __in_ecount_opt(uNumInvalidTargetRegions) MilRectF const *rgInvalidTargetRegions,
         float allowedDirtyRegionOverhead,
         MilBitmapInterpolationMode::Enum defaultInterpolationMode,
-        __in_opt ScrollArea *pScrollArea,        
+        __in_opt ScrollAreaList *pScrollAreas,
         BOOL fDontComputeDirtyRegions = FALSE
         );
 
@@ -130,9 +152,9 @@ public:
     HRESULT PostSubgraph();
 
 private:
-    bool IsAcceleratedScrollEnabled() const { return (m_pScrollAreaParameters != NULL); }
-    bool ScrollHasCompleted() const { return m_fScrollHasCompleted; }
-    bool ScrollHasBegun() const { return m_fScrollHasBegun; }
+    bool IsAcceleratedScrollEnabled() const { return (m_pScrollAreas != NULL); }
+    bool ScrollHasCompleted() const { return m_cScrollsCompleted != 0; }
+    bool ScrollHasBegun() const { return m_fScrollInProgress; }
 
     HRESULT AddToDirtyRegion(
         __in_ecount(1) CDirtyRegion2 *pDirtyRegion,
@@ -177,7 +199,8 @@ private:
         );
 
     bool ScrollHandlingRequired(
-        __in CMilVisual const *pNode
+        __in CMilVisual const *pNode,
+        __in CDirtyRegion2 const *pDirtyRegion
         );
 
     bool EffectsInParentChain() const 
@@ -216,20 +239,19 @@ private:
 
     CMilRectF m_surfaceBounds;
 
-    ScrollArea *m_pScrollAreaParameters;
+    ScrollAreaList *m_pScrollAreas;
 
-    // True for the rest of the scenegraph traversal after _exiting_ a node for which
-    // ScrollHandlingRequired has returned true, and a scroll actually occurred.
-    bool  m_fScrollHasCompleted                         : 1;
+    // Number of entries at the start of m_pScrollAreas->rgScrollAreas whose
+    // scroll node has been _exited_ in PostSubgraph. Content visited after
+    // that which overlaps one of these areas has to be redrawn at its
+    // scrolled position too.
+    UINT m_cScrollsCompleted;
 
-    // Set in PreCompute as soon as a node is hit for which scrolling is available and will
-    // be executed. Is used later to check that other scrolls don't occur also. We allow
-    // multiple scroll areas to exist in the tree simultaneously, but only one accelerated
-    // scroll per frame
-    bool m_fScrollHasBegun                              : 1;
-    
-    // The clip area for the scroll that occurred. Only valid when m_fScrollHasOccurred is true
-    CRectF<CoordinateSpace::PageInPixels>               m_scrolledClipArea;
+    // True between entering and exiting a node whose scroll is being
+    // accelerated. Scrolls nested inside it are not accelerated in the same
+    // frame, since their source pixels have already been moved by the outer
+    // ScrollBlt; they fall back to regular dirty region handling.
+    bool m_fScrollInProgress;
 
     // Effect stack count. Keeps track of how many nodes in the parent chain returned true for
     // CMilVisual::HasEffects
@@ -45,6 +45,7 @@ Environment:
 #include "htslave.h"
 #include "generated_resource_factory.h"
 
+#include "frametiming.h"
 #include "partition.h"
 #include "partitionmanager.h"
 #include "partitionthread.h"
@@ -52,6 +53,8 @@ Environment:
 #include "crossthreadcomposition.h"
 #include "samethreadcomposition.h"
 
+#include "glyphatlas.h"
+#include "glyphoutlinecache.h"
 #include "glyphcacheslave.h"
 
 //
@@ -91,5 +94,6 @@ Environment:
 #include "VisualCache.h"
 #include "VisualCacheSet.h"
 #include "VisualCacheManager.h"
+#include "EffectResultCache.h"
 
 
@@ -187,6 +187,24 @@ HRESULT WINAPI MILCreateFactory(__deref_out_ecount(1) IMILCoreFactory **ppIFacto
 
 HRESULT WINAPI MILCreateEffectList(__deref_out IMILEffectList **ppIMILEffectList);
 
+/*=========================================================================*\
+
+    Drains up to cFramesMax of the oldest frame timings recorded by the
+    composition engine in this process, see MilFrameTiming. rgFrames->cbSize
+    must be set to sizeof(MilFrameTiming) as the caller knows it; sizes
+    smaller than the fields up to qpcFrameStart, or that misalign the 64 bit
+    fields, fail with E_INVALIDARG. *pcFramesDropped receives the number of
+    frames overwritten because the log was not drained often enough.
+
+\*=========================================================================*/
+
+HRESULT WINAPI MilCompositionEngine_GetFrameTimings(
+    UINT cFramesMax,
+    __inout_bcount(cFramesMax * rgFrames->cbSize) MilFrameTiming *rgFrames,
+    __out_ecount(1) UINT *pcFrames,
+    __out_ecount(1) UINT *pcFramesDropped
+    );
+
 
 
 /*=========================================================================*\
@@ -75,6 +75,77 @@ typedef DWORD MilVertexFormat;
 
 typedef __range(0,MILSP_MAX_HANDLE) UINT MILSPHandle;
 
+/*=========================================================================*\
+    Frame timing types
+
+    MilFrameTiming holds the timings and counters of one composed frame,
+    as returned by MilCompositionEngine_GetFrameTimings. Durations are in
+    microseconds and are summed over all render targets of the composition
+    device.
+
+    Versioning: fields are only ever appended. Callers set cbSize of the
+    first element to the size of the structure they were built against;
+    it is also the stride of the array. Each frame receives that prefix of
+    the engine's structure, and cbSize of every element is set to it.
+
+\*=========================================================================*/
+
+struct MilFrameTiming
+{
+    // Size in bytes of the structure, set by the caller
+    UINT cbSize;
+
+    // Value of the composition frame counter when the frame was composed
+    UINT64 frameNumber;
+
+    // QueryPerformanceCounter value at the start of the frame, 0 if QPC is
+    // not supported
+    UINT64 qpcFrameStart;
+
+    UINT usProcessBatches;
+    UINT usCompose;
+    UINT usPreCompute;
+    UINT usRender;
+    UINT usPresent;
+
+    UINT cBatchesProcessed;
+    UINT cCommandsProcessed;
+    UINT cDirtyRects;
+    UINT cDirtyPixels;
+    UINT cVisualCacheUpdates;
+    UINT cScrolledAreas;
+    UINT cAcceleratedScrolls;
+
+    // Software shader effects run fused with the effect of their only
+    // child, and the bytes of effect intermediates this avoided
+    UINT cFusedEffects;
+    UINT cbEffectIntermediatesSaved;
+
+    // Effects drawn from CEffectResultCache instead of being run, and the
+    // bytes held by the cache at the end of the frame
+    UINT cEffectResultsReused;
+    UINT cbEffectResultCache;
+
+    // Glyph run realizations drawn with the bitmaps they already had, and
+    // those that had to be rasterized first
+    UINT cGlyphRealizationHits;
+    UINT cGlyphRealizationMisses;
+
+    // Glyph run realization bitmaps trimmed from the glyph cache, and the
+    // bytes the cache holds at the end of the frame
+    UINT cGlyphRealizationsTrimmed;
+    UINT cbGlyphRealizations;
+
+    // Bytes of glyph atlas entries first rasterized for a subpixel origin
+    // at the end of the frame, counted apart from cbGlyphRealizations
+    UINT cbGlyphSubpixelVariants;
+
+    // Font face lookups since the process started that were found in the
+    // process wide font face cache, and those that created the face
+    UINT cFontFaceCacheHits;
+    UINT cFontFaceCacheMisses;
+};
+
 #include "Generated\wgx_render_types_generated.h"
 
 